@@ -0,0 +1,59 @@
+/**
+ * @file bench_arith.c
+ * @brief Cost of a counter increment: in-process arithmetic vs `expr`.
+ *
+ * "let" evaluates `i = i + 1` with arith_eval(), "$(( ))" expands
+ * `$((i + 1))` and assigns it (as `i=$((i + 1))` does), and "expr" spawns
+ * `/usr/bin/expr 1 + 1` with output to /dev/null and waits for it: the
+ * floor of what counting cost before the shell had arithmetic.
+ */
+#include "arith.h"
+#include "ast.h"
+#include "env.h"
+#include "launch.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#define ITERATIONS 100000
+#define SPAWNS 500
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+int main(void) {
+    long v = 0;
+    env_assign("i", "0");
+    uint64_t t0 = now_ns();
+    for (int n = 0; n < ITERATIONS; ++n)
+        arith_eval("i = i + 1", &v);
+    uint64_t let_ns = now_ns() - t0;
+
+    arena_t arena;
+    arena_init(&arena, 0);
+    t0 = now_ns();
+    for (int n = 0; n < ITERATIONS; ++n) {
+        arena_mark_t mark = arena_mark(&arena);
+        env_assign("i", expand_word(&arena, "$((i + 1))"));
+        arena_release(&arena, mark);
+    }
+    uint64_t expand_ns = now_ns() - t0;
+    arena_free(&arena);
+
+    char *argv[] = {"expr", "1", "+", "1", NULL};
+    launch_redir_t to_null = {1, REDIR_OUTPUT, "/dev/null"};
+    t0 = now_ns();
+    for (int n = 0; n < SPAWNS; ++n)
+        launch_external("/usr/bin/expr", argv, &to_null, 1);
+    uint64_t expr_ns = now_ns() - t0;
+
+    printf("counter increment (i=%s)\n", env_get("i"));
+    printf("%-10s %12s\n", "case", "ns/op");
+    printf("%-10s %12.1f\n", "let", (double)let_ns / ITERATIONS);
+    printf("%-10s %12.1f\n", "$(( ))", (double)expand_ns / ITERATIONS);
+    printf("%-10s %12.1f\n", "expr", (double)expr_ns / SPAWNS);
+    return 0;
+}
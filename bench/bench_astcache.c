@@ -0,0 +1,100 @@
+/**
+ * @file bench_astcache.c
+ * @brief Cost of starting a script: cold parse vs compiled cache load.
+ *
+ * The script is LINES lines of assignments, tests, loops and function
+ * calls. "parse" is what shell_run_file() does without a cache: map the
+ * file, lex and parse it into a tree, free the tree. "cache load" is what
+ * it does after `myshell --compile`: map the file, hash it, map the cache
+ * file, check it and relocate the image. Neither case runs the script, so
+ * the numbers are pure start-up cost.
+ */
+#include "astcache.h"
+#include "parser.h"
+#include "shell.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LINES 100000
+#define ROUNDS 10
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Map the script; fills st.
+static char *map_script(const char *path, struct stat *st) {
+    int fd = open(path, O_RDONLY);
+    fstat(fd, st);
+    char *text = mmap(NULL, (size_t)st->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    return text;
+}
+
+int main(void) {
+    char dir[] = "/tmp/bench_astcache_XXXXXX";
+    if (!mkdtemp(dir))
+        return 1;
+    char script[64];
+    snprintf(script, sizeof script, "%s/script.sh", dir);
+    setenv("MYSHELL_CACHE_DIR", dir, 1);
+    FILE *f = fopen(script, "w");
+    fprintf(f, "f() { local x=$1; total=$((total + x)); }\n");
+    for (int i = 1; i < LINES; ++i) {
+        switch (i % 4) {
+        case 0: fprintf(f, "v%d=\"value $i\" && echo $v%d > /dev/null\n", i, i); break;
+        case 1: fprintf(f, "if test $i -gt %d; then f %d; else f 1; fi\n", i, i); break;
+        case 2: fprintf(f, "for w in a b c; do case $w in a) n=1 ;; *) n=2 ;; esac; done\n"); break;
+        default: fprintf(f, "while false; do f 2; done | cat 2> /dev/null\n"); break;
+        }
+    }
+    fclose(f);
+    if (shell_compile_file(script) != 0)
+        return 1;
+
+    struct stat st;
+    uint64_t parse_ns = 0, load_ns = 0;
+    int hits = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        uint64_t t0 = now_ns();
+        char *text = map_script(script, &st);
+        lexer_t *lexer = lexer_create_n(text, (size_t)st.st_size);
+        parser_t *parser = parser_create(lexer);
+        ast_node_t *ast = parser_parse_program(parser, NULL);
+        parser_free(parser);
+        lexer_free(lexer);
+        munmap(text, (size_t)st.st_size);
+        ast_free(ast);
+        parse_ns += now_ns() - t0;
+
+        t0 = now_ns();
+        text = map_script(script, &st);
+        astcache_image_t image;
+        hits += astcache_load(script, &st, text, (size_t)st.st_size, &image) == 0;
+        munmap(text, (size_t)st.st_size);
+        astcache_release(&image);
+        load_ns += now_ns() - t0;
+    }
+
+    char cache[256];
+    struct stat cst = {0};
+    if (astcache_path(script, cache, sizeof cache) == 0)
+        stat(cache, &cst);
+    printf("script start-up, %d lines, %lld bytes, cache %lld bytes (hits %d/%d)\n", LINES,
+           (long long)st.st_size, (long long)cst.st_size, hits, ROUNDS);
+    printf("%-12s %12s\n", "case", "ms/start");
+    printf("%-12s %12.2f\n", "parse", parse_ns / 1e6 / ROUNDS);
+    printf("%-12s %12.2f\n", "cache load", load_ns / 1e6 / ROUNDS);
+    unlink(cache);
+    unlink(script);
+    rmdir(dir);
+    return 0;
+}
@@ -0,0 +1,101 @@
+/**
+ * @file bench_evloop.c
+ * @brief Dispatch latency of the event loop backends vs. registered fds.
+ *
+ * For each backend and each registration count, N eventfds are registered
+ * and one of them (chosen pseudo-randomly) is signalled per round; the
+ * time from evloop_run() entry to the callback stopping the loop is
+ * averaged over many rounds.
+ */
+#include "evloop.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ROUNDS 20000
+
+typedef struct {
+    evloop_t *loop;
+    long hits;
+} bench_ctx_t;
+
+static void on_ready(int fd, void *data) {
+    bench_ctx_t *ctx = data;
+    uint64_t v;
+    (void)!read(fd, &v, sizeof v);
+    ctx->hits++;
+    evloop_stop(ctx->loop);
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// Returns mean ns per dispatch, or -1 if the backend cannot hold n fds.
+static double run_case(const char *backend, int n) {
+    evloop_t *loop = evloop_create_backend(backend);
+    if (!loop)
+        return -1;
+    bench_ctx_t ctx = {loop, 0};
+    int *fds = malloc(sizeof(int) * (size_t)n);
+    int ok = 1;
+    int opened = 0;
+    for (; opened < n; ++opened) {
+        fds[opened] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fds[opened] < 0 || evloop_add_fd(loop, fds[opened], EVLOOP_READ, on_ready, &ctx) != 0) {
+            if (fds[opened] >= 0)
+                close(fds[opened]);
+            ok = 0;
+            break;
+        }
+    }
+
+    double total = 0;
+    if (ok) {
+        unsigned seed = 12345;
+        uint64_t one = 1;
+        for (int r = 0; r < ROUNDS; ++r) {
+            seed = seed * 1103515245u + 12345u;
+            int fd = fds[(seed >> 8) % (unsigned)n];
+            (void)!write(fd, &one, sizeof one);
+            double t0 = now_ns();
+            evloop_run(loop, -1);
+            total += now_ns() - t0;
+        }
+    }
+
+    evloop_free(loop);
+    for (int i = 0; i < opened; ++i)
+        close(fds[i]);
+    free(fds);
+    return ok && ctx.hits == ROUNDS ? total / ROUNDS : -1;
+}
+
+int main(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    const char *backends[] = {"epoll", "poll", "select"};
+    const int counts[] = {10, 100, 1000};
+    printf("evloop dispatch latency (%d rounds, one ready fd per round)\n", ROUNDS);
+    printf("%-8s %8s %14s\n", "backend", "fds", "ns/dispatch");
+    for (size_t b = 0; b < sizeof backends / sizeof *backends; ++b) {
+        for (size_t c = 0; c < sizeof counts / sizeof *counts; ++c) {
+            double ns = run_case(backends[b], counts[c]);
+            if (ns < 0)
+                printf("%-8s %8d %14s\n", backends[b], counts[c], "n/a");
+            else
+                printf("%-8s %8d %14.0f\n", backends[b], counts[c], ns);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+/**
+ * @file bench_expand.c
+ * @brief Word expansion cost for argument-heavy commands.
+ *
+ * Expands a 5000-word argv (half plain words, half `$NAME`/`${NAME%pat}`
+ * words, as in generated scripts) the way exec_command() does, into an
+ * arena released after each command, and compares it with
+ * expand_variables(), which returns one malloc'ed string per word.
+ */
+#include "env.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define WORDS 5000
+#define ITERATIONS 200
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+int main(void) {
+    static char *words[WORDS];
+    char buf[64];
+    env_assign("BENCH_DIR", "/var/tmp/build");
+    env_assign("BENCH_FILE", "output.tar.gz");
+    for (int i = 0; i < WORDS; ++i) {
+        switch (i % 4) {
+        case 0:
+        case 1:
+            snprintf(buf, sizeof buf, "--flag-%d", i);
+            break;
+        case 2:
+            snprintf(buf, sizeof buf, "$BENCH_DIR/obj%d.o", i);
+            break;
+        default:
+            snprintf(buf, sizeof buf, "${BENCH_FILE%%.tar.gz}-%d", i);
+            break;
+        }
+        words[i] = strdup(buf);
+    }
+
+    arena_t arena;
+    arena_init(&arena, 0);
+    size_t sink = 0;
+    uint64_t t0 = now_ns();
+    for (int it = 0; it < ITERATIONS; ++it) {
+        arena_mark_t mark = arena_mark(&arena);
+        char **argv = arena_alloc(&arena, sizeof(char *) * (WORDS + 1));
+        for (int i = 0; i < WORDS; ++i)
+            argv[i] = expand_word(&arena, words[i]);
+        argv[WORDS] = NULL;
+        sink += (size_t)argv[WORDS - 1][0];
+        arena_release(&arena, mark);
+    }
+    uint64_t arena_ns = now_ns() - t0;
+
+    t0 = now_ns();
+    for (int it = 0; it < ITERATIONS; ++it) {
+        char **argv = malloc(sizeof(char *) * (WORDS + 1));
+        for (int i = 0; i < WORDS; ++i)
+            argv[i] = expand_variables(words[i]);
+        argv[WORDS] = NULL;
+        sink += (size_t)argv[WORDS - 1][0];
+        for (int i = 0; i < WORDS; ++i)
+            free(argv[i]);
+        free(argv);
+    }
+    uint64_t heap_ns = now_ns() - t0;
+
+    printf("expansion, %d words x %d commands (%zu)\n", WORDS, ITERATIONS, sink);
+    printf("%-18s %12s\n", "case", "ns/word");
+    printf("%-18s %12.1f\n", "arena", (double)arena_ns / (WORDS * ITERATIONS));
+    printf("%-18s %12.1f\n", "malloc per word", (double)heap_ns / (WORDS * ITERATIONS));
+    arena_free(&arena);
+    for (int i = 0; i < WORDS; ++i)
+        free(words[i]);
+    return 0;
+}
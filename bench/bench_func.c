@@ -0,0 +1,77 @@
+/**
+ * @file bench_func.c
+ * @brief Cost of calling a reusable snippet: function vs `source`.
+ *
+ * The snippet adds its two arguments to a counter. "function" defines it
+ * once as `add() { ... }` and calls `add 1 2` from a parsed loop, so each
+ * call is a table lookup plus a walk of the stored body. "source" keeps
+ * the same body in a file and runs `source file 1 2`, which opens, maps
+ * and parses the file on every call: the only way to reuse code before
+ * functions existed.
+ */
+#include "ast.h"
+#include "env.h"
+#include "exec.h"
+#include "parser.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CALLS 20000
+#define STR(x) #x
+#define XSTR(x) STR(x)
+
+static const char body[] = "local sum=$(( $1 + $2 ))\ncount=$(( count + sum ))\n";
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void run_text(const char *text) {
+    lexer_t *lexer = lexer_create(text);
+    parser_t *parser = parser_create(lexer);
+    ast_node_t *ast = parser_parse_program(parser, NULL);
+    if (ast)
+        exec_ast(ast);
+    ast_free(ast);
+    parser_free(parser);
+    lexer_free(lexer);
+}
+
+int main(void) {
+    char path[] = "/tmp/bench_func_XXXXXX";
+    int fd = mkstemp(path);
+    FILE *f = fdopen(fd, "w");
+    // `local` only works in functions: a sourced file uses a plain variable
+    fprintf(f, "sum=$(( $1 + $2 ))\ncount=$(( count + sum ))\n");
+    fclose(f);
+
+    char text[512];
+    snprintf(text, sizeof text, "add() {\n%s}\n"
+             "i=0; while [ $i -lt " XSTR(CALLS) " ]; do add 1 2; i=$((i + 1)); done",
+             body);
+    env_assign("count", "0");
+    uint64_t t0 = now_ns();
+    run_text(text);
+    uint64_t func_ns = now_ns() - t0;
+    long func_count = strtol(env_get("count"), NULL, 10);
+
+    snprintf(text, sizeof text,
+             "i=0; while [ $i -lt " XSTR(CALLS) " ]; do source %s 1 2; i=$((i + 1)); done",
+             path);
+    env_assign("count", "0");
+    t0 = now_ns();
+    run_text(text);
+    uint64_t source_ns = now_ns() - t0;
+    unlink(path);
+
+    printf("snippet calls, %d calls (count=%ld/%s)\n", CALLS, func_count, env_get("count"));
+    printf("%-10s %12s %12s\n", "case", "ms total", "ns/call");
+    printf("%-10s %12.1f %12.1f\n", "function", func_ns / 1e6, (double)func_ns / CALLS);
+    printf("%-10s %12.1f %12.1f\n", "source", source_ns / 1e6, (double)source_ns / CALLS);
+    return 0;
+}
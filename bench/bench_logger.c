@@ -0,0 +1,98 @@
+/**
+ * @file bench_logger.c
+ * @brief Producer-side latency of LOG_* calls under contention.
+ *
+ * 1, 4 and 16 threads each issue a fixed number of LOG_INFO calls while
+ * the consumer thread writes to /dev/null. Every call is timed and the
+ * mean, median and 99th percentile are reported per thread count, along
+ * with the number of messages dropped because the ring was full.
+ */
+#include "logger.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CALLS_PER_THREAD 50000
+
+typedef struct {
+    int id;
+    uint64_t *samples;
+    pthread_barrier_t *start;
+} worker_t;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void *producer(void *arg) {
+    worker_t *w = arg;
+    pthread_barrier_wait(w->start);
+    for (int i = 0; i < CALLS_PER_THREAD; ++i) {
+        uint64_t t0 = now_ns();
+        LOG_INFO("worker %d iteration %d value %s", w->id, i, "payload");
+        w->samples[i] = now_ns() - t0;
+    }
+    return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void run_case(int threads) {
+    size_t total = (size_t)threads * CALLS_PER_THREAD;
+    uint64_t *samples = malloc(sizeof(uint64_t) * total);
+    pthread_t *tids = malloc(sizeof(pthread_t) * (size_t)threads);
+    worker_t *workers = malloc(sizeof(worker_t) * (size_t)threads);
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, (unsigned)threads);
+
+    unsigned long dropped_before = logger_dropped();
+    logger_init();
+    logger_set_level(LOG_LEVEL_INFO);
+    for (int t = 0; t < threads; ++t) {
+        workers[t] = (worker_t){t, samples + (size_t)t * CALLS_PER_THREAD, &start};
+        pthread_create(&tids[t], NULL, producer, &workers[t]);
+    }
+    for (int t = 0; t < threads; ++t)
+        pthread_join(tids[t], NULL);
+    logger_shutdown();
+
+    double sum = 0;
+    for (size_t i = 0; i < total; ++i)
+        sum += (double)samples[i];
+    qsort(samples, total, sizeof(uint64_t), cmp_u64);
+    printf("%-8d %12.0f %12lu %12lu %12lu\n", threads, sum / (double)total,
+           (unsigned long)samples[total / 2], (unsigned long)samples[total * 99 / 100],
+           logger_dropped() - dropped_before);
+
+    pthread_barrier_destroy(&start);
+    free(workers);
+    free(tids);
+    free(samples);
+}
+
+int main(void) {
+    // The consumer's output is not what is being measured.
+    int devnull = open("/dev/null", O_WRONLY);
+    int saved = dup(STDERR_FILENO);
+    dup2(devnull, STDERR_FILENO);
+    close(devnull);
+
+    printf("logger producer latency, %d calls per thread\n", CALLS_PER_THREAD);
+    printf("%-8s %12s %12s %12s %12s\n", "threads", "mean ns", "p50 ns", "p99 ns", "dropped");
+    const int counts[] = {1, 4, 16};
+    for (int i = 0; i < 3; ++i)
+        run_case(counts[i]);
+
+    dup2(saved, STDERR_FILENO);
+    close(saved);
+    return 0;
+}
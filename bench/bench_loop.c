@@ -0,0 +1,73 @@
+/**
+ * @file bench_loop.c
+ * @brief Cost of a loop iteration: cached loop tree vs re-parsing the body.
+ *
+ * Both cases count i up to ITERATIONS with a body of builtins
+ * (`test`, an arithmetic assignment and a `case`). "while (tree)" parses
+ * one while loop and runs it, so every iteration reuses the same nodes
+ * and only expands words. "re-parse" drives the loop from C the way it
+ * had to be done without loop syntax: each iteration lexes, parses, runs
+ * and frees the text of the condition plus body.
+ */
+#include "ast.h"
+#include "env.h"
+#include "exec.h"
+#include "parser.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define ITERATIONS 100000
+#define STR(x) #x
+#define XSTR(x) STR(x)
+
+static const char loop_text[] =
+    "while test $i -lt " XSTR(ITERATIONS) "; do\n"
+    "  i=$((i + 1))\n"
+    "  case $i in *0) n=$((n + 1)) ;; esac\n"
+    "done\n";
+
+static const char step_text[] =
+    "test $i -lt " XSTR(ITERATIONS) " && i=$((i + 1)) && "
+    "case $i in *0) n=$((n + 1)) ;; esac";
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int run_text(const char *text) {
+    lexer_t *lexer = lexer_create(text);
+    parser_t *parser = parser_create(lexer);
+    ast_node_t *ast = parser_parse_program(parser, NULL);
+    int rc = ast ? exec_ast(ast) : -1;
+    ast_free(ast);
+    parser_free(parser);
+    lexer_free(lexer);
+    return rc;
+}
+
+int main(void) {
+    env_assign("i", "0");
+    env_assign("n", "0");
+    uint64_t t0 = now_ns();
+    run_text(loop_text);
+    uint64_t tree_ns = now_ns() - t0;
+    long tree_n = strtol(env_get("n"), NULL, 10);
+
+    env_assign("i", "0");
+    env_assign("n", "0");
+    t0 = now_ns();
+    while (run_text(step_text) == 0)
+        ;
+    uint64_t reparse_ns = now_ns() - t0;
+
+    printf("loop, %d iterations (n=%ld/%s)\n", ITERATIONS, tree_n, env_get("n"));
+    printf("%-14s %12s %12s\n", "case", "ms total", "ns/iter");
+    printf("%-14s %12.1f %12.1f\n", "while (tree)", tree_ns / 1e6, (double)tree_ns / ITERATIONS);
+    printf("%-14s %12.1f %12.1f\n", "re-parse", reparse_ns / 1e6,
+           (double)reparse_ns / ITERATIONS);
+    return 0;
+}
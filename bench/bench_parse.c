@@ -0,0 +1,104 @@
+/**
+ * @file bench_parse.c
+ * @brief Lex and parse cost for a generated script.
+ *
+ * Parses LINES generated command lines (quoted words, redirections,
+ * pipelines and && lists, as produced by build-script generators) one line
+ * at a time, as shell_run_file() does. "lex (views)" scans with
+ * lexer_next(), "lex (token_t)" with the allocating lexer_next_token(), and
+ * "parse" builds and frees the AST.
+ */
+#include "ast.h"
+#include "parser.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LINES 20000
+#define ITERATIONS 10
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+int main(void) {
+    static char *lines[LINES];
+    size_t bytes = 0;
+    char buf[256];
+    for (int i = 0; i < LINES; ++i) {
+        switch (i % 4) {
+        case 0:
+            snprintf(buf, sizeof buf,
+                     "cc -O2 -Wall -c src/file%d.c -o build/file%d.o -I include -DVERSION=%d", i, i, i);
+            break;
+        case 1:
+            snprintf(buf, sizeof buf, "echo \"building target %d\" '$literal' >> build/log.txt", i);
+            break;
+        case 2:
+            snprintf(buf, sizeof buf, "grep -q pattern%d build/log.txt | sort | uniq -c > /dev/null", i);
+            break;
+        default:
+            snprintf(buf, sizeof buf, "test -f build/file%d.o && mv build/file%d.o out/ || echo missing %d", i, i, i);
+            break;
+        }
+        lines[i] = strdup(buf);
+        bytes += strlen(buf);
+    }
+
+    size_t tokens = 0;
+    uint64_t t0 = now_ns();
+    for (int it = 0; it < ITERATIONS; ++it) {
+        for (int i = 0; i < LINES; ++i) {
+            lexer_t *lexer = lexer_create(lines[i]);
+            while (lexer_next(lexer).type != TOKEN_EOF)
+                tokens++;
+            lexer_free(lexer);
+        }
+    }
+    uint64_t view_ns = now_ns() - t0;
+
+    t0 = now_ns();
+    for (int it = 0; it < ITERATIONS; ++it) {
+        for (int i = 0; i < LINES; ++i) {
+            lexer_t *lexer = lexer_create(lines[i]);
+            token_t *token;
+            while ((token = lexer_next_token(lexer))->type != TOKEN_EOF)
+                token_free(token);
+            token_free(token);
+            lexer_free(lexer);
+        }
+    }
+    uint64_t heap_ns = now_ns() - t0;
+
+    size_t nodes = 0;
+    t0 = now_ns();
+    for (int it = 0; it < ITERATIONS; ++it) {
+        for (int i = 0; i < LINES; ++i) {
+            lexer_t *lexer = lexer_create(lines[i]);
+            parser_t *parser = parser_create(lexer);
+            ast_node_t *ast = parser_parse(parser);
+            nodes += ast != NULL;
+            ast_free(ast);
+            parser_free(parser);
+            lexer_free(lexer);
+        }
+    }
+    uint64_t ns = now_ns() - t0;
+
+    printf("lex + parse, %d lines x %d (%zu tokens, %zu ASTs)\n", LINES, ITERATIONS, tokens,
+           nodes);
+    printf("%-14s %12s %12s\n", "case", "ns/line", "ns/byte");
+    printf("%-14s %12.1f %12.2f\n", "lex (views)", (double)view_ns / (LINES * ITERATIONS),
+           (double)view_ns / ((double)bytes * ITERATIONS));
+    printf("%-14s %12.1f %12.2f\n", "lex (token_t)", (double)heap_ns / (LINES * ITERATIONS),
+           (double)heap_ns / ((double)bytes * ITERATIONS));
+    printf("%-14s %12.1f %12.2f\n", "parse", (double)ns / (LINES * ITERATIONS),
+           (double)ns / ((double)bytes * ITERATIONS));
+    for (int i = 0; i < LINES; ++i)
+        free(lines[i]);
+    return 0;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file bench_script.c
+ * @brief Running a 100k-line generated script: per-line vs parse-once.
+ *
+ * The script mixes assignments with $(( )), `:` and `test ... &&` lines,
+ * all builtins, so lex/parse overhead is visible next to execution.
+ * "per line" reads it with getline() and lexes, parses and frees every
+ * line on its own (what shell_run_file() used to do); "parse once" is
+ * shell_run_file(), which maps the file and parses it into one AST.
+ * "parse only" times parser_parse_program() on the mapped file.
+ */
+#include "ast.h"
+#include "env.h"
+#include "exec.h"
+#include "parser.h"
+#include "shell.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LINES 100000
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int run_per_line(const char *path) {
+    FILE *f = fopen(path, "r");
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t n;
+    int rc = 0;
+    while ((n = getline(&line, &cap, f)) != -1) {
+        if (n > 0 && line[n - 1] == '\n')
+            line[n - 1] = '\0';
+        lexer_t *lexer = lexer_create(line);
+        parser_t *parser = parser_create(lexer);
+        ast_node_t *ast = parser_parse(parser);
+        if (ast) {
+            rc = exec_ast(ast);
+            ast_free(ast);
+        }
+        parser_free(parser);
+        lexer_free(lexer);
+    }
+    free(line);
+    fclose(f);
+    return rc;
+}
+
+int main(void) {
+    char path[] = "/tmp/bench_script_XXXXXX";
+    int fd = mkstemp(path);
+    FILE *f = fdopen(fd, "w");
+    for (int i = 0; i < LINES; ++i) {
+        switch (i % 4) {
+        case 0:
+            fprintf(f, "x=$((x + 1))\n");
+            break;
+        case 1:
+            fprintf(f, ": step %d of the build \"target-%d\" $x\n", i, i);
+            break;
+        case 2:
+            fprintf(f, "test -n \"$x\" && y=$x\n");
+            break;
+        default:
+            fprintf(f, "true\n");
+            break;
+        }
+    }
+    fclose(f);
+
+    env_assign("x", "0");
+    uint64_t t0 = now_ns();
+    run_per_line(path);
+    uint64_t line_ns = now_ns() - t0;
+
+    env_assign("x", "0");
+    t0 = now_ns();
+    shell_run_file(path);
+    uint64_t once_ns = now_ns() - t0;
+
+    struct stat st;
+    fd = open(path, O_RDONLY);
+    fstat(fd, &st);
+    char *text = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    t0 = now_ns();
+    lexer_t *lexer = lexer_create_n(text, (size_t)st.st_size);
+    parser_t *parser = parser_create(lexer);
+    ast_node_t *ast = parser_parse_program(parser, NULL);
+    uint64_t parse_ns = now_ns() - t0;
+    ast_free(ast);
+    parser_free(parser);
+    lexer_free(lexer);
+    munmap(text, (size_t)st.st_size);
+    close(fd);
+    unlink(path);
+
+    printf("script, %d lines (x=%s)\n", LINES, env_get("x"));
+    printf("%-12s %12s %12s\n", "case", "ms total", "ns/line");
+    printf("%-12s %12.1f %12.1f\n", "per line", line_ns / 1e6, (double)line_ns / LINES);
+    printf("%-12s %12.1f %12.1f\n", "parse once", once_ns / 1e6, (double)once_ns / LINES);
+    printf("%-12s %12.1f %12.1f\n", "parse only", parse_ns / 1e6, (double)parse_ns / LINES);
+    return 0;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file bench_startup.c
+ * @brief Shell startup cost: time to first prompt and to run an empty script.
+ *
+ * "first prompt" is shell_init() (everything the shell does before it
+ * prints its first prompt) followed by shell_cleanup(); "empty script"
+ * is the whole lifecycle of `myshell empty.sh`: init, shell_main() on an
+ * empty file, cleanup. Both run in-process many times and report the
+ * mean and median per iteration.
+ */
+#include "shell.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ITERATIONS 2000
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void report(const char *name, uint64_t *samples, int n) {
+    double sum = 0;
+    for (int i = 0; i < n; ++i)
+        sum += (double)samples[i];
+    qsort(samples, (size_t)n, sizeof(uint64_t), cmp_u64);
+    printf("%-14s %12.1f %12.1f\n", name, sum / n / 1000.0, (double)samples[n / 2] / 1000.0);
+}
+
+int main(void) {
+    char script[] = "/tmp/myshell_bench_XXXXXX";
+    int fd = mkstemp(script);
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+    char *argv[] = {"myshell", script, NULL};
+
+    uint64_t *prompt = malloc(sizeof(uint64_t) * ITERATIONS);
+    uint64_t *empty = malloc(sizeof(uint64_t) * ITERATIONS);
+    for (int i = 0; i < ITERATIONS; ++i) {
+        uint64_t t0 = now_ns();
+        shell_init();
+        uint64_t t1 = now_ns();
+        shell_cleanup();
+        prompt[i] = t1 - t0;
+
+        t0 = now_ns();
+        shell_init();
+        shell_main(2, argv);
+        shell_cleanup();
+        empty[i] = now_ns() - t0;
+    }
+
+    printf("shell startup, %d iterations\n", ITERATIONS);
+    printf("%-14s %12s %12s\n", "case", "mean us", "p50 us");
+    report("first prompt", prompt, ITERATIONS);
+    report("empty script", empty, ITERATIONS);
+
+    free(prompt);
+    free(empty);
+    unlink(script);
+    return 0;
+}
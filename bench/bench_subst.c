@@ -0,0 +1,54 @@
+/**
+ * @file bench_subst.c
+ * @brief Command substitution cost by capture path.
+ *
+ * "builtin" expands `$(echo hi)`, captured in-process through a memfd;
+ * "forked builtin" expands `$(echo hi; cd .)`, which has to fork because
+ * cd changes shell state; "external" expands `$(/bin/echo hi)`. "large"
+ * captures the 6.9 MB output of `seq 1 1000000` and reports MB/s.
+ */
+#include "env.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define ITERATIONS 2000
+#define FORKS 300
+#define LARGE 5
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static double per_op(arena_t *arena, const char *word, int n, size_t *bytes) {
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < n; ++i) {
+        arena_mark_t mark = arena_mark(arena);
+        *bytes += strlen(expand_word(arena, word));
+        arena_release(arena, mark);
+    }
+    return (double)(now_ns() - t0) / n;
+}
+
+int main(void) {
+    arena_t arena;
+    arena_init(&arena, 0);
+    size_t bytes = 0;
+    double builtin_ns = per_op(&arena, "$(echo hi)", ITERATIONS, &bytes);
+    double forked_ns = per_op(&arena, "$(echo hi; cd .)", FORKS, &bytes);
+    double external_ns = per_op(&arena, "$(/bin/echo hi)", FORKS, &bytes);
+    bytes = 0;
+    double large_ns = per_op(&arena, "$(seq 1 1000000)", LARGE, &bytes);
+    arena_free(&arena);
+
+    printf("command substitution\n");
+    printf("%-16s %12s\n", "case", "us/op");
+    printf("%-16s %12.2f\n", "builtin", builtin_ns / 1000);
+    printf("%-16s %12.2f\n", "forked builtin", forked_ns / 1000);
+    printf("%-16s %12.2f\n", "external", external_ns / 1000);
+    printf("%-16s %12.1f MB/s\n", "large", (double)bytes / LARGE / large_ns * 1000);
+    return 0;
+}
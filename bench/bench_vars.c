@@ -0,0 +1,67 @@
+/**
+ * @file bench_vars.c
+ * @brief Variable store cost: assignment, lookup and envp rebuilds.
+ *
+ * "assign+get" is one env_assign() plus one env_get() of a shell variable
+ * (what a script loop doing `i=$i...` costs), "envp local" is env_envp()
+ * after assigning an unexported variable (no rebuild), and "envp export"
+ * is env_envp() after changing an exported one (full rebuild). The store
+ * holds the process environment plus VARS extra variables.
+ */
+#include "env.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#define VARS 1000
+#define ITERATIONS 200000
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void report(const char *name, uint64_t elapsed, int n) {
+    printf("%-14s %12.1f\n", name, (double)elapsed / n);
+}
+
+int main(void) {
+    char name[32], value[32];
+    for (int i = 0; i < VARS; ++i) {
+        snprintf(name, sizeof name, "BENCH_VAR_%d", i);
+        env_assign(name, "x");
+    }
+    env_set("BENCH_EXPORTED", "0");
+
+    uint64_t t0 = now_ns();
+    size_t sink = 0;
+    for (int i = 0; i < ITERATIONS; ++i) {
+        snprintf(name, sizeof name, "BENCH_VAR_%d", i % VARS);
+        snprintf(value, sizeof value, "%d", i);
+        env_assign(name, value);
+        sink += env_get(name)[0];
+    }
+    uint64_t assign = now_ns() - t0;
+
+    t0 = now_ns();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        env_assign("BENCH_VAR_0", i & 1 ? "a" : "b");
+        sink += (size_t)(env_envp() != NULL);
+    }
+    uint64_t local = now_ns() - t0;
+
+    t0 = now_ns();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        env_assign("BENCH_EXPORTED", i & 1 ? "a" : "b");
+        sink += (size_t)(env_envp() != NULL);
+    }
+    uint64_t exported = now_ns() - t0;
+
+    printf("variable store, %d variables, %d iterations (%zu)\n", VARS, ITERATIONS, sink);
+    printf("%-14s %12s\n", "case", "ns/op");
+    report("assign+get", assign, ITERATIONS);
+    report("envp local", local, ITERATIONS);
+    report("envp export", exported, ITERATIONS);
+    return 0;
+}
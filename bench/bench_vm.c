@@ -0,0 +1,100 @@
+/**
+ * @file bench_vm.c
+ * @brief Tree walker vs bytecode VM on a long script and on hot loops.
+ *
+ * "script" runs a generated LINES-line list of assignments, tests, &&/||
+ * chains, ifs and cases once; the VM time includes compiling it. "loop"
+ * runs a while loop of ITERATIONS iterations whose body has an if/elif
+ * chain, a case and a function call, so the VM runs a compiled loop and
+ * a compiled function body (compiled on its first call). Both engines run
+ * the same parsed tree and must end with the same counters.
+ */
+#include "ast.h"
+#include "env.h"
+#include "exec.h"
+#include "parser.h"
+#include "vm.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define LINES 100000
+#define ITERATIONS 50000
+#define STR(x) #x
+#define XSTR(x) STR(x)
+
+static const char loop_text[] =
+    "bump() { n=$((n + $1)); }\n"
+    "i=0\n"
+    "while [ $i -lt " XSTR(ITERATIONS) " ]; do\n"
+    "  i=$((i + 1))\n"
+    "  if [ $i -lt 10 ]; then n=$((n + 1)); elif [ $i -lt 100 ]; then n=$((n + 2)); else :; fi\n"
+    "  case $i in *0) bump 3 ;; *5) ;; *) true && n=$((n + 1)) || n=0 ;; esac\n"
+    "done\n";
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static char *script_text(void) {
+    size_t size = (size_t)LINES * 64;
+    char *text = malloc(size);
+    size_t len = 0;
+    for (int i = 0; i < LINES; ++i) {
+        const char *line;
+        switch (i % 4) {
+        case 0: line = "n=$((n + 1))\n"; break;
+        case 1: line = "test $n -gt 0 && m=$n || m=0\n"; break;
+        case 2: line = "if [ $m -eq $n ]; then k=$((k + 1)); fi\n"; break;
+        default: line = "case $k in *7) k=$((k + 3)) ;; *) : ;; esac\n"; break;
+        }
+        len += (size_t)snprintf(text + len, size - len, "%s", line);
+    }
+    return text;
+}
+
+// Run the tree with one engine; returns ns and leaves the counters set.
+static uint64_t run(exec_engine_t engine, ast_node_t *ast) {
+    env_assign("n", "0");
+    env_assign("k", "0");
+    exec_set_engine(engine);
+    uint64_t t0 = now_ns();
+    exec_program(ast);
+    return now_ns() - t0;
+}
+
+static void compare(const char *name, const char *text, int units, const char *unit) {
+    lexer_t *lexer = lexer_create(text);
+    parser_t *parser = parser_create(lexer);
+    ast_node_t *ast = parser_parse_program(parser, NULL);
+
+    uint64_t tree_ns = run(EXEC_ENGINE_TREE, ast);
+    char tree_n[32];
+    snprintf(tree_n, sizeof tree_n, "%s/%s", env_get("n"), env_get("k"));
+    uint64_t vm_ns = run(EXEC_ENGINE_VM, ast);
+    uint64_t t0 = now_ns();
+    vm_program_t *program = vm_compile(ast);
+    uint64_t compile_ns = now_ns() - t0;
+    int length = vm_length(program);
+    vm_free(program);
+
+    printf("%s (n/k tree=%s vm=%s/%s, %d instructions, compile %.2f ms)\n", name, tree_n,
+           env_get("n"), env_get("k"), length, compile_ns / 1e6);
+    printf("  %-6s %12.1f ms %10.1f ns/%s\n", "tree", tree_ns / 1e6, (double)tree_ns / units,
+           unit);
+    printf("  %-6s %12.1f ms %10.1f ns/%s\n", "vm", vm_ns / 1e6, (double)vm_ns / units, unit);
+    ast_free(ast);
+    parser_free(parser);
+    lexer_free(lexer);
+}
+
+int main(void) {
+    char *text = script_text();
+    compare("script, " XSTR(LINES) " lines", text, LINES, "line");
+    free(text);
+    compare("loop, " XSTR(ITERATIONS) " iterations", loop_text, ITERATIONS, "iter");
+    return 0;
+}
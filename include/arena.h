@@ -0,0 +1,64 @@
+/**
+ * @file arena.h
+ * @brief Bump allocator with mark/release for short-lived allocations.
+ *
+ * @details An arena hands out memory from large chunks and frees it all at
+ * once. arena_mark() records the current position and arena_release()
+ * rolls back to it, so nested users (a command expanded while another is
+ * being executed) can share one arena. Released chunks are kept for reuse;
+ * allocations larger than a quarter chunk get a dedicated block that is
+ * freed on release, so one huge word does not pin memory forever.
+ */
+#ifndef ARENA_H
+#define ARENA_H
+/** \defgroup group_arena arena
+ *  @brief Chunked bump allocation with mark/release.
+ *  @{ */
+
+#include <stddef.h>
+
+/** Default chunk size used when arena_init() is given 0. */
+#define ARENA_DEFAULT_CHUNK 4096
+
+typedef struct arena_chunk arena_chunk_t;
+
+/** Arena state; zero-initialized arenas are valid (default chunk size). */
+typedef struct arena {
+    arena_chunk_t *first;   /**< Chunk list (kept across releases). */
+    arena_chunk_t *current; /**< Chunk allocations come from. */
+    arena_chunk_t *large;   /**< Dedicated blocks, newest first. */
+    size_t chunk_size;      /**< Payload size of regular chunks. */
+} arena_t;
+
+/** A position in an arena, from arena_mark(). */
+typedef struct {
+    arena_chunk_t *chunk;
+    size_t used;
+    arena_chunk_t *large;
+} arena_mark_t;
+
+/** Initialize an empty arena; chunk_size 0 selects ::ARENA_DEFAULT_CHUNK. */
+void arena_init(arena_t *arena, size_t chunk_size);
+/** Allocate size bytes aligned for any type. Never returns NULL (aborts on OOM). */
+void *arena_alloc(arena_t *arena, size_t size);
+/** Copy len bytes of s into the arena and NUL-terminate them. */
+char *arena_strndup(arena_t *arena, const char *s, size_t len);
+/** Current position, to roll back to with arena_release(). */
+arena_mark_t arena_mark(const arena_t *arena);
+/** Free everything allocated since mark was taken. */
+void arena_release(arena_t *arena, arena_mark_t mark);
+/** Free everything allocated from the arena, keeping its chunks. */
+void arena_reset(arena_t *arena);
+/**
+ * @brief Move all of other's memory into arena, leaving other empty.
+ *
+ * Allocations made from other stay valid and are freed with arena (by
+ * arena_free(), or by releasing to a mark taken before the call).
+ */
+void arena_adopt(arena_t *arena, arena_t *other);
+/** Return all memory to the system; the arena can be reused afterwards. */
+void arena_free(arena_t *arena);
+
+/** @} */
+
+#endif // ARENA_H
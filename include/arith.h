@@ -0,0 +1,33 @@
+/**
+ * @file arith.h
+ * @brief Shell arithmetic evaluation for $(( )), let and (( )).
+ *
+ * @details Expressions use C integer semantics on signed 64-bit values
+ * (wrapping on overflow) with the usual precedence: unary + - ! ~ and
+ * ++/-- (prefix and postfix), ** (right-associative), * / %, + -, << >>,
+ * relational, equality, & ^ |, && ||, ?: and the assignment operators
+ * = *= /= %= += -= <<= >>= &= ^= |=, then ','. Numbers are decimal,
+ * 0x hex or 0 octal. A variable name evaluates its value as an
+ * expression (unset or empty is 0); assignments store the result as a
+ * shell variable with env_assign().
+ */
+#ifndef ARITH_H
+#define ARITH_H
+/** \defgroup group_arith arithmetic
+ *  @brief Integer expression evaluation.
+ *  @{ */
+
+/**
+ * @brief Evaluate an arithmetic expression.
+ *
+ * An empty expression evaluates to 0. Errors (syntax, division by zero)
+ * are reported on stderr as "myshell: expr: message".
+ * @param expr NUL-terminated expression; parameters already expanded.
+ * @param result Receives the value of the expression.
+ * @return 0 on success, -1 on error.
+ */
+int arith_eval(const char *expr, long *result);
+
+/** @} */
+
+#endif // ARITH_H
@@ -8,6 +8,8 @@
  *  @brief Abstract Syntax Tree nodes and constructors.
  *  @{ */
 
+#include "arena.h"
+
 /** Opaque base node type. */
 typedef struct ast_node ast_node_t;
 /** Opaque command node type. */
@@ -31,7 +33,13 @@ typedef enum {
     AST_BACKGROUND,/**< Background execution of a child node. */
     AST_AND,       /**< Logical AND: execute right only if left succeeded. */
     AST_OR,        /**< Logical OR: execute right only if left failed. */
-    AST_SUBSHELL   /**< Execute child in a subshell environment. */
+    AST_SUBSHELL,  /**< Execute child in a subshell environment. */
+    AST_IF,        /**< if cond; then ...; [else ...;] fi (elif nests in else). */
+    AST_WHILE,     /**< Run body while cond succeeds. */
+    AST_UNTIL,     /**< Run body until cond succeeds. */
+    AST_FOR,       /**< Run body once per word with a variable set to it. */
+    AST_CASE,      /**< Run the body of the first item whose pattern matches. */
+    AST_FUNCTION   /**< name() body: define a function (see func.h). */
 } ast_node_type_t;
 
 /**
@@ -44,11 +52,87 @@ typedef enum {
     REDIR_HEREDOC = 3  /**< '<<' here-doc (stdin from inline data until delimiter). */
 } ast_redir_type_t;
 
+/** One redirection of a command node. */
+typedef struct {
+    int fd;         /**< Target descriptor. */
+    int type;       /**< One of ::ast_redir_type_t. */
+    char *filename; /**< Path, or delimiter for here-docs. */
+} ast_redir_t;
+
+/** One `pattern | pattern ) body ;;` item of a case node. */
+typedef struct {
+    char **patterns; /**< n_patterns patterns, matched with fnmatch(). */
+    int n_patterns;  /**< Number of patterns. */
+    ast_node_t *body;/**< Body to run, NULL if empty. */
+} ast_case_item_t;
+
+/**
+ * @brief Create a command node in an arena (used by the parser).
+ *
+ * A whole tree is built in one arena: the node, its argv array (stored
+ * right after the node) and its redirection list are allocated from it.
+ * The argv strings and filenames are not copied and must live in the same
+ * arena. The tree is freed by handing the arena to the root with
+ * ast_set_arena().
+ * @param argv argc words; a NULL argv gives a command without words.
+ * @param redirs n_redirs redirections, copied into the arena.
+ */
+ast_node_t *ast_arena_command(arena_t *arena, char **argv, int argc, const ast_redir_t *redirs,
+                              int n_redirs);
+/**
+ * @brief Create a non-command node in an arena.
+ *
+ * Binary kinds (pipeline, sequence, and, or) use left and right;
+ * AST_BACKGROUND and AST_SUBSHELL use left as their child; AST_WHILE and
+ * AST_UNTIL use left as the condition and right as the body.
+ */
+ast_node_t *ast_arena_node(arena_t *arena, ast_node_type_t type, ast_node_t *left,
+                           ast_node_t *right);
+/**
+ * @brief Create an if node in an arena. else_part may be NULL, or another
+ * AST_IF for an elif.
+ */
+ast_node_t *ast_arena_if(arena_t *arena, ast_node_t *cond, ast_node_t *then_part,
+                         ast_node_t *else_part);
+/**
+ * @brief Create a for node in an arena.
+ *
+ * The word array is stored after the node like a command's argv; name and
+ * the words themselves must live in the arena.
+ * @param words n_words words expanded at the start of each run of the
+ *        loop; NULL (no `in` clause) loops over the positional parameters.
+ */
+ast_node_t *ast_arena_for(arena_t *arena, char *name, char **words, int n_words,
+                          ast_node_t *body);
+/**
+ * @brief Create a case node in an arena. The items are copied; their
+ * pattern arrays and word must live in the arena.
+ */
+ast_node_t *ast_arena_case(arena_t *arena, char *word, const ast_case_item_t *items,
+                           int n_items);
+/** @brief Create a function definition node in an arena. */
+ast_node_t *ast_arena_function(arena_t *arena, char *name, ast_node_t *body);
+/**
+ * @brief Deep-copy a tree (or subtree) into arena, strings included.
+ *
+ * Used to keep a function body after the tree it was parsed into is
+ * freed. The copy does not own the arena.
+ * @return The copy, or NULL if node is NULL.
+ */
+ast_node_t *ast_copy(arena_t *arena, const ast_node_t *node);
+/**
+ * @brief Make root own arena, a heap-allocated arena holding its tree.
+ *
+ * ast_free(root) then frees the arena and the arena_t itself.
+ */
+void ast_set_arena(ast_node_t *root, arena_t *arena);
+
 /**
  * @brief Create a command node from an argv array (NULL-terminated).
  *
- * Ownership: The function deep-copies argv; caller retains ownership of
- * the original array and strings and must free them separately if allocated.
+ * Ownership: The function deep-copies argv into a new tree arena; caller
+ * retains ownership of the original array and strings and must free them
+ * separately if allocated.
  *
  * @param argv Argument vector ending with NULL; argv[0] is the program.
  * @return Newly allocated AST node; must be freed with ast_free().
@@ -58,8 +142,9 @@ ast_node_t *ast_create_command(char **argv);
 /**
  * @brief Create a pipeline node that connects left | right.
  *
- * Ownership: Takes ownership of left and right nodes; the returned node
- * must be freed with ast_free() which will free the entire subtree.
+ * Ownership: Takes ownership of left and right nodes (their arenas are
+ * merged into one); the returned node must be freed with ast_free() which
+ * will free the entire tree.
  */
 ast_node_t *ast_create_pipeline(ast_node_t *left, ast_node_t *right);
 
@@ -89,14 +174,17 @@ ast_node_t *ast_create_subshell(ast_node_t *child);
  *
  * The redirection applies to the given target file descriptor (fd). Type is
  * one of ast_redir_type_t. The filename is copied; for REDIR_HEREDOC, it
- * carries the delimiter string.
+ * carries the delimiter string. cmd must be the root of its tree (not yet
+ * passed to another constructor). There is no limit on the number of
+ * redirections.
  */
 void ast_command_add_redirection(ast_node_t *cmd, int fd, int type, const char *filename);
 
 /**
- * @brief Recursively free an AST subtree.
+ * @brief Free an AST.
  *
- * Safe to call with NULL. Frees both structure and any copied argv arrays.
+ * Safe to call with NULL. Releases the arena holding the whole tree in one
+ * step; nodes that are not the root of a tree are not freed on their own.
  */
 void ast_free(ast_node_t *node);
 
@@ -0,0 +1,82 @@
+/**
+ * @file astcache.h
+ * @brief On-disk cache of parsed scripts (compiled ASTs).
+ *
+ * @details `myshell --compile script` parses a script once and writes its
+ * tree to a cache file. Later runs of the unchanged script (shell_run_file()
+ * and therefore `source`) map that file and execute the tree in place
+ * instead of lexing and parsing the script again.
+ *
+ * A cache file holds a header, the script's absolute path, an image of
+ * the tree and a relocation table. In the image every pointer is stored as
+ * an offset from the image start, so the image does not depend on where
+ * it is loaded: loading maps the file privately and adds the mapping's
+ * address to each entry of the relocation table. Nodes keep the executor's
+ * in-memory layout; the header records a format version plus the node and
+ * pointer sizes, and a file written by a different build is ignored.
+ *
+ * A cache file is used only if the script's size, modification time
+ * (nanoseconds) and 64-bit content hash all match the ones it was compiled
+ * from, and the hash of its own image and relocation table checks out. Files are named after a hash of the script's absolute
+ * path and live in $MYSHELL_CACHE_DIR, else $XDG_CACHE_HOME/myshell, else
+ * $HOME/.cache/myshell (all read as shell variables).
+ */
+#ifndef ASTCACHE_H
+#define ASTCACHE_H
+/** \defgroup group_astcache script_cache
+ *  @brief Compiled script cache.
+ *  @{ */
+
+#include "ast.h"
+#include <stddef.h>
+#include <sys/stat.h>
+
+/** Version of the cache file format; bumped on any layout or word encoding change. */
+#define ASTCACHE_VERSION 3
+
+/** A tree mapped from a cache file. */
+typedef struct {
+    void *map;        /**< Mapping of the cache file. */
+    size_t map_size;  /**< Size of the mapping. */
+    ast_node_t *root; /**< Root of the tree inside the mapping; NULL for an empty script. */
+} astcache_image_t;
+
+/**
+ * @brief Path of the cache file for a script.
+ * @return 0, or -1 if there is no cache directory or the path does not fit.
+ */
+int astcache_path(const char *script, char *buf, size_t size);
+
+/**
+ * @brief Write the cache file for a parsed script.
+ *
+ * The file is written to a temporary name and renamed into place; the
+ * cache directory is created if needed.
+ * @param script Path of the script.
+ * @param st fstat() of the script, taken before text was read.
+ * @param text, length The script's contents (for the content hash).
+ * @param root Tree parsed from text; NULL for an empty script.
+ * @return 0, or -1 on error (reported with perror()).
+ */
+int astcache_write(const char *script, const struct stat *st, const char *text, size_t length,
+                   const ast_node_t *root);
+
+/**
+ * @brief Map the cache file for a script if it is valid for its contents.
+ *
+ * @param text, length The script's current contents.
+ * @param image Receives the mapped tree; release with astcache_release().
+ * @return 0 on a hit, -1 if there is no usable cache file.
+ */
+int astcache_load(const char *script, const struct stat *st, const char *text, size_t length,
+                  astcache_image_t *image);
+
+/** Unmap a tree returned by astcache_load(). Safe on an empty image. */
+void astcache_release(astcache_image_t *image);
+
+/** 64-bit hash of length bytes (FNV-1a over 8-byte words, in four lanes). */
+unsigned long long astcache_hash(const char *data, size_t length);
+
+/** @} */
+
+#endif // ASTCACHE_H
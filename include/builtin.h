@@ -38,6 +38,8 @@ int builtin_exit(int argc, char **argv);
 int builtin_export(int argc, char **argv);
 /** Unset environment variables. */
 int builtin_unset(int argc, char **argv);
+/** Evaluate each argument as an arithmetic expression (also runs `(( ))`); 0 if the last is non-zero. */
+int builtin_let(int argc, char **argv);
 /** Print current working directory. */
 int builtin_pwd(int argc, char **argv);
 /** List known jobs. */
@@ -50,6 +52,20 @@ int builtin_bg(int argc, char **argv);
 int builtin_type(int argc, char **argv);
 /** Source commands from a file into the current shell. */
 int builtin_source(int argc, char **argv);
+/** Inspect or manage the command path cache (bash-compatible options). */
+int builtin_hash(int argc, char **argv);
+
+// POSIX utility builtins (builtin_posix.c)
+/** Print arguments separated by spaces; supports -n, -e and -E. */
+int builtin_echo(int argc, char **argv);
+/** Formatted output; reuses the format while arguments remain. */
+int builtin_printf(int argc, char **argv);
+/** Evaluate a conditional expression (also registered as "["). */
+int builtin_test(int argc, char **argv);
+/** Return success (also registered as ":"). */
+int builtin_true(int argc, char **argv);
+/** Return failure. */
+int builtin_false(int argc, char **argv);
 
 /** @} */
 
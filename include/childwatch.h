@@ -0,0 +1,74 @@
+/**
+ * @file childwatch.h
+ * @brief Event-driven supervision of child processes.
+ *
+ * @details Each watched child gets a pidfd (pidfd_open(2)) registered with
+ * the shell's event loop; the pidfd becomes readable when the child exits
+ * and the child is reaped from that event. SIGCHLD is blocked and read
+ * from a signalfd(2) so stop/continue notifications are delivered through
+ * the same loop. Kernels without pidfd support fall back to checking the
+ * watched children whenever the signalfd fires.
+ *
+ * The supervisor is bound to the process that called childwatch_init().
+ * In any other process (forked pipeline stages, subshells) or before
+ * initialization, the wait helpers degrade to plain blocking waitpid().
+ */
+#ifndef CHILDWATCH_H
+#define CHILDWATCH_H
+/** \defgroup group_childwatch child_watch
+ *  @brief pidfd/signalfd child reaping on top of the event loop.
+ *  @{ */
+
+#include "evloop.h"
+#include <sys/types.h>
+
+/**
+ * Called when a watched child changes state. status is in waitpid() form
+ * (WIFEXITED/WIFSIGNALED/WIFSTOPPED/WIFCONTINUED apply). The watch is
+ * removed after an exit or termination has been delivered.
+ */
+typedef void (*childwatch_callback_t)(pid_t pid, int status, void *data);
+
+/**
+ * @brief Start supervising children through loop.
+ *
+ * Blocks SIGCHLD in the calling thread and registers a signalfd for it.
+ * Any other thread must keep SIGCHLD blocked as well (the logger thread
+ * blocks all signals), or stop notifications may be lost.
+ * Calling it again while active is a no-op.
+ * @return 0 on success, -1 on error (the shell keeps using waitpid()).
+ */
+int childwatch_init(evloop_t *loop);
+/** Drop all watches, close the signalfd and restore the signal mask. */
+void childwatch_shutdown(void);
+/** Non-zero when the supervisor is active in the calling process. */
+int childwatch_active(void);
+
+/**
+ * @brief Watch a child of the calling process.
+ * @return 0 on success, -1 if the supervisor is inactive or pid is invalid.
+ */
+int childwatch_add(pid_t pid, childwatch_callback_t callback, void *data);
+
+/**
+ * @brief Wait for pid to exit while dispatching other loop events.
+ *
+ * Falls back to blocking waitpid() when the supervisor is inactive.
+ * @param status Receives the waitpid() status; may be NULL.
+ * @return 0 once the child has been reaped, -1 on error.
+ */
+int childwatch_wait(pid_t pid, int *status);
+
+/**
+ * @brief Run the event loop until at least one event was handled.
+ *
+ * Every child event stops the loop, so callers waiting on a condition
+ * (a job leaving the running state, input becoming readable) re-check it
+ * after each call.
+ * @return 0 on success, -1 if the supervisor is inactive or the loop failed.
+ */
+int childwatch_dispatch(void);
+
+/** @} */
+
+#endif // CHILDWATCH_H
@@ -0,0 +1,38 @@
+/**
+ * @file cmdhash.h
+ * @brief Per-shell cache mapping command names to absolute paths.
+ *
+ * @details Lookups fill the table on first use by walking $PATH once;
+ * later lookups are a hash probe. The table is dropped when PATH is
+ * assigned through env_set()/env_unset(), and entries found in a PATH
+ * directory are dropped when that directory (or one searched before it)
+ * changes mtime. Directory mtimes are revalidated at most once per second.
+ */
+#ifndef CMDHASH_H
+#define CMDHASH_H
+/** \defgroup group_cmdhash command_hash
+ *  @brief Cached PATH resolution for external commands.
+ *  @{ */
+
+/**
+ * @brief Resolve a command name through the cache, searching PATH on miss.
+ *
+ * Names containing '/' are not hashed and yield NULL.
+ * @return Absolute path owned by the cache (valid until the next table
+ *         mutation), or NULL if not found.
+ */
+const char *cmdhash_lookup(const char *name);
+/** Return the cached path for name without searching PATH, or NULL. */
+const char *cmdhash_peek(const char *name);
+/** Insert a pinned name -> path mapping (hash -p); never revalidated. */
+int cmdhash_add(const char *name, const char *path);
+/** Forget a single name (hash -d). Returns 0 if it was present. */
+int cmdhash_remove(const char *name);
+/** Forget every entry (hash -r, PATH assignment). */
+void cmdhash_clear(void);
+/** Print the table as "hits<TAB>command" lines; returns the entry count. */
+int cmdhash_print(void);
+
+/** @} */
+
+#endif // CMDHASH_H
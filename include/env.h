@@ -1,27 +1,110 @@
 /**
  * @file env.h
- * @brief Environment variable helpers and expansion.
+ * @brief Shell variable store and expansion.
  */
 #ifndef ENV_H
 #define ENV_H
 /** \defgroup group_env environment
- *  @brief Environment variables and expansion.
+ *  @brief Shell variables, the exported environment, and expansion.
  *  @{ */
 
-// Environment functions
-/** Get the value of an environment variable or NULL if unset. */
+#include "arena.h"
+#include <stddef.h>
+
+// Variable store
+//
+// Variables live in a hash table owned by the shell, seeded from the
+// process environment on first use. Only exported variables are passed to
+// children, through env_envp(), which is rebuilt lazily when an exported
+// variable changes.
+
+/** Get the value of a shell variable or NULL if unset. */
 char *env_get(const char *name);
-/** Set an environment variable (overwrites existing). Returns 0 on success. */
+/** Like env_get() for the name name[0..len), which need not be NUL-terminated. */
+char *env_getn(const char *name, size_t len);
+/** Set a variable and mark it exported. Returns 0, or -1 (EINVAL) for an invalid name. */
 int env_set(const char *name, const char *value);
-/** Unset an environment variable. Returns 0 on success. */
+/** Set a variable, keeping its export flag (new variables are not exported). Returns 0 or -1. */
+int env_assign(const char *name, const char *value);
+/** Mark a variable exported; an unset name is exported once it gets a value. Returns 0 or -1. */
+int env_export(const char *name);
+/** Non-zero if the variable is marked exported. */
+int env_is_exported(const char *name);
+/** Unset a variable. Returns 0 on success (also when it was not set). */
 int env_unset(const char *name);
-/** Snapshot environment as a NULL-terminated array for iteration. */
+/** NULL-terminated "NAME=value" array of exported variables for execve()/posix_spawn(). Valid until the next change. */
+char **env_envp(void);
+/** Snapshot of the exported variables as a NULL-terminated array (same as env_envp()). */
 char **env_get_all(void);
-/** Print all environment variables to stdout in NAME=VALUE form. */
+/** Print all exported variables to stdout in NAME=VALUE form. */
 void env_print(void);
+/** Non-zero if word has the form NAME=value with a valid variable name. */
+int env_is_assignment(const char *word);
+
+// Positional parameters
+
+/** Positional parameters $1, $2, ... (also $#, $@ and $*). */
+typedef struct {
+    char **argv; /**< Parameters; not copied, must outlive their use. */
+    int argc;    /**< Number of parameters. */
+} env_positional_t;
+
+/** Current positional parameters (none at startup). */
+const env_positional_t *env_positional(void);
+/**
+ * @brief Replace the positional parameters.
+ *
+ * The array is referenced, not copied. Callers that set them for a
+ * limited time (function calls, scripts) save *env_positional() first and
+ * set it back afterwards.
+ */
+void env_set_positional(char **argv, int argc);
+/** Drop the first n positional parameters (shift). Returns 0, or -1 if there are fewer than n. */
+int env_shift_positional(int n);
 
 // Variable expansion
-/** Expand $VAR occurrences in a string; returns a newly allocated string. */
+/**
+ * @brief Expand parameters in a word in a single pass.
+ *
+ * Supports $NAME, $? and $$, the positional parameters $1..$9, ${10}...,
+ * $#, $@ and $* (joined with spaces), $((expression)) (see arith.h), command
+ * substitution $(...) and `...` (see exec_capture()), and the braced forms ${NAME}, ${#NAME},
+ * ${NAME-word}, ${NAME:-word}, ${NAME=word}, ${NAME:=word},
+ * ${NAME+word}, ${NAME:+word}, ${NAME#pat}, ${NAME##pat}, ${NAME%pat}
+ * and ${NAME%%pat} (glob patterns, shortest/longest match).
+ * @return word itself when it contains no '$', otherwise a string
+ *         allocated in arena.
+ */
+char *expand_word(arena_t *arena, const char *word);
+/** Words produced by expand_fields(); arrays live in the arena, NULL-terminated. */
+typedef struct {
+    char **words; /**< Fields so far. */
+    int n;        /**< Number of fields. */
+    int cap;      /**< Allocated slots. */
+} expand_fields_t;
+
+/**
+ * @brief Expand a word and append the resulting fields.
+ *
+ * The results of unquoted expansions ($NAME, ${...}, $((...)), $(...) and
+ * `...`) are split at IFS characters (default space, tab, newline; runs
+ * count as one separator); literal text and double-quoted expansions are
+ * not. A word left empty by unquoted expansions yields no field. A word
+ * that is exactly $@ (quoted or not) yields one field per positional
+ * parameter.
+ */
+void expand_fields(arena_t *arena, const char *word, expand_fields_t *fields);
+/**
+ * Exit status of the last command substitution since the previous call, or
+ * -1. Also clears the flag read by expand_failed().
+ */
+int expand_take_status(void);
+/**
+ * Nonzero if an expansion failed (e.g. an arithmetic error, already
+ * reported) since the last expand_take_status().
+ */
+int expand_failed(void);
+/** Expand a string like expand_word(); returns a newly allocated string. */
 char *expand_variables(const char *str);
 
 /** @} */
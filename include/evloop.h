@@ -1,32 +1,69 @@
 /**
  * @file evloop.h
- * @brief Event loop abstraction over select()/epoll().
+ * @brief Event loop abstraction over epoll()/poll()/select().
+ *
+ * @details All backends are built into the binary. evloop_create() uses
+ * the one named by the MYSHELL_EVLOOP environment variable ("epoll",
+ * "poll" or "select"), defaulting to epoll on Linux and poll elsewhere.
+ *
+ * Besides fd readiness a loop runs timers (one timerfd per loop on epoll,
+ * folded into the wait timeout on poll/select) and deferred callbacks,
+ * which run once at the start of the next iteration.
  */
 #ifndef EVLOOP_H
 #define EVLOOP_H
 /** \defgroup group_evloop event_loop
- *  @brief select/epoll event loop abstraction.
+ *  @brief epoll/poll/select event loop abstraction.
  *  @{ */
 
 typedef struct evloop evloop_t;                        /**< Opaque event loop. */
 typedef void (*evloop_callback_t)(int fd, void *data); /**< FD callback. */
+typedef void (*evloop_timer_callback_t)(void *data);   /**< Timer/deferred callback. */
 
-/** Bitmask of interest events. */
+/** Bitmask of interest events and registration flags. */
 typedef enum {
-    EVLOOP_READ = 1,  /**< Read readiness. */
-    EVLOOP_WRITE = 2, /**< Write readiness. */
-    EVLOOP_ERROR = 4  /**< Error condition. */
+    EVLOOP_READ = 1,    /**< Read readiness. */
+    EVLOOP_WRITE = 2,   /**< Write readiness. */
+    EVLOOP_ERROR = 4,   /**< Error condition. */
+    EVLOOP_EDGE = 8,    /**< Report transitions only (EPOLLET); the callback
+                             must drain the fd until EAGAIN. Level-triggered
+                             on poll/select, which is compatible with that. */
+    EVLOOP_ONESHOT = 16 /**< Disarm after one callback (EPOLLONESHOT) until
+                             re-armed with evloop_mod_fd(). */
 } evloop_events_t;
 
 // Event loop functions
-/** Create a new event loop instance. */
+/** Create a new event loop on the backend chosen by MYSHELL_EVLOOP
+ *  (unknown names fall back to the default with a warning). */
 evloop_t *evloop_create(void);
-/** Register a file descriptor with interest events and a callback. */
+/** Create a loop on a specific backend; NULL selects the default.
+ *  Returns NULL (errno ENOENT) if the backend is not built in. */
+evloop_t *evloop_create_backend(const char *name);
+/** Name of the backend a loop runs on ("epoll", "poll" or "select"). */
+const char *evloop_backend_name(const evloop_t *loop);
+/** Register a file descriptor with interest events and a callback.
+ *  Registrations live in a table indexed by fd, so add/mod/remove are
+ *  O(1); registering the same fd twice fails with EEXIST. */
 int evloop_add_fd(evloop_t *loop, int fd, evloop_events_t events,
                   evloop_callback_t callback, void *data);
+/** Replace the interest set/flags of a registered fd (re-arms ONESHOT).
+ *  Returns -1 if fd is not registered. */
+int evloop_mod_fd(evloop_t *loop, int fd, evloop_events_t events);
 /** Unregister a file descriptor from the loop. */
 int evloop_remove_fd(evloop_t *loop, int fd);
-/** Run the loop, optionally with a timeout in milliseconds (-1 = infinite). */
+/** Arm a timer firing after delay_ms, then every interval_ms (0 = once).
+ *  Returns a positive timer id, or -1 on invalid arguments. */
+int evloop_add_timer(evloop_t *loop, int delay_ms, int interval_ms,
+                     evloop_timer_callback_t callback, void *data);
+/** Cancel a pending timer (a callback may cancel its own periodic timer).
+ *  Returns -1 if id is unknown or was a one-shot timer that already fired. */
+int evloop_cancel_timer(evloop_t *loop, int id);
+/** Queue callback to run once at the start of the next loop iteration.
+ *  Callbacks deferred from a deferred callback run an iteration later. */
+int evloop_defer(evloop_t *loop, evloop_timer_callback_t callback, void *data);
+/** Run the loop while anything is registered, armed or deferred. Returns
+ *  once an iteration waited timeout_ms (-1 = infinite) with no fd ready
+ *  and no timer due, or after evloop_stop(). */
 int evloop_run(evloop_t *loop, int timeout_ms);
 /** Request that the loop stop on the next iteration. */
 void evloop_stop(evloop_t *loop);
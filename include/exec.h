@@ -3,12 +3,23 @@
  * @brief Execution engine for AST nodes (commands and pipelines).
  *
  * @details The executor handles three categories of commands:
- *  - Builtins: Dispatched directly in-process via builtin_execute().
+ *  - Builtins: Dispatched directly in-process; redirections are applied
+ *    with a ::redir_stack_t and undone afterwards (no fork).
  *  - Plugins: Dispatched to dynamically loaded modules via plugin_execute().
- *  - External commands: Fork/exec with argv search through PATH.
+ *  - External commands: Spawned via launch_external() (posix_spawn with
+ *    PATH search); redirections are applied as spawn file actions.
  *
  * Pipelines are executed from left to right, and the return code is the
  * status of the last command in the pipeline (conventional shell behavior).
+ *
+ * Compound commands (if, while, until, for, case) are run from their
+ * tree: a loop executes the same condition and body nodes on every
+ * iteration, so nothing is lexed or parsed again. Functions (func.h) are
+ * looked up before builtins and plugins and run from their stored tree.
+ *
+ * With MYSHELL_ENGINE=vm, whole programs (scripts, input lines, function
+ * bodies) are instead compiled to bytecode and run by the VM (vm.h);
+ * exec_ast() always walks the tree.
  */
 #ifndef EXEC_H
 #define EXEC_H
@@ -16,7 +27,9 @@
  *  @brief Execution of ASTs, commands, and pipelines.
  *  @{ */
 
+#include "arena.h"
 #include "ast.h"
+#include <stddef.h>
 
 /** Opaque execution context (reserved for future use). */
 typedef struct exec_context exec_context_t;
@@ -30,10 +43,36 @@ typedef struct exec_context exec_context_t;
  */
 int exec_ast(ast_node_t *ast);
 
+/** Engines that can run a program. */
+typedef enum {
+    EXEC_ENGINE_TREE, /**< Walk the tree with exec_ast() (default). */
+    EXEC_ENGINE_VM    /**< Compile to bytecode and run it with vm_run(). */
+} exec_engine_t;
+
+/**
+ * @brief Engine used by exec_program() and function calls.
+ *
+ * Chosen on first use from the MYSHELL_ENGINE shell variable ("tree" or
+ * "vm"); an unknown name is reported and the tree walker is used.
+ */
+exec_engine_t exec_engine(void);
+
+/** Override the engine chosen from MYSHELL_ENGINE. */
+void exec_set_engine(exec_engine_t engine);
+
+/**
+ * @brief Execute a whole parsed program with the selected engine.
+ *
+ * Used for scripts and input lines. Under the VM engine the tree is
+ * compiled first and must stay alive until this returns.
+ * @return Same as exec_ast().
+ */
+int exec_program(ast_node_t *ast);
+
 /**
  * @brief Execute a single command node and return its exit status.
  *
- * Resolution order: builtin -> plugin -> external (fork/exec).
+ * Resolution order: function -> builtin -> plugin -> external (posix_spawn).
  * On external exec failure (e.g., command not found), returns non-zero.
  */
 int exec_command(ast_command_t *cmd);
@@ -46,6 +85,44 @@ int exec_command(ast_command_t *cmd);
  */
 int exec_pipeline(ast_pipeline_t *pipeline);
 
+/**
+ * @brief Run a command substitution body and capture its standard output.
+ *
+ * Bodies that are lists of output-only builtins (echo, printf, test, ...)
+ * run in the shell process with stdout redirected to a memfd; anything
+ * else runs in a forked subshell whose output is read through a pipe that
+ * is enlarged (F_SETPIPE_SZ) once the output outgrows it.
+ *
+ * @param body Command text between $( and ) or backquotes.
+ * @param arena Receives the output buffer.
+ * @param out Set to the NUL-terminated output (never NULL).
+ * @param len Set to the output length.
+ * @return Exit status of the body, or -1 if it could not be run.
+ */
+int exec_capture(const char *body, arena_t *arena, char **out, size_t *len);
+
+/**
+ * @brief Leave (break) or restart (continue) enclosing loops.
+ *
+ * Used by the break and continue builtins. The request takes effect when
+ * the current command returns: the lists being run stop, and the
+ * levels-th enclosing loop ends or starts its next iteration.
+ * @param levels Number of loops to leave (>= 1); clamped to the nesting.
+ * @param resume 0 for break, 1 for continue.
+ * @return 0, or -1 if no loop is running.
+ */
+int exec_loop_control(int levels, int resume);
+
+/**
+ * @brief Return from the running function (the return builtin).
+ *
+ * Like exec_loop_control(), this takes effect when the current command
+ * returns: everything up to the function call stops, and the call's
+ * status is that of the command that requested it.
+ * @return 0, or -1 if no function is running.
+ */
+int exec_return(void);
+
 /** @} */
 
 #endif // EXEC_H
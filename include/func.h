@@ -0,0 +1,68 @@
+/**
+ * @file func.h
+ * @brief Shell function table and local variable frames.
+ *
+ * @details `name() compound-command` stores a copy of the body tree under
+ * name. A call is a hash probe plus a walk of that tree: nothing is read
+ * or parsed again. Each body lives in its own arena and is reference
+ * counted, so a function may redefine or unset itself while it runs.
+ *
+ * Variables declared with `local` are saved in the frame of the running
+ * call and restored when it returns.
+ */
+#ifndef FUNC_H
+#define FUNC_H
+/** \defgroup group_func functions
+ *  @brief Shell functions and their local variables.
+ *  @{ */
+
+#include "ast.h"
+#include "vm.h"
+
+/** Opaque function definition. */
+typedef struct func func_t;
+
+/**
+ * @brief Define (or redefine) a function.
+ *
+ * The body is copied with ast_copy(), so the tree it came from may be
+ * freed afterwards.
+ * @return 0, or -1 if name or body is NULL.
+ */
+int func_define(const char *name, const ast_node_t *body);
+/** Look up a function by name; NULL if none is defined. */
+func_t *func_find(const char *name);
+/** Remove a function. Returns 0 if it was defined, else -1. */
+int func_unset(const char *name);
+/** Body tree of a function; valid while a reference is held. */
+ast_node_t *func_body(const func_t *fn);
+/**
+ * Body of a function compiled for the VM engine. Compiled on the first
+ * call and kept with the function; valid while a reference is held.
+ */
+vm_program_t *func_program(func_t *fn);
+/** Take a reference that keeps the body alive across a call. */
+void func_retain(func_t *fn);
+/** Drop a reference; the function is freed with its last one. */
+void func_release(func_t *fn);
+/** Remove every function. */
+void func_clear(void);
+
+/** Begin the local variable frame of a call. */
+void func_frame_push(void);
+/** End the current frame, restoring the variables made local in it. */
+void func_frame_pop(void);
+/** Number of calls in progress. */
+int func_depth(void);
+/**
+ * @brief Make a variable local to the current call.
+ *
+ * Its previous value and export flag are restored by func_frame_pop().
+ * @param value New value, or NULL to leave the local variable unset.
+ * @return 0, or -1 outside a function or for an invalid name.
+ */
+int func_local(const char *name, const char *value);
+
+/** @} */
+
+#endif // FUNC_H
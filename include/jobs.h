@@ -19,7 +19,9 @@ typedef enum { JOB_RUNNING, /**< Currently running. */
 job_status_t;
 
 // Job control functions
-/** Create a new job record and add it to the list. */
+/** Create a new job record and add it to the list. When the child
+ *  supervisor is active, the leader (pgid) is watched and the job's state
+ *  follows its exit/stop events as they happen. */
 job_t *job_create(pid_t pgid, const char *command);
 /** Update a job's status in-place. */
 void job_set_status(job_t *job, job_status_t status);
@@ -37,7 +39,11 @@ void job_cleanup(void);
 // Signal and background reaping support
 /** Notify jobs module that SIGCHLD occurred (from signal handler). */
 void jobs_notify_sigchld(void);
-/** Reap finished/stopped children that belong to background jobs. */
+/** Print "[id] Done/Stopped" for background jobs whose state changed since
+ *  the last call; returns the number of lines printed. */
+int jobs_report_changes(void);
+/** Reap finished/stopped children that belong to background jobs.
+ *  Only needed without the child supervisor (SIGCHLD is then unblocked). */
 void jobs_reap_background(void);
 
 /** @} */
@@ -0,0 +1,72 @@
+/**
+ * @file launch.h
+ * @brief Spawn engine for external commands (posix_spawn, no fork()).
+ *
+ * @details External commands are started with posix_spawn(3), which on
+ * glibc is implemented with clone(CLONE_VM|CLONE_VFORK): the child shares
+ * the shell's address space until it execs, so launch cost no longer grows
+ * with the shell's resident set. Redirections are translated into spawn
+ * file actions (open/dup2/close) and process-group placement into spawn
+ * attributes. fork() remains in use only where the child must run shell
+ * code (builtins with redirections, subshells, background lists).
+ */
+#ifndef LAUNCH_H
+#define LAUNCH_H
+/** \defgroup group_launch launch
+ *  @brief posix_spawn-based launching of external commands.
+ *  @{ */
+
+#include <sys/types.h>
+
+/** Returned by launch_spawn() when a redirection could not be opened. */
+#define LAUNCH_EREDIR (-2)
+
+/** A redirection to apply in the spawned child. */
+typedef struct {
+    int fd;               /**< Target descriptor in the child. */
+    int type;             /**< One of ::ast_redir_type_t. */
+    const char *filename; /**< Path to open, or delimiter for here-docs. */
+} launch_redir_t;
+
+/**
+ * @brief Spawn a command with the given redirections.
+ *
+ * path is the resolved executable (e.g. from cmdhash_lookup()); when NULL,
+ * argv[0] is searched in PATH. If a resolved path has vanished (ENOENT),
+ * the PATH search is retried once before giving up.
+ *
+ * Redirection sources are opened by the shell (so errors name the file)
+ * and dup2'ed into place by the spawn file actions. The child is placed in
+ * process group pgid (0 = new group led by the child) and gets default
+ * dispositions for job-control signals.
+ *
+ * @return Child pid; -1 with errno set if the spawn itself failed (ENOENT
+ *         when the command is not found); ::LAUNCH_EREDIR if a redirection
+ *         could not be opened (already reported on stderr).
+ */
+pid_t launch_spawn(const char *path, char **argv, const launch_redir_t *redirs,
+                   int n_redirs, pid_t pgid);
+
+/**
+ * @brief Wait for a foreground child and convert its status.
+ *
+ * With an active child supervisor (see childwatch.h) the child is reaped
+ * from the event loop, so other child events are handled meanwhile;
+ * otherwise this is a blocking waitpid() with SIGINT ignored.
+ * @return Exit status, 128+signal when killed, or 1 if unknown.
+ */
+int launch_wait(pid_t pid);
+
+/**
+ * @brief Spawn a command in its own process group and wait for it.
+ *
+ * Spawn failures are reported on stderr.
+ * @return Command status; 127 if not found, 126 if not executable, 1 for
+ *         other spawn errors (e.g. a redirection could not be opened).
+ */
+int launch_external(const char *path, char **argv, const launch_redir_t *redirs,
+                    int n_redirs);
+
+/** @} */
+
+#endif // LAUNCH_H
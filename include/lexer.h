@@ -8,6 +8,8 @@
  *  @brief Tokenization of input strings.
  *  @{ */
 
+#include <stddef.h>
+
 /** Types of lexical tokens recognized by the lexer. */
 typedef enum {
     TOKEN_WORD,            /**< Plain word (command or arg). */
@@ -21,20 +23,55 @@ typedef enum {
     TOKEN_REDIRECT_AND_OUT,/**< '&>' redirect stdout+stderr. */
     TOKEN_BACKGROUND,      /**< '&' background. */
     TOKEN_SEMICOLON,       /**< ';' sequence separator. */
+    TOKEN_DSEMI,           /**< ';;' end of a case item. */
+    TOKEN_NEWLINE,         /**< Newline; separates commands like ';'. */
     TOKEN_LPAREN,          /**< '(' open subshell/group. */
     TOKEN_RPAREN,          /**< ')' close subshell/group. */
+    TOKEN_ARITH,           /**< '(( expr ))' arithmetic command; value is expr. */
     TOKEN_EOF              /**< End of input. */
 } token_type_t;
 
+/**
+ * Inserted by the lexer where a quoted part of a word opens and before an
+ * expansion ('$' or '`') inside double quotes, so the expander does not
+ * split its result into fields.
+ */
+#define LEXER_QUOTE_MARK '\001'
+
+/**
+ * Inserted by the lexer before a '$' or '`' that was quoted (inside single
+ * quotes or by a backslash), so the expander copies it literally.
+ */
+#define LEXER_LITERAL_MARK '\002'
+
 /** A single token with type and optional string value. */
 typedef struct {
     token_type_t type; /**< Token kind. */
     char *value;       /**< Token text (for words), else NULL. */
 } token_t;
 
+/**
+ * A token returned by value from lexer_next(), as a view of the input.
+ *
+ * For words, text is the word after quote removal: it points into the
+ * input when quote removal changes nothing (the common case), otherwise
+ * into a buffer owned by the lexer that the next lexer_next() call reuses.
+ * For (( )), text is the expression; for operators, the operator itself.
+ * text is not NUL-terminated.
+ */
+typedef struct {
+    token_type_t type; /**< Token kind. */
+    size_t offset;     /**< Offset of the token in the input. */
+    size_t length;     /**< Length of the token in the input. */
+    const char *text;  /**< Token text (see above). */
+    size_t text_len;   /**< Length of text. */
+} token_view_t;
+
 /**
  * Opaque lexer state. One lexer instance scans one immutable input string.
- * Not thread-safe. The input string must outlive the lexer.
+ * Not thread-safe. The input string must outlive the lexer. Blanks,
+ * backslash-newline pairs and comments (from a '#' that starts a token to
+ * the end of the line) are skipped; newlines are returned as tokens.
  */
 typedef struct lexer lexer_t;
 
@@ -44,13 +81,28 @@ typedef struct lexer lexer_t;
  * @return New lexer instance; free with lexer_free().
  */
 lexer_t *lexer_create(const char *input);
+/**
+ * @brief Create a lexer over length bytes that need not be NUL-terminated
+ * (e.g. a memory-mapped script).
+ */
+lexer_t *lexer_create_n(const char *input, size_t length);
+/** 1-based line number of an input offset, for error messages. */
+size_t lexer_line_at(const lexer_t *lexer, size_t offset);
 /**
  * @brief Retrieve the next token from the input stream.
  *
  * Repeatedly calling returns a sequence of tokens and finally TOKEN_EOF.
+ * Allocating wrapper around lexer_next(), whose text it copies.
  * Ownership: Caller owns the returned token and must free via token_free().
  */
 token_t *lexer_next_token(lexer_t *lexer);
+/**
+ * @brief Retrieve the next token as a view, without allocating.
+ *
+ * Returns TOKEN_EOF (length 0) at the end of the input. See token_view_t
+ * for how long the text stays valid.
+ */
+token_view_t lexer_next(lexer_t *lexer);
 /** Free the lexer. Does not free tokens produced earlier. */
 void lexer_free(lexer_t *lexer);
 /** Free a token object and its value (if any). Safe on NULL. */
@@ -1,6 +1,29 @@
 /**
  * @file logger.h
  * @brief Minimal async logger with single consumer thread and bounded queue.
+ *
+ * @details LOG_* calls append records to a lock-free multi-producer ring
+ * of variable-length records; a background thread formats, timestamps
+ * and prints them to stderr. When the ring is full new messages are
+ * dropped (and counted) rather than blocking the caller.
+ *
+ * The LOG_* macros use deferred formatting: the caller copies the format
+ * pointer and the raw argument values (string arguments by content) and
+ * the consumer thread runs the printf conversions. Their format must
+ * therefore be a string literal. logger_log()/logger_vlog() format on
+ * the calling thread and accept any format.
+ *
+ * Output goes to stderr, or to the file named by MYSHELL_LOG_FILE (read
+ * by logger_init()). A file is rotated to name.1 .. name.3 before it
+ * would exceed MYSHELL_LOG_MAX_SIZE bytes (k/M/G suffixes accepted,
+ * default 8M, 0 disables rotation). The consumer drains everything queued
+ * at once and writes it with a single writev().
+ *
+ * A LOG_* call whose level is below the runtime level costs one load and
+ * a predicted-not-taken branch; its arguments are not evaluated. Levels
+ * less severe than MYSHELL_LOG_MIN_LEVEL (a log_level_t value, defaulting
+ * to LOG_LEVEL_TRACE) are compiled out entirely, e.g.
+ * -DMYSHELL_LOG_MIN_LEVEL=LOG_LEVEL_DEBUG removes every LOG_TRACE.
  */
 #ifndef LOGGER_H
 #define LOGGER_H
@@ -16,19 +39,52 @@ typedef enum {
     LOG_LEVEL_TRACE,
 } log_level_t;
 
-int logger_init(void);      // idempotent; returns 0 on success
-void logger_shutdown(void); // joins background thread
+/** Enable logging (idempotent; returns 0). The consumer thread and the
+ *  ring are created on the first record at an enabled level; records
+ *  before logger_init() or after logger_shutdown() are discarded. */
+int logger_init(void);
+void logger_shutdown(void); // flushes, then joins background thread
+/** Block until every message logged before the call has been written to
+ *  the sink. Returns 0, or -1 if the logger is not running. */
+int logger_flush(void);
 
 void logger_set_level(log_level_t level);
 log_level_t logger_get_level(void);
+/** Most verbose level currently emitted (LOG_LEVEL_OFF when disabled).
+ *  Read by the LOG_* macros; change it through logger_set_level(). */
+extern log_level_t logger_threshold;
+unsigned long logger_dropped(void); // messages lost to a full ring so far
 
 void logger_log(log_level_t level, const char *path, const char *fmt, ...);
 void logger_vlog(log_level_t level, const char *path, const char *fmt, va_list ap);
+// path and fmt must outlive the logger (string literals); formats using
+// %n, %m, positional or wide arguments fall back to logger_vlog().
+void logger_log_deferred(log_level_t level, const char *path, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
 
-#define LOG_ERROR(...) logger_log(LOG_LEVEL_ERROR, __FILE__, __VA_ARGS__)
-#define LOG_WARN(...) logger_log(LOG_LEVEL_WARN, __FILE__, __VA_ARGS__)
-#define LOG_INFO(...) logger_log(LOG_LEVEL_INFO, __FILE__, __VA_ARGS__)
-#define LOG_DEBUG(...) logger_log(LOG_LEVEL_DEBUG, __FILE__, __VA_ARGS__)
-#define LOG_TRACE(...) logger_log(LOG_LEVEL_TRACE, __FILE__, __VA_ARGS__)
+#ifndef MYSHELL_LOG_MIN_LEVEL
+#define MYSHELL_LOG_MIN_LEVEL LOG_LEVEL_TRACE
+#endif
+
+#if defined(__GNUC__)
+#define LOG_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define LOG_UNLIKELY(x) (x)
+#endif
+
+// The compile-time test folds to a constant, so calls below
+// MYSHELL_LOG_MIN_LEVEL are type-checked but never emitted. "" fmt
+// rejects non-literal formats at compile time.
+#define LOG_AT(level, fmt, ...)                                                                    \
+    do {                                                                                           \
+        if ((level) <= MYSHELL_LOG_MIN_LEVEL && LOG_UNLIKELY((level) <= logger_threshold))         \
+            logger_log_deferred((level), __FILE__, "" fmt, ##__VA_ARGS__);                         \
+    } while (0)
+
+#define LOG_ERROR(fmt, ...) LOG_AT(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define LOG_WARN(fmt, ...) LOG_AT(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#define LOG_INFO(fmt, ...) LOG_AT(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(fmt, ...) LOG_AT(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#define LOG_TRACE(fmt, ...) LOG_AT(LOG_LEVEL_TRACE, fmt, ##__VA_ARGS__)
 
 #endif // LOGGER_H
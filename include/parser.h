@@ -14,8 +14,15 @@
 /**
  * Opaque parser instance bound to a lexer. Consumes tokens from the lexer
  * and produces ASTs according to a minimal grammar:
- *   command := WORD { WORD }
+ *   command := WORD { WORD } | ( list ) | { list; } | (( expr )) | compound
+ *            | NAME ( ) compound
+ *   compound := if list then list [elif list then list]... [else list] fi
+ *             | (while | until) list do list done
+ *             | for NAME [in WORD...] do list done
+ *             | case WORD in [pattern [| pattern]... ) list ;;]... esac
  *   pipeline := command { '|' command }
+ *   list := and_or { (';' | '&' | newline) and_or }
+ * Reserved words are recognized only unquoted and where a command starts.
  */
 typedef struct parser parser_t;
 
@@ -26,6 +33,36 @@ parser_t *parser_create(lexer_t *lexer);
  * The returned AST must be freed with ast_free().
  */
 ast_node_t *parser_parse(parser_t *parser);
+/**
+ * @brief Parse a whole script into one AST.
+ *
+ * Newlines separate commands like ';' and may follow '|', '&&' and '||';
+ * blank lines and comments are skipped. Unlike parser_parse(), all input
+ * must be consumed.
+ * @param error Receives 1 if a syntax error was found (already reported
+ *        on stderr with its line number), else 0. May be NULL.
+ * @return AST of the script, or NULL if it is empty or has an error.
+ */
+ast_node_t *parser_parse_program(parser_t *parser, int *error);
+/** Outcome of parser_parse_input(). */
+typedef enum {
+    PARSER_OK,         /**< Input parsed (the tree is NULL if it was blank). */
+    PARSER_ERROR,      /**< Syntax error, already reported on stderr. */
+    PARSER_INCOMPLETE, /**< Input ended inside a command; nothing reported. */
+} parser_status_t;
+
+/**
+ * @brief Parse interactive input that may continue on the next line.
+ *
+ * Like parser_parse_program(), except that running out of input where
+ * more is required (inside if/while/until/for/case, a { } group or a
+ * subshell, or after '|', '&&' or '||') is not reported: status is set
+ * to PARSER_INCOMPLETE so the caller can read another line and parse the
+ * longer text again.
+ * @param status Receives the outcome.
+ * @return AST of the input, or NULL unless status is PARSER_OK.
+ */
+ast_node_t *parser_parse_input(parser_t *parser, parser_status_t *status);
 /** Destroy the parser and free internal resources. Safe on NULL. */
 void parser_free(parser_t *parser);
 
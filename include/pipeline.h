@@ -11,7 +11,9 @@
 #include "ast.h"
 
 /** Execute a pipeline of count commands; returns last stage status.
- * The array must contain count valid AST command nodes.
+ * The array must contain count valid AST command nodes. There is no limit
+ * on count: pipes are created one stage ahead and each child keeps only
+ * its own stdin/stdout ends.
  */
 int pipeline_execute(ast_node_t **commands, int count);
 
@@ -8,27 +8,84 @@
  *  @brief File descriptor redirection helpers.
  *  @{ */
 
-/** Types of redirection supported. */
-typedef enum { REDIR_INPUT,   /**< Redirect input from file. */
-               REDIR_OUTPUT,  /**< Redirect output to file. */
-               REDIR_APPEND } /**< Append output to file. */
-redir_type_t;
+#include "ast.h"
+
+/** Types of redirection supported; shares values with ::ast_redir_type_t. */
+typedef ast_redir_type_t redir_type_t;
+
+/** saved_fd marker: the target descriptor was closed before setup. */
+#define REDIR_SAVED_CLOSED (-2)
 
 /** A redirection specification. The filename is owned by the redir_t. */
 typedef struct {
     redir_type_t type; /**< Kind of redirection. */
     int fd;            /**< Target file descriptor (e.g., STDIN_FILENO). */
     char *filename;    /**< Path to the file. */
+    int saved_fd;      /**< Copy of the original target (-1 when not set up). */
 } redir_t;
 
+/**
+ * @brief Apply a redirection in the current process.
+ *
+ * The original target descriptor is first saved with F_DUPFD_CLOEXEC so
+ * redir_cleanup() can restore it. Pending stdio output is flushed first.
+ * @return 0 on success, -1 on error (nothing is left modified).
+ */
 int redir_setup(redir_t *redir);
-/** Placeholder that would restore descriptors in a fuller implementation. */
+/** Restore the descriptor saved by redir_setup(). Safe on NULL or if not set up. */
 void redir_cleanup(redir_t *redir);
 /** Allocate a redir object; copies filename; free with redir_free(). */
 redir_t *redir_create(redir_type_t type, int fd, const char *filename);
 /** Free a redir object and its owned filename. Safe on NULL. */
 void redir_free(redir_t *redir);
 
+/**
+ * @brief Open the source descriptor for a redirection without installing it.
+ *
+ * Files are opened with O_CLOEXEC using the flags implied by type; for
+ * REDIR_HEREDOC, filename is the delimiter and the body is read from stdin
+ * via redir_heredoc_fd(). Errors are reported on stderr.
+ * @return Open descriptor, or -1 on error.
+ */
+int redir_open_source(redir_type_t type, const char *filename);
+
+/**
+ * @brief Read a here-doc body from stdin up to a line equal to delim.
+ *
+ * The body is stored in an anonymous memory file (an unlinked file in
+ * $TMPDIR or /tmp if memfd is not available) positioned at offset 0.
+ * @return Readable O_CLOEXEC descriptor holding the body, or -1 on error.
+ */
+int redir_heredoc_fd(const char *delim);
+
+/** One entry of a ::redir_stack_t: a replaced descriptor and its saved copy. */
+typedef struct {
+    int fd;       /**< Target descriptor that was replaced. */
+    int saved_fd; /**< CLOEXEC copy of the original, or ::REDIR_SAVED_CLOSED. */
+} redir_saved_t;
+
+/**
+ * Stack of redirections applied in the shell process, unwound in reverse
+ * order. Used to run builtins with redirections without forking.
+ */
+typedef struct {
+    redir_saved_t inline_slots[8]; /**< Storage for the common case. */
+    redir_saved_t *slots;          /**< Active storage (inline or heap). */
+    int depth;                     /**< Number of applied entries. */
+    int capacity;                  /**< Capacity of slots. */
+} redir_stack_t;
+
+/** Initialize an empty stack. */
+void redir_stack_init(redir_stack_t *stack);
+/**
+ * @brief Apply one redirection and record how to undo it.
+ * @return 0 on success; -1 on error (reported on stderr, stack unchanged).
+ */
+int redir_stack_push(redir_stack_t *stack, redir_type_t type, int fd,
+                     const char *filename);
+/** Restore every recorded descriptor (newest first) and release storage. */
+void redir_stack_unwind(redir_stack_t *stack);
+
 /** @} */
 
 #endif // REDIR_H
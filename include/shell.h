@@ -56,16 +56,32 @@ int shell_main(int argc, char **argv);
 /**
  * @brief Execute commands from a file path in non-interactive mode.
  *
- * Shebang (#!) on the first line is ignored. Commands run in the current
- * shell context (builtins affect variables). Honors shell_flag_errexit and
- * shell_flag_xtrace.
+ * A regular file is memory-mapped, anything else (a pipe, FIFO or
+ * /dev/stdin) is read into a buffer; the text is parsed once into a single AST (see
+ * parser_parse_program()), so commands may span lines; nothing runs if it
+ * has a syntax error. If shell_compile_file() cached a tree for the
+ * file's current contents, that tree runs and nothing is parsed. A shebang (#!) line is a comment. Commands run in
+ * the current shell context (builtins affect variables). Honors
+ * shell_flag_errexit and shell_flag_xtrace.
  *
  * @param path Path to the script file to execute.
  * @return Last command status, or first failing status when -e is set;
- *         127 if the file cannot be opened.
+ *         127 if the file cannot be opened, 2 on a syntax error.
  */
 int shell_run_file(const char *path);
 
+/**
+ * @brief Parse a script and store its tree in the compiled script cache.
+ *
+ * Implements `myshell --compile`. shell_run_file() then runs the cached
+ * tree for as long as the script is unchanged (see astcache.h).
+ *
+ * @param path Path to the script file to compile.
+ * @return 0 on success, 2 on a syntax error, 1 if the file cannot be read,
+ *         is not a regular file or the cache file cannot be written.
+ */
+int shell_compile_file(const char *path);
+
 /** Toggle shell options (used by the 'set' builtin and CLI flags). */
 void shell_set_errexit(int on);
 void shell_set_xtrace(int on);
@@ -74,6 +90,8 @@ int shell_get_xtrace(void);
 
 /** Return the last command status tracked by the shell. */
 int shell_get_last_status(void);
+/** Record the status of a command that just finished (what $? expands to). */
+void shell_set_last_status(int status);
 
 /**
  * @brief Initialize shell subsystems (signals, plugins, builtins).
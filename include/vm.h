@@ -0,0 +1,55 @@
+/**
+ * @file vm.h
+ * @brief Bytecode compiler and interpreter for parsed programs.
+ *
+ * @details vm_compile() lowers the control flow of a tree into a flat
+ * array of fixed-size instructions. Lists (;), && and ||, if/elif/else,
+ * while, until, for and case become conditional jumps, so running a
+ * program is one loop over that array instead of a recursive walk.
+ * Simple commands stay nodes of the tree: an instruction calls
+ * exec_command() on them, and pipelines, subshells, background jobs and
+ * function definitions are handed to exec_ast() whole. A program points
+ * into the tree it was compiled from and must not outlive it.
+ *
+ * Programs behave exactly like exec_ast() on the same tree, including
+ * `set -e`, exit, break/continue N and return. The VM is selected with
+ * MYSHELL_ENGINE=vm (see exec_program()).
+ */
+#ifndef VM_H
+#define VM_H
+/** \defgroup group_vm vm
+ *  @brief Bytecode engine for scripts.
+ *  @{ */
+
+#include "ast.h"
+#include <stdio.h>
+
+/** Opaque compiled program. */
+typedef struct vm_program vm_program_t;
+
+/**
+ * @brief Compile a tree to bytecode.
+ *
+ * Compiling NULL gives a program that returns -1, like exec_ast(NULL).
+ * @return A program to free with vm_free().
+ */
+vm_program_t *vm_compile(ast_node_t *ast);
+
+/**
+ * @brief Run a compiled program in the shell process.
+ * @return Exit status, as exec_ast() would return it for the tree.
+ */
+int vm_run(const vm_program_t *program);
+
+/** Free a program (not the tree it was compiled from). NULL is ignored. */
+void vm_free(vm_program_t *program);
+
+/** Number of instructions in a program. */
+int vm_length(const vm_program_t *program);
+
+/** Write a listing of a program's instructions, one per line. */
+void vm_dump(const vm_program_t *program, FILE *out);
+
+/** @} */
+
+#endif // VM_H
@@ -0,0 +1,123 @@
+/**
+ * @file arena.c
+ * @brief Chunked bump allocator with mark/release.
+ */
+#include "arena.h"
+#include "util.h"
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN alignof(max_align_t)
+
+struct arena_chunk {
+    arena_chunk_t *next;
+    size_t size; // payload bytes
+    size_t used;
+    alignas(max_align_t) char data[];
+};
+
+static size_t align_up(size_t n) {
+    return (n + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+static arena_chunk_t *new_chunk(size_t size) {
+    arena_chunk_t *chunk = malloc_safe(sizeof(arena_chunk_t) + size);
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+void arena_init(arena_t *arena, size_t chunk_size) {
+    arena->first = arena->current = arena->large = NULL;
+    arena->chunk_size = chunk_size ? align_up(chunk_size) : ARENA_DEFAULT_CHUNK;
+}
+
+void *arena_alloc(arena_t *arena, size_t size) {
+    if (!arena->chunk_size)
+        arena->chunk_size = ARENA_DEFAULT_CHUNK;
+    size = align_up(size ? size : 1);
+
+    if (size > arena->chunk_size / 4) {
+        arena_chunk_t *block = new_chunk(size);
+        block->used = size;
+        block->next = arena->large;
+        arena->large = block;
+        return block->data;
+    }
+
+    arena_chunk_t *chunk = arena->current;
+    if (!chunk) {
+        if (!arena->first)
+            arena->first = new_chunk(arena->chunk_size);
+        chunk = arena->current = arena->first;
+        chunk->used = 0;
+    }
+    while (chunk->size - chunk->used < size) {
+        // Move on to a chunk kept from an earlier release, or add one.
+        if (!chunk->next)
+            chunk->next = new_chunk(arena->chunk_size);
+        chunk = arena->current = chunk->next;
+        chunk->used = 0;
+    }
+    void *p = chunk->data + chunk->used;
+    chunk->used += size;
+    return p;
+}
+
+char *arena_strndup(arena_t *arena, const char *s, size_t len) {
+    char *p = arena_alloc(arena, len + 1);
+    memcpy(p, s, len);
+    p[len] = '\0';
+    return p;
+}
+
+arena_mark_t arena_mark(const arena_t *arena) {
+    arena_mark_t mark;
+    mark.chunk = arena->current;
+    mark.used = arena->current ? arena->current->used : 0;
+    mark.large = arena->large;
+    return mark;
+}
+
+void arena_release(arena_t *arena, arena_mark_t mark) {
+    while (arena->large != mark.large) {
+        arena_chunk_t *block = arena->large;
+        arena->large = block->next;
+        free(block);
+    }
+    arena->current = mark.chunk;
+    if (mark.chunk)
+        mark.chunk->used = mark.used;
+}
+
+void arena_reset(arena_t *arena) {
+    arena_mark_t empty = {NULL, 0, NULL};
+    arena_release(arena, empty);
+}
+
+void arena_adopt(arena_t *arena, arena_t *other) {
+    // Other's chunks become dedicated blocks of arena: they are not bumped
+    // into again, only freed.
+    arena_chunk_t *lists[2] = {other->first, other->large};
+    for (int i = 0; i < 2; ++i) {
+        arena_chunk_t *chunk = lists[i];
+        while (chunk) {
+            arena_chunk_t *next = chunk->next;
+            chunk->next = arena->large;
+            arena->large = chunk;
+            chunk = next;
+        }
+    }
+    other->first = other->current = other->large = NULL;
+}
+
+void arena_free(arena_t *arena) {
+    arena_reset(arena);
+    while (arena->first) {
+        arena_chunk_t *chunk = arena->first;
+        arena->first = chunk->next;
+        free(chunk);
+    }
+}
@@ -0,0 +1,464 @@
+/**
+ * @file arith.c
+ * @brief Recursive-descent evaluator for shell arithmetic.
+ *
+ * The expression is evaluated while it is parsed; there is no tree.
+ * Branches that must not run (the right side of a short-circuited && or
+ * ||, the unused arm of ?:) are parsed with `noeval` set, which skips
+ * variable reads, assignments and division-by-zero checks.
+ */
+#include "arith.h"
+#include "env.h"
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Limit on nested parentheses plus variables evaluated as expressions. */
+#define ARITH_MAX_DEPTH 64
+#define ARITH_NAME_MAX 256
+
+typedef struct {
+    const char *s;
+    size_t pos;
+    const char *error; // first error, NULL if none
+    int noeval;        // > 0 while parsing a branch that is not taken
+    int depth;
+} arith_t;
+
+static long comma_expr(arith_t *a);
+static long assign_expr(arith_t *a);
+static long unary_expr(arith_t *a);
+
+static void fail(arith_t *a, const char *msg) {
+    if (!a->error)
+        a->error = msg;
+}
+
+static char peek(arith_t *a) {
+    while (isspace((unsigned char)a->s[a->pos]))
+        a->pos++;
+    return a->s[a->pos];
+}
+
+static char peek_at(const arith_t *a, size_t off) {
+    // Only used right after peek(); stops at the terminating NUL.
+    for (size_t i = 0; i < off; ++i) {
+        if (!a->s[a->pos + i])
+            return '\0';
+    }
+    return a->s[a->pos + off];
+}
+
+static int is_name_start(char c) {
+    return c == '_' || isalpha((unsigned char)c);
+}
+
+static size_t name_end(const arith_t *a, size_t start) {
+    size_t i = start;
+    while (a->s[i] == '_' || isalnum((unsigned char)a->s[i]))
+        i++;
+    return i;
+}
+
+// Wrapping arithmetic: overflow is defined as two's complement.
+static long wrap_add(long x, long y) {
+    return (long)((unsigned long)x + (unsigned long)y);
+}
+
+static long wrap_sub(long x, long y) {
+    return (long)((unsigned long)x - (unsigned long)y);
+}
+
+static long wrap_mul(long x, long y) {
+    return (long)((unsigned long)x * (unsigned long)y);
+}
+
+// Value of a variable: its contents evaluated as an expression.
+static long var_value(arith_t *a, const char *name, size_t len) {
+    if (a->noeval)
+        return 0;
+    const char *value = env_getn(name, len);
+    if (!value || !*value)
+        return 0;
+
+    // Fast path: a plain decimal number
+    char *end;
+    errno = 0;
+    long v = strtol(value, &end, 10);
+    if (*end == '\0' && errno == 0 && !isspace((unsigned char)*value))
+        return v;
+
+    if (a->depth + 1 > ARITH_MAX_DEPTH) {
+        fail(a, "expression recursion level exceeded");
+        return 0;
+    }
+    arith_t sub = {value, 0, NULL, 0, a->depth + 1};
+    v = comma_expr(&sub);
+    if (!sub.error && peek(&sub) != '\0')
+        fail(&sub, "syntax error in expression");
+    if (sub.error)
+        fail(a, sub.error);
+    return v;
+}
+
+static void var_store(arith_t *a, const char *name, size_t len, long value) {
+    if (a->noeval || a->error)
+        return;
+    if (len >= ARITH_NAME_MAX) {
+        fail(a, "variable name too long");
+        return;
+    }
+    char nm[ARITH_NAME_MAX];
+    char buf[24];
+    memcpy(nm, name, len);
+    nm[len] = '\0';
+    snprintf(buf, sizeof buf, "%ld", value);
+    if (env_assign(nm, buf) != 0)
+        fail(a, "assignment failed");
+}
+
+// Apply a binary operator; op is the operator's first character, with
+// '<' and '>' standing for the shifts.
+static long apply(arith_t *a, char op, long x, long y) {
+    switch (op) {
+    case '*':
+        return wrap_mul(x, y);
+    case '/':
+    case '%':
+        if (y == 0) {
+            if (!a->noeval)
+                fail(a, "division by 0");
+            return 0;
+        }
+        if (x == LONG_MIN && y == -1)
+            return op == '/' ? LONG_MIN : 0;
+        return op == '/' ? x / y : x % y;
+    case '+':
+        return wrap_add(x, y);
+    case '-':
+        return wrap_sub(x, y);
+    case '<':
+        return (long)((unsigned long)x << (y & 63));
+    case '>':
+        return x >> (y & 63);
+    case '&':
+        return x & y;
+    case '^':
+        return x ^ y;
+    case '|':
+        return x | y;
+    }
+    return y; // plain '='
+}
+
+static long number(arith_t *a) {
+    char *end;
+    errno = 0;
+    long v = strtol(a->s + a->pos, &end, 0);
+    if (errno == ERANGE)
+        fail(a, "number out of range");
+    a->pos = (size_t)(end - a->s);
+    if (is_name_start(a->s[a->pos]) || isdigit((unsigned char)a->s[a->pos]))
+        fail(a, "value too great for base");
+    return v;
+}
+
+static long primary_expr(arith_t *a) {
+    char c = peek(a);
+    if (c == '(') {
+        if (a->depth + 1 > ARITH_MAX_DEPTH) {
+            fail(a, "expression recursion level exceeded");
+            return 0;
+        }
+        a->pos++;
+        a->depth++;
+        long v = comma_expr(a);
+        a->depth--;
+        if (peek(a) != ')') {
+            fail(a, "missing `)'");
+            return 0;
+        }
+        a->pos++;
+        return v;
+    }
+    if (isdigit((unsigned char)c))
+        return number(a);
+    if (is_name_start(c)) {
+        size_t start = a->pos;
+        size_t end = name_end(a, start);
+        a->pos = end;
+        long v = var_value(a, a->s + start, end - start);
+        char p = peek(a);
+        if ((p == '+' || p == '-') && peek_at(a, 1) == p) {
+            // Postfix ++/--: yields the old value
+            a->pos += 2;
+            var_store(a, a->s + start, end - start, p == '+' ? wrap_add(v, 1) : wrap_sub(v, 1));
+        }
+        return v;
+    }
+    fail(a, c ? "syntax error: operand expected" : "syntax error: operand expected (end of expression)");
+    return 0;
+}
+
+static long unary_expr(arith_t *a) {
+    char c = peek(a);
+    if ((c == '+' || c == '-') && peek_at(a, 1) == c) {
+        // Prefix ++/--
+        a->pos += 2;
+        if (!is_name_start(peek(a))) {
+            fail(a, "syntax error: operand expected");
+            return 0;
+        }
+        size_t start = a->pos;
+        size_t end = name_end(a, start);
+        a->pos = end;
+        long v = var_value(a, a->s + start, end - start);
+        v = c == '+' ? wrap_add(v, 1) : wrap_sub(v, 1);
+        var_store(a, a->s + start, end - start, v);
+        return v;
+    }
+    switch (c) {
+    case '+':
+        a->pos++;
+        return unary_expr(a);
+    case '-':
+        a->pos++;
+        return wrap_sub(0, unary_expr(a));
+    case '!':
+        a->pos++;
+        return !unary_expr(a);
+    case '~':
+        a->pos++;
+        return ~unary_expr(a);
+    }
+    return primary_expr(a);
+}
+
+static long power_expr(arith_t *a) {
+    long base = unary_expr(a);
+    if (peek(a) == '*' && peek_at(a, 1) == '*') {
+        a->pos += 2;
+        long exp = power_expr(a); // right-associative
+        if (exp < 0) {
+            if (!a->noeval)
+                fail(a, "exponent less than 0");
+            return 0;
+        }
+        long result = 1;
+        while (exp > 0) {
+            if (exp & 1)
+                result = wrap_mul(result, base);
+            base = wrap_mul(base, base);
+            exp >>= 1;
+        }
+        return result;
+    }
+    return base;
+}
+
+static long mul_expr(arith_t *a) {
+    long v = power_expr(a);
+    for (;;) {
+        char c = peek(a);
+        if (!(c == '*' || c == '/' || c == '%') || peek_at(a, 1) == '=' ||
+            (c == '*' && peek_at(a, 1) == '*'))
+            return v;
+        a->pos++;
+        v = apply(a, c, v, power_expr(a));
+    }
+}
+
+static long add_expr(arith_t *a) {
+    long v = mul_expr(a);
+    for (;;) {
+        char c = peek(a);
+        if (!(c == '+' || c == '-') || peek_at(a, 1) == '=')
+            return v;
+        a->pos++;
+        v = apply(a, c, v, mul_expr(a));
+    }
+}
+
+static long shift_expr(arith_t *a) {
+    long v = add_expr(a);
+    for (;;) {
+        char c = peek(a);
+        if (!(c == '<' || c == '>') || peek_at(a, 1) != c || peek_at(a, 2) == '=')
+            return v;
+        a->pos += 2;
+        v = apply(a, c, v, add_expr(a));
+    }
+}
+
+static long rel_expr(arith_t *a) {
+    long v = shift_expr(a);
+    for (;;) {
+        char c = peek(a);
+        if (!(c == '<' || c == '>') || peek_at(a, 1) == c)
+            return v;
+        int or_equal = peek_at(a, 1) == '=';
+        a->pos += or_equal ? 2 : 1;
+        long r = shift_expr(a);
+        if (c == '<')
+            v = or_equal ? v <= r : v < r;
+        else
+            v = or_equal ? v >= r : v > r;
+    }
+}
+
+static long eq_expr(arith_t *a) {
+    long v = rel_expr(a);
+    for (;;) {
+        char c = peek(a);
+        if (!(c == '=' || c == '!') || peek_at(a, 1) != '=')
+            return v;
+        a->pos += 2;
+        long r = rel_expr(a);
+        v = c == '=' ? v == r : v != r;
+    }
+}
+
+// One level of the bitwise operators & ^ |; `next` parses the operands.
+static long bit_expr(arith_t *a, char op, long (*next)(arith_t *)) {
+    long v = next(a);
+    for (;;) {
+        if (peek(a) != op || peek_at(a, 1) == op || peek_at(a, 1) == '=')
+            return v;
+        a->pos++;
+        v = apply(a, op, v, next(a));
+    }
+}
+
+static long band_expr(arith_t *a) {
+    return bit_expr(a, '&', eq_expr);
+}
+
+static long bxor_expr(arith_t *a) {
+    return bit_expr(a, '^', band_expr);
+}
+
+static long bor_expr(arith_t *a) {
+    return bit_expr(a, '|', bxor_expr);
+}
+
+static long land_expr(arith_t *a) {
+    long v = bor_expr(a);
+    while (peek(a) == '&' && peek_at(a, 1) == '&') {
+        a->pos += 2;
+        if (!v)
+            a->noeval++;
+        long r = bor_expr(a);
+        if (!v)
+            a->noeval--;
+        v = v && r;
+    }
+    return v;
+}
+
+static long lor_expr(arith_t *a) {
+    long v = land_expr(a);
+    while (peek(a) == '|' && peek_at(a, 1) == '|') {
+        a->pos += 2;
+        if (v)
+            a->noeval++;
+        long r = land_expr(a);
+        if (v)
+            a->noeval--;
+        v = v || r;
+    }
+    return v;
+}
+
+static long cond_expr(arith_t *a) {
+    long cond = lor_expr(a);
+    if (peek(a) != '?')
+        return cond;
+    a->pos++;
+    if (!cond)
+        a->noeval++;
+    long then_v = comma_expr(a);
+    if (!cond)
+        a->noeval--;
+    if (peek(a) != ':') {
+        fail(a, "`:' expected for conditional expression");
+        return 0;
+    }
+    a->pos++;
+    if (cond)
+        a->noeval++;
+    long else_v = cond_expr(a);
+    if (cond)
+        a->noeval--;
+    return cond ? then_v : else_v;
+}
+
+// Length of the assignment operator at the current position (0 if none);
+// *op receives the binary operator it applies ('=' for plain assignment).
+static size_t assign_op(const arith_t *a, char *op) {
+    char c = peek_at(a, 0);
+    char c1 = peek_at(a, 1);
+    if (c == '=' && c1 != '=') {
+        *op = '=';
+        return 1;
+    }
+    if (strchr("*/%+-&^|", c) && c1 == '=') {
+        *op = c;
+        return 2;
+    }
+    if ((c == '<' || c == '>') && c1 == c && peek_at(a, 2) == '=') {
+        *op = c;
+        return 3;
+    }
+    return 0;
+}
+
+static long assign_expr(arith_t *a) {
+    size_t save = a->pos;
+    if (is_name_start(peek(a))) {
+        size_t start = a->pos;
+        size_t end = name_end(a, start);
+        a->pos = end;
+        peek(a);
+        char op;
+        size_t op_len = assign_op(a, &op);
+        if (op_len) {
+            a->pos += op_len;
+            long rhs = assign_expr(a);
+            long v = op == '=' ? rhs : apply(a, op, var_value(a, a->s + start, end - start), rhs);
+            var_store(a, a->s + start, end - start, v);
+            return v;
+        }
+    }
+    a->pos = save;
+    return cond_expr(a);
+}
+
+static long comma_expr(arith_t *a) {
+    long v = assign_expr(a);
+    while (!a->error && peek(a) == ',') {
+        a->pos++;
+        v = assign_expr(a);
+    }
+    return v;
+}
+
+int arith_eval(const char *expr, long *result) {
+    if (!expr || !result)
+        return -1;
+    arith_t a = {expr, 0, NULL, 0, 0};
+    long v = 0;
+    if (peek(&a) != '\0') {
+        v = comma_expr(&a);
+        if (!a.error && peek(&a) != '\0')
+            fail(&a, "syntax error in expression");
+    }
+    if (a.error) {
+        fprintf(stderr, "myshell: %s: %s\n", expr, a.error);
+        return -1;
+    }
+    *result = v;
+    return 0;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file ast_node.h
+ * @brief Internal layout of AST nodes, shared by the executor (exec.c)
+ *        and the compiled script cache (astcache.c).
+ *
+ * @details Everything outside those two files uses the opaque handles of
+ * ast.h. The cache stores trees in this exact layout, so any change to it
+ * must bump ASTCACHE_VERSION.
+ */
+#ifndef AST_NODE_H
+#define AST_NODE_H
+
+#include "ast.h"
+
+/**
+ * AST node. A tree lives in one arena; command nodes keep their argv array
+ * right after the node and their redirections in an out-of-line list.
+ */
+struct ast_node {
+    ast_node_type_t type;
+    arena_t *arena; // on a tree's root only: the heap arena holding the tree
+    union {
+        struct {
+            char **argv;
+            ast_redir_t *redirs;
+            int argc;
+            int n_redirs;
+        } command;
+        struct {
+            ast_node_t *left;
+            ast_node_t *right;
+        } pipeline;
+        struct {
+            ast_node_t *left;
+            ast_node_t *right;
+        } sequence;
+        struct {
+            ast_node_t *child;
+        } background;
+        struct { // and / or
+            ast_node_t *left;
+            ast_node_t *right;
+        } boollist;
+        struct { // subshell
+            ast_node_t *child;
+        } subshell;
+        struct {
+            ast_node_t *cond;
+            ast_node_t *then_part;
+            ast_node_t *else_part;
+        } if_clause;
+        struct { // while / until
+            ast_node_t *cond;
+            ast_node_t *body;
+        } loop;
+        struct {
+            char *name;
+            char **words; // after the node, NULL-terminated; NULL: "$@"
+            ast_node_t *body;
+        } for_clause;
+        struct {
+            char *word;
+            ast_case_item_t *items;
+            int n_items;
+        } case_clause;
+        struct {
+            char *name;
+            ast_node_t *body;
+        } function;
+    } data;
+};
+
+#endif // AST_NODE_H
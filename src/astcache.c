@@ -0,0 +1,476 @@
+/**
+ * @file astcache.c
+ * @brief Compiled script cache: tree images with a relocation table.
+ *
+ * File layout: header, absolute script path, padding to 16 bytes, image,
+ * relocation table. The image holds nodes, word arrays, redirection and
+ * case item lists, and strings, all in their in-memory layout, with every
+ * pointer replaced by its target's offset in the image. The relocation
+ * table lists the image offset of each non-NULL pointer. The first
+ * ALIGN bytes of the image are padding, so no pointer targets offset 0.
+ * Relocation entries are 32-bit, which limits an image to 4 GiB.
+ */
+#include "astcache.h"
+#include "ast_node.h"
+#include "env.h"
+#include "util.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define ASTCACHE_MAGIC "MYSHAST"
+#define BYTE_ORDER_MARK 0x01020304u
+#define ALIGN sizeof(void *)
+#define IMAGE_ALIGN 16
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t node_size;
+    uint32_t pointer_size;
+    uint64_t source_size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t source_hash;
+    uint64_t path_len;     // path follows the header, without a terminator
+    uint64_t image_offset;
+    uint64_t image_size;
+    uint64_t root;         // image offset of the root; 0 for an empty script
+    uint64_t n_relocs;     // table of uint32_t offsets follows the image
+    uint64_t check;        // hash of the image and relocation table
+} cache_header_t;
+
+/** Image under construction. */
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    uint32_t *relocs;
+    size_t n_relocs;
+    size_t relocs_capacity;
+} image_writer_t;
+
+unsigned long long astcache_hash(const char *data, size_t length) {
+    // FNV-1a over 8-byte words in four interleaved lanes, so the multiplies
+    // overlap instead of forming one chain per byte
+    const uint64_t prime = 1099511628211ull;
+    uint64_t lane[4] = {14695981039346656037ull, 14695981039346656037ull ^ 1,
+                        14695981039346656037ull ^ 2, 14695981039346656037ull ^ 3};
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        for (int k = 0; k < 4; ++k) {
+            uint64_t word;
+            memcpy(&word, data + i + 8 * k, sizeof word);
+            lane[k] = (lane[k] ^ word) * prime;
+        }
+    }
+    uint64_t h = lane[0];
+    for (int k = 1; k < 4; ++k)
+        h = (h ^ lane[k]) * prime;
+    for (; i < length; ++i)
+        h = (h ^ (unsigned char)data[i]) * prime;
+    return (h ^ length) * prime;
+}
+
+// --- cache location ---------------------------------------------------------
+
+// The directory comes from shell variables: an assignment in the shell
+// counts even when it is not exported.
+static int cache_dir(char *buf, size_t size) {
+    const char *dir = env_get("MYSHELL_CACHE_DIR");
+    int n;
+    if (dir && *dir) {
+        n = snprintf(buf, size, "%s", dir);
+    } else if ((dir = env_get("XDG_CACHE_HOME")) && *dir) {
+        n = snprintf(buf, size, "%s/myshell", dir);
+    } else if ((dir = env_get("HOME")) && *dir) {
+        n = snprintf(buf, size, "%s/.cache/myshell", dir);
+    } else {
+        return -1;
+    }
+    return n > 0 && (size_t)n < size ? 0 : -1;
+}
+
+// Resolve script to an absolute path and name its cache file.
+static int cache_location(const char *script, char *abs, char *buf, size_t size) {
+    char dir[PATH_MAX];
+    if (!script || !realpath(script, abs) || cache_dir(dir, sizeof dir) != 0)
+        return -1;
+    int n = snprintf(buf, size, "%s/%016llx.ast", dir, astcache_hash(abs, strlen(abs)));
+    return n > 0 && (size_t)n < size ? 0 : -1;
+}
+
+int astcache_path(const char *script, char *buf, size_t size) {
+    char abs[PATH_MAX];
+    return cache_location(script, abs, buf, size);
+}
+
+// mkdir -p for the directory part of path.
+static int make_parent_dirs(const char *path) {
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof dir, "%s", path);
+    char *slash = strrchr(dir, '/');
+    if (!slash || slash == dir)
+        return 0;
+    *slash = '\0';
+    for (char *p = dir + 1; *p; ++p) {
+        if (*p != '/')
+            continue;
+        *p = '\0';
+        if (mkdir(dir, 0700) != 0 && errno != EEXIST)
+            return -1;
+        *p = '/';
+    }
+    return mkdir(dir, 0700) != 0 && errno != EEXIST ? -1 : 0;
+}
+
+// --- writing ----------------------------------------------------------------
+
+#define FIELD(member) offsetof(ast_node_t, data.member)
+#define NODE_AT(w, off) ((ast_node_t *)((w)->data + (off)))
+
+// Zeroed space for size bytes at an aligned offset.
+static size_t reserve(image_writer_t *w, size_t size, size_t align) {
+    size_t off = (w->length + align - 1) & ~(align - 1);
+    if (off + size > w->capacity) {
+        size_t capacity = w->capacity ? w->capacity : 4096;
+        while (off + size > capacity)
+            capacity *= 2;
+        w->data = realloc_safe(w->data, capacity);
+        w->capacity = capacity;
+    }
+    memset(w->data + w->length, 0, off + size - w->length);
+    w->length = off + size;
+    return off;
+}
+
+// Store a pointer to target at image offset at; 0 leaves it NULL.
+static void set_ptr(image_writer_t *w, size_t at, size_t target) {
+    if (!target)
+        return;
+    uintptr_t value = target;
+    memcpy(w->data + at, &value, sizeof value);
+    if (w->n_relocs == w->relocs_capacity) {
+        w->relocs_capacity = w->relocs_capacity ? w->relocs_capacity * 2 : 256;
+        w->relocs = realloc_safe(w->relocs, w->relocs_capacity * sizeof(uint32_t));
+    }
+    w->relocs[w->n_relocs++] = (uint32_t)at;
+}
+
+static size_t put_string(image_writer_t *w, const char *s) {
+    if (!s)
+        return 0;
+    size_t n = strlen(s) + 1;
+    size_t off = reserve(w, n, 1);
+    memcpy(w->data + off, s, n);
+    return off;
+}
+
+// NULL-terminated word array at image offset at.
+static void put_words(image_writer_t *w, size_t at, char *const *words) {
+    for (size_t i = 0; words[i]; ++i)
+        set_ptr(w, at + i * sizeof(char *), put_string(w, words[i]));
+}
+
+static size_t new_node(image_writer_t *w, ast_node_type_t type, size_t tail) {
+    size_t off = reserve(w, sizeof(ast_node_t) + tail, ALIGN);
+    NODE_AT(w, off)->type = type;
+    return off;
+}
+
+static size_t put_node(image_writer_t *w, const ast_node_t *node) {
+    if (!node)
+        return 0;
+    size_t off;
+    switch (node->type) {
+    case AST_COMMAND: {
+        char **argv = node->data.command.argv;
+        int argc = node->data.command.argc;
+        int n = node->data.command.n_redirs;
+        off = new_node(w, node->type, argv ? (size_t)(argc + 1) * sizeof(char *) : 0);
+        NODE_AT(w, off)->data.command.argc = argc;
+        NODE_AT(w, off)->data.command.n_redirs = n;
+        if (argv) {
+            set_ptr(w, off + FIELD(command.argv), off + sizeof(ast_node_t));
+            put_words(w, off + sizeof(ast_node_t), argv);
+        }
+        if (n > 0) {
+            size_t list = reserve(w, (size_t)n * sizeof(ast_redir_t), ALIGN);
+            set_ptr(w, off + FIELD(command.redirs), list);
+            for (int i = 0; i < n; ++i) {
+                const ast_redir_t *r = &node->data.command.redirs[i];
+                size_t at = list + (size_t)i * sizeof(ast_redir_t);
+                ((ast_redir_t *)(w->data + at))->fd = r->fd;
+                ((ast_redir_t *)(w->data + at))->type = r->type;
+                set_ptr(w, at + offsetof(ast_redir_t, filename), put_string(w, r->filename));
+            }
+        }
+        break;
+    }
+    case AST_SEQUENCE: {
+        // Write the right spine in a loop, like exec_ast() runs it
+        off = new_node(w, node->type, 0);
+        size_t tail = off;
+        const ast_node_t *src = node;
+        for (;;) {
+            set_ptr(w, tail + FIELD(sequence.left), put_node(w, src->data.sequence.left));
+            src = src->data.sequence.right;
+            if (!src || src->type != AST_SEQUENCE) {
+                set_ptr(w, tail + FIELD(sequence.right), put_node(w, src));
+                break;
+            }
+            size_t next = new_node(w, src->type, 0);
+            set_ptr(w, tail + FIELD(sequence.right), next);
+            tail = next;
+        }
+        break;
+    }
+    case AST_PIPELINE:
+    case AST_AND:
+    case AST_OR:
+        off = new_node(w, node->type, 0);
+        set_ptr(w, off + FIELD(pipeline.left), put_node(w, node->data.pipeline.left));
+        set_ptr(w, off + FIELD(pipeline.right), put_node(w, node->data.pipeline.right));
+        break;
+    case AST_BACKGROUND:
+    case AST_SUBSHELL:
+        off = new_node(w, node->type, 0);
+        set_ptr(w, off + FIELD(subshell.child), put_node(w, node->data.subshell.child));
+        break;
+    case AST_IF:
+        off = new_node(w, node->type, 0);
+        set_ptr(w, off + FIELD(if_clause.cond), put_node(w, node->data.if_clause.cond));
+        set_ptr(w, off + FIELD(if_clause.then_part), put_node(w, node->data.if_clause.then_part));
+        set_ptr(w, off + FIELD(if_clause.else_part), put_node(w, node->data.if_clause.else_part));
+        break;
+    case AST_WHILE:
+    case AST_UNTIL:
+        off = new_node(w, node->type, 0);
+        set_ptr(w, off + FIELD(loop.cond), put_node(w, node->data.loop.cond));
+        set_ptr(w, off + FIELD(loop.body), put_node(w, node->data.loop.body));
+        break;
+    case AST_FOR: {
+        char **words = node->data.for_clause.words;
+        size_t slots = 0;
+        while (words && words[slots])
+            slots++;
+        off = new_node(w, node->type, words ? (slots + 1) * sizeof(char *) : 0);
+        set_ptr(w, off + FIELD(for_clause.name), put_string(w, node->data.for_clause.name));
+        if (words) {
+            set_ptr(w, off + FIELD(for_clause.words), off + sizeof(ast_node_t));
+            put_words(w, off + sizeof(ast_node_t), words);
+        }
+        set_ptr(w, off + FIELD(for_clause.body), put_node(w, node->data.for_clause.body));
+        break;
+    }
+    case AST_CASE: {
+        int n = node->data.case_clause.n_items;
+        off = new_node(w, node->type, 0);
+        NODE_AT(w, off)->data.case_clause.n_items = n;
+        set_ptr(w, off + FIELD(case_clause.word), put_string(w, node->data.case_clause.word));
+        if (n <= 0)
+            break;
+        size_t items = reserve(w, (size_t)n * sizeof(ast_case_item_t), ALIGN);
+        set_ptr(w, off + FIELD(case_clause.items), items);
+        for (int i = 0; i < n; ++i) {
+            const ast_case_item_t *item = &node->data.case_clause.items[i];
+            size_t at = items + (size_t)i * sizeof(ast_case_item_t);
+            ((ast_case_item_t *)(w->data + at))->n_patterns = item->n_patterns;
+            if (item->n_patterns > 0) {
+                size_t patterns = reserve(w, (size_t)item->n_patterns * sizeof(char *), ALIGN);
+                set_ptr(w, at + offsetof(ast_case_item_t, patterns), patterns);
+                for (int j = 0; j < item->n_patterns; ++j)
+                    set_ptr(w, patterns + (size_t)j * sizeof(char *),
+                            put_string(w, item->patterns[j]));
+            }
+            set_ptr(w, at + offsetof(ast_case_item_t, body), put_node(w, item->body));
+        }
+        break;
+    }
+    case AST_FUNCTION:
+        off = new_node(w, node->type, 0);
+        set_ptr(w, off + FIELD(function.name), put_string(w, node->data.function.name));
+        set_ptr(w, off + FIELD(function.body), put_node(w, node->data.function.body));
+        break;
+    default:
+        return 0;
+    }
+    return off;
+}
+
+static int write_all(int fd, const void *buf, size_t size) {
+    const char *p = buf;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+int astcache_write(const char *script, const struct stat *st, const char *text, size_t length,
+                   const ast_node_t *root) {
+    char abs[PATH_MAX], path[PATH_MAX], tmp[PATH_MAX + 8];
+    if (cache_location(script, abs, path, sizeof path) != 0) {
+        fprintf(stderr, "myshell: %s: no cache location\n", script ? script : "");
+        return -1;
+    }
+
+    image_writer_t w = {0};
+    reserve(&w, ALIGN, ALIGN); // keeps offset 0 free for NULL
+    size_t root_off = put_node(&w, root);
+    if (w.length > UINT32_MAX) { // relocation entries are 32-bit
+        fprintf(stderr, "myshell: %s: script too large to cache\n", script);
+        free(w.data);
+        free(w.relocs);
+        return -1;
+    }
+    size_t relocs_at = reserve(&w, w.n_relocs * sizeof(uint32_t), ALIGN);
+    memcpy(w.data + relocs_at, w.relocs, w.n_relocs * sizeof(uint32_t));
+
+    size_t path_len = strlen(abs);
+    cache_header_t h = {0};
+    memcpy(h.magic, ASTCACHE_MAGIC, sizeof ASTCACHE_MAGIC);
+    h.version = ASTCACHE_VERSION;
+    h.byte_order = BYTE_ORDER_MARK;
+    h.node_size = sizeof(ast_node_t);
+    h.pointer_size = sizeof(void *);
+    h.source_size = length;
+    h.mtime_sec = st->st_mtim.tv_sec;
+    h.mtime_nsec = st->st_mtim.tv_nsec;
+    h.source_hash = astcache_hash(text, length);
+    h.path_len = path_len;
+    h.image_offset = (sizeof h + path_len + IMAGE_ALIGN - 1) & ~(uint64_t)(IMAGE_ALIGN - 1);
+    h.image_size = relocs_at;
+    h.root = root_off;
+    h.n_relocs = w.n_relocs;
+    h.check = astcache_hash(w.data, w.length);
+
+    static const char pad[IMAGE_ALIGN];
+    int rc = -1;
+    int fd = -1;
+    snprintf(tmp, sizeof tmp, "%s.XXXXXX", path);
+    if (make_parent_dirs(path) == 0 && (fd = mkstemp(tmp)) >= 0 &&
+        write_all(fd, &h, sizeof h) == 0 && write_all(fd, abs, path_len) == 0 &&
+        write_all(fd, pad, h.image_offset - sizeof h - path_len) == 0 &&
+        write_all(fd, w.data, w.length) == 0 && close(fd) == 0) {
+        fd = -1;
+        rc = rename(tmp, path);
+    }
+    if (rc != 0) {
+        perror(path);
+        if (fd >= 0)
+            close(fd);
+        unlink(tmp);
+    }
+    free(w.data);
+    free(w.relocs);
+    return rc;
+}
+
+// --- loading ----------------------------------------------------------------
+
+// Check a mapped cache file against the script; relocate it and set *root
+// on success.
+static int validate(char *map, size_t map_size, const char *abs, const struct stat *st,
+                    const char *text, size_t length, ast_node_t **root) {
+    cache_header_t h;
+    if (map_size < sizeof h)
+        return -1;
+    memcpy(&h, map, sizeof h);
+    if (memcmp(h.magic, ASTCACHE_MAGIC, sizeof ASTCACHE_MAGIC) != 0 ||
+        h.version != ASTCACHE_VERSION || h.byte_order != BYTE_ORDER_MARK ||
+        h.node_size != sizeof(ast_node_t) || h.pointer_size != sizeof(void *))
+        return -1;
+    if (h.source_size != length || h.mtime_sec != (int64_t)st->st_mtim.tv_sec ||
+        h.mtime_nsec != (int64_t)st->st_mtim.tv_nsec)
+        return -1;
+    if (h.path_len != strlen(abs) || h.path_len > map_size - sizeof h ||
+        memcmp(map + sizeof h, abs, h.path_len) != 0)
+        return -1;
+    // Sizes in order, so none of the sums below can wrap
+    if (h.image_offset % IMAGE_ALIGN || h.image_offset < sizeof h + h.path_len ||
+        h.image_offset > map_size || h.image_size % ALIGN ||
+        h.image_size > map_size - h.image_offset ||
+        h.n_relocs > (map_size - h.image_offset - h.image_size) / sizeof(uint32_t) ||
+        h.image_offset + h.image_size + h.n_relocs * sizeof(uint32_t) != map_size)
+        return -1;
+    if (h.image_size < ALIGN || h.root % ALIGN ||
+        (h.root && (h.image_size < sizeof(ast_node_t) || h.root > h.image_size - sizeof(ast_node_t))))
+        return -1;
+    char *image = map + h.image_offset;
+    if (astcache_hash(image, map_size - h.image_offset) != h.check ||
+        astcache_hash(text, length) != h.source_hash)
+        return -1;
+
+    const uint32_t *relocs = (const uint32_t *)(image + h.image_size);
+    for (uint64_t i = 0; i < h.n_relocs; ++i) {
+        uint32_t at = relocs[i];
+        uintptr_t target;
+        if (at % ALIGN || at > h.image_size - sizeof target)
+            return -1;
+        memcpy(&target, image + at, sizeof target);
+        if (target == 0 || target >= h.image_size)
+            return -1;
+        target += (uintptr_t)image;
+        memcpy(image + at, &target, sizeof target);
+    }
+    *root = h.root ? (ast_node_t *)(image + h.root) : NULL;
+    return 0;
+}
+
+int astcache_load(const char *script, const struct stat *st, const char *text, size_t length,
+                  astcache_image_t *image) {
+    char abs[PATH_MAX], path[PATH_MAX];
+    image->map = NULL;
+    image->map_size = 0;
+    image->root = NULL;
+    if (cache_location(script, abs, path, sizeof path) != 0)
+        return -1;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    struct stat cst;
+    if (fstat(fd, &cst) != 0 || cst.st_size < (off_t)sizeof(cache_header_t)) {
+        close(fd);
+        return -1;
+    }
+    size_t map_size = (size_t)cst.st_size;
+    // Private and writable: relocation patches pointers in our copy only.
+    // Relocation touches every page, so take the copy-on-write faults in
+    // one batch up front.
+    char *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+    ast_node_t *root;
+    if (validate(map, map_size, abs, st, text, length, &root) != 0) {
+        munmap(map, map_size);
+        return -1;
+    }
+    image->map = map;
+    image->map_size = map_size;
+    image->root = root;
+    return 0;
+}
+
+void astcache_release(astcache_image_t *image) {
+    if (!image || !image->map)
+        return;
+    munmap(image->map, image->map_size);
+    image->map = NULL;
+    image->map_size = 0;
+    image->root = NULL;
+}
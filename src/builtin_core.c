@@ -3,7 +3,11 @@
  * @brief Core builtin implementations (cd, exit, env, jobs, type, etc.).
  */
 #include "builtin.h"
+#include "arith.h"
+#include "cmdhash.h"
 #include "env.h"
+#include "exec.h"
+#include "func.h"
 #include "jobs.h"
 #include "shell.h"
 #include "util.h"
@@ -73,15 +77,10 @@ int builtin_export(int argc, char **argv) {
                 return 1;
             }
             *eq = '='; // Restore original string
-        } else {
-            // Export existing variable
-            char *value = env_get(argv[i]);
-            if (value) {
-                if (env_set(argv[i], value) != 0) {
-                    perror("export");
-                    return 1;
-                }
-            }
+        } else if (env_export(argv[i]) != 0) {
+            // Export an existing (or future) shell variable
+            perror("export");
+            return 1;
         }
     }
 
@@ -94,7 +93,18 @@ int builtin_unset(int argc, char **argv) {
         return 1;
     }
 
-    for (int i = 1; i < argc; i++) {
+    // unset -f name...: remove functions; -v (the default): variables
+    int first = 1;
+    int functions = 0;
+    if (strcmp(argv[1], "-f") == 0 || strcmp(argv[1], "-v") == 0) {
+        functions = argv[1][1] == 'f';
+        first = 2;
+    }
+    for (int i = first; i < argc; i++) {
+        if (functions) {
+            (void)func_unset(argv[i]);
+            continue;
+        }
         if (env_unset(argv[i]) != 0) {
             perror("unset");
             return 1;
@@ -104,6 +114,19 @@ int builtin_unset(int argc, char **argv) {
     return 0;
 }
 
+int builtin_let(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "let: expression expected\n");
+        return 1;
+    }
+    long value = 0;
+    for (int i = 1; i < argc; i++) {
+        if (arith_eval(argv[i], &value) != 0)
+            return 1;
+    }
+    return value != 0 ? 0 : 1;
+}
+
 int builtin_pwd(int argc __attribute__((unused)),
                 char **argv __attribute__((unused))) {
     char *cwd = getcwd(NULL, 0);
@@ -164,17 +187,25 @@ int builtin_type(int argc, char **argv) {
     }
 
     for (int i = 1; i < argc; i++) {
-        if (builtin_find(argv[i])) {
+        if (func_find(argv[i])) {
+            printf("%s is a function\n", argv[i]);
+        } else if (builtin_find(argv[i])) {
             printf("%s is a shell builtin\n", argv[i]);
+        } else if (strchr(argv[i], '/')) {
+            if (is_executable(argv[i]))
+                printf("%s is %s\n", argv[i], argv[i]);
+            else
+                printf("%s: not found\n", argv[i]);
         } else {
-            // Check if it's an external command
-            char *path = resolve_path(argv[i]);
-            if (path && is_executable(path)) {
+            // Check if it's an external command (via the command hash)
+            const char *hashed = cmdhash_peek(argv[i]);
+            const char *path = hashed ? hashed : cmdhash_lookup(argv[i]);
+            if (hashed)
+                printf("%s is hashed (%s)\n", argv[i], path);
+            else if (path)
                 printf("%s is %s\n", argv[i], path);
-                free(path);
-            } else {
+            else
                 printf("%s: not found\n", argv[i]);
-            }
         }
     }
 
@@ -188,11 +219,103 @@ int builtin_source(int argc, char **argv) {
     }
 
     const char *path = argv[1];
-    // Execute file in current shell context using shell_run_file
+    // Execute file in current shell context using shell_run_file; extra
+    // arguments become its positional parameters
+    env_positional_t saved = *env_positional();
+    if (argc > 2)
+        env_set_positional(argv + 2, argc - 2);
     int rc = shell_run_file(path);
+    if (argc > 2)
+        env_set_positional(saved.argv, saved.argc);
+    return rc;
+}
+
+// break [n] / continue [n]
+static int loop_control(int argc, char **argv, int resume) {
+    int levels = 1;
+    if (argc > 1) {
+        char *end = NULL;
+        long val = strtol(argv[1], &end, 10);
+        if (!end || *end != '\0' || val < 1) {
+            fprintf(stderr, "%s: %s: loop count out of range\n", argv[0], argv[1]);
+            return 1;
+        }
+        levels = val > 1000 ? 1000 : (int)val;
+    }
+    if (exec_loop_control(levels, resume) != 0) {
+        fprintf(stderr, "%s: only meaningful in a `for', `while', or `until' loop\n", argv[0]);
+        return 0;
+    }
+    return 0;
+}
+
+static int builtin_break(int argc, char **argv) {
+    return loop_control(argc, argv, 0);
+}
+
+static int builtin_continue(int argc, char **argv) {
+    return loop_control(argc, argv, 1);
+}
+
+// local name[=value]...
+static int builtin_local(int argc, char **argv) {
+    if (func_depth() == 0) {
+        fprintf(stderr, "local: can only be used in a function\n");
+        return 1;
+    }
+    int rc = 0;
+    for (int i = 1; i < argc; i++) {
+        char *eq = strchr(argv[i], '=');
+        if (eq)
+            *eq = '\0';
+        if (func_local(argv[i], eq ? eq + 1 : NULL) != 0) {
+            fprintf(stderr, "local: `%s': not a valid identifier\n", argv[i]);
+            rc = 1;
+        }
+        if (eq)
+            *eq = '=';
+    }
     return rc;
 }
 
+// return [n]: n defaults to the status of the last command
+static int builtin_return(int argc, char **argv) {
+    int status = shell_get_last_status();
+    if (argc > 1) {
+        char *end = NULL;
+        long val = strtol(argv[1], &end, 10);
+        if (!end || *end != '\0') {
+            fprintf(stderr, "return: %s: numeric argument required\n", argv[1]);
+            status = 2;
+        } else {
+            status = (int)(val & 0xFF);
+        }
+    }
+    if (exec_return() != 0) {
+        fprintf(stderr, "return: can only `return' from a function\n");
+        return 1;
+    }
+    return status;
+}
+
+// shift [n]
+static int builtin_shift(int argc, char **argv) {
+    long n = 1;
+    if (argc > 1) {
+        char *end = NULL;
+        n = strtol(argv[1], &end, 10);
+        if (!end || *end != '\0' || n < 0) {
+            fprintf(stderr, "shift: %s: numeric argument required\n", argv[1]);
+            return 1;
+        }
+    }
+    if (n > env_positional()->argc || env_shift_positional((int)n) != 0) {
+        fprintf(stderr, "shift: shift count out of range\n");
+        return 1;
+    }
+    return 0;
+}
+
 static int builtin_set(int argc, char **argv) {
     // Support: set -e | +e | -x | +x
     if (argc < 2) {
@@ -216,6 +339,65 @@ static int builtin_set(int argc, char **argv) {
     return 0;
 }
 
+int builtin_hash(int argc, char **argv) {
+    // Support: hash | hash -r | hash -d name... | hash -p path name | hash -t name... | hash name...
+    if (argc < 2) {
+        if (cmdhash_print() == 0)
+            printf("hash: hash table empty\n");
+        return 0;
+    }
+    if (strcmp(argv[1], "-r") == 0) {
+        cmdhash_clear();
+        return 0;
+    }
+    if (strcmp(argv[1], "-p") == 0) {
+        if (argc < 4) {
+            fprintf(stderr, "hash: usage: hash -p path name\n");
+            return 2;
+        }
+        if (cmdhash_add(argv[3], argv[2]) != 0) {
+            fprintf(stderr, "hash: %s: invalid name\n", argv[3]);
+            return 1;
+        }
+        return 0;
+    }
+    if (strcmp(argv[1], "-d") == 0 || strcmp(argv[1], "-t") == 0) {
+        int forget = argv[1][1] == 'd';
+        int rc = 0;
+        for (int i = 2; i < argc; i++) {
+            const char *path = cmdhash_peek(argv[i]);
+            if (!path) {
+                fprintf(stderr, "hash: %s: not found\n", argv[i]);
+                rc = 1;
+            } else if (forget) {
+                cmdhash_remove(argv[i]);
+            } else if (argc > 3) {
+                printf("%s\t%s\n", argv[i], path);
+            } else {
+                printf("%s\n", path);
+            }
+        }
+        return rc;
+    }
+    if (argv[1][0] == '-') {
+        fprintf(stderr, "hash: unsupported option '%s'\n", argv[1]);
+        return 2;
+    }
+
+    int rc = 0;
+    for (int i = 1; i < argc; i++) {
+        if (builtin_find(argv[i]) || strchr(argv[i], '/'))
+            continue;
+        // Re-resolve explicitly named commands
+        cmdhash_remove(argv[i]);
+        if (!cmdhash_lookup(argv[i])) {
+            fprintf(stderr, "hash: %s: not found\n", argv[i]);
+            rc = 1;
+        }
+    }
+    return rc;
+}
+
 // Builtin registry
 // Reserve a couple of extra slots for dynamic registration
 static builtin_t builtins[] = {
@@ -223,6 +405,7 @@ static builtin_t builtins[] = {
     {"exit", builtin_exit, "Exit the shell"},
     {"export", builtin_export, "Set environment variables"},
     {"unset", builtin_unset, "Unset environment variables"},
+    {"let", builtin_let, "Evaluate arithmetic expressions"},
     {"pwd", builtin_pwd, "Print working directory"},
     {"jobs", builtin_jobs, "List active jobs"},
     {"fg", builtin_fg, "Bring job to foreground"},
@@ -230,6 +413,19 @@ static builtin_t builtins[] = {
     {"type", builtin_type, "Display command type"},
     {"source", builtin_source, "Source and execute commands from a file"},
     {"set", builtin_set, "Set shell options: -e/+e, -x/+x"},
+    {"break", builtin_break, "Exit from for, while or until loops"},
+    {"continue", builtin_continue, "Resume the next iteration of a loop"},
+    {"local", builtin_local, "Declare variables local to a function"},
+    {"return", builtin_return, "Return from a function"},
+    {"shift", builtin_shift, "Shift positional parameters"},
+    {"hash", builtin_hash, "Remember or display command locations"},
+    {"echo", builtin_echo, "Write arguments to standard output"},
+    {"printf", builtin_printf, "Write formatted output"},
+    {"test", builtin_test, "Evaluate a conditional expression"},
+    {"[", builtin_test, "Evaluate a conditional expression"},
+    {"true", builtin_true, "Return success"},
+    {"false", builtin_false, "Return failure"},
+    {":", builtin_true, "Null command; return success"},
     {NULL, NULL, NULL}, // slot 1
     {NULL, NULL, NULL}};
 
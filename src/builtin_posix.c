@@ -0,0 +1,650 @@
+/**
+ * @file builtin_posix.c
+ * @brief In-process POSIX utilities: echo, printf, test/[, true, false, ':'.
+ *
+ * These run in the shell so that conditions in && / || chains and loops do
+ * not fork/exec external binaries. Output of each command goes through one
+ * buffered writer and reaches the descriptor with as few write(2) calls as
+ * possible.
+ */
+#include "builtin.h"
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// --- buffered writer ----------------------------------------------------------
+
+typedef struct {
+    int fd;
+    size_t len;
+    int error;
+    char buf[4096];
+} out_writer_t;
+
+static void writer_init(out_writer_t *w, int fd) {
+    // Keep ordering with anything previously printed through stdio
+    fflush(stdout);
+    w->fd = fd;
+    w->len = 0;
+    w->error = 0;
+}
+
+static void writer_flush(out_writer_t *w) {
+    size_t off = 0;
+    while (off < w->len && !w->error) {
+        ssize_t n = write(w->fd, w->buf + off, w->len - off);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            w->error = errno;
+            break;
+        }
+        off += (size_t)n;
+    }
+    w->len = 0;
+}
+
+static void writer_put(out_writer_t *w, const char *s, size_t n) {
+    if (n > sizeof(w->buf) - w->len) {
+        writer_flush(w);
+        if (n > sizeof(w->buf)) {
+            // Large chunk: write it straight through instead of copying
+            while (n > 0 && !w->error) {
+                ssize_t r = write(w->fd, s, n);
+                if (r < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    w->error = errno;
+                    break;
+                }
+                s += r;
+                n -= (size_t)r;
+            }
+            return;
+        }
+    }
+    memcpy(w->buf + w->len, s, n);
+    w->len += n;
+}
+
+static void writer_putc(out_writer_t *w, char c) {
+    if (w->len == sizeof(w->buf))
+        writer_flush(w);
+    w->buf[w->len++] = c;
+}
+
+static int writer_finish(out_writer_t *w, const char *name) {
+    writer_flush(w);
+    if (w->error) {
+        fprintf(stderr, "%s: write error: %s\n", name, strerror(w->error));
+        return 1;
+    }
+    return 0;
+}
+
+// --- escapes ------------------------------------------------------------------
+
+// Decode one backslash escape starting after the backslash at s. Returns the
+// number of input bytes consumed; sets *stop for \c. octal_prefix selects the
+// echo form (\0nnn) rather than the printf form (\nnn).
+static size_t decode_escape(const char *s, out_writer_t *w, int octal_prefix, int *stop) {
+    switch (*s) {
+    case 'a': writer_putc(w, '\a'); return 1;
+    case 'b': writer_putc(w, '\b'); return 1;
+    case 'e': writer_putc(w, '\033'); return 1;
+    case 'f': writer_putc(w, '\f'); return 1;
+    case 'n': writer_putc(w, '\n'); return 1;
+    case 'r': writer_putc(w, '\r'); return 1;
+    case 't': writer_putc(w, '\t'); return 1;
+    case 'v': writer_putc(w, '\v'); return 1;
+    case '\\': writer_putc(w, '\\'); return 1;
+    case 'c': *stop = 1; return 1;
+    case 'x': {
+        size_t i = 1;
+        int v = 0;
+        while (i < 3 && isxdigit((unsigned char)s[i])) {
+            char c = s[i];
+            v = v * 16 + (isdigit((unsigned char)c) ? c - '0' : (tolower((unsigned char)c) - 'a' + 10));
+            i++;
+        }
+        if (i == 1) {
+            writer_put(w, "\\x", 2);
+            return 1;
+        }
+        writer_putc(w, (char)v);
+        return i;
+    }
+    default:
+        break;
+    }
+    if (*s >= '0' && *s <= '7') {
+        size_t i = 0, max = 3;
+        if (octal_prefix && *s == '0') {
+            i = 1;
+            max = 4;
+        }
+        int v = 0;
+        while (i < max && s[i] >= '0' && s[i] <= '7') {
+            v = v * 8 + (s[i] - '0');
+            i++;
+        }
+        writer_putc(w, (char)v);
+        return i;
+    }
+    // Unknown escape: keep it verbatim
+    writer_putc(w, '\\');
+    return 0;
+}
+
+static int put_escaped(out_writer_t *w, const char *s, int octal_prefix) {
+    int stop = 0;
+    while (*s && !stop) {
+        const char *bs = strchr(s, '\\');
+        if (!bs) {
+            writer_put(w, s, strlen(s));
+            break;
+        }
+        writer_put(w, s, (size_t)(bs - s));
+        s = bs + 1;
+        if (!*s) {
+            writer_putc(w, '\\');
+            break;
+        }
+        s += decode_escape(s, w, octal_prefix, &stop);
+    }
+    return stop;
+}
+
+// --- echo ---------------------------------------------------------------------
+
+int builtin_echo(int argc, char **argv) {
+    int newline = 1, escapes = 0;
+    int i = 1;
+    // Leading option words made only of n/e/E letters, as in bash
+    for (; i < argc; i++) {
+        const char *a = argv[i];
+        if (a[0] != '-' || a[1] == '\0' || strspn(a + 1, "neE") != strlen(a + 1))
+            break;
+        for (const char *p = a + 1; *p; ++p) {
+            if (*p == 'n')
+                newline = 0;
+            else if (*p == 'e')
+                escapes = 1;
+            else
+                escapes = 0;
+        }
+    }
+
+    out_writer_t w;
+    writer_init(&w, STDOUT_FILENO);
+    for (int first = i; i < argc; i++) {
+        if (i > first)
+            writer_putc(&w, ' ');
+        if (escapes) {
+            if (put_escaped(&w, argv[i], 1)) {
+                newline = 0;
+                break;
+            }
+        } else {
+            writer_put(&w, argv[i], strlen(argv[i]));
+        }
+    }
+    if (newline)
+        writer_putc(&w, '\n');
+    return writer_finish(&w, "echo");
+}
+
+// --- printf -------------------------------------------------------------------
+
+// Parse a numeric printf argument; 'c or "c yields the character code.
+static int parse_number(const char *arg, intmax_t *out) {
+    if (!arg || !*arg) {
+        *out = 0;
+        return 0;
+    }
+    if (arg[0] == '\'' || arg[0] == '"') {
+        *out = (unsigned char)arg[1];
+        return 0;
+    }
+    char *end = NULL;
+    errno = 0;
+    intmax_t v = strtoimax(arg, &end, 0);
+    if (errno == ERANGE || end == arg || *end != '\0') {
+        fprintf(stderr, "printf: %s: invalid number\n", arg);
+        *out = v;
+        return 1;
+    }
+    *out = v;
+    return 0;
+}
+
+static int parse_double(const char *arg, double *out) {
+    if (!arg || !*arg) {
+        *out = 0;
+        return 0;
+    }
+    if (arg[0] == '\'' || arg[0] == '"') {
+        *out = (unsigned char)arg[1];
+        return 0;
+    }
+    char *end = NULL;
+    *out = strtod(arg, &end);
+    if (end == arg || *end != '\0') {
+        fprintf(stderr, "printf: %s: invalid number\n", arg);
+        return 1;
+    }
+    return 0;
+}
+
+// Emit one conversion using snprintf with the collected spec.
+static void put_formatted(out_writer_t *w, const char *spec, ...) {
+    char small[256];
+    va_list ap, ap2;
+    va_start(ap, spec);
+    va_copy(ap2, ap);
+    int n = vsnprintf(small, sizeof small, spec, ap);
+    va_end(ap);
+    if (n < 0) {
+        va_end(ap2);
+        return;
+    }
+    if ((size_t)n < sizeof small) {
+        writer_put(w, small, (size_t)n);
+    } else {
+        char *big = malloc((size_t)n + 1);
+        if (big) {
+            vsnprintf(big, (size_t)n + 1, spec, ap2);
+            writer_put(w, big, (size_t)n);
+            free(big);
+        }
+    }
+    va_end(ap2);
+}
+
+int builtin_printf(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "printf: usage: printf format [arguments]\n");
+        return 2;
+    }
+    const char *fmt = argv[1];
+    char **args = argv + 2;
+    int nargs = argc - 2;
+    int ai = 0;
+    int rc = 0;
+    int stop = 0;
+
+    out_writer_t w;
+    writer_init(&w, STDOUT_FILENO);
+
+    // The format is reused while arguments remain (POSIX)
+    do {
+        int consumed_before = ai;
+        const char *p = fmt;
+        while (*p && !stop) {
+            if (*p == '\\') {
+                p++;
+                if (!*p) {
+                    writer_putc(&w, '\\');
+                    break;
+                }
+                p += decode_escape(p, &w, 0, &stop);
+                continue;
+            }
+            if (*p != '%') {
+                const char *next = p + strcspn(p, "%\\");
+                writer_put(&w, p, (size_t)(next - p));
+                p = next;
+                continue;
+            }
+            if (p[1] == '%') {
+                writer_putc(&w, '%');
+                p += 2;
+                continue;
+            }
+
+            // Collect "%[flags][width][.precision]" into spec, resolving '*'
+            char spec[64];
+            size_t sl = 0;
+            spec[sl++] = *p++;
+            while (*p && strchr("-+ #0", *p) && sl < 20)
+                spec[sl++] = *p++;
+            for (int part = 0; part < 2; part++) {
+                if (part == 1) {
+                    if (*p != '.')
+                        break;
+                    spec[sl++] = *p++;
+                }
+                if (*p == '*') {
+                    intmax_t v = 0;
+                    if (ai < nargs)
+                        rc |= parse_number(args[ai++], &v);
+                    sl += (size_t)snprintf(spec + sl, sizeof spec - sl - 8, "%d", (int)v);
+                    p++;
+                } else {
+                    while (isdigit((unsigned char)*p) && sl < 40)
+                        spec[sl++] = *p++;
+                }
+            }
+            char conv = *p;
+            if (!conv) {
+                fprintf(stderr, "printf: %s: missing format character\n", fmt);
+                rc = 1;
+                break;
+            }
+            p++;
+            const char *arg = ai < nargs ? args[ai++] : NULL;
+            switch (conv) {
+            case 'd':
+            case 'i': {
+                intmax_t v;
+                rc |= parse_number(arg, &v);
+                memcpy(spec + sl, "jd", 3);
+                put_formatted(&w, spec, v);
+                break;
+            }
+            case 'o':
+            case 'u':
+            case 'x':
+            case 'X': {
+                intmax_t v;
+                rc |= parse_number(arg, &v);
+                spec[sl] = 'j';
+                spec[sl + 1] = conv;
+                spec[sl + 2] = '\0';
+                put_formatted(&w, spec, (uintmax_t)v);
+                break;
+            }
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A': {
+                double v;
+                rc |= parse_double(arg, &v);
+                spec[sl] = conv;
+                spec[sl + 1] = '\0';
+                put_formatted(&w, spec, v);
+                break;
+            }
+            case 'c':
+                // An empty or missing argument prints only the padding
+                spec[sl] = arg && *arg ? 'c' : 's';
+                spec[sl + 1] = '\0';
+                if (arg && *arg)
+                    put_formatted(&w, spec, arg[0]);
+                else
+                    put_formatted(&w, spec, "");
+                break;
+            case 's':
+                spec[sl] = 's';
+                spec[sl + 1] = '\0';
+                put_formatted(&w, spec, arg ? arg : "");
+                break;
+            case 'b': {
+                // %b: argument with echo-style escapes (width/precision ignored)
+                if (arg && put_escaped(&w, arg, 1))
+                    stop = 1;
+                break;
+            }
+            default:
+                fprintf(stderr, "printf: %%%c: invalid directive\n", conv);
+                rc = 1;
+                stop = 1;
+                break;
+            }
+        }
+        // Avoid looping forever on a format without conversions
+        if (ai == consumed_before)
+            break;
+    } while (ai < nargs && !stop);
+
+    if (writer_finish(&w, "printf") != 0)
+        rc = 1;
+    return rc;
+}
+
+// --- test / [ -----------------------------------------------------------------
+
+typedef struct {
+    char **argv;
+    int argc;
+    int pos;
+    int error;
+} test_state_t;
+
+static int test_expr(test_state_t *t);
+
+static int is_binary_op(const char *s) {
+    static const char *const ops[] = {"=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le",
+                                      "-gt", "-ge", "-nt", "-ot", "-ef", NULL};
+    for (int i = 0; ops[i]; i++) {
+        if (strcmp(s, ops[i]) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+static int is_unary_op(const char *s) {
+    return s[0] == '-' && s[1] && !s[2] && strchr("bcdefghknprsStuwxzLOG", s[1]) != NULL;
+}
+
+static int test_integer(test_state_t *t, const char *s, long long *out) {
+    char *end = NULL;
+    errno = 0;
+    while (isspace((unsigned char)*s))
+        s++;
+    *out = strtoll(s, &end, 10);
+    while (end && isspace((unsigned char)*end))
+        end++;
+    if (errno == ERANGE || end == s || *end != '\0') {
+        fprintf(stderr, "test: %s: integer expression expected\n", s);
+        t->error = 1;
+        return 0;
+    }
+    return 1;
+}
+
+static int test_unary(const char *op, const char *arg) {
+    struct stat st;
+    switch (op[1]) {
+    case 'n':
+        return arg[0] != '\0';
+    case 'z':
+        return arg[0] == '\0';
+    case 't': {
+        char *end = NULL;
+        long fd = strtol(arg, &end, 10);
+        return end != arg && *end == '\0' && isatty((int)fd);
+    }
+    case 'r':
+        return access(arg, R_OK) == 0;
+    case 'w':
+        return access(arg, W_OK) == 0;
+    case 'x':
+        return access(arg, X_OK) == 0;
+    case 'h':
+    case 'L':
+        return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode);
+    default:
+        break;
+    }
+    if (stat(arg, &st) != 0)
+        return 0;
+    switch (op[1]) {
+    case 'e':
+        return 1;
+    case 'f':
+        return S_ISREG(st.st_mode);
+    case 'd':
+        return S_ISDIR(st.st_mode);
+    case 'b':
+        return S_ISBLK(st.st_mode);
+    case 'c':
+        return S_ISCHR(st.st_mode);
+    case 'p':
+        return S_ISFIFO(st.st_mode);
+    case 'S':
+        return S_ISSOCK(st.st_mode);
+    case 's':
+        return st.st_size > 0;
+    case 'g':
+        return (st.st_mode & S_ISGID) != 0;
+    case 'u':
+        return (st.st_mode & S_ISUID) != 0;
+    case 'k':
+        return (st.st_mode & S_ISVTX) != 0;
+    case 'O':
+        return st.st_uid == geteuid();
+    case 'G':
+        return st.st_gid == getegid();
+    default:
+        return 0;
+    }
+}
+
+static int test_binary(test_state_t *t, const char *l, const char *op, const char *r) {
+    if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0)
+        return strcmp(l, r) == 0;
+    if (strcmp(op, "!=") == 0)
+        return strcmp(l, r) != 0;
+    if (strcmp(op, "<") == 0)
+        return strcmp(l, r) < 0;
+    if (strcmp(op, ">") == 0)
+        return strcmp(l, r) > 0;
+    if (op[0] == '-' && (op[1] == 'n' || op[1] == 'o') && op[2] == 't') {
+        struct stat a, b;
+        int ha = stat(l, &a) == 0, hb = stat(r, &b) == 0;
+        if (op[1] == 'n')
+            return ha && (!hb || a.st_mtim.tv_sec > b.st_mtim.tv_sec ||
+                          (a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec > b.st_mtim.tv_nsec));
+        return hb && (!ha || a.st_mtim.tv_sec < b.st_mtim.tv_sec ||
+                      (a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec < b.st_mtim.tv_nsec));
+    }
+    if (strcmp(op, "-ef") == 0) {
+        struct stat a, b;
+        return stat(l, &a) == 0 && stat(r, &b) == 0 && a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+    }
+    long long a, b;
+    if (!test_integer(t, l, &a) || !test_integer(t, r, &b))
+        return 0;
+    if (strcmp(op, "-eq") == 0)
+        return a == b;
+    if (strcmp(op, "-ne") == 0)
+        return a != b;
+    if (strcmp(op, "-lt") == 0)
+        return a < b;
+    if (strcmp(op, "-le") == 0)
+        return a <= b;
+    if (strcmp(op, "-gt") == 0)
+        return a > b;
+    return a >= b; // -ge
+}
+
+// primary := '(' expr ')' | unary-op arg | arg binary-op arg | arg
+static int test_primary(test_state_t *t) {
+    if (t->pos >= t->argc) {
+        fprintf(stderr, "test: argument expected\n");
+        t->error = 1;
+        return 0;
+    }
+    const char *a = t->argv[t->pos];
+    // Binary operators bind first so that "test -n = -n" compares strings
+    if (t->pos + 2 < t->argc && is_binary_op(t->argv[t->pos + 1])) {
+        const char *op = t->argv[t->pos + 1];
+        const char *b = t->argv[t->pos + 2];
+        t->pos += 3;
+        return test_binary(t, a, op, b);
+    }
+    if (strcmp(a, "(") == 0 && t->pos + 1 < t->argc) {
+        t->pos++;
+        int v = test_expr(t);
+        if (t->pos >= t->argc || strcmp(t->argv[t->pos], ")") != 0) {
+            fprintf(stderr, "test: ')' expected\n");
+            t->error = 1;
+            return 0;
+        }
+        t->pos++;
+        return v;
+    }
+    if (is_unary_op(a) && t->pos + 1 < t->argc) {
+        t->pos += 2;
+        return test_unary(a, t->argv[t->pos - 1]);
+    }
+    t->pos++;
+    return a[0] != '\0';
+}
+
+static int test_not(test_state_t *t) {
+    // "! = x" is a string comparison, not a negation
+    if (t->pos + 1 < t->argc && strcmp(t->argv[t->pos], "!") == 0 &&
+        !(t->pos + 2 < t->argc && is_binary_op(t->argv[t->pos + 1]))) {
+        t->pos++;
+        return !test_not(t);
+    }
+    return test_primary(t);
+}
+
+static int test_and(test_state_t *t) {
+    int v = test_not(t);
+    while (!t->error && t->pos < t->argc && strcmp(t->argv[t->pos], "-a") == 0) {
+        t->pos++;
+        int r = test_not(t);
+        v = v && r;
+    }
+    return v;
+}
+
+static int test_expr(test_state_t *t) {
+    int v = test_and(t);
+    while (!t->error && t->pos < t->argc && strcmp(t->argv[t->pos], "-o") == 0) {
+        t->pos++;
+        int r = test_and(t);
+        v = v || r;
+    }
+    return v;
+}
+
+int builtin_test(int argc, char **argv) {
+    const char *name = argv[0] ? argv[0] : "test";
+    if (strcmp(name, "[") == 0) {
+        if (argc < 2 || strcmp(argv[argc - 1], "]") != 0) {
+            fprintf(stderr, "[: missing ']'\n");
+            return 2;
+        }
+        argc--;
+    }
+    if (argc < 2)
+        return 1;
+
+    test_state_t t = {.argv = argv + 1, .argc = argc - 1, .pos = 0, .error = 0};
+    int v = test_expr(&t);
+    if (!t.error && t.pos < t.argc) {
+        fprintf(stderr, "%s: %s: unexpected argument\n", name, t.argv[t.pos]);
+        t.error = 1;
+    }
+    if (t.error)
+        return 2;
+    return v ? 0 : 1;
+}
+
+// --- true / false / : -----------------------------------------------------------
+
+int builtin_true(int argc __attribute__((unused)),
+                 char **argv __attribute__((unused))) {
+    return 0;
+}
+
+int builtin_false(int argc __attribute__((unused)),
+                  char **argv __attribute__((unused))) {
+    return 1;
+}
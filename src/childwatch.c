@@ -0,0 +1,268 @@
+/**
+ * @file childwatch.c
+ * @brief Child reaping driven by pidfds and a SIGCHLD signalfd.
+ */
+#include "childwatch.h"
+#include "util.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+typedef struct childwatch_entry {
+    pid_t pid;
+    int pidfd; // -1 when pidfd_open() is unavailable; checked on SIGCHLD
+    childwatch_callback_t callback;
+    void *data;
+    struct childwatch_entry *next;
+} childwatch_entry_t;
+
+static evloop_t *watch_loop = NULL;
+static pid_t owner_pid = 0;
+static int signal_fd = -1;
+static sigset_t saved_mask;
+static childwatch_entry_t *entries = NULL;
+
+static int pidfd_open_compat(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+// Encode stop/continue notifications the way waitpid() reports them.
+static int stop_status(int sig) {
+    return (sig << 8) | 0x7f;
+}
+static int continued_status(void) {
+    return 0xffff;
+}
+
+static childwatch_entry_t *find_entry(pid_t pid) {
+    for (childwatch_entry_t *e = entries; e; e = e->next) {
+        if (e->pid == pid)
+            return e;
+    }
+    return NULL;
+}
+
+static void unlink_entry(childwatch_entry_t *entry) {
+    for (childwatch_entry_t **pp = &entries; *pp; pp = &(*pp)->next) {
+        if (*pp == entry) {
+            *pp = entry->next;
+            break;
+        }
+    }
+    if (entry->pidfd != -1) {
+        evloop_remove_fd(watch_loop, entry->pidfd);
+        close(entry->pidfd);
+    }
+}
+
+// The child has been reaped: drop the watch first so the callback may
+// add new ones, then report.
+static void deliver_exit(childwatch_entry_t *entry, int status) {
+    unlink_entry(entry);
+    if (entry->callback)
+        entry->callback(entry->pid, status, entry->data);
+    free(entry);
+}
+
+// Reap entry->pid if it has exited. Returns 1 when the watch is gone.
+static int try_reap(childwatch_entry_t *entry) {
+    int status = 0;
+    pid_t r = waitpid(entry->pid, &status, WNOHANG);
+    if (r == entry->pid) {
+        deliver_exit(entry, status);
+        return 1;
+    }
+    if (r == -1 && errno == ECHILD) {
+        // Reaped by someone else; nothing left to report.
+        unlink_entry(entry);
+        free(entry);
+        return 1;
+    }
+    return 0;
+}
+
+static void on_pidfd_ready(int fd, void *data) {
+    (void)fd;
+    try_reap((childwatch_entry_t *)data);
+    evloop_stop(watch_loop);
+}
+
+static void on_sigchld(int fd, void *data) {
+    (void)data;
+    struct signalfd_siginfo info;
+    while (read(fd, &info, sizeof(info)) == (ssize_t)sizeof(info)) {
+        // Drain: coalesced SIGCHLDs carry no extra information.
+    }
+
+    // Exits of children watched without a pidfd.
+    childwatch_entry_t *e = entries;
+    while (e) {
+        childwatch_entry_t *next = e->next;
+        if (e->pidfd == -1)
+            try_reap(e);
+        e = next;
+    }
+
+    // Stop/continue notifications. Exits are left for the pidfd handlers
+    // (WEXITED is not requested, so nothing is reaped here).
+    for (;;) {
+        siginfo_t si;
+        si.si_pid = 0;
+        if (waitid(P_ALL, 0, &si, WSTOPPED | WCONTINUED | WNOHANG) == -1 || si.si_pid == 0)
+            break;
+        childwatch_entry_t *entry = find_entry(si.si_pid);
+        if (!entry || !entry->callback)
+            continue;
+        int status = si.si_code == CLD_CONTINUED ? continued_status() : stop_status(si.si_status);
+        entry->callback(si.si_pid, status, entry->data);
+    }
+    evloop_stop(watch_loop);
+}
+
+int childwatch_init(evloop_t *loop) {
+    if (!loop)
+        return -1;
+    if (childwatch_active())
+        return 0;
+
+    sigset_t chld;
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    if (sigprocmask(SIG_BLOCK, &chld, &saved_mask) == -1) {
+        perror("sigprocmask");
+        return -1;
+    }
+    signal_fd = signalfd(-1, &chld, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd == -1) {
+        perror("signalfd");
+        sigprocmask(SIG_SETMASK, &saved_mask, NULL);
+        return -1;
+    }
+    if (evloop_add_fd(loop, signal_fd, EVLOOP_READ, on_sigchld, NULL) != 0) {
+        close(signal_fd);
+        signal_fd = -1;
+        sigprocmask(SIG_SETMASK, &saved_mask, NULL);
+        return -1;
+    }
+    watch_loop = loop;
+    owner_pid = getpid();
+    return 0;
+}
+
+void childwatch_shutdown(void) {
+    if (!childwatch_active())
+        return;
+    while (entries) {
+        childwatch_entry_t *e = entries;
+        unlink_entry(e);
+        free(e);
+    }
+    evloop_remove_fd(watch_loop, signal_fd);
+    close(signal_fd);
+    signal_fd = -1;
+    sigprocmask(SIG_SETMASK, &saved_mask, NULL);
+    watch_loop = NULL;
+    owner_pid = 0;
+}
+
+int childwatch_active(void) {
+    return watch_loop != NULL && owner_pid == getpid();
+}
+
+int childwatch_add(pid_t pid, childwatch_callback_t callback, void *data) {
+    if (!childwatch_active() || pid <= 0)
+        return -1;
+
+    childwatch_entry_t *entry = malloc_safe(sizeof(*entry));
+    entry->pid = pid;
+    entry->pidfd = pidfd_open_compat(pid);
+    entry->callback = callback;
+    entry->data = data;
+    entry->next = entries;
+    entries = entry;
+
+    if (entry->pidfd == -1) {
+        // No pidfd: rely on SIGCHLD. A child that is not ours (or already
+        // reaped) would never be reported, so refuse it up front.
+        siginfo_t si;
+        if (waitid(P_PID, (id_t)pid, &si, WEXITED | WSTOPPED | WCONTINUED | WNOHANG | WNOWAIT) == -1 &&
+            errno == ECHILD) {
+            entries = entry->next;
+            free(entry);
+            return -1;
+        }
+        return 0;
+    }
+    if (evloop_add_fd(watch_loop, entry->pidfd, EVLOOP_READ, on_pidfd_ready, entry) != 0) {
+        close(entry->pidfd);
+        entry->pidfd = -1;
+    }
+    return 0;
+}
+
+typedef struct {
+    int done;
+    int status;
+} childwatch_waiter_t;
+
+static void on_waited_child(pid_t pid, int status, void *data) {
+    (void)pid;
+    childwatch_waiter_t *w = data;
+    if (WIFEXITED(status) || WIFSIGNALED(status)) {
+        w->done = 1;
+        w->status = status;
+    }
+}
+
+static int blocking_wait(pid_t pid, int *status) {
+    int st = 0;
+    pid_t w;
+    do {
+        w = waitpid(pid, &st, 0);
+    } while (w == -1 && errno == EINTR);
+    if (w == -1)
+        return -1;
+    if (status)
+        *status = st;
+    return 0;
+}
+
+int childwatch_wait(pid_t pid, int *status) {
+    childwatch_waiter_t waiter = {0, 0};
+    if (childwatch_add(pid, on_waited_child, &waiter) != 0)
+        return blocking_wait(pid, status);
+
+    // The watch disappears without a report if the child was reaped elsewhere.
+    while (!waiter.done && find_entry(pid)) {
+        if (evloop_run(watch_loop, -1) != 0) {
+            childwatch_entry_t *e = find_entry(pid);
+            if (e) {
+                unlink_entry(e);
+                free(e);
+            }
+            return blocking_wait(pid, status);
+        }
+    }
+    if (!waiter.done)
+        return -1;
+    if (status)
+        *status = waiter.status;
+    return 0;
+}
+
+int childwatch_dispatch(void) {
+    if (!childwatch_active())
+        return -1;
+    return evloop_run(watch_loop, -1);
+}
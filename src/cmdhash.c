@@ -0,0 +1,220 @@
+/**
+ * @file cmdhash.c
+ * @brief Command-name -> absolute-path cache with PATH/mtime invalidation.
+ */
+#include "cmdhash.h"
+#include "env.h"
+#include "util.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CMDHASH_BUCKETS 128
+
+typedef struct cmdhash_entry {
+    char *name;
+    char *path;
+    int dir;       // index into path_dirs, or -1 when pinned with hash -p
+    unsigned hits;
+    struct cmdhash_entry *next;
+} cmdhash_entry_t;
+
+static cmdhash_entry_t *buckets[CMDHASH_BUCKETS];
+static int n_entries = 0;
+
+/** PATH split into directories, with their mtimes when last checked. */
+static char **path_dirs = NULL;
+static int n_dirs = 0;
+static struct timespec *dir_mtimes = NULL;
+static time_t last_validate = 0;
+
+static unsigned hash_name(const char *s) {
+    unsigned h = 2166136261u; // FNV-1a
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h % CMDHASH_BUCKETS;
+}
+
+static cmdhash_entry_t *find_entry(const char *name) {
+    for (cmdhash_entry_t *e = buckets[hash_name(name)]; e; e = e->next) {
+        if (strcmp(e->name, name) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+static cmdhash_entry_t *insert_entry(const char *name, const char *path, int dir) {
+    cmdhash_entry_t *e = find_entry(name);
+    if (e) {
+        free(e->path);
+    } else {
+        unsigned b = hash_name(name);
+        e = malloc_safe(sizeof(*e));
+        e->name = strdup_safe(name);
+        e->next = buckets[b];
+        buckets[b] = e;
+        n_entries++;
+    }
+    e->path = strdup_safe(path);
+    e->dir = dir;
+    e->hits = 0;
+    return e;
+}
+
+// Drop entries matching the predicate (all, or those found at index >= min_dir).
+static void drop_entries(int min_dir, int keep_pinned) {
+    for (int b = 0; b < CMDHASH_BUCKETS; ++b) {
+        cmdhash_entry_t **pp = &buckets[b];
+        while (*pp) {
+            cmdhash_entry_t *e = *pp;
+            int pinned = e->dir < 0;
+            if ((pinned && keep_pinned) || (!pinned && e->dir < min_dir)) {
+                pp = &e->next;
+                continue;
+            }
+            *pp = e->next;
+            free(e->name);
+            free(e->path);
+            free(e);
+            n_entries--;
+        }
+    }
+}
+
+static void free_dirs(void) {
+    free_string_array(path_dirs);
+    free(dir_mtimes);
+    path_dirs = NULL;
+    dir_mtimes = NULL;
+    n_dirs = 0;
+}
+
+static void stat_dir(int i) {
+    struct stat st;
+    if (stat(path_dirs[i], &st) == 0)
+        dir_mtimes[i] = st.st_mtim;
+    else
+        dir_mtimes[i].tv_sec = dir_mtimes[i].tv_nsec = 0;
+}
+
+static int ensure_dirs(void) {
+    if (path_dirs)
+        return n_dirs;
+    const char *path_env = env_get("PATH");
+    if (!path_env)
+        return 0;
+    path_dirs = split_string(path_env, ":");
+    n_dirs = (int)string_array_length(path_dirs);
+    dir_mtimes = malloc_safe(sizeof(struct timespec) * (size_t)(n_dirs > 0 ? n_dirs : 1));
+    for (int i = 0; i < n_dirs; ++i)
+        stat_dir(i);
+    last_validate = time(NULL);
+    return n_dirs;
+}
+
+// A change in directory i can shadow or remove any entry found at index >= i.
+static void validate_dirs(void) {
+    time_t now = time(NULL);
+    if (now == last_validate)
+        return;
+    last_validate = now;
+    for (int i = 0; i < n_dirs; ++i) {
+        struct timespec old = dir_mtimes[i];
+        stat_dir(i);
+        if (old.tv_sec != dir_mtimes[i].tv_sec || old.tv_nsec != dir_mtimes[i].tv_nsec) {
+            drop_entries(i, 1);
+            for (int j = i + 1; j < n_dirs; ++j)
+                stat_dir(j);
+            return;
+        }
+    }
+}
+
+static int is_regular_executable(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode) && is_executable(path);
+}
+
+const char *cmdhash_lookup(const char *name) {
+    if (!name || !*name || strchr(name, '/'))
+        return NULL;
+    if (ensure_dirs() > 0)
+        validate_dirs();
+
+    cmdhash_entry_t *e = find_entry(name);
+    if (e) {
+        e->hits++;
+        return e->path;
+    }
+
+    size_t name_len = strlen(name);
+    for (int i = 0; i < n_dirs; ++i) {
+        size_t dir_len = strlen(path_dirs[i]);
+        char full[dir_len + name_len + 2];
+        memcpy(full, path_dirs[i], dir_len);
+        full[dir_len] = '/';
+        memcpy(full + dir_len + 1, name, name_len + 1);
+        if (is_regular_executable(full)) {
+            e = insert_entry(name, full, i);
+            e->hits = 1;
+            return e->path;
+        }
+    }
+    return NULL;
+}
+
+const char *cmdhash_peek(const char *name) {
+    if (!name)
+        return NULL;
+    cmdhash_entry_t *e = find_entry(name);
+    return e ? e->path : NULL;
+}
+
+int cmdhash_add(const char *name, const char *path) {
+    if (!name || !*name || !path || strchr(name, '/')) {
+        errno = EINVAL;
+        return -1;
+    }
+    insert_entry(name, path, -1);
+    return 0;
+}
+
+int cmdhash_remove(const char *name) {
+    if (!name)
+        return -1;
+    cmdhash_entry_t **pp = &buckets[hash_name(name)];
+    for (; *pp; pp = &(*pp)->next) {
+        cmdhash_entry_t *e = *pp;
+        if (strcmp(e->name, name) == 0) {
+            *pp = e->next;
+            free(e->name);
+            free(e->path);
+            free(e);
+            n_entries--;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void cmdhash_clear(void) {
+    drop_entries(0, 0);
+    free_dirs();
+}
+
+int cmdhash_print(void) {
+    if (n_entries == 0)
+        return 0;
+    printf("hits\tcommand\n");
+    for (int b = 0; b < CMDHASH_BUCKETS; ++b) {
+        for (cmdhash_entry_t *e = buckets[b]; e; e = e->next)
+            printf("%4u\t%s\n", e->hits, e->path);
+    }
+    return n_entries;
+}
@@ -0,0 +1,325 @@
+/**
+ * @file env.c
+ * @brief Shell variable store: open-addressing hash table with export flags.
+ *
+ * Each variable is kept as one "NAME=value" allocation, so the envp array
+ * handed to children is just a vector of pointers into the table. That
+ * vector is rebuilt only when an exported variable was added, changed or
+ * removed since the last env_envp() call; assigning unexported shell
+ * variables never touches it.
+ */
+#include "env.h"
+#include "cmdhash.h"
+#include "util.h"
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern char **environ;
+
+#define ENV_MIN_CAPACITY 64
+
+#define VAR_EXPORTED 0x1
+#define VAR_NOVALUE 0x2 // exported with `export NAME` but never assigned
+#define VAR_DELETED 0x4 // tombstone
+
+typedef struct env_var {
+    char *entry; // "NAME=value"; NULL for empty slots and tombstones
+    unsigned hash;
+    unsigned name_len;
+    int flags;
+} env_var_t;
+
+static env_var_t *table = NULL;
+static size_t capacity = 0; // power of two
+static size_t n_used = 0;   // live entries plus tombstones
+static size_t n_live = 0;
+static size_t n_exported = 0;
+
+static char **envp = NULL; // exported entries, NULL-terminated
+static size_t envp_capacity = 0;
+static int envp_dirty = 1;
+
+static unsigned hash_name(const char *s, size_t len) {
+    unsigned h = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Length of the variable name at the start of s (0 if there is none).
+static size_t name_length(const char *s) {
+    if (!s || !(*s == '_' || isalpha((unsigned char)*s)))
+        return 0;
+    size_t n = 1;
+    while (s[n] == '_' || isalnum((unsigned char)s[n]))
+        n++;
+    return n;
+}
+
+static int valid_name(const char *name) {
+    size_t n = name_length(name);
+    return n > 0 && name[n] == '\0';
+}
+
+// Slot holding name, or NULL. With insert set, returns the slot a new
+// entry should go to instead (the first tombstone on the probe path, else
+// the empty slot that ended it).
+static env_var_t *probe(const char *name, size_t len, unsigned hash, int insert) {
+    size_t mask = capacity - 1;
+    env_var_t *reuse = NULL;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        env_var_t *v = &table[i];
+        if (!v->entry) {
+            if (!(v->flags & VAR_DELETED))
+                return insert ? (reuse ? reuse : v) : NULL;
+            if (!reuse)
+                reuse = v;
+            continue;
+        }
+        if (v->hash == hash && v->name_len == len && memcmp(v->entry, name, len) == 0)
+            return v;
+    }
+}
+
+// Resize to hold at least `want` live entries below a 3/4 load factor;
+// tombstones are dropped on the way.
+static void rehash(size_t want) {
+    size_t cap = ENV_MIN_CAPACITY;
+    while (cap * 3 / 4 <= want)
+        cap *= 2;
+    env_var_t *old = table;
+    size_t old_capacity = capacity;
+    table = malloc_safe(sizeof(env_var_t) * cap);
+    memset(table, 0, sizeof(env_var_t) * cap);
+    capacity = cap;
+    n_used = n_live;
+    for (size_t i = 0; i < old_capacity; ++i) {
+        if (!old[i].entry)
+            continue;
+        size_t mask = capacity - 1;
+        size_t j = old[i].hash & mask;
+        while (table[j].entry)
+            j = (j + 1) & mask;
+        table[j] = old[i];
+    }
+    free(old);
+}
+
+static char *make_entry(const char *name, size_t len, const char *value) {
+    size_t vlen = value ? strlen(value) : 0;
+    char *entry = malloc_safe(len + vlen + 2);
+    memcpy(entry, name, len);
+    entry[len] = '=';
+    if (vlen)
+        memcpy(entry + len + 1, value, vlen);
+    entry[len + 1 + vlen] = '\0';
+    return entry;
+}
+
+static void mark_exported_change(const env_var_t *v) {
+    if (v->flags & VAR_EXPORTED)
+        envp_dirty = 1;
+}
+
+// Create or update a variable and add flags_set to its flags. A NULL
+// value leaves an existing value alone (or declares the name unset).
+static env_var_t *store(const char *name, size_t len, const char *value, int flags_set) {
+    unsigned hash = hash_name(name, len);
+    env_var_t *v = probe(name, len, hash, 1);
+    if (!v->entry) {
+        if (n_used + 1 > capacity * 3 / 4) {
+            rehash(n_live + 1);
+            v = probe(name, len, hash, 1);
+        }
+        if (!(v->flags & VAR_DELETED))
+            n_used++;
+        v->entry = make_entry(name, len, value);
+        v->hash = hash;
+        v->name_len = (unsigned)len;
+        v->flags = flags_set | (value ? 0 : VAR_NOVALUE);
+        n_live++;
+        if (v->flags & VAR_EXPORTED)
+            n_exported++;
+        mark_exported_change(v);
+        return v;
+    }
+    if (value) {
+        // Build the new entry first: value may point into the old one.
+        char *entry = make_entry(name, len, value);
+        free(v->entry);
+        v->entry = entry;
+        v->flags &= ~VAR_NOVALUE;
+        mark_exported_change(v);
+    }
+    if ((flags_set & VAR_EXPORTED) && !(v->flags & VAR_EXPORTED)) {
+        v->flags |= VAR_EXPORTED;
+        n_exported++;
+        envp_dirty = 1;
+    }
+    return v;
+}
+
+// Import the process environment the first time the store is used.
+static void ensure_table(void) {
+    if (table)
+        return;
+    rehash(0);
+    for (char **e = environ; e && *e; ++e) {
+        const char *eq = strchr(*e, '=');
+        if (!eq || eq == *e)
+            continue;
+        store(*e, (size_t)(eq - *e), eq + 1, VAR_EXPORTED);
+    }
+}
+
+static env_var_t *lookup_n(const char *name, size_t len) {
+    ensure_table();
+    return probe(name, len, hash_name(name, len), 0);
+}
+
+static env_var_t *lookup(const char *name) {
+    return lookup_n(name, strlen(name));
+}
+
+// posix_spawnp() searches the shell's own PATH, so keep it in step with
+// the store and drop cached lookups.
+static void path_changed(const char *name) {
+    if (strcmp(name, "PATH") != 0)
+        return;
+    cmdhash_clear();
+    env_var_t *v = lookup(name);
+    if (v && !(v->flags & VAR_NOVALUE))
+        setenv("PATH", v->entry + v->name_len + 1, 1);
+    else
+        unsetenv("PATH");
+}
+
+static int set_var(const char *name, const char *value, int flags) {
+    if (!valid_name(name) || !value) {
+        errno = EINVAL;
+        return -1;
+    }
+    ensure_table();
+    store(name, strlen(name), value, flags);
+    path_changed(name);
+    return 0;
+}
+
+char *env_get(const char *name) {
+    return name ? env_getn(name, strlen(name)) : NULL;
+}
+
+char *env_getn(const char *name, size_t len) {
+    if (!name || len == 0)
+        return NULL;
+    env_var_t *v = lookup_n(name, len);
+    if (!v || (v->flags & VAR_NOVALUE))
+        return NULL;
+    return v->entry + v->name_len + 1;
+}
+
+int env_set(const char *name, const char *value) {
+    return set_var(name, value, VAR_EXPORTED);
+}
+
+int env_assign(const char *name, const char *value) {
+    return set_var(name, value, 0);
+}
+
+int env_export(const char *name) {
+    if (!valid_name(name)) {
+        errno = EINVAL;
+        return -1;
+    }
+    ensure_table();
+    store(name, strlen(name), NULL, VAR_EXPORTED);
+    return 0;
+}
+
+int env_is_exported(const char *name) {
+    if (!name)
+        return 0;
+    env_var_t *v = lookup(name);
+    return v && (v->flags & VAR_EXPORTED);
+}
+
+int env_unset(const char *name) {
+    if (!name || !*name || strchr(name, '=')) {
+        errno = EINVAL;
+        return -1;
+    }
+    env_var_t *v = lookup(name);
+    if (!v)
+        return 0;
+    if (v->flags & VAR_EXPORTED) {
+        n_exported--;
+        envp_dirty = 1;
+    }
+    free(v->entry);
+    v->entry = NULL;
+    v->flags = VAR_DELETED;
+    n_live--;
+    path_changed(name);
+    return 0;
+}
+
+char **env_envp(void) {
+    ensure_table();
+    if (!envp_dirty)
+        return envp;
+    if (n_exported + 1 > envp_capacity) {
+        envp_capacity = n_exported + 1 > 2 * envp_capacity ? n_exported + 1 : 2 * envp_capacity;
+        envp = realloc_safe(envp, sizeof(char *) * envp_capacity);
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < capacity; ++i) {
+        const env_var_t *v = &table[i];
+        if (v->entry && (v->flags & VAR_EXPORTED) && !(v->flags & VAR_NOVALUE))
+            envp[n++] = v->entry;
+    }
+    envp[n] = NULL;
+    envp_dirty = 0;
+    return envp;
+}
+
+char **env_get_all(void) {
+    return env_envp();
+}
+
+void env_print(void) {
+    char **env = env_envp();
+    for (int i = 0; env[i]; i++) {
+        printf("%s\n", env[i]);
+    }
+}
+
+int env_is_assignment(const char *word) {
+    size_t n = name_length(word);
+    return n > 0 && word[n] == '=';
+}
+
+static env_positional_t positional = {NULL, 0};
+
+const env_positional_t *env_positional(void) {
+    return &positional;
+}
+
+void env_set_positional(char **argv, int argc) {
+    positional.argv = argc > 0 ? argv : NULL;
+    positional.argc = argc > 0 ? argc : 0;
+}
+
+int env_shift_positional(int n) {
+    if (n < 0 || n > positional.argc)
+        return -1;
+    if (n == 0)
+        return 0;
+    positional.argv += n;
+    positional.argc -= n;
+    return 0;
+}
@@ -0,0 +1,429 @@
+/**
+ * @file evloop.c
+ * @brief Event loop front-end: registrations, run loop and backend registry.
+ */
+#include "evloop_backend.h"
+#include "util.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+
+/** Built-in backends, in order of preference. The first is the default. */
+static const evloop_backend_t *const backends[] = {
+#ifdef __linux__
+    &evloop_backend_epoll,
+#endif
+    &evloop_backend_poll,
+    &evloop_backend_select,
+    NULL,
+};
+
+static const evloop_backend_t *find_backend(const char *name) {
+    for (int i = 0; backends[i]; ++i) {
+        if (strcmp(backends[i]->name, name) == 0)
+            return backends[i];
+    }
+    return NULL;
+}
+
+static evloop_t *create_with(const evloop_backend_t *backend) {
+    evloop_t *loop = malloc_safe(sizeof(evloop_t));
+    memset(loop, 0, sizeof(*loop));
+    loop->backend = backend;
+    loop->timer_free = -1;
+    if (backend->init(loop) != 0) {
+        free(loop);
+        return NULL;
+    }
+    return loop;
+}
+
+evloop_t *evloop_create_backend(const char *name) {
+    const evloop_backend_t *backend = name ? find_backend(name) : backends[0];
+    if (!backend) {
+        errno = ENOENT;
+        return NULL;
+    }
+    return create_with(backend);
+}
+
+evloop_t *evloop_create(void) {
+    const char *name = getenv("MYSHELL_EVLOOP");
+    const evloop_backend_t *backend = backends[0];
+    if (name && *name) {
+        backend = find_backend(name);
+        if (!backend) {
+            fprintf(stderr, "myshell: MYSHELL_EVLOOP=%s: unknown backend, using %s\n", name,
+                    backends[0]->name);
+            backend = backends[0];
+        }
+    }
+    return create_with(backend);
+}
+
+const char *evloop_backend_name(const evloop_t *loop) {
+    return loop ? loop->backend->name : NULL;
+}
+
+// Grow the slot table so that fd is a valid index; new slots are zeroed.
+static void ensure_slot(evloop_t *loop, int fd) {
+    if (fd < loop->capacity)
+        return;
+    int cap = loop->capacity ? loop->capacity : 64;
+    while (cap <= fd)
+        cap *= 2;
+    loop->slots = realloc_safe(loop->slots, sizeof(struct evloop_fd) * (size_t)cap);
+    memset(loop->slots + loop->capacity, 0,
+           sizeof(struct evloop_fd) * (size_t)(cap - loop->capacity));
+    loop->capacity = cap;
+}
+
+int evloop_add_fd(evloop_t *loop, int fd, evloop_events_t events,
+                  evloop_callback_t callback, void *data) {
+    if (!loop || fd < 0 || !callback) {
+        return -1;
+    }
+    if (evloop_slot(loop, fd)) {
+        errno = EEXIST;
+        return -1;
+    }
+
+    ensure_slot(loop, fd);
+    struct evloop_fd *reg = &loop->slots[fd];
+    reg->callback = callback;
+    reg->data = data;
+    reg->events = events;
+    reg->gen = reg->gen + 1 ? reg->gen + 1 : 1;
+    reg->armed = 1;
+    reg->slot = -1;
+    if (loop->backend->add(loop, fd) != 0) {
+        reg->callback = NULL;
+        return -1;
+    }
+    loop->n_fds++;
+    return 0;
+}
+
+int evloop_mod_fd(evloop_t *loop, int fd, evloop_events_t events) {
+    if (!loop)
+        return -1;
+    struct evloop_fd *reg = evloop_slot(loop, fd);
+    if (!reg) {
+        errno = ENOENT;
+        return -1;
+    }
+    evloop_events_t old_events = reg->events;
+    int old_armed = reg->armed;
+    reg->events = events;
+    reg->armed = 1;
+    if (loop->backend->mod(loop, fd) != 0) {
+        reg->events = old_events;
+        reg->armed = old_armed;
+        return -1;
+    }
+    return 0;
+}
+
+int evloop_remove_fd(evloop_t *loop, int fd) {
+    if (!loop)
+        return -1;
+    struct evloop_fd *reg = evloop_slot(loop, fd);
+    if (!reg)
+        return -1;
+    loop->backend->remove(loop, fd);
+    // Events already collected for this fd are dropped by evloop_dispatch().
+    reg->callback = NULL;
+    reg->data = NULL;
+    loop->n_fds--;
+    return 0;
+}
+
+void evloop_dispatch(evloop_t *loop, int fd, unsigned gen) {
+    struct evloop_fd *reg = evloop_slot(loop, fd);
+    if (!loop->running || !reg || (gen && reg->gen != gen) || !reg->armed)
+        return;
+    // Copy out: the callback may grow (move) the slot table.
+    evloop_callback_t callback = reg->callback;
+    void *data = reg->data;
+    if (reg->events & EVLOOP_ONESHOT) {
+        reg->armed = 0;
+        loop->backend->mod(loop, fd);
+    }
+    callback(fd, data);
+}
+
+// Timer ids combine the record slot with its generation so a stale id
+// never cancels a timer that later reused the slot.
+#define TIMER_SLOT_BITS 20
+#define TIMER_SLOT_MASK ((1 << TIMER_SLOT_BITS) - 1)
+#define TIMER_GEN_MASK 0x7ffu
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t timer_deadline(const evloop_t *loop, int pos) {
+    return loop->timers[loop->timer_heap[pos]].deadline;
+}
+
+static void heap_set(evloop_t *loop, int pos, int slot) {
+    loop->timer_heap[pos] = slot;
+    loop->timers[slot].heap_pos = pos;
+}
+
+static void heap_sift_up(evloop_t *loop, int pos) {
+    int slot = loop->timer_heap[pos];
+    uint64_t deadline = loop->timers[slot].deadline;
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (timer_deadline(loop, parent) <= deadline)
+            break;
+        heap_set(loop, pos, loop->timer_heap[parent]);
+        pos = parent;
+    }
+    heap_set(loop, pos, slot);
+}
+
+static void heap_sift_down(evloop_t *loop, int pos) {
+    int slot = loop->timer_heap[pos];
+    uint64_t deadline = loop->timers[slot].deadline;
+    for (;;) {
+        int child = 2 * pos + 1;
+        if (child >= loop->n_timers)
+            break;
+        if (child + 1 < loop->n_timers &&
+            timer_deadline(loop, child + 1) < timer_deadline(loop, child))
+            child++;
+        if (deadline <= timer_deadline(loop, child))
+            break;
+        heap_set(loop, pos, loop->timer_heap[child]);
+        pos = child;
+    }
+    heap_set(loop, pos, slot);
+}
+
+// Remove the timer at heap position pos and release its slot.
+static void timer_release(evloop_t *loop, int pos) {
+    int slot = loop->timer_heap[pos];
+    int last = loop->timer_heap[--loop->n_timers];
+    if (pos < loop->n_timers) {
+        heap_set(loop, pos, last);
+        heap_sift_down(loop, pos);
+        heap_sift_up(loop, loop->timers[last].heap_pos);
+    }
+    struct evloop_timer *t = &loop->timers[slot];
+    t->heap_pos = -1;
+    t->callback = NULL;
+    t->data = NULL;
+    t->next_free = loop->timer_free;
+    loop->timer_free = slot;
+}
+
+static int timer_alloc(evloop_t *loop) {
+    if (loop->timer_free < 0) {
+        if (loop->timer_capacity > TIMER_SLOT_MASK)
+            return -1;
+        int old = loop->timer_capacity;
+        int cap = old ? old * 2 : 16;
+        loop->timers = realloc_safe(loop->timers, sizeof(struct evloop_timer) * (size_t)cap);
+        loop->timer_heap = realloc_safe(loop->timer_heap, sizeof(int) * (size_t)cap);
+        memset(loop->timers + old, 0, sizeof(struct evloop_timer) * (size_t)(cap - old));
+        for (int i = cap - 1; i >= old; --i) {
+            loop->timers[i].heap_pos = -1;
+            loop->timers[i].next_free = loop->timer_free;
+            loop->timer_free = i;
+        }
+        loop->timer_capacity = cap;
+    }
+    int slot = loop->timer_free;
+    loop->timer_free = loop->timers[slot].next_free;
+    return slot;
+}
+
+int evloop_add_timer(evloop_t *loop, int delay_ms, int interval_ms,
+                     evloop_timer_callback_t callback, void *data) {
+    if (!loop || delay_ms < 0 || interval_ms < 0 || !callback)
+        return -1;
+    int slot = timer_alloc(loop);
+    if (slot < 0)
+        return -1;
+
+    struct evloop_timer *t = &loop->timers[slot];
+    t->deadline = now_ns() + (uint64_t)delay_ms * 1000000u;
+    t->interval = (uint64_t)interval_ms * 1000000u;
+    t->callback = callback;
+    t->data = data;
+    t->gen = (t->gen + 1) & TIMER_GEN_MASK;
+    if (!t->gen)
+        t->gen = 1;
+    loop->timer_heap[loop->n_timers] = slot;
+    t->heap_pos = loop->n_timers++;
+    heap_sift_up(loop, t->heap_pos);
+    return (int)(t->gen << TIMER_SLOT_BITS) | slot;
+}
+
+int evloop_cancel_timer(evloop_t *loop, int id) {
+    if (!loop || id <= 0)
+        return -1;
+    int slot = id & TIMER_SLOT_MASK;
+    unsigned gen = (unsigned)id >> TIMER_SLOT_BITS;
+    if (slot >= loop->timer_capacity)
+        return -1;
+    struct evloop_timer *t = &loop->timers[slot];
+    if (t->heap_pos < 0 || t->gen != gen)
+        return -1;
+    timer_release(loop, t->heap_pos);
+    return 0;
+}
+
+// Fire every timer that is due. Each periodic timer fires at most once
+// per call; if it fell behind, its next deadline is one interval from now.
+static int run_timers(evloop_t *loop) {
+    if (!loop->n_timers)
+        return 0;
+    uint64_t now = now_ns();
+    int fired = 0;
+    while (loop->running && loop->n_timers > 0 && timer_deadline(loop, 0) <= now) {
+        struct evloop_timer *t = &loop->timers[loop->timer_heap[0]];
+        evloop_timer_callback_t callback = t->callback;
+        void *data = t->data;
+        if (t->interval) {
+            t->deadline += t->interval;
+            if (t->deadline <= now)
+                t->deadline = now + t->interval;
+            heap_sift_down(loop, 0);
+        } else {
+            timer_release(loop, 0);
+        }
+        callback(data);
+        fired++;
+    }
+    return fired;
+}
+
+int evloop_defer(evloop_t *loop, evloop_timer_callback_t callback, void *data) {
+    if (!loop || !callback)
+        return -1;
+    if (loop->n_deferred == loop->deferred_capacity) {
+        if (loop->deferred_head > 0) {
+            // Reclaim the slots of callbacks that already ran.
+            loop->n_deferred -= loop->deferred_head;
+            memmove(loop->deferred, loop->deferred + loop->deferred_head,
+                    sizeof(struct evloop_deferred) * (size_t)loop->n_deferred);
+            loop->deferred_head = 0;
+        }
+        if (loop->n_deferred == loop->deferred_capacity) {
+            int cap = loop->deferred_capacity ? loop->deferred_capacity * 2 : 8;
+            loop->deferred =
+                realloc_safe(loop->deferred, sizeof(struct evloop_deferred) * (size_t)cap);
+            loop->deferred_capacity = cap;
+        }
+    }
+    loop->deferred[loop->n_deferred].callback = callback;
+    loop->deferred[loop->n_deferred].data = data;
+    loop->n_deferred++;
+    return 0;
+}
+
+// Run the callbacks queued before this call; ones they queue wait for the
+// next iteration. The head index keeps this safe under nested evloop_run().
+static int run_deferred(evloop_t *loop) {
+    int end = loop->n_deferred;
+    int ran = 0;
+    while (loop->running && loop->deferred_head < end) {
+        struct evloop_deferred d = loop->deferred[loop->deferred_head++];
+        d.callback(d.data);
+        ran++;
+    }
+    if (loop->deferred_head == loop->n_deferred)
+        loop->deferred_head = loop->n_deferred = 0;
+    return ran;
+}
+
+// Wait timeout for this iteration: 0 with deferred work pending, else the
+// caller's timeout shortened to the earliest timer (rounded up, so the
+// wait never ends before the deadline) unless the backend arms its own.
+static int wait_timeout(evloop_t *loop, int timeout_ms) {
+    if (loop->deferred_head < loop->n_deferred)
+        return 0;
+    if (loop->backend->set_timer) {
+        loop->backend->set_timer(loop, loop->n_timers ? timer_deadline(loop, 0) : 0);
+        return timeout_ms;
+    }
+    if (!loop->n_timers)
+        return timeout_ms;
+    uint64_t deadline = timer_deadline(loop, 0);
+    uint64_t now = now_ns();
+    if (deadline <= now)
+        return 0;
+    uint64_t ms = (deadline - now + 999999u) / 1000000u;
+    if (ms > INT_MAX)
+        ms = INT_MAX;
+    return (timeout_ms < 0 || (int)ms < timeout_ms) ? (int)ms : timeout_ms;
+}
+
+// Anything left that could make a wait return?
+static int loop_alive(const evloop_t *loop) {
+    return loop->running &&
+           (loop->n_fds > 0 || loop->n_timers > 0 || loop->deferred_head < loop->n_deferred);
+}
+
+int evloop_run(evloop_t *loop, int timeout_ms) {
+    if (!loop)
+        return -1;
+
+    loop->running = 1;
+
+    while (loop_alive(loop)) {
+        int ran = run_deferred(loop);
+        if (!loop_alive(loop))
+            break;
+
+        int result = loop->backend->wait(loop, wait_timeout(loop, timeout_ms));
+        int err = errno;
+
+        if (result < 0) {
+            if (err == EINTR) {
+                continue;
+            }
+            errno = err;
+            perror(loop->backend->name);
+            return -1;
+        }
+
+        int fired = run_timers(loop);
+        if (result == 0 && !fired && !ran && timeout_ms >= 0) {
+            // Timeout
+            break;
+        }
+    }
+
+    return 0;
+}
+
+void evloop_stop(evloop_t *loop) {
+    if (loop) {
+        loop->running = 0;
+    }
+}
+
+void evloop_free(evloop_t *loop) {
+    if (!loop)
+        return;
+
+    for (int fd = 0; fd < loop->capacity && loop->n_fds > 0; ++fd) {
+        if (evloop_slot(loop, fd))
+            evloop_remove_fd(loop, fd);
+    }
+    loop->backend->fini(loop);
+    free(loop->slots);
+    free(loop->timers);
+    free(loop->timer_heap);
+    free(loop->deferred);
+    free(loop);
+}
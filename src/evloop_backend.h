@@ -0,0 +1,124 @@
+/**
+ * @file evloop_backend.h
+ * @brief Internal interface between the event loop front-end and its
+ *        readiness backends (epoll, poll, select).
+ *
+ * @details The front-end (evloop.c) owns registrations, the run loop and
+ * stop/timeout semantics. Registrations live in a dense table indexed by
+ * fd. A backend mirrors the interest set of a slot into its kernel object
+ * or arrays and, in wait(), reports ready descriptors through
+ * evloop_dispatch(). Backends refer to registrations by fd (plus the
+ * slot's generation where the kernel can carry it), never by pointer, so
+ * the table may grow and slots may be freed while a wait is dispatching.
+ */
+#ifndef EVLOOP_BACKEND_H
+#define EVLOOP_BACKEND_H
+
+#include "evloop.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/** Interest bits (without registration flags). */
+#define EVLOOP_INTEREST_MASK (EVLOOP_READ | EVLOOP_WRITE | EVLOOP_ERROR)
+
+/** One slot of the fd-indexed registration table. */
+struct evloop_fd {
+    evloop_callback_t callback; // NULL when the slot is free
+    void *data;
+    evloop_events_t events;
+    unsigned gen; // bumped on every registration of this fd; never 0 when used
+    int armed;    // cleared when an EVLOOP_ONESHOT registration fires
+    int slot;     // backend-private (poll array index)
+};
+
+/** A timer record; slots are reused through a free list. */
+struct evloop_timer {
+    uint64_t deadline; // CLOCK_MONOTONIC, ns
+    uint64_t interval; // ns; 0 for one-shot timers
+    evloop_timer_callback_t callback;
+    void *data;
+    unsigned gen;  // part of the timer id, bumped when the slot is reused
+    int heap_pos;  // index in timer_heap, -1 when the slot is free
+    int next_free;
+};
+
+/** A queued evloop_defer() callback. */
+struct evloop_deferred {
+    evloop_timer_callback_t callback;
+    void *data;
+};
+
+/** Operations implemented by a readiness backend. */
+typedef struct evloop_backend {
+    const char *name;
+    /** Allocate backend state in loop->state. Returns 0 or -1. */
+    int (*init)(evloop_t *loop);
+    /** Release backend state. */
+    void (*fini)(evloop_t *loop);
+    /** Start watching the slot of fd. Returns 0 or -1 (errno set). */
+    int (*add)(evloop_t *loop, int fd);
+    /** The slot's events or armed state changed. Returns 0 or -1. */
+    int (*mod)(evloop_t *loop, int fd);
+    /** Stop watching fd (called before its slot is cleared). */
+    void (*remove)(evloop_t *loop, int fd);
+    /**
+     * Block up to timeout_ms (-1 = forever) and dispatch ready
+     * descriptors. Returns the number of ready descriptors, 0 on timeout,
+     * or -1 with errno set.
+     */
+    int (*wait)(evloop_t *loop, int timeout_ms);
+    /**
+     * Optional: wake wait() at the absolute CLOCK_MONOTONIC deadline (ns),
+     * or disarm when deadline is 0. Without it the front-end shortens the
+     * wait timeout to the earliest timer instead.
+     */
+    void (*set_timer)(evloop_t *loop, uint64_t deadline);
+} evloop_backend_t;
+
+/** Front-end state shared by all backends. */
+struct evloop {
+    const evloop_backend_t *backend;
+    void *state;             // backend-private
+    struct evloop_fd *slots; // indexed by fd
+    int capacity;            // number of slots
+    int n_fds;               // registered descriptors
+    int running;
+
+    struct evloop_timer *timers; // indexed by timer slot
+    int timer_capacity;
+    int timer_free;  // head of the free slot list, -1 if empty
+    int *timer_heap; // min-heap of timer slots ordered by deadline
+    int n_timers;
+
+    struct evloop_deferred *deferred; // FIFO; [deferred_head, n_deferred) pending
+    int deferred_head;
+    int n_deferred;
+    int deferred_capacity;
+};
+
+/** Interest a backend should watch for a slot right now (0 if disarmed). */
+static inline evloop_events_t evloop_interest(const struct evloop_fd *reg) {
+    return reg->armed ? (evloop_events_t)(reg->events & EVLOOP_INTEREST_MASK) : 0;
+}
+
+/** Slot of a registered fd, or NULL. */
+static inline struct evloop_fd *evloop_slot(evloop_t *loop, int fd) {
+    if (fd < 0 || fd >= loop->capacity || !loop->slots[fd].callback)
+        return NULL;
+    return &loop->slots[fd];
+}
+
+/**
+ * Invoke the callback registered for fd unless the loop was stopped, the
+ * fd was unregistered, or (gen != 0) it was re-registered since the event
+ * was queued.
+ */
+void evloop_dispatch(evloop_t *loop, int fd, unsigned gen);
+
+#ifdef __linux__
+extern const evloop_backend_t evloop_backend_epoll;
+#endif
+extern const evloop_backend_t evloop_backend_poll;
+extern const evloop_backend_t evloop_backend_select;
+
+#endif // EVLOOP_BACKEND_H
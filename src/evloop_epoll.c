@@ -1,166 +1,165 @@
 /**
  * @file evloop_epoll.c
- * @brief epoll(7)-based implementation of the event loop abstraction (Linux).
+ * @brief epoll(7)-based event loop backend (Linux, the default there).
  */
 #ifdef __linux__
 
-#include "evloop.h"
+#include "evloop_backend.h"
 #include "util.h"
 #include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
 #include <unistd.h>
 
 #define MAX_EVENTS 64
 
-struct evloop_fd {
-    int fd;
-    evloop_events_t events;
-    evloop_callback_t callback;
-    void *data;
-    struct evloop_fd *next;
-};
-
-struct evloop {
+typedef struct {
     int epoll_fd;
-    struct evloop_fd *fds;
-    int running;
-};
+    int timer_fd;           // created on first use, -1 until then
+    uint64_t timer_armed;   // deadline programmed into timer_fd, 0 if none
+    struct epoll_event events[MAX_EVENTS];
+} epoll_state_t;
+
+// Registered slots always have a non-zero generation, so generation 0 in
+// an event key identifies the loop's own timerfd.
+#define TIMER_KEY(fd) ((uint64_t)(uint32_t)(fd))
 
-evloop_t *evloop_create(void) {
-    evloop_t *loop = malloc_safe(sizeof(evloop_t));
-    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
-    if (loop->epoll_fd == -1) {
+static int epoll_init(evloop_t *loop) {
+    epoll_state_t *st = malloc_safe(sizeof(epoll_state_t));
+    st->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (st->epoll_fd == -1) {
         perror("epoll_create1");
-        free(loop);
-        return NULL;
+        free(st);
+        return -1;
     }
-    loop->fds = NULL;
-    loop->running = 0;
-    return loop;
+    st->timer_fd = -1;
+    st->timer_armed = 0;
+    loop->state = st;
+    return 0;
 }
 
-int evloop_add_fd(evloop_t *loop, int fd, evloop_events_t events,
-                  evloop_callback_t callback, void *data) {
-    if (!loop || fd < 0 || !callback) {
-        return -1;
-    }
+static void epoll_fini(evloop_t *loop) {
+    epoll_state_t *st = loop->state;
+    if (st->timer_fd >= 0)
+        close(st->timer_fd);
+    close(st->epoll_fd);
+    free(st);
+}
 
-    struct evloop_fd *evfd = malloc_safe(sizeof(struct evloop_fd));
-    evfd->fd = fd;
-    evfd->events = events;
-    evfd->callback = callback;
-    evfd->data = data;
-    evfd->next = loop->fds;
-    loop->fds = evfd;
+// data.u64 carries the fd and the slot generation, so events queued for a
+// registration that was removed (and possibly replaced) in the same batch
+// are dropped by evloop_dispatch().
+static void fill_event(struct epoll_event *ev, int fd, const struct evloop_fd *reg) {
+    ev->events = 0;
+    if (reg->events & EVLOOP_READ)
+        ev->events |= EPOLLIN;
+    if (reg->events & EVLOOP_WRITE)
+        ev->events |= EPOLLOUT;
+    if (reg->events & EVLOOP_ERROR)
+        ev->events |= EPOLLERR | EPOLLPRI;
+    if (reg->events & EVLOOP_EDGE)
+        ev->events |= EPOLLET;
+    if (reg->events & EVLOOP_ONESHOT)
+        ev->events |= EPOLLONESHOT;
+    ev->data.u64 = ((uint64_t)reg->gen << 32) | (uint32_t)fd;
+}
 
+static int epoll_add(evloop_t *loop, int fd) {
+    epoll_state_t *st = loop->state;
     struct epoll_event ev;
-    ev.events = 0;
-    if (events & EVLOOP_READ)
-        ev.events |= EPOLLIN;
-    if (events & EVLOOP_WRITE)
-        ev.events |= EPOLLOUT;
-    if (events & EVLOOP_ERROR)
-        ev.events |= EPOLLERR;
-    ev.data.ptr = evfd;
-
-    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+    fill_event(&ev, fd, &loop->slots[fd]);
+    if (epoll_ctl(st->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
         perror("epoll_ctl");
-        free(evfd);
         return -1;
     }
-
     return 0;
 }
 
-int evloop_remove_fd(evloop_t *loop, int fd) {
-    if (!loop)
+static int epoll_mod(evloop_t *loop, int fd) {
+    epoll_state_t *st = loop->state;
+    const struct evloop_fd *reg = &loop->slots[fd];
+    // A ONESHOT registration that just fired was disarmed by the kernel.
+    if (!reg->armed)
+        return 0;
+    struct epoll_event ev;
+    fill_event(&ev, fd, reg);
+    if (epoll_ctl(st->epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1) {
+        perror("epoll_ctl");
         return -1;
-
-    struct evloop_fd *current = loop->fds;
-    struct evloop_fd *prev = NULL;
-
-    while (current) {
-        if (current->fd == fd) {
-            if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL) == -1) {
-                perror("epoll_ctl");
-            }
-
-            if (prev) {
-                prev->next = current->next;
-            } else {
-                loop->fds = current->next;
-            }
-            free(current);
-            return 0;
-        }
-        prev = current;
-        current = current->next;
     }
-
-    return -1;
+    return 0;
 }
 
-int evloop_run(evloop_t *loop, int timeout_ms) {
-    if (!loop)
-        return -1;
-
-    loop->running = 1;
-
-    struct epoll_event events[MAX_EVENTS];
-
-    while (loop->running && loop->fds) {
-        int nfds = epoll_wait(loop->epoll_fd, events, MAX_EVENTS, timeout_ms);
-
-        if (nfds < 0) {
-            if (errno == EINTR) {
-                continue;
-            }
-            perror("epoll_wait");
-            return -1;
-        }
+static void epoll_remove(evloop_t *loop, int fd) {
+    epoll_state_t *st = loop->state;
+    // The descriptor may already be closed, in which case the kernel has
+    // dropped it from the interest list on its own.
+    if (epoll_ctl(st->epoll_fd, EPOLL_CTL_DEL, fd, NULL) == -1 && errno != EBADF &&
+        errno != ENOENT)
+        perror("epoll_ctl");
+}
 
-        if (nfds == 0) {
-            // Timeout
-            if (timeout_ms >= 0) {
-                break;
-            }
-            continue;
+// One timerfd per loop, programmed with the earliest timer deadline; the
+// front-end fires the due timers after every wait.
+static void epoll_set_timer(evloop_t *loop, uint64_t deadline) {
+    epoll_state_t *st = loop->state;
+    if (deadline == st->timer_armed)
+        return;
+    if (st->timer_fd < 0) {
+        if (!deadline)
+            return;
+        st->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (st->timer_fd == -1) {
+            perror("timerfd_create");
+            return;
         }
-
-        for (int i = 0; i < nfds && loop->running; i++) {
-            struct evloop_fd *evfd = (struct evloop_fd *)events[i].data.ptr;
-            if (evfd && evfd->callback) {
-                int fd = evfd->fd;
-                void *data = evfd->data;
-                evfd->callback(fd, data);
-            }
+        struct epoll_event ev = {.events = EPOLLIN, .data.u64 = TIMER_KEY(st->timer_fd)};
+        if (epoll_ctl(st->epoll_fd, EPOLL_CTL_ADD, st->timer_fd, &ev) == -1) {
+            perror("epoll_ctl");
+            close(st->timer_fd);
+            st->timer_fd = -1;
+            return;
         }
     }
-
-    return 0;
-}
-
-void evloop_stop(evloop_t *loop) {
-    if (loop) {
-        loop->running = 0;
+    struct itimerspec its = {0};
+    its.it_value.tv_sec = (time_t)(deadline / 1000000000u);
+    its.it_value.tv_nsec = (long)(deadline % 1000000000u);
+    if (timerfd_settime(st->timer_fd, TFD_TIMER_ABSTIME, &its, NULL) == -1) {
+        perror("timerfd_settime");
+        return;
     }
+    st->timer_armed = deadline;
 }
 
-void evloop_free(evloop_t *loop) {
-    if (!loop)
-        return;
-
-    while (loop->fds) {
-        struct evloop_fd *next = loop->fds->next;
-        epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, loop->fds->fd, NULL);
-        free(loop->fds);
-        loop->fds = next;
+static int epoll_wait_events(evloop_t *loop, int timeout_ms) {
+    epoll_state_t *st = loop->state;
+    int nfds = epoll_wait(st->epoll_fd, st->events, MAX_EVENTS, timeout_ms);
+    for (int i = 0; i < nfds && loop->running; i++) {
+        uint64_t key = st->events[i].data.u64;
+        if (st->timer_fd >= 0 && key == TIMER_KEY(st->timer_fd)) {
+            uint64_t expirations;
+            (void)!read(st->timer_fd, &expirations, sizeof(expirations));
+            st->timer_armed = 0;
+            continue;
+        }
+        evloop_dispatch(loop, (int)(uint32_t)key, (unsigned)(key >> 32));
     }
-
-    close(loop->epoll_fd);
-    free(loop);
+    return nfds;
 }
 
+const evloop_backend_t evloop_backend_epoll = {
+    .name = "epoll",
+    .init = epoll_init,
+    .fini = epoll_fini,
+    .add = epoll_add,
+    .mod = epoll_mod,
+    .remove = epoll_remove,
+    .wait = epoll_wait_events,
+    .set_timer = epoll_set_timer,
+};
+
 #endif // __linux__
@@ -0,0 +1,138 @@
+/**
+ * @file evloop_poll.c
+ * @brief poll(2)-based event loop backend.
+ *
+ * The pollfd array is maintained incrementally: registrations append an
+ * entry and record its index in the fd's slot, modifications rewrite that
+ * entry, removals blank it (poll ignores negative fds) and the array is
+ * compacted before the next wait.
+ */
+#include "evloop_backend.h"
+#include "util.h"
+#include <poll.h>
+#include <stdlib.h>
+
+typedef struct {
+    struct pollfd *pfds;
+    int *fds; // fds[i] is the descriptor behind pfds[i]; -1 when blanked
+    int count;
+    int capacity;
+    int blanked;
+} poll_state_t;
+
+static short to_poll_events(evloop_events_t interest) {
+    short ev = 0;
+    if (interest & EVLOOP_READ)
+        ev |= POLLIN;
+    if (interest & EVLOOP_WRITE)
+        ev |= POLLOUT;
+    if (interest & EVLOOP_ERROR)
+        ev |= POLLPRI;
+    return ev;
+}
+
+// A disarmed entry is hidden from poll() entirely; with events == 0 it
+// would still report POLLHUP/POLLERR on every call.
+static void fill_entry(evloop_t *loop, poll_state_t *st, int i) {
+    int fd = st->fds[i];
+    evloop_events_t interest = evloop_interest(&loop->slots[fd]);
+    st->pfds[i].fd = interest ? fd : -1;
+    st->pfds[i].events = to_poll_events(interest);
+    st->pfds[i].revents = 0;
+}
+
+static int poll_init(evloop_t *loop) {
+    poll_state_t *st = malloc_safe(sizeof(poll_state_t));
+    st->pfds = NULL;
+    st->fds = NULL;
+    st->count = 0;
+    st->capacity = 0;
+    st->blanked = 0;
+    loop->state = st;
+    return 0;
+}
+
+static void poll_fini(evloop_t *loop) {
+    poll_state_t *st = loop->state;
+    free(st->pfds);
+    free(st->fds);
+    free(st);
+}
+
+static int poll_add(evloop_t *loop, int fd) {
+    poll_state_t *st = loop->state;
+    if (st->count == st->capacity) {
+        int cap = st->capacity ? st->capacity * 2 : 16;
+        st->pfds = realloc_safe(st->pfds, sizeof(struct pollfd) * (size_t)cap);
+        st->fds = realloc_safe(st->fds, sizeof(int) * (size_t)cap);
+        st->capacity = cap;
+    }
+    int i = st->count++;
+    st->fds[i] = fd;
+    loop->slots[fd].slot = i;
+    fill_entry(loop, st, i);
+    return 0;
+}
+
+static int poll_mod(evloop_t *loop, int fd) {
+    fill_entry(loop, loop->state, loop->slots[fd].slot);
+    return 0;
+}
+
+static void poll_remove(evloop_t *loop, int fd) {
+    poll_state_t *st = loop->state;
+    int i = loop->slots[fd].slot;
+    if (i < 0 || i >= st->count)
+        return;
+    st->pfds[i].fd = -1;
+    st->fds[i] = -1;
+    loop->slots[fd].slot = -1;
+    st->blanked++;
+}
+
+static void poll_compact(evloop_t *loop, poll_state_t *st) {
+    int n = 0;
+    for (int i = 0; i < st->count; ++i) {
+        if (st->fds[i] < 0)
+            continue;
+        st->pfds[n] = st->pfds[i];
+        st->fds[n] = st->fds[i];
+        loop->slots[st->fds[n]].slot = n;
+        n++;
+    }
+    st->count = n;
+    st->blanked = 0;
+}
+
+static int poll_wait(evloop_t *loop, int timeout_ms) {
+    poll_state_t *st = loop->state;
+    if (st->blanked)
+        poll_compact(loop, st);
+
+    int result = poll(st->pfds, (nfds_t)st->count, timeout_ms);
+    if (result <= 0)
+        return result;
+
+    // Callbacks may append entries (growing the arrays) or blank them;
+    // only the entries polled above are examined.
+    int polled = st->count;
+    int seen = 0;
+    for (int i = 0; i < polled && seen < result && loop->running; ++i) {
+        if (!st->pfds[i].revents)
+            continue;
+        seen++;
+        if (st->fds[i] >= 0)
+            evloop_dispatch(loop, st->fds[i], 0);
+    }
+    return result;
+}
+
+const evloop_backend_t evloop_backend_poll = {
+    .name = "poll",
+    .init = poll_init,
+    .fini = poll_fini,
+    .add = poll_add,
+    .mod = poll_mod,
+    .remove = poll_remove,
+    .wait = poll_wait,
+};
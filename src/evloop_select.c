@@ -1,188 +1,116 @@
 /**
  * @file evloop_select.c
- * @brief select(2)-based implementation of the event loop abstraction.
+ * @brief select(2)-based event loop backend.
+ *
+ * Portable fallback. Descriptors must be below FD_SETSIZE. Master fd sets
+ * are updated on add/mod/remove and copied into each select() call; only
+ * descriptors up to the highest registered one are scanned afterwards,
+ * stopping once every ready descriptor has been seen.
  */
-#include "evloop.h"
+#include "evloop_backend.h"
 #include "util.h"
 #include <errno.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <sys/select.h>
-#include <unistd.h>
 
-struct evloop_fd {
-    int fd;
-    evloop_events_t events;
-    evloop_callback_t callback;
-    void *data;
-    struct evloop_fd *next;
-};
-
-struct evloop {
-    struct evloop_fd *fds;
-    int running;
+typedef struct {
+    fd_set readfds, writefds, errorfds;
     int max_fd;
-};
-
-evloop_t *evloop_create(void) {
-    evloop_t *loop = malloc_safe(sizeof(evloop_t));
-    loop->fds = NULL;
-    loop->running = 0;
-    loop->max_fd = -1;
-    return loop;
-}
-
-int evloop_add_fd(evloop_t *loop, int fd, evloop_events_t events,
-                  evloop_callback_t callback, void *data) {
-    if (!loop || fd < 0 || !callback) {
-        return -1;
-    }
-
-    struct evloop_fd *evfd = malloc_safe(sizeof(struct evloop_fd));
-    evfd->fd = fd;
-    evfd->events = events;
-    evfd->callback = callback;
-    evfd->data = data;
-    evfd->next = loop->fds;
-    loop->fds = evfd;
-
-    if (fd > loop->max_fd) {
-        loop->max_fd = fd;
-    }
-
+} select_state_t;
+
+static int select_init(evloop_t *loop) {
+    select_state_t *st = malloc_safe(sizeof(select_state_t));
+    FD_ZERO(&st->readfds);
+    FD_ZERO(&st->writefds);
+    FD_ZERO(&st->errorfds);
+    st->max_fd = -1;
+    loop->state = st;
     return 0;
 }
 
-int evloop_remove_fd(evloop_t *loop, int fd) {
-    if (!loop)
-        return -1;
-
-    struct evloop_fd *current = loop->fds;
-    struct evloop_fd *prev = NULL;
-
-    while (current) {
-        if (current->fd == fd) {
-            if (prev) {
-                prev->next = current->next;
-            } else {
-                loop->fds = current->next;
-            }
-            free(current);
-
-            // Recalculate max_fd
-            loop->max_fd = -1;
-            current = loop->fds;
-            while (current) {
-                if (current->fd > loop->max_fd) {
-                    loop->max_fd = current->fd;
-                }
-                current = current->next;
-            }
-
-            return 0;
-        }
-        prev = current;
-        current = current->next;
-    }
+static void select_fini(evloop_t *loop) {
+    free(loop->state);
+}
 
-    return -1;
+static void update_sets(select_state_t *st, int fd, evloop_events_t interest) {
+    if (interest & EVLOOP_READ)
+        FD_SET(fd, &st->readfds);
+    else
+        FD_CLR(fd, &st->readfds);
+    if (interest & EVLOOP_WRITE)
+        FD_SET(fd, &st->writefds);
+    else
+        FD_CLR(fd, &st->writefds);
+    if (interest & EVLOOP_ERROR)
+        FD_SET(fd, &st->errorfds);
+    else
+        FD_CLR(fd, &st->errorfds);
 }
 
-int evloop_run(evloop_t *loop, int timeout_ms) {
-    if (!loop)
+static int select_add(evloop_t *loop, int fd) {
+    select_state_t *st = loop->state;
+    if (fd >= FD_SETSIZE) {
+        errno = EINVAL;
         return -1;
-
-    loop->running = 1;
-
-    while (loop->running && loop->fds) {
-        fd_set readfds, writefds, errorfds;
-        FD_ZERO(&readfds);
-        FD_ZERO(&writefds);
-        FD_ZERO(&errorfds);
-
-        struct evloop_fd *current = loop->fds;
-        while (current) {
-            if (current->events & EVLOOP_READ) {
-                FD_SET(current->fd, &readfds);
-            }
-            if (current->events & EVLOOP_WRITE) {
-                FD_SET(current->fd, &writefds);
-            }
-            if (current->events & EVLOOP_ERROR) {
-                FD_SET(current->fd, &errorfds);
-            }
-            current = current->next;
-        }
-
-        struct timeval timeout;
-        struct timeval *timeout_ptr = NULL;
-        if (timeout_ms >= 0) {
-            timeout.tv_sec = timeout_ms / 1000;
-            timeout.tv_usec = (timeout_ms % 1000) * 1000;
-            timeout_ptr = &timeout;
-        }
-
-        int result =
-            select(loop->max_fd + 1, &readfds, &writefds, &errorfds, timeout_ptr);
-
-        if (result < 0) {
-            if (errno == EINTR) {
-                continue;
-            }
-            perror("select");
-            return -1;
-        }
-
-        if (result == 0) {
-            // Timeout
-            if (timeout_ms >= 0) {
-                break;
-            }
-            continue;
-        }
-
-        // Process ready file descriptors
-        current = loop->fds;
-        while (current && loop->running) {
-            // Save next before invoking callback in case the callback removes this fd
-            struct evloop_fd *next = current->next;
-
-            int fd_ready = 0;
-
-            if (FD_ISSET(current->fd, &readfds) && (current->events & EVLOOP_READ))
-                fd_ready = 1;
-
-            if (FD_ISSET(current->fd, &writefds) && (current->events & EVLOOP_WRITE))
-                fd_ready = 1;
-
-            if (FD_ISSET(current->fd, &errorfds) && (current->events & EVLOOP_ERROR))
-                fd_ready = 1;
-
-            if (fd_ready)
-                current->callback(current->fd, current->data);
-
-            current = next;
-        }
     }
+    update_sets(st, fd, evloop_interest(&loop->slots[fd]));
+    if (fd > st->max_fd)
+        st->max_fd = fd;
+    return 0;
+}
 
+static int select_mod(evloop_t *loop, int fd) {
+    update_sets(loop->state, fd, evloop_interest(&loop->slots[fd]));
     return 0;
 }
 
-void evloop_stop(evloop_t *loop) {
-    if (loop) {
-        loop->running = 0;
+static void select_remove(evloop_t *loop, int fd) {
+    select_state_t *st = loop->state;
+    update_sets(st, fd, 0);
+    if (fd == st->max_fd) {
+        // The slot is still registered here; look below it.
+        do {
+            st->max_fd--;
+        } while (st->max_fd >= 0 && !evloop_slot(loop, st->max_fd));
     }
 }
 
-void evloop_free(evloop_t *loop) {
-    if (!loop)
-        return;
+static int select_wait(evloop_t *loop, int timeout_ms) {
+    select_state_t *st = loop->state;
+    fd_set readfds = st->readfds, writefds = st->writefds, errorfds = st->errorfds;
 
-    while (loop->fds) {
-        struct evloop_fd *next = loop->fds->next;
-        free(loop->fds);
-        loop->fds = next;
+    struct timeval timeout;
+    struct timeval *timeout_ptr = NULL;
+    if (timeout_ms >= 0) {
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_usec = (timeout_ms % 1000) * 1000;
+        timeout_ptr = &timeout;
     }
 
-    free(loop);
+    int result = select(st->max_fd + 1, &readfds, &writefds, &errorfds, timeout_ptr);
+    if (result <= 0)
+        return result;
+
+    // select() counts each set bit, so a descriptor can account for more
+    // than one of the result.
+    int remaining = result;
+    int max_fd = st->max_fd;
+    for (int fd = 0; fd <= max_fd && remaining > 0 && loop->running; ++fd) {
+        int bits = !!FD_ISSET(fd, &readfds) + !!FD_ISSET(fd, &writefds) + !!FD_ISSET(fd, &errorfds);
+        if (!bits)
+            continue;
+        remaining -= bits;
+        evloop_dispatch(loop, fd, 0);
+    }
+    return result;
 }
+
+const evloop_backend_t evloop_backend_select = {
+    .name = "select",
+    .init = select_init,
+    .fini = select_fini,
+    .add = select_add,
+    .mod = select_mod,
+    .remove = select_remove,
+    .wait = select_wait,
+};
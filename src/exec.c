@@ -4,55 +4,33 @@
  */
 #include "exec.h"
 #include "builtin.h"
-#include "env.h" // for expand_variables
+#include "cmdhash.h"
+#include "env.h"
+#include "func.h"
 #include "plugin.h"
 #include "jobs.h"
+#include "launch.h"
+#include "lexer.h"
+#include "parser.h"
+#include "redir.h"
+#include "shell.h"
 #include "util.h"
 #include "ast.h"
+#include "ast_node.h"
+#include "exec_vm.h"
+#include "vm.h"
 #include <errno.h>
 #include <fcntl.h>
+#include <fnmatch.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include "pipeline.h"
 
-/** Simple AST node structures (normally defined in ast.c). */
-struct ast_node {
-    ast_node_type_t type;
-    union {
-        struct {
-            char **argv;
-            struct {
-                int fd;
-                int type; // 0=input,1=output,2=append
-                char *filename;
-            } redirs[8];
-            int n_redirs;
-        } command;
-        struct {
-            ast_node_t *left;
-            ast_node_t *right;
-        } pipeline;
-        struct {
-            ast_node_t *left;
-            ast_node_t *right;
-        } sequence;
-        struct {
-            ast_node_t *child;
-        } background;
-        struct { // and / or
-            ast_node_t *left;
-            ast_node_t *right;
-        } boollist;
-        struct { // subshell
-            ast_node_t *child;
-        } subshell;
-    } data;
-};
-
 // Helper: build a short label string from an AST (best-effort, <= ~80 chars)
 static char *ast_to_label_rec(ast_node_t *node, int depth) {
     if (!node || depth > 8) return strdup_safe("...");
@@ -119,180 +97,430 @@ static char *ast_to_label_rec(ast_node_t *node, int depth) {
         free(c);
         return res;
     }
+    case AST_IF:
+        return strdup_safe("if ...");
+    case AST_WHILE:
+        return strdup_safe("while ...");
+    case AST_UNTIL:
+        return strdup_safe("until ...");
+    case AST_FOR: {
+        size_t need = strlen(node->data.for_clause.name) + 9;
+        char *res = malloc_safe(need);
+        snprintf(res, need, "for %s ...", node->data.for_clause.name);
+        return res;
+    }
+    case AST_CASE:
+        return strdup_safe("case ...");
+    case AST_FUNCTION: {
+        size_t need = strlen(node->data.function.name) + 3;
+        char *res = malloc_safe(need);
+        snprintf(res, need, "%s()", node->data.function.name);
+        return res;
+    }
     }
     return strdup_safe("job");
 }
 
-static char **expand_argv(char **argv) {
-    int argc = string_array_length(argv);
-    char **expanded = malloc_safe((argc + 1) * sizeof(char *));
-    for (int i = 0; i < argc; i++) {
-        expanded[i] = expand_variables(argv[i]);
-        if (!expanded[i]) {
-            expanded[i] = strdup_safe(argv[i]);
-        }
-    }
-    expanded[argc] = NULL;
-    return expanded;
+// Words are expanded into expand_arena; exec_command() releases what it
+// allocated on return, so the arena's chunks are reused command after
+// command and nested commands (subshells, substitutions) stack on it.
+static arena_t expand_arena;
+
+// Expand argv into fields; *argc receives the new count, which differs
+// from the original when command substitutions split or vanish.
+static char **expand_argv(arena_t *arena, char **argv, int *argc) {
+    expand_fields_t fields = {0};
+    for (int i = 0; argv[i]; i++)
+        expand_fields(arena, argv[i], &fields);
+    *argc = fields.n;
+    return fields.words;
 }
 
-static int exec_external(char **argv) {
-    pid_t pid = fork();
-    if (pid == 0) {
-        // Child: become a process group leader for job control consistency
-        // Ignore errors if already in a group or permissions block
-        (void)setpgid(0, 0);
-        execvp(argv[0], argv);
-        perror("execvp");
-        _exit(127);
-    } else if (pid > 0) {
-        // Parent: ensure child is in its own process group (race-safe double call)
-        (void)setpgid(pid, pid);
-        int status;
-        void (*oldint)(int) = signal(SIGINT, SIG_IGN);
-        waitpid(pid, &status, 0);
-        signal(SIGINT, oldint);
-        if (WIFEXITED(status))
-            return WEXITSTATUS(status);
-        if (WIFSIGNALED(status))
-            return 128 + WTERMSIG(status);
-        return 1;
-    } else {
-        perror("fork");
-        return -1;
+// Collect a command node's redirections into launcher form.
+static launch_redir_t *command_launch_redirs(arena_t *arena, ast_node_t *node) {
+    int n = node->data.command.n_redirs;
+    launch_redir_t *out = arena_alloc(arena, (size_t)(n ? n : 1) * sizeof(launch_redir_t));
+    for (int i = 0; i < n; ++i) {
+        out[i].fd = node->data.command.redirs[i].fd;
+        out[i].type = node->data.command.redirs[i].type;
+        out[i].filename = node->data.command.redirs[i].filename;
     }
+    return out;
 }
 
-ast_node_t *ast_create_command(char **argv) {
-    ast_node_t *node = malloc_safe(sizeof(ast_node_t));
-    node->type = AST_COMMAND;
+// Chunk size of arenas for trees built with the ast_create_* calls.
+#define AST_TREE_CHUNK 1024
 
-    // Copy the argv array so we own the memory
+ast_node_t *ast_arena_command(arena_t *arena, char **argv, int argc, const ast_redir_t *redirs,
+                              int n_redirs) {
+    size_t words = argv ? (size_t)argc + 1 : 0;
+    ast_node_t *node = arena_alloc(arena, sizeof(ast_node_t) + words * sizeof(char *));
+    node->type = AST_COMMAND;
+    node->arena = NULL;
+    node->data.command.argv = NULL;
+    node->data.command.argc = argv ? argc : 0;
     if (argv) {
-        int argc = string_array_length(argv);
-        node->data.command.argv = malloc_safe((argc + 1) * sizeof(char *));
-        for (int i = 0; i < argc; i++) {
-            node->data.command.argv[i] = strdup_safe(argv[i]);
-        }
+        node->data.command.argv = (char **)(node + 1);
+        memcpy(node->data.command.argv, argv, (size_t)argc * sizeof(char *));
         node->data.command.argv[argc] = NULL;
-    } else {
-        node->data.command.argv = NULL;
     }
-
-    node->data.command.n_redirs = 0;
-
+    node->data.command.redirs = NULL;
+    node->data.command.n_redirs = n_redirs;
+    if (n_redirs > 0) {
+        node->data.command.redirs = arena_alloc(arena, (size_t)n_redirs * sizeof(ast_redir_t));
+        memcpy(node->data.command.redirs, redirs, (size_t)n_redirs * sizeof(ast_redir_t));
+    }
     return node;
 }
 
-ast_node_t *ast_create_pipeline(ast_node_t *left, ast_node_t *right) {
-    ast_node_t *node = malloc_safe(sizeof(ast_node_t));
-    node->type = AST_PIPELINE;
-    node->data.pipeline.left = left;
-    node->data.pipeline.right = right;
+ast_node_t *ast_arena_node(arena_t *arena, ast_node_type_t type, ast_node_t *left,
+                           ast_node_t *right) {
+    ast_node_t *node = arena_alloc(arena, sizeof(ast_node_t));
+    node->type = type;
+    node->arena = NULL;
+    switch (type) {
+    case AST_BACKGROUND:
+        node->data.background.child = left;
+        break;
+    case AST_SUBSHELL:
+        node->data.subshell.child = left;
+        break;
+    case AST_WHILE:
+    case AST_UNTIL:
+        node->data.loop.cond = left;
+        node->data.loop.body = right;
+        break;
+    default:
+        node->data.pipeline.left = left;
+        node->data.pipeline.right = right;
+        break;
+    }
     return node;
 }
 
-ast_node_t *ast_create_sequence(ast_node_t *left, ast_node_t *right) {
-    ast_node_t *node = malloc_safe(sizeof(ast_node_t));
-    node->type = AST_SEQUENCE;
-    node->data.sequence.left = left;
-    node->data.sequence.right = right;
+ast_node_t *ast_arena_if(arena_t *arena, ast_node_t *cond, ast_node_t *then_part,
+                         ast_node_t *else_part) {
+    ast_node_t *node = arena_alloc(arena, sizeof(ast_node_t));
+    node->type = AST_IF;
+    node->arena = NULL;
+    node->data.if_clause.cond = cond;
+    node->data.if_clause.then_part = then_part;
+    node->data.if_clause.else_part = else_part;
     return node;
 }
 
-ast_node_t *ast_create_background(ast_node_t *child) {
-    ast_node_t *node = malloc_safe(sizeof(ast_node_t));
-    node->type = AST_BACKGROUND;
-    node->data.background.child = child;
+ast_node_t *ast_arena_for(arena_t *arena, char *name, char **words, int n_words,
+                          ast_node_t *body) {
+    size_t slots = words ? (size_t)n_words + 1 : 0;
+    ast_node_t *node = arena_alloc(arena, sizeof(ast_node_t) + slots * sizeof(char *));
+    node->type = AST_FOR;
+    node->arena = NULL;
+    node->data.for_clause.name = name;
+    node->data.for_clause.words = NULL;
+    node->data.for_clause.body = body;
+    if (words) {
+        node->data.for_clause.words = (char **)(node + 1);
+        memcpy(node->data.for_clause.words, words, (size_t)n_words * sizeof(char *));
+        node->data.for_clause.words[n_words] = NULL;
+    }
     return node;
 }
 
-ast_node_t *ast_create_and(ast_node_t *left, ast_node_t *right) {
-    ast_node_t *node = malloc_safe(sizeof(ast_node_t));
-    node->type = AST_AND;
-    node->data.boollist.left = left;
-    node->data.boollist.right = right;
+ast_node_t *ast_arena_case(arena_t *arena, char *word, const ast_case_item_t *items,
+                           int n_items) {
+    ast_node_t *node = arena_alloc(arena, sizeof(ast_node_t));
+    node->type = AST_CASE;
+    node->arena = NULL;
+    node->data.case_clause.word = word;
+    node->data.case_clause.items = NULL;
+    node->data.case_clause.n_items = n_items;
+    if (n_items > 0) {
+        node->data.case_clause.items = arena_alloc(arena, (size_t)n_items * sizeof(ast_case_item_t));
+        memcpy(node->data.case_clause.items, items, (size_t)n_items * sizeof(ast_case_item_t));
+    }
     return node;
 }
 
-ast_node_t *ast_create_or(ast_node_t *left, ast_node_t *right) {
-    ast_node_t *node = malloc_safe(sizeof(ast_node_t));
-    node->type = AST_OR;
-    node->data.boollist.left = left;
-    node->data.boollist.right = right;
+ast_node_t *ast_arena_function(arena_t *arena, char *name, ast_node_t *body) {
+    ast_node_t *node = arena_alloc(arena, sizeof(ast_node_t));
+    node->type = AST_FUNCTION;
+    node->arena = NULL;
+    node->data.function.name = name;
+    node->data.function.body = body;
     return node;
 }
 
-ast_node_t *ast_create_subshell(ast_node_t *child) {
-    ast_node_t *node = malloc_safe(sizeof(ast_node_t));
-    node->type = AST_SUBSHELL;
-    node->data.subshell.child = child;
-    return node;
+static char *copy_string(arena_t *arena, const char *s) {
+    return arena_strndup(arena, s, strlen(s));
 }
 
-void ast_command_add_redirection(ast_node_t *cmd, int fd, int type, const char *filename) {
-    if (!cmd || cmd->type != AST_COMMAND || !filename)
-        return;
-    if (cmd->data.command.n_redirs >= 8)
-        return;
-    int n = cmd->data.command.n_redirs++;
-    cmd->data.command.redirs[n].fd = fd;
-    cmd->data.command.redirs[n].type = type;
-    cmd->data.command.redirs[n].filename = strdup_safe(filename);
+// Copy a NULL-terminated word array into the slots after a copied node.
+static char **copy_words(arena_t *arena, ast_node_t *copy, char **words) {
+    char **out = (char **)(copy + 1);
+    int i = 0;
+    for (; words[i]; ++i)
+        out[i] = copy_string(arena, words[i]);
+    out[i] = NULL;
+    return out;
 }
 
-void ast_free(ast_node_t *node) {
+ast_node_t *ast_copy(arena_t *arena, const ast_node_t *node) {
     if (!node)
-        return;
-
+        return NULL;
+    ast_node_t *copy;
     switch (node->type) {
-    case AST_COMMAND:
-        free_string_array(node->data.command.argv);
-        for (int i = 0; i < node->data.command.n_redirs; ++i) {
-            free(node->data.command.redirs[i].filename);
+    case AST_COMMAND: {
+        char **argv = node->data.command.argv;
+        size_t words = argv ? (size_t)node->data.command.argc + 1 : 0;
+        copy = arena_alloc(arena, sizeof(ast_node_t) + words * sizeof(char *));
+        *copy = *node;
+        if (argv)
+            copy->data.command.argv = copy_words(arena, copy, argv);
+        int n = node->data.command.n_redirs;
+        if (n > 0) {
+            copy->data.command.redirs = arena_alloc(arena, (size_t)n * sizeof(ast_redir_t));
+            for (int i = 0; i < n; ++i) {
+                copy->data.command.redirs[i] = node->data.command.redirs[i];
+                copy->data.command.redirs[i].filename =
+                    copy_string(arena, node->data.command.redirs[i].filename);
+            }
         }
         break;
-    case AST_PIPELINE:
-        ast_free(node->data.pipeline.left);
-        ast_free(node->data.pipeline.right);
-        break;
-    case AST_SEQUENCE:
-        ast_free(node->data.sequence.left);
-        ast_free(node->data.sequence.right);
-        break;
-    case AST_BACKGROUND:
-        ast_free(node->data.background.child);
+    }
+    case AST_SEQUENCE: {
+        // Copy the right spine in a loop, like exec_ast() runs it
+        copy = arena_alloc(arena, sizeof(ast_node_t));
+        ast_node_t *tail = copy;
+        const ast_node_t *src = node;
+        for (;;) {
+            *tail = *src;
+            tail->arena = NULL;
+            tail->data.sequence.left = ast_copy(arena, src->data.sequence.left);
+            src = src->data.sequence.right;
+            if (!src || src->type != AST_SEQUENCE) {
+                tail->data.sequence.right = ast_copy(arena, src);
+                break;
+            }
+            tail->data.sequence.right = arena_alloc(arena, sizeof(ast_node_t));
+            tail = tail->data.sequence.right;
+        }
         break;
+    }
+    case AST_PIPELINE:
     case AST_AND:
     case AST_OR:
-        ast_free(node->data.boollist.left);
-        ast_free(node->data.boollist.right);
+        copy = arena_alloc(arena, sizeof(ast_node_t));
+        *copy = *node;
+        copy->data.pipeline.left = ast_copy(arena, node->data.pipeline.left);
+        copy->data.pipeline.right = ast_copy(arena, node->data.pipeline.right);
         break;
+    case AST_BACKGROUND:
     case AST_SUBSHELL:
-        ast_free(node->data.subshell.child);
+        copy = arena_alloc(arena, sizeof(ast_node_t));
+        *copy = *node;
+        copy->data.subshell.child = ast_copy(arena, node->data.subshell.child);
+        break;
+    case AST_IF:
+        copy = arena_alloc(arena, sizeof(ast_node_t));
+        *copy = *node;
+        copy->data.if_clause.cond = ast_copy(arena, node->data.if_clause.cond);
+        copy->data.if_clause.then_part = ast_copy(arena, node->data.if_clause.then_part);
+        copy->data.if_clause.else_part = ast_copy(arena, node->data.if_clause.else_part);
+        break;
+    case AST_WHILE:
+    case AST_UNTIL:
+        copy = arena_alloc(arena, sizeof(ast_node_t));
+        *copy = *node;
+        copy->data.loop.cond = ast_copy(arena, node->data.loop.cond);
+        copy->data.loop.body = ast_copy(arena, node->data.loop.body);
+        break;
+    case AST_FOR: {
+        char **words = node->data.for_clause.words;
+        size_t slots = 0;
+        while (words && words[slots])
+            slots++;
+        if (words)
+            slots++;
+        copy = arena_alloc(arena, sizeof(ast_node_t) + slots * sizeof(char *));
+        *copy = *node;
+        copy->data.for_clause.name = copy_string(arena, node->data.for_clause.name);
+        if (words)
+            copy->data.for_clause.words = copy_words(arena, copy, words);
+        copy->data.for_clause.body = ast_copy(arena, node->data.for_clause.body);
         break;
     }
-    free(node);
+    case AST_CASE: {
+        copy = arena_alloc(arena, sizeof(ast_node_t));
+        *copy = *node;
+        copy->data.case_clause.word = copy_string(arena, node->data.case_clause.word);
+        int n = node->data.case_clause.n_items;
+        if (n > 0)
+            copy->data.case_clause.items = arena_alloc(arena, (size_t)n * sizeof(ast_case_item_t));
+        for (int i = 0; i < n; ++i) {
+            const ast_case_item_t *item = &node->data.case_clause.items[i];
+            ast_case_item_t *out = &copy->data.case_clause.items[i];
+            out->n_patterns = item->n_patterns;
+            out->patterns = arena_alloc(arena, (size_t)item->n_patterns * sizeof(char *));
+            for (int j = 0; j < item->n_patterns; ++j)
+                out->patterns[j] = copy_string(arena, item->patterns[j]);
+            out->body = ast_copy(arena, item->body);
+        }
+        break;
+    }
+    case AST_FUNCTION:
+        copy = arena_alloc(arena, sizeof(ast_node_t));
+        *copy = *node;
+        copy->data.function.name = copy_string(arena, node->data.function.name);
+        copy->data.function.body = ast_copy(arena, node->data.function.body);
+        break;
+    default:
+        return NULL;
+    }
+    copy->arena = NULL;
+    return copy;
 }
 
-// Safely apply a redirection: if the opened fd equals the target, clear CLOEXEC;
-// otherwise dup2 and close the source fd.
-static inline void dup2_or_clear_cloexec(int src_fd, int target_fd) {
-    if (src_fd < 0) return;
-    if (src_fd == target_fd) {
-        int flags = fcntl(target_fd, F_GETFD);
-        if (flags != -1) {
-            (void)fcntl(target_fd, F_SETFD, flags & ~FD_CLOEXEC);
+void ast_set_arena(ast_node_t *root, arena_t *arena) {
+    root->arena = arena;
+}
+
+ast_node_t *ast_create_command(char **argv) {
+    arena_t *arena = malloc_safe(sizeof(arena_t));
+    arena_init(arena, AST_TREE_CHUNK);
+    int argc = argv ? string_array_length(argv) : 0;
+    char **copy = NULL;
+    if (argv) {
+        copy = arena_alloc(arena, (size_t)(argc + 1) * sizeof(char *));
+        for (int i = 0; i < argc; i++)
+            copy[i] = arena_strndup(arena, argv[i], strlen(argv[i]));
+    }
+    ast_node_t *node = ast_arena_command(arena, copy, argc, NULL, 0);
+    ast_set_arena(node, arena);
+    return node;
+}
+
+// Build a node over standalone trees: the first child's arena takes in
+// the other's and becomes the new root's.
+static ast_node_t *join_trees(ast_node_type_t type, ast_node_t *left, ast_node_t *right) {
+    arena_t *arena = left && left->arena ? left->arena : right ? right->arena : NULL;
+    if (!arena) {
+        arena = malloc_safe(sizeof(arena_t));
+        arena_init(arena, AST_TREE_CHUNK);
+    }
+    ast_node_t *children[2] = {left, right};
+    for (int i = 0; i < 2; ++i) {
+        ast_node_t *child = children[i];
+        if (child && child->arena && child->arena != arena) {
+            arena_adopt(arena, child->arena);
+            free(child->arena);
         }
+        if (child)
+            child->arena = NULL;
+    }
+    ast_node_t *node = ast_arena_node(arena, type, left, right);
+    ast_set_arena(node, arena);
+    return node;
+}
+
+ast_node_t *ast_create_pipeline(ast_node_t *left, ast_node_t *right) {
+    return join_trees(AST_PIPELINE, left, right);
+}
+
+ast_node_t *ast_create_sequence(ast_node_t *left, ast_node_t *right) {
+    return join_trees(AST_SEQUENCE, left, right);
+}
+
+ast_node_t *ast_create_background(ast_node_t *child) {
+    return join_trees(AST_BACKGROUND, child, NULL);
+}
+
+ast_node_t *ast_create_and(ast_node_t *left, ast_node_t *right) {
+    return join_trees(AST_AND, left, right);
+}
+
+ast_node_t *ast_create_or(ast_node_t *left, ast_node_t *right) {
+    return join_trees(AST_OR, left, right);
+}
+
+ast_node_t *ast_create_subshell(ast_node_t *child) {
+    return join_trees(AST_SUBSHELL, child, NULL);
+}
+
+void ast_command_add_redirection(ast_node_t *cmd, int fd, int type, const char *filename) {
+    if (!cmd || cmd->type != AST_COMMAND || !cmd->arena || !filename)
         return;
+    // The list is copied on every addition; the parser builds it in one go
+    int n = cmd->data.command.n_redirs;
+    ast_redir_t *redirs = arena_alloc(cmd->arena, (size_t)(n + 1) * sizeof(ast_redir_t));
+    if (n)
+        memcpy(redirs, cmd->data.command.redirs, (size_t)n * sizeof(ast_redir_t));
+    redirs[n].fd = fd;
+    redirs[n].type = type;
+    redirs[n].filename = arena_strndup(cmd->arena, filename, strlen(filename));
+    cmd->data.command.redirs = redirs;
+    cmd->data.command.n_redirs = n + 1;
+}
+
+void ast_free(ast_node_t *node) {
+    if (!node || !node->arena)
+        return;
+    arena_t *arena = node->arena;
+    arena_free(arena);
+    free(arena);
+}
+
+// A failed expansion skips its command with status 1; a shell that is not
+// interactive stops as well, like on a syntax error.
+static int expansion_failed(void) {
+    expand_take_status();
+    if (!shell_interactive)
+        shell_running = 0;
+    return 1;
+}
+
+// A command made only of NAME=value words sets shell variables. Values are
+// expanded; the variables keep their export flag (new ones stay local).
+static int exec_assignments(arena_t *arena, char **argv) {
+    expand_take_status();
+    for (int i = 0; argv[i]; ++i) {
+        char *eq = strchr(argv[i], '=');
+        char *name = arena_strndup(arena, argv[i], (size_t)(eq - argv[i]));
+        char *value = expand_word(arena, eq + 1);
+        if (expand_failed())
+            return expansion_failed();
+        if (env_assign(name, value) != 0) {
+            perror(name);
+            return 1;
+        }
     }
-    if (dup2(src_fd, target_fd) == -1) {
-        perror("dup2");
-        // best effort: close src_fd regardless
+    // x=$(cmd) has the status of the last substitution
+    int status = expand_take_status();
+    return status >= 0 ? status : 0;
+}
+
+// Run a builtin in the shell process with the command's redirections applied
+// through a redirection stack, so state changes (cd, export, ...) persist and
+// no fork is needed. Descriptors are restored before returning.
+static int exec_builtin_redirected(ast_node_t *node, builtin_t *builtin, int argc, char **argv) {
+    redir_stack_t stack;
+    redir_stack_init(&stack);
+    int rc = 0;
+    for (int i = 0; i < node->data.command.n_redirs; ++i) {
+        if (redir_stack_push(&stack, node->data.command.redirs[i].type,
+                             node->data.command.redirs[i].fd,
+                             node->data.command.redirs[i].filename) != 0) {
+            rc = 1;
+            break;
+        }
     }
-    close(src_fd);
+    if (rc == 0)
+        rc = builtin->func(argc, argv);
+    redir_stack_unwind(&stack);
+    return rc;
 }
 
+static int exec_function(func_t *fn, int argc, char **argv);
+
 int exec_command(ast_command_t *cmd) {
     // Cast for simplicity
     ast_node_t *node = (ast_node_t *)cmd;
@@ -307,155 +535,490 @@ int exec_command(ast_command_t *cmd) {
         return -1;
     }
 
-    // Expand variables in all arguments
-    char **expanded_argv = expand_argv(argv);
-    if (!expanded_argv || !expanded_argv[0]) {
-        free_string_array(expanded_argv);
-        return -1;
+    arena_mark_t mark = arena_mark(&expand_arena);
+    int argc = node->data.command.argc;
+    int n_assign = 0;
+    while (n_assign < argc && env_is_assignment(argv[n_assign]))
+        n_assign++;
+    int rc;
+    if (n_assign == argc) {
+        rc = exec_assignments(&expand_arena, argv);
+    } else {
+        // Expand variables in all arguments
+        expand_take_status();
+        char **expanded_argv = expand_argv(&expand_arena, argv, &argc);
+        if (expand_failed()) {
+            arena_release(&expand_arena, mark);
+            return expansion_failed();
+        }
+        func_t *fn = argc > 0 ? func_find(expanded_argv[0]) : NULL;
+        builtin_t *builtin = argc > 0 && !fn ? builtin_find(expanded_argv[0]) : NULL;
+        if (shell_flag_xtrace && argc > 0) {
+            fputc('+', stderr);
+            for (int i = 0; i < argc; ++i)
+                fprintf(stderr, " %s", expanded_argv[i]);
+            fputc('\n', stderr);
+        }
+        if (argc == 0) {
+            // Everything expanded away, e.g. `$(true)`
+            int status = expand_take_status();
+            rc = status >= 0 ? status : 0;
+        } else if (fn) {
+            rc = exec_function(fn, argc, expanded_argv);
+        } else if (builtin) {
+            rc = exec_builtin_redirected(node, builtin, argc, expanded_argv);
+        } else if (plugin_execute(expanded_argv[0], argc, expanded_argv) == 0) {
+            rc = 0;
+        } else {
+            // Execute external command via the spawn engine (redirections
+            // become spawn file actions, so no fork() of the shell is needed)
+            launch_redir_t *redirs = command_launch_redirs(&expand_arena, node);
+            rc = launch_external(cmdhash_lookup(expanded_argv[0]), expanded_argv, redirs,
+                                 node->data.command.n_redirs);
+        }
     }
-    int argc = string_array_length(expanded_argv);
-
-    // Check for builtin commands
-    int builtin_result = builtin_execute(expanded_argv[0], argc, expanded_argv);
-    if (builtin_result != -1) {
-        // If this command has redirections, execute builtin in child to apply them
-        ast_node_t *n = (ast_node_t *)cmd;
-        if (n->data.command.n_redirs > 0) {
-            pid_t c = fork();
-            if (c == 0) {
-                for (int i = 0; i < n->data.command.n_redirs; ++i) {
-                    int fd = n->data.command.redirs[i].fd;
-                    int t = n->data.command.redirs[i].type;
-                    const char *fn = n->data.command.redirs[i].filename;
-                    int f = -1;
-                    if (t == REDIR_INPUT) f = open(fn, O_RDONLY | O_CLOEXEC);
-                    else if (t == REDIR_OUTPUT) f = open(fn, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
-                    else if (t == REDIR_APPEND) f = open(fn, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
-                    else if (t == REDIR_HEREDOC) {
-                        // Create a pipe, feed stdin until delimiter, and hook read end to fd
-                        int p[2];
-                        if (pipe(p) == 0) {
-                            size_t cap = 0; char *line = NULL; ssize_t nread;
-                            // Read from current stdin until a line equal to delimiter
-                            while ((nread = getline(&line, &cap, stdin)) != -1) {
-                                // Strip trailing newline for comparison
-                                if (nread > 0 && line[nread - 1] == '\n') {
-                                    line[nread - 1] = '\0';
-                                    nread--;
-                                }
-                                if (strcmp(line, fn) == 0) {
-                                    break;
-                                }
-                                // Write the line and a newline back
-                                if (nread > 0) { sig_safe_write(p[1], line, (size_t)nread); }
-                                sig_safe_write(p[1], "\n", 1);
-                            }
-                            free(line);
-                            close(p[1]);
-                            f = p[0];
-                        }
-                    }
-                    if (f >= 0) { dup2_or_clear_cloexec(f, fd); }
-                }
-                int rc = builtin_execute(expanded_argv[0], argc, expanded_argv);
-                _exit(rc & 0xFF);
-            } else if (c > 0) {
-                int st; void (*oldint)(int) = signal(SIGINT, SIG_IGN);
-                waitpid(c, &st, 0);
-                signal(SIGINT, oldint);
-                free_string_array(expanded_argv);
-                if (WIFEXITED(st)) return WEXITSTATUS(st);
-                if (WIFSIGNALED(st)) return 128 + WTERMSIG(st);
+    arena_release(&expand_arena, mark);
+    return rc;
+}
+
+// Builtins that only write output and never change shell state, so a
+// substitution made of them can run without a subshell.
+static const char *const pure_builtins[] = {
+    "echo", "printf", "test", "[", "true", "false", ":", "pwd", "type", NULL,
+};
+
+// Could expanding this word change shell state (${X=...}, $((x++)), ...)?
+static int word_has_side_effects(const char *w) {
+    for (const char *p = strchr(w, '$'); p; p = strchr(p + 1, '$')) {
+        if (p[1] == '(' && p[2] == '(')
+            return 1;
+        if (p[1] == '{') {
+            const char *end = strchr(p, '}');
+            const char *eq = strchr(p, '=');
+            if (eq && (!end || eq < end))
                 return 1;
-            } else {
-                perror("fork");
-                free_string_array(expanded_argv);
-                return -1;
-            }
         }
-        free_string_array(expanded_argv);
-        return builtin_result;
     }
+    return 0;
+}
 
-    // Check for plugin commands
-    if (plugin_execute(expanded_argv[0], argc, expanded_argv) == 0) {
-        free_string_array(expanded_argv);
+// A substitution body may run in the shell process when it is a list
+// (;, &&, ||) of simple commands that use pure builtins without
+// redirections. Nested substitutions decide for themselves.
+static int capture_in_process(ast_node_t *node) {
+    if (!node)
         return 0;
+    switch (node->type) {
+    case AST_COMMAND: {
+        char **argv = node->data.command.argv;
+        if (!argv || !argv[0] || node->data.command.n_redirs > 0 || func_find(argv[0]))
+            return 0;
+        int pure = 0;
+        for (int i = 0; pure_builtins[i]; ++i)
+            pure |= strcmp(argv[0], pure_builtins[i]) == 0;
+        if (!pure)
+            return 0;
+        for (int i = 1; argv[i]; ++i) {
+            if (word_has_side_effects(argv[i]))
+                return 0;
+        }
+        return 1;
+    }
+    case AST_SEQUENCE:
+        return capture_in_process(node->data.sequence.left) &&
+               capture_in_process(node->data.sequence.right);
+    case AST_AND:
+    case AST_OR:
+        return capture_in_process(node->data.boollist.left) &&
+               capture_in_process(node->data.boollist.right);
+    default:
+        return 0;
+    }
+}
+
+// One memfd is kept between in-process captures (nested ones open more).
+// It belongs to the process that opened it: forked children close their
+// inherited descriptors, so a spare left by the parent is never reused.
+static int spare_memfd = -1;
+static pid_t spare_memfd_owner;
+
+// Run ast with stdout redirected to a memfd and copy what it wrote.
+static int capture_builtins(ast_node_t *ast, arena_t *arena, char **out, size_t *len) {
+    int mfd = -1;
+    if (spare_memfd >= 0 && spare_memfd_owner == getpid())
+        mfd = spare_memfd;
+    spare_memfd = -1;
+    if (mfd < 0 && (mfd = memfd_create("myshell-subst", MFD_CLOEXEC)) < 0) {
+        perror("memfd_create");
+        return -1;
     }
+    fflush(stdout);
+    int saved = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 10);
+    if (saved < 0 || dup2(mfd, STDOUT_FILENO) < 0) {
+        perror("dup2");
+        if (saved >= 0)
+            close(saved);
+        close(mfd);
+        return -1;
+    }
+    int rc = exec_ast(ast);
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
 
-    // Execute external command (apply redirs if present)
-    ast_node_t *n = (ast_node_t *)cmd;
-    int rc;
-    if (n->data.command.n_redirs == 0) {
-        rc = exec_external(expanded_argv);
-    } else {
-        pid_t pid = fork();
-        if (pid == 0) {
-            for (int i = 0; i < n->data.command.n_redirs; ++i) {
-                int fd = n->data.command.redirs[i].fd;
-                int t = n->data.command.redirs[i].type;
-                const char *fn = n->data.command.redirs[i].filename;
-                int f = -1;
-                if (t == REDIR_INPUT) f = open(fn, O_RDONLY | O_CLOEXEC);
-                else if (t == REDIR_OUTPUT) f = open(fn, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
-                else if (t == REDIR_APPEND) f = open(fn, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
-                else if (t == REDIR_HEREDOC) {
-                    // Create a pipe, feed stdin until delimiter, and hook read end to fd
-                    int p[2];
-                    if (pipe(p) == 0) {
-                        size_t cap = 0; char *line = NULL; ssize_t nread;
-                        while ((nread = getline(&line, &cap, stdin)) != -1) {
-                            if (nread > 0 && line[nread - 1] == '\n') {
-                                line[nread - 1] = '\0';
-                                nread--;
-                            }
-                            if (strcmp(line, fn) == 0) break;
-                            if (nread > 0) { sig_safe_write(p[1], line, (size_t)nread); }
-                            sig_safe_write(p[1], "\n", 1);
-                        }
-                        free(line);
-                        close(p[1]);
-                        f = p[0];
-                    }
-                }
-                if (f >= 0) { dup2_or_clear_cloexec(f, fd); }
-            }
-            execvp(expanded_argv[0], expanded_argv);
-            perror("execvp");
+    off_t size = lseek(mfd, 0, SEEK_CUR);
+    *len = size > 0 ? (size_t)size : 0;
+    *out = arena_alloc(arena, *len + 1);
+    size_t got = 0;
+    while (got < *len) {
+        ssize_t n = pread(mfd, *out + got, *len - got, (off_t)got);
+        if (n <= 0)
+            break;
+        got += (size_t)n;
+    }
+    *len = got;
+    (*out)[got] = '\0';
+
+    if (spare_memfd < 0 && ftruncate(mfd, 0) == 0 && lseek(mfd, 0, SEEK_SET) == 0) {
+        spare_memfd = mfd;
+        spare_memfd_owner = getpid();
+    } else
+        close(mfd);
+    return rc;
+}
+
+#define CAPTURE_INITIAL 4096
+#define CAPTURE_PIPE_SIZE (1 << 20)
+
+// Run ast in a forked subshell and read its stdout through a pipe. The
+// buffer doubles as it fills; once the output outgrows the default pipe
+// the pipe is enlarged so the writer blocks less and each read returns
+// more.
+static int capture_subshell(ast_node_t *ast, arena_t *arena, char **out, size_t *len) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        perror("pipe");
+        return -1;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        if (dup2(fds[1], STDOUT_FILENO) < 0)
             _exit(127);
-        } else if (pid > 0) {
-            int st; void (*oldint)(int) = signal(SIGINT, SIG_IGN);
-            waitpid(pid, &st, 0);
-            signal(SIGINT, oldint);
-            if (WIFEXITED(st)) rc = WEXITSTATUS(st);
-            else if (WIFSIGNALED(st)) rc = 128 + WTERMSIG(st);
-            else rc = 1;
-        } else {
-            perror("fork");
-            rc = -1;
+        int rc = exec_ast(ast);
+        fflush(stdout);
+        _exit(rc & 0xFF);
+    }
+    close(fds[1]);
+
+    size_t cap = CAPTURE_INITIAL;
+    size_t used = 0;
+    int grown = 0;
+    char *buf = arena_alloc(arena, cap);
+    for (;;) {
+        if (used + 1 >= cap) {
+            char *bigger = arena_alloc(arena, cap * 2);
+            memcpy(bigger, buf, used);
+            buf = bigger;
+            cap *= 2;
+            if (!grown) {
+                (void)fcntl(fds[0], F_SETPIPE_SZ, CAPTURE_PIPE_SIZE);
+                grown = 1;
+            }
         }
+        ssize_t n = read(fds[0], buf + used, cap - used - 1);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        used += (size_t)n;
     }
-    free_string_array(expanded_argv);
+    close(fds[0]);
+    buf[used] = '\0';
+    *out = buf;
+    *len = used;
+    return launch_wait(pid);
+}
+
+int exec_capture(const char *body, arena_t *arena, char **out, size_t *len) {
+    *out = NULL;
+    *len = 0;
+    if (!body || !arena)
+        return -1;
+
+    lexer_t *lexer = lexer_create(body);
+    parser_t *parser = parser_create(lexer);
+    ast_node_t *ast = parser_parse(parser);
+    parser_free(parser);
+    lexer_free(lexer);
+
+    int rc = 0;
+    if (!ast) {
+        *out = arena_strndup(arena, "", 0);
+    } else if (capture_in_process(ast)) {
+        rc = capture_builtins(ast, arena, out, len);
+    } else {
+        rc = capture_subshell(ast, arena, out, len);
+    }
+    ast_free(ast);
+    if (!*out)
+        *out = arena_strndup(arena, "", 0);
     return rc;
 }
 
+// Count the stages of a pipeline tree. The parser builds left-leaning
+// trees ((a | b) | c), but any nesting of AST_PIPELINE nodes is accepted.
+static int pipeline_stage_count(ast_node_t *node) {
+    if (node && node->type == AST_PIPELINE)
+        return pipeline_stage_count(node->data.pipeline.left) +
+               pipeline_stage_count(node->data.pipeline.right);
+    return 1;
+}
+
+// Store the stages of a pipeline tree in left-to-right order.
+static int pipeline_collect_stages(ast_node_t *node, ast_node_t **out, int n) {
+    if (node && node->type == AST_PIPELINE) {
+        n = pipeline_collect_stages(node->data.pipeline.left, out, n);
+        return pipeline_collect_stages(node->data.pipeline.right, out, n);
+    }
+    out[n] = node;
+    return n + 1;
+}
+
 int exec_pipeline(ast_pipeline_t *pipeline) {
     ast_node_t *node = (ast_node_t *)pipeline;
     if (!node) return -1;
-    // Flatten simple binary tree into array
-    ast_node_t *arr[16];
-    int n = 0;
-    ast_node_t *cur = node;
-    while (cur && n < 16) {
-        if (cur->type == AST_PIPELINE) {
-            arr[n++] = cur->data.pipeline.left;
-            cur = cur->data.pipeline.right;
-        } else {
-            arr[n++] = cur;
+    // Flatten the binary tree into an array of stages
+    int count = pipeline_stage_count(node);
+    ast_node_t **stages = malloc_safe(sizeof(ast_node_t *) * (size_t)count);
+    int n = pipeline_collect_stages(node, stages, 0);
+    int rc = pipeline_execute(stages, n);
+    free(stages);
+    return rc;
+}
+
+// Loops being run, and the number of loop levels a break or continue
+// still has to leave. While a request is pending, lists and conditions
+// stop on their way out to the loop it targets; a pending `return` stops
+// everything up to the function call.
+static int loop_depth;
+static int loop_pending;
+static int loop_resume; // the pending request is a continue
+static int returning;
+
+/** Limit on nested function calls (recursion runs on the C stack). */
+#define FUNC_MAX_DEPTH 1000
+
+int exec_loop_control(int levels, int resume) {
+    if (loop_depth == 0)
+        return -1;
+    loop_pending = levels < loop_depth ? levels : loop_depth;
+    loop_resume = resume;
+    return 0;
+}
+
+int exec_return(void) {
+    if (func_depth() == 0)
+        return -1;
+    returning = 1;
+    return 0;
+}
+
+int exec_interrupted(void) {
+    return !shell_running || loop_pending > 0 || returning;
+}
+
+int exec_loop_stop(void) {
+    if (!shell_running || returning)
+        return 1;
+    if (loop_pending == 0)
+        return 0;
+    if (--loop_pending == 0 && loop_resume) {
+        loop_resume = 0;
+        return 0;
+    }
+    return 1;
+}
+
+void exec_loop_enter(void) {
+    loop_depth++;
+}
+
+void exec_loop_leave(void) {
+    loop_depth--;
+}
+
+arena_t *exec_arena(void) {
+    return &expand_arena;
+}
+
+// while/until. The condition and body trees are parsed once and run again
+// on every iteration; only their words are expanded anew.
+static int exec_loop(ast_node_t *node) {
+    int until = node->type == AST_UNTIL;
+    int rc = 0;
+    exec_loop_enter();
+    for (;;) {
+        int cond = exec_ast(node->data.loop.cond);
+        shell_set_last_status(cond);
+        if (exec_interrupted()) {
+            if (exec_loop_stop())
+                break;
+            continue;
+        }
+        if ((cond == 0) == until)
+            break;
+        rc = exec_ast(node->data.loop.body);
+        shell_set_last_status(rc);
+        if (exec_loop_stop() || (shell_flag_errexit && rc != 0))
+            break;
+    }
+    exec_loop_leave();
+    return rc;
+}
+
+int exec_for_words(ast_node_t *node, expand_fields_t *fields) {
+    *fields = (expand_fields_t){0};
+    char **words = node->data.for_clause.words;
+    if (words) {
+        expand_take_status();
+        for (int i = 0; words[i]; ++i)
+            expand_fields(&expand_arena, words[i], fields);
+        if (expand_failed()) {
+            *fields = (expand_fields_t){0};
+            return expansion_failed();
+        }
+    } else {
+        fields->words = env_positional()->argv;
+        fields->n = env_positional()->argc;
+    }
+    return 0;
+}
+
+int exec_for_assign(ast_node_t *node, const char *word) {
+    if (env_assign(node->data.for_clause.name, word) != 0) {
+        perror(node->data.for_clause.name);
+        return -1;
+    }
+    return 0;
+}
+
+// for name in words: the words are expanded once, when the loop starts.
+// Without `in` the loop runs over the positional parameters.
+static int exec_for(ast_node_t *node) {
+    arena_mark_t mark = arena_mark(&expand_arena);
+    expand_fields_t fields;
+    int rc = exec_for_words(node, &fields);
+    if (rc != 0) {
+        arena_release(&expand_arena, mark);
+        return rc;
+    }
+    exec_loop_enter();
+    for (int i = 0; i < fields.n; ++i) {
+        if (exec_for_assign(node, fields.words[i]) != 0) {
+            rc = 1;
             break;
         }
+        rc = exec_ast(node->data.for_clause.body);
+        shell_set_last_status(rc);
+        if (exec_loop_stop() || (shell_flag_errexit && rc != 0))
+            break;
     }
-    return pipeline_execute(arr, n);
+    exec_loop_leave();
+    arena_release(&expand_arena, mark);
+    return rc;
+}
+
+int exec_case_match(ast_node_t *node, int *matched) {
+    arena_mark_t mark = arena_mark(&expand_arena);
+    expand_take_status();
+    const char *word = expand_word(&expand_arena, node->data.case_clause.word);
+    *matched = -1;
+    for (int i = 0; i < node->data.case_clause.n_items && *matched < 0; ++i) {
+        const ast_case_item_t *item = &node->data.case_clause.items[i];
+        for (int j = 0; j < item->n_patterns && *matched < 0 && !expand_failed(); ++j) {
+            const char *pattern = expand_word(&expand_arena, item->patterns[j]);
+            if (!expand_failed() && fnmatch(pattern, word, 0) == 0)
+                *matched = i;
+        }
+    }
+    arena_release(&expand_arena, mark);
+    if (expand_failed()) {
+        *matched = -1;
+        return expansion_failed();
+    }
+    return 0;
+}
+
+// case: patterns are expanded and matched in order, stopping at the first
+// match; a case without a match succeeds.
+static int exec_case(ast_node_t *node) {
+    int i;
+    int rc = exec_case_match(node, &i);
+    if (rc != 0)
+        return rc;
+    ast_node_t *body = i >= 0 ? node->data.case_clause.items[i].body : NULL;
+    return body ? exec_ast(body) : 0;
+}
+
+// Call a function: argv[1..] become the positional parameters (argv lives
+// in the caller's expansion arena until the call returns, so nothing is
+// copied). Loops are per call; break and continue do not reach the
+// caller's loops.
+static int exec_function(func_t *fn, int argc, char **argv) {
+    if (func_depth() >= FUNC_MAX_DEPTH) {
+        fprintf(stderr, "myshell: %s: maximum function nesting level exceeded (%d)\n", argv[0],
+                FUNC_MAX_DEPTH);
+        return 1;
+    }
+    env_positional_t saved = *env_positional();
+    int saved_depth = loop_depth;
+    env_set_positional(argv + 1, argc - 1);
+    loop_depth = 0;
+    func_retain(fn); // the body may redefine or unset the function
+    func_frame_push();
+    int rc = exec_engine() == EXEC_ENGINE_VM ? vm_run(func_program(fn)) : exec_ast(func_body(fn));
+    func_frame_pop();
+    func_release(fn);
+    returning = 0;
+    loop_pending = 0;
+    loop_depth = saved_depth;
+    env_set_positional(saved.argv, saved.argc);
+    return rc;
+}
+
+static int engine = -1; // exec_engine_t once chosen
+
+exec_engine_t exec_engine(void) {
+    if (engine < 0) {
+        const char *name = env_get("MYSHELL_ENGINE");
+        engine = EXEC_ENGINE_TREE;
+        if (name && strcmp(name, "vm") == 0) {
+            engine = EXEC_ENGINE_VM;
+        } else if (name && *name && strcmp(name, "tree") != 0) {
+            fprintf(stderr, "myshell: MYSHELL_ENGINE=%s: unknown engine, using tree\n", name);
+        }
+    }
+    return (exec_engine_t)engine;
+}
+
+void exec_set_engine(exec_engine_t selected) {
+    engine = selected;
+}
+
+int exec_program(ast_node_t *ast) {
+    if (!ast || exec_engine() == EXEC_ENGINE_TREE)
+        return exec_ast(ast);
+    vm_program_t *program = vm_compile(ast);
+    int rc = vm_run(program);
+    vm_free(program);
+    return rc;
 }
 
 int exec_ast(ast_node_t *ast) {
@@ -468,8 +1031,17 @@ int exec_ast(ast_node_t *ast) {
     case AST_PIPELINE:
         return exec_pipeline((ast_pipeline_t *)ast);
     case AST_SEQUENCE: {
-        (void)exec_ast(ast->data.sequence.left);
-        return exec_ast(ast->data.sequence.right);
+        // Walk the right spine in a loop: a script is one sequence as long
+        // as the script. -e and exit stop it after the failing command.
+        ast_node_t *node = ast;
+        while (node->type == AST_SEQUENCE) {
+            int rc = exec_ast(node->data.sequence.left);
+            shell_set_last_status(rc);
+            if (exec_interrupted() || (shell_flag_errexit && rc != 0))
+                return rc;
+            node = node->data.sequence.right;
+        }
+        return exec_ast(node);
     }
     case AST_BACKGROUND: {
         pid_t pid = fork();
@@ -492,12 +1064,14 @@ int exec_ast(ast_node_t *ast) {
     }
     case AST_AND: {
         int lrc = exec_ast(ast->data.boollist.left);
-        if (lrc == 0) return exec_ast(ast->data.boollist.right);
+        shell_set_last_status(lrc);
+        if (lrc == 0 && !exec_interrupted()) return exec_ast(ast->data.boollist.right);
         return lrc;
     }
     case AST_OR: {
         int lrc = exec_ast(ast->data.boollist.left);
-        if (lrc != 0) return exec_ast(ast->data.boollist.right);
+        shell_set_last_status(lrc);
+        if (lrc != 0 && !exec_interrupted()) return exec_ast(ast->data.boollist.right);
         return lrc;
     }
     case AST_SUBSHELL: {
@@ -508,17 +1082,35 @@ int exec_ast(ast_node_t *ast) {
             _exit(rc & 0xFF);
         } else if (pid > 0) {
             (void)setpgid(pid, pid);
-            int st; void (*oldint)(int) = signal(SIGINT, SIG_IGN);
-            waitpid(pid, &st, 0);
-            signal(SIGINT, oldint);
-            if (WIFEXITED(st)) return WEXITSTATUS(st);
-            if (WIFSIGNALED(st)) return 128 + WTERMSIG(st);
-            return 1;
+            return launch_wait(pid);
         } else {
             perror("fork");
             return -1;
         }
     }
+    case AST_IF: {
+        // An elif is an if in the else part: follow the chain in a loop
+        ast_node_t *node = ast;
+        while (node && node->type == AST_IF) {
+            int cond = exec_ast(node->data.if_clause.cond);
+            shell_set_last_status(cond);
+            if (exec_interrupted())
+                return cond;
+            if (cond == 0)
+                return exec_ast(node->data.if_clause.then_part);
+            node = node->data.if_clause.else_part;
+        }
+        return node ? exec_ast(node) : 0;
+    }
+    case AST_WHILE:
+    case AST_UNTIL:
+        return exec_loop(ast);
+    case AST_FOR:
+        return exec_for(ast);
+    case AST_CASE:
+        return exec_case(ast);
+    case AST_FUNCTION:
+        return func_define(ast->data.function.name, ast->data.function.body) == 0 ? 0 : 1;
     default:
         return -1;
     }
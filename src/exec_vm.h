@@ -0,0 +1,46 @@
+/**
+ * @file exec_vm.h
+ * @brief Internal interface between the tree executor (exec.c) and the
+ *        bytecode VM (vm.c).
+ *
+ * @details The VM runs control flow from its own instruction stream but
+ * leaves everything else to the executor: simple commands, pipelines,
+ * subshells and background jobs, word expansion, and the state behind
+ * break, continue and return. Both engines go through these helpers, so
+ * they agree on when lists and loops stop.
+ */
+#ifndef EXEC_VM_H
+#define EXEC_VM_H
+
+#include "ast.h"
+#include "env.h"
+
+/** Must the current list stop (exit, break, continue, return)? */
+int exec_interrupted(void);
+/**
+ * Called by a loop after its body ran: must the loop stop? Consumes one
+ * level of a pending break or continue.
+ */
+int exec_loop_stop(void);
+/** A loop starts running: break and continue may target it. */
+void exec_loop_enter(void);
+/** The innermost running loop has ended. */
+void exec_loop_leave(void);
+
+/** Arena words are expanded into; mark it before expanding, release after. */
+arena_t *exec_arena(void);
+/**
+ * Words a for loop iterates over: its list expanded into exec_arena(), or
+ * the positional parameters when it has no `in`. Returns 0, or the status
+ * of a failed expansion (reported, fields left empty).
+ */
+int exec_for_words(ast_node_t *node, expand_fields_t *fields);
+/** Set a for loop's variable to word. Returns 0, or -1 (reported) on error. */
+int exec_for_assign(ast_node_t *node, const char *word);
+/**
+ * Set matched to the index of the first case item with a pattern matching
+ * the word, or -1. Returns 0, or the status of a failed expansion.
+ */
+int exec_case_match(ast_node_t *node, int *matched);
+
+#endif // EXEC_VM_H
@@ -1,115 +1,590 @@
+/**
+ * @file expand.c
+ * @brief Single-pass parameter expansion into an arena.
+ *
+ * A word is scanned once: literal runs are copied with memcpy, `$NAME`
+ * and `${...}` are resolved against the variable store without
+ * NUL-terminated copies of the name, and the result is written into the
+ * caller's arena. Words without '$' are returned as-is.
+ *
+ * Command substitutions run through exec_capture(). When one makes up a
+ * whole word its output buffer becomes the word, and field splitting
+ * (expand_fields) cuts that buffer in place, so large outputs are not
+ * copied again after they are read. Other words are split as they are
+ * expanded: the results of unquoted expansions are cut at IFS characters,
+ * while literal text and expansions the lexer marked as double-quoted are
+ * not.
+ */
+#include "arith.h"
 #include "env.h"
+#include "exec.h"
+#include "lexer.h"
 #include "shell.h"
 #include "util.h"
 #include <ctype.h>
+#include <fnmatch.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
-char *expand_variables(const char *str) {
-    // Simple variable expansion implementation
-    // This would need to be expanded for full shell variable expansion
-    if (!str)
-        return NULL;
+/** Characters that make a word need expansion. */
+static const char expand_special[] = {'$', '`', LEXER_QUOTE_MARK, LEXER_LITERAL_MARK, '\0'};
+
+/** Output buffer growing inside an arena (old buffers are left behind). */
+typedef struct {
+    arena_t *arena;
+    char *buf;
+    size_t len;
+    size_t cap;
+    // Field splitting, for expand_fields() only: finished fields go to
+    // fields, and while split is set appended text is cut at ifs.
+    expand_fields_t *fields;
+    const char *ifs;
+    int split;
+    int keep;  // the current field stays even if empty ("$x" with x empty)
+    int depth; // expand_into() nesting
+} expand_out_t;
+
+static void out_init(expand_out_t *out, arena_t *arena, size_t hint) {
+    out->arena = arena;
+    out->cap = hint + 32;
+    out->buf = arena_alloc(arena, out->cap);
+    out->len = 0;
+    out->fields = NULL;
+    out->ifs = NULL;
+    out->split = 0;
+    out->keep = 0;
+    out->depth = 0;
+}
+
+static void out_put(expand_out_t *out, const char *s, size_t n) {
+    if (out->len + n + 1 > out->cap) {
+        size_t cap = out->cap * 2;
+        while (out->len + n + 1 > cap)
+            cap *= 2;
+        char *buf = arena_alloc(out->arena, cap);
+        memcpy(buf, out->buf, out->len);
+        out->buf = buf;
+        out->cap = cap;
+    }
+    memcpy(out->buf + out->len, s, n);
+    out->len += n;
+}
+
+static char *out_finish(expand_out_t *out) {
+    out->buf[out->len] = '\0';
+    return out->buf;
+}
+
+static void push_field(arena_t *arena, expand_fields_t *fields, char *word) {
+    if (fields->n + 1 >= fields->cap) {
+        int cap = fields->cap ? fields->cap * 2 : 16;
+        char **words = arena_alloc(arena, sizeof(char *) * (size_t)cap);
+        if (fields->n)
+            memcpy(words, fields->words, sizeof(char *) * (size_t)fields->n);
+        fields->words = words;
+        fields->cap = cap;
+    }
+    fields->words[fields->n++] = word;
+    fields->words[fields->n] = NULL;
+}
+
+// Close the current field; an empty one is dropped unless it was quoted,
+// so runs of separators count as one.
+static void out_end_field(expand_out_t *out) {
+    if (out->len == 0 && !out->keep)
+        return;
+    push_field(out->arena, out->fields, out_finish(out));
+    out->buf = arena_alloc(out->arena, out->cap);
+    out->len = 0;
+    out->keep = 0;
+}
+
+static void out_append(expand_out_t *out, const char *s, size_t n) {
+    if (!out->split) {
+        out_put(out, s, n);
+        return;
+    }
+    size_t start = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (s[i] && strchr(out->ifs, s[i])) {
+            out_put(out, s + start, i - start);
+            out_end_field(out);
+            start = i + 1;
+        }
+    }
+    out_put(out, s + start, n - start);
+}
+
+static int is_name_start(char c) {
+    return c == '_' || isalpha((unsigned char)c);
+}
+
+static int is_name_char(char c) {
+    return c == '_' || isalnum((unsigned char)c);
+}
+
+// Length of the parameter name at s[0..len): an identifier, a positional
+// parameter or one of the special parameters ? $ # @ *. Unbraced, a
+// positional parameter is one digit ($10 is $1 then 0).
+static size_t param_length(const char *s, size_t len, int braced) {
+    if (len == 0)
+        return 0;
+    if (s[0] == '?' || s[0] == '$' || s[0] == '#' || s[0] == '@' || s[0] == '*')
+        return 1;
+    if (isdigit((unsigned char)s[0])) {
+        size_t n = 1;
+        while (braced && n < len && isdigit((unsigned char)s[n]))
+            n++;
+        return n;
+    }
+    if (!is_name_start(s[0]))
+        return 0;
+    size_t n = 1;
+    while (n < len && is_name_char(s[n]))
+        n++;
+    return n;
+}
 
-    size_t len = strlen(str);
-    size_t cap = len + 1; // initial capacity
-    char *result = malloc_safe(cap);
-    size_t result_pos = 0;
-
-// Helper to ensure capacity for appending n more chars (plus NUL)
-#define ENSURE_CAP(NEED)                           \
-    do {                                           \
-        size_t _need = (NEED);                     \
-        if (result_pos + _need + 1 > cap) {        \
-            while (result_pos + _need + 1 > cap) { \
-                cap *= 2;                          \
-            }                                      \
-            result = realloc_safe(result, cap);    \
-        }                                          \
-    } while (0)
-
-    for (size_t i = 0; i < len; i++) {
-        if (str[i] == '$' && i + 1 < len) {
-            // Special parameters: $? and $$
-            if (str[i + 1] == '?') {
-                char buf[16];
-                snprintf(buf, sizeof buf, "%d", shell_get_last_status());
-                size_t vl = strlen(buf);
-                ENSURE_CAP(vl);
-                memcpy(&result[result_pos], buf, vl);
-                result_pos += vl;
-                i += 1;
-                continue;
-            } else if (str[i + 1] == '$') {
-                char buf[32];
-                snprintf(buf, sizeof buf, "%ld", (long)getpid());
-                size_t vl = strlen(buf);
-                ENSURE_CAP(vl);
-                memcpy(&result[result_pos], buf, vl);
-                result_pos += vl;
-                i += 1;
-                continue;
+// Value of a parameter, or NULL if unset. Numeric special parameters are
+// formatted into buf; $@ and $* are joined into the arena.
+static const char *param_value(arena_t *arena, const char *name, size_t len, char buf[32]) {
+    const env_positional_t *pos = env_positional();
+    if (isdigit((unsigned char)name[0])) {
+        long n = 0;
+        for (size_t i = 0; i < len && n <= pos->argc; ++i)
+            n = n * 10 + (name[i] - '0');
+        if (n == 0)
+            return "myshell";
+        return n <= pos->argc ? pos->argv[n - 1] : NULL;
+    }
+    if (len == 1) {
+        switch (name[0]) {
+        case '?':
+            snprintf(buf, 32, "%d", shell_get_last_status());
+            return buf;
+        case '$':
+            snprintf(buf, 32, "%ld", (long)getpid());
+            return buf;
+        case '#':
+            snprintf(buf, 32, "%d", pos->argc);
+            return buf;
+        case '@':
+        case '*': {
+            size_t total = 1;
+            for (int i = 0; i < pos->argc; ++i)
+                total += strlen(pos->argv[i]) + 1;
+            char *joined = arena_alloc(arena, total);
+            char *p = joined;
+            for (int i = 0; i < pos->argc; ++i) {
+                size_t n = strlen(pos->argv[i]);
+                if (i > 0)
+                    *p++ = ' ';
+                memcpy(p, pos->argv[i], n);
+                p += n;
             }
-            // Simple variable name extraction
-            size_t var_start = i + 1;
-            size_t var_end = var_start;
-
-            while (var_end < len && (isalnum((unsigned char)str[var_end]) || str[var_end] == '_'))
-                var_end++;
-
-            if (var_end > var_start) {
-                size_t name_len = var_end - var_start;
-                char *var_name = malloc_safe(name_len + 1);
-                memcpy(var_name, &str[var_start], name_len);
-                var_name[name_len] = '\0';
-
-                char *var_value = env_get(var_name);
-                if (var_value) {
-                    size_t value_len = strlen(var_value);
-                    ENSURE_CAP(value_len);
-                    memcpy(&result[result_pos], var_value, value_len);
-                    result_pos += value_len;
-                }
-
-                free(var_name);
-                i = var_end - 1;
-                continue;
+            *p = '\0';
+            return joined;
+        }
+        }
+    }
+    return env_getn(name, len);
+}
+
+static void expand_into(expand_out_t *out, const char *s, size_t len);
+
+// Expand s[0..len) into a fresh NUL-terminated arena string.
+static char *expand_sub(arena_t *arena, const char *s, size_t len) {
+    expand_out_t sub;
+    out_init(&sub, arena, len);
+    expand_into(&sub, s, len);
+    return out_finish(&sub);
+}
+
+// Remove the shortest/longest prefix (#, ##) or suffix (%, %%) of value
+// matching pattern and append the rest.
+static void append_trimmed(expand_out_t *out, const char *value, const char *pattern,
+                           int suffix, int longest) {
+    size_t vlen = strlen(value);
+    if (suffix) {
+        // value + i is NUL-terminated already
+        for (size_t k = 0; k <= vlen; ++k) {
+            size_t i = longest ? k : vlen - k;
+            if (fnmatch(pattern, value + i, 0) == 0) {
+                out_append(out, value, i);
+                return;
+            }
+        }
+    } else {
+        char *prefix = arena_strndup(out->arena, value, vlen);
+        for (size_t k = 0; k <= vlen; ++k) {
+            size_t i = longest ? vlen - k : k;
+            char saved = prefix[i];
+            prefix[i] = '\0';
+            int match = fnmatch(pattern, prefix, 0) == 0;
+            prefix[i] = saved;
+            if (match) {
+                out_append(out, value + i, vlen - i);
+                return;
             }
         }
+    }
+    out_append(out, value, vlen);
+}
 
-    // Default: copy the character as-is
-        ENSURE_CAP(1);
-        result[result_pos++] = str[i];
+// Set when an expansion failed since the last expand_take_status().
+static int expand_error;
+
+static void bad_substitution(const char *s, size_t len) {
+    fprintf(stderr, "myshell: ${%.*s}: bad substitution\n", (int)len, s);
+    expand_error = 1;
+}
+
+// Expand the body of ${...} (s[0..len), without the braces).
+static void expand_braced(expand_out_t *out, const char *s, size_t len) {
+    char buf[32];
+
+    if (len > 1 && s[0] == '#') {
+        size_t n = param_length(s + 1, len - 1, 1);
+        if (n != len - 1) {
+            bad_substitution(s, len);
+            return;
+        }
+        const char *value = param_value(out->arena, s + 1, n, buf);
+        char num[24];
+        int w = snprintf(num, sizeof num, "%zu", value ? strlen(value) : (size_t)0);
+        out_append(out, num, (size_t)w);
+        return;
     }
 
-    result[result_pos] = '\0';
-    return result;
+    size_t n = param_length(s, len, 1);
+    if (n == 0) {
+        bad_substitution(s, len);
+        return;
+    }
+    const char *value = param_value(out->arena, s, n, buf);
+    if (n == len) {
+        if (value)
+            out_append(out, value, strlen(value));
+        return;
+    }
+
+    const char *op = s + n;
+    size_t rest = len - n;
+    int colon = op[0] == ':';
+    if (colon) {
+        op++;
+        rest--;
+    }
+    if (rest == 0) {
+        bad_substitution(s, len);
+        return;
+    }
+    const char *word = op + 1;
+    size_t word_len = rest - 1;
+    // With ':' an empty value counts as unset.
+    int missing = !value || (colon && !*value);
 
-#undef ENSURE_CAP
+    switch (op[0]) {
+    case '-':
+        if (missing)
+            expand_into(out, word, word_len);
+        else
+            out_append(out, value, strlen(value));
+        return;
+    case '=':
+        if (missing) {
+            if (!is_name_start(s[0])) {
+                fprintf(stderr, "myshell: $%.*s: cannot assign in this way\n", (int)n, s);
+                expand_error = 1;
+                return;
+            }
+            char *assigned = expand_sub(out->arena, word, word_len);
+            char *name = arena_strndup(out->arena, s, n);
+            env_assign(name, assigned);
+            value = assigned;
+        }
+        out_append(out, value, strlen(value));
+        return;
+    case '+':
+        if (!missing)
+            expand_into(out, word, word_len);
+        return;
+    case '#':
+    case '%':
+        if (colon)
+            break;
+        if (value) {
+            int longest = word_len > 0 && word[0] == op[0];
+            if (longest) {
+                word++;
+                word_len--;
+            }
+            char *pattern = expand_sub(out->arena, word, word_len);
+            append_trimmed(out, value, pattern, op[0] == '%', longest);
+        }
+        return;
+    }
+    bad_substitution(s, len);
+}
+
+// Index of the "))" closing a "$((" whose body starts at s[start], or len.
+static size_t find_arith_end(const char *s, size_t start, size_t len) {
+    int depth = 0;
+    for (size_t i = start; i < len; ++i) {
+        if (s[i] == '(') {
+            depth++;
+        } else if (s[i] == ')') {
+            if (depth > 0)
+                depth--;
+            else
+                return i + 1 < len && s[i + 1] == ')' ? i : len;
+        }
+    }
+    return len;
+}
+
+// Evaluate the body of $((...)): parameters first, then the arithmetic.
+static void expand_arith(expand_out_t *out, const char *s, size_t len) {
+    long value;
+    if (arith_eval(expand_sub(out->arena, s, len), &value) != 0) {
+        expand_error = 1; // arith_eval() has reported it
+        return;
+    }
+    char num[24];
+    int w = snprintf(num, sizeof num, "%ld", value);
+    out_append(out, num, (size_t)w);
+}
+
+// Status of the last command substitution, -1 if none ran since the last
+// expand_take_status().
+static int subst_status = -1;
+
+int expand_take_status(void) {
+    int status = subst_status;
+    subst_status = -1;
+    expand_error = 0;
+    return status;
+}
+
+int expand_failed(void) {
+    return expand_error;
 }
 
-char *env_get(const char *name) {
-    return getenv(name);
+// Length of the command substitution ("$(...)" or "`...`") at s[i], or 0
+// if there is none or it is not terminated.
+static size_t subst_length(const char *s, size_t i, size_t len) {
+    if (s[i] == '`') {
+        const char *close = memchr(s + i + 1, '`', len - i - 1);
+        return close ? (size_t)(close - s) + 1 - i : 0;
+    }
+    if (s[i] != '$' || i + 1 >= len || s[i + 1] != '(')
+        return 0;
+    if (i + 2 < len && s[i + 2] == '(' && find_arith_end(s, i + 3, len) < len)
+        return 0; // $(( ... )) is arithmetic
+    int depth = 0;
+    for (size_t j = i + 1; j < len; ++j) {
+        if (s[j] == '(') {
+            depth++;
+        } else if (s[j] == ')' && --depth == 0) {
+            return j + 1 - i;
+        }
+    }
+    return 0;
+}
+
+// Run the substitution s[i..i+n) and return its output (writable, in the
+// arena) with trailing newlines removed.
+static char *run_subst(arena_t *arena, const char *s, size_t n, size_t *out_len) {
+    size_t skip = s[0] == '`' ? 1 : 2;
+    char *body = arena_strndup(arena, s + skip, n - skip - 1);
+    char *text;
+    size_t len;
+    // Commands in the substitution take the status for themselves
+    int failed = expand_error;
+    subst_status = exec_capture(body, arena, &text, &len);
+    expand_error |= failed;
+    while (len > 0 && text[len - 1] == '\n')
+        len--;
+    text[len] = '\0';
+    *out_len = len;
+    return text;
+}
+
+// Index of the '}' closing a "${" whose body starts at s[start], or len.
+static size_t find_brace_end(const char *s, size_t start, size_t len) {
+    int depth = 1;
+    for (size_t i = start; i < len; ++i) {
+        if (s[i] == '$' && i + 1 < len && s[i + 1] == '{') {
+            depth++;
+            i++;
+        } else if (s[i] == '}' && --depth == 0) {
+            return i;
+        }
+    }
+    return len;
 }
 
-int env_set(const char *name, const char *value) {
-    return setenv(name, value, 1);
+// Expand one '$' or '`' expansion at s[i] and return the index after it.
+static size_t expand_one(expand_out_t *out, const char *s, size_t i, size_t len) {
+    size_t n = subst_length(s, i, len);
+    if (n > 0) {
+        size_t text_len;
+        char *text = run_subst(out->arena, s + i, n, &text_len);
+        out_append(out, text, text_len);
+        return i + n;
+    }
+    if (s[i] == '`') {
+        out_put(out, "`", 1);
+        return i + 1;
+    }
+
+    // s[i] == '$'
+    if (i + 2 < len && s[i + 1] == '(' && s[i + 2] == '(') {
+        size_t end = find_arith_end(s, i + 3, len);
+        if (end < len) {
+            expand_arith(out, s + i + 3, end - i - 3);
+            return end + 2;
+        }
+    }
+    if (i + 1 < len && s[i + 1] == '{') {
+        size_t end = find_brace_end(s, i + 2, len);
+        if (end == len) {
+            // Unterminated: keep the text literally
+            out_put(out, s + i, len - i);
+            return len;
+        }
+        expand_braced(out, s + i + 2, end - i - 2);
+        return end + 1;
+    }
+    n = param_length(s + i + 1, len - i - 1, 0);
+    if (n == 0) {
+        out_put(out, "$", 1);
+        return i + 1;
+    }
+    char buf[32];
+    const char *value = param_value(out->arena, s + i + 1, n, buf);
+    if (value)
+        out_append(out, value, strlen(value));
+    return i + 1 + n;
 }
 
-int env_unset(const char *name) {
-    return unsetenv(name);
+static void expand_into(expand_out_t *out, const char *s, size_t len) {
+    size_t i = 0;
+    int quoted = 0; // the next expansion was inside double quotes
+    out->depth++;
+    while (i < len) {
+        size_t lit_end = i;
+        while (lit_end < len && s[lit_end] != '$' && s[lit_end] != '`' &&
+               s[lit_end] != LEXER_QUOTE_MARK && s[lit_end] != LEXER_LITERAL_MARK)
+            lit_end++;
+        if (lit_end > i) {
+            out_append(out, s + i, lit_end - i);
+            quoted = 0;
+        }
+        i = lit_end;
+        if (i >= len)
+            break;
+
+        if (s[i] == LEXER_QUOTE_MARK) {
+            quoted = 1;
+            out->keep = 1;
+            i++;
+            continue;
+        }
+        if (s[i] == LEXER_LITERAL_MARK) {
+            // A quoted '$' or '`': copy it as-is
+            if (i + 1 < len)
+                out_put(out, s + i + 1, 1);
+            i += 2;
+            continue;
+        }
+        // Only the word itself decides what is split; inside ${...} the
+        // enclosing expansion has decided already
+        int split = out->split;
+        if (out->depth == 1)
+            out->split = out->fields && !quoted;
+        i = expand_one(out, s, i, len);
+        out->split = split;
+        quoted = 0;
+    }
+    out->depth--;
 }
 
-char **env_get_all(void) {
-    extern char **environ;
-    return environ;
+char *expand_word(arena_t *arena, const char *word) {
+    if (!word)
+        return NULL;
+    if (!strpbrk(word, expand_special))
+        return (char *)word;
+    size_t len = strlen(word);
+    if (subst_length(word, 0, len) == len) {
+        // The whole word is a substitution: use its output buffer as-is
+        size_t text_len;
+        return run_subst(arena, word, len, &text_len);
+    }
+    expand_out_t out;
+    out_init(&out, arena, len);
+    expand_into(&out, word, len);
+    return out_finish(&out);
 }
 
-void env_print(void) {
-    char **env = env_get_all();
-    for (int i = 0; env[i]; i++) {
-        printf("%s\n", env[i]);
+void expand_fields(arena_t *arena, const char *word, expand_fields_t *fields) {
+    const char *param = word[0] == LEXER_QUOTE_MARK ? word + 1 : word;
+    if (strcmp(param, "$@") == 0 || strcmp(param, "${@}") == 0) {
+        // One field per positional parameter, quoted or not
+        const env_positional_t *pos = env_positional();
+        for (int i = 0; i < pos->argc; ++i)
+            push_field(arena, fields, pos->argv[i]);
+        return;
+    }
+    if (!strpbrk(word, "$`")) {
+        push_field(arena, fields, expand_word(arena, word));
+        return;
+    }
+    size_t len = strlen(word);
+    if ((word[0] != '$' && word[0] != '`') || subst_length(word, 0, len) != len) {
+        expand_out_t out;
+        out_init(&out, arena, len);
+        out.fields = fields;
+        out.ifs = env_get("IFS");
+        if (!out.ifs)
+            out.ifs = " \t\n";
+        expand_into(&out, word, len);
+        out_end_field(&out);
+        return;
+    }
+
+    // Unquoted substitution: split its output in place at IFS characters,
+    // treating runs of them as one separator.
+    size_t text_len;
+    char *text = run_subst(arena, word, len, &text_len);
+    const char *ifs = env_get("IFS");
+    if (!ifs)
+        ifs = " \t\n";
+    if (!*ifs) {
+        push_field(arena, fields, text);
+        return;
+    }
+    char *p = text;
+    char *end = text + text_len;
+    while (p < end) {
+        p += strspn(p, ifs);
+        if (p >= end)
+            break;
+        char *field = p;
+        p += strcspn(p, ifs);
+        *p++ = '\0';
+        push_field(arena, fields, field);
     }
 }
+
+char *expand_variables(const char *str) {
+    static arena_t scratch;
+    if (!str)
+        return NULL;
+    arena_mark_t mark = arena_mark(&scratch);
+    char *result = strdup_safe(expand_word(&scratch, str));
+    arena_release(&scratch, mark);
+    return result;
+}
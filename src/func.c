@@ -0,0 +1,189 @@
+/**
+ * @file func.c
+ * @brief Function table (chained hash of reference-counted bodies) and
+ * the saved-variable stack behind `local`.
+ */
+#include "func.h"
+#include "env.h"
+#include "util.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FUNC_BUCKETS 64
+
+struct func {
+    char *name;
+    arena_t arena;    // holds the body tree
+    ast_node_t *body;
+    vm_program_t *program; // body compiled for the VM, on first use
+    int refs;         // the table's reference plus calls in progress
+    struct func *next;
+};
+
+static func_t *buckets[FUNC_BUCKETS];
+
+/** A variable made local, with what to restore when its frame ends. */
+typedef struct {
+    char *name;
+    char *value; // previous value, NULL if it was unset
+    int exported;
+} func_saved_t;
+
+static func_saved_t *saved = NULL; // all frames, innermost last
+static int n_saved = 0;
+static int saved_capacity = 0;
+static int *frames = NULL; // index into saved where each frame starts
+static int depth = 0;
+static int frames_capacity = 0;
+
+static unsigned hash_name(const char *s) {
+    unsigned h = 2166136261u; // FNV-1a
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h % FUNC_BUCKETS;
+}
+
+// Link pointing at the function called name, or at the bucket's end.
+static func_t **find_link(const char *name) {
+    func_t **pp = &buckets[hash_name(name)];
+    while (*pp && strcmp((*pp)->name, name) != 0)
+        pp = &(*pp)->next;
+    return pp;
+}
+
+int func_define(const char *name, const ast_node_t *body) {
+    if (!name || !body)
+        return -1;
+    func_t *fn = malloc_safe(sizeof(*fn));
+    fn->name = strdup_safe(name);
+    arena_init(&fn->arena, 0);
+    fn->body = ast_copy(&fn->arena, body);
+    fn->program = NULL;
+    fn->refs = 1;
+
+    func_t **pp = find_link(name);
+    func_t *old = *pp;
+    fn->next = old ? old->next : NULL;
+    *pp = fn;
+    if (old)
+        func_release(old);
+    return 0;
+}
+
+func_t *func_find(const char *name) {
+    if (!name)
+        return NULL;
+    return *find_link(name);
+}
+
+int func_unset(const char *name) {
+    if (!name)
+        return -1;
+    func_t **pp = find_link(name);
+    func_t *fn = *pp;
+    if (!fn)
+        return -1;
+    *pp = fn->next;
+    func_release(fn);
+    return 0;
+}
+
+ast_node_t *func_body(const func_t *fn) {
+    return fn ? fn->body : NULL;
+}
+
+vm_program_t *func_program(func_t *fn) {
+    if (!fn)
+        return NULL;
+    if (!fn->program)
+        fn->program = vm_compile(fn->body);
+    return fn->program;
+}
+
+void func_retain(func_t *fn) {
+    if (fn)
+        fn->refs++;
+}
+
+void func_release(func_t *fn) {
+    if (!fn || --fn->refs > 0)
+        return;
+    vm_free(fn->program);
+    arena_free(&fn->arena);
+    free(fn->name);
+    free(fn);
+}
+
+void func_clear(void) {
+    for (int b = 0; b < FUNC_BUCKETS; ++b) {
+        while (buckets[b]) {
+            func_t *fn = buckets[b];
+            buckets[b] = fn->next;
+            func_release(fn);
+        }
+    }
+}
+
+void func_frame_push(void) {
+    if (depth == frames_capacity) {
+        frames_capacity = frames_capacity ? frames_capacity * 2 : 16;
+        frames = realloc_safe(frames, sizeof(int) * (size_t)frames_capacity);
+    }
+    frames[depth++] = n_saved;
+}
+
+void func_frame_pop(void) {
+    if (depth == 0)
+        return;
+    int start = frames[--depth];
+    // Restore in reverse so the outermost saved value wins
+    while (n_saved > start) {
+        func_saved_t *s = &saved[--n_saved];
+        if (s->value) {
+            env_assign(s->name, s->value);
+            if (s->exported)
+                env_export(s->name);
+        } else {
+            env_unset(s->name);
+        }
+        free(s->name);
+        free(s->value);
+    }
+}
+
+int func_depth(void) {
+    return depth;
+}
+
+static int valid_name(const char *name) {
+    if (!(*name == '_' || isalpha((unsigned char)*name)))
+        return 0;
+    for (const char *p = name + 1; *p; ++p) {
+        if (!(*p == '_' || isalnum((unsigned char)*p)))
+            return 0;
+    }
+    return 1;
+}
+
+int func_local(const char *name, const char *value) {
+    if (depth == 0 || !name || !valid_name(name))
+        return -1;
+    int already = 0;
+    for (int i = frames[depth - 1]; i < n_saved && !already; ++i)
+        already = strcmp(saved[i].name, name) == 0;
+    if (!already) {
+        if (n_saved == saved_capacity) {
+            saved_capacity = saved_capacity ? saved_capacity * 2 : 16;
+            saved = realloc_safe(saved, sizeof(func_saved_t) * (size_t)saved_capacity);
+        }
+        const char *old = env_get(name);
+        saved[n_saved].name = strdup_safe(name);
+        saved[n_saved].value = old ? strdup_safe(old) : NULL;
+        saved[n_saved].exported = env_is_exported(name);
+        n_saved++;
+    }
+    return value ? env_assign(name, value) : env_unset(name);
+}
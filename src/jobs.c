@@ -3,6 +3,7 @@
  * @brief Minimal job control: list, fg/bg, and cleanup.
  */
 #include "jobs.h"
+#include "childwatch.h"
 #include "shell.h"
 #include "util.h"
 #include <errno.h>
@@ -18,6 +19,8 @@ struct job {
     pid_t pgid;
     char *command;
     job_status_t status;
+    int watched; // reaped through childwatch events
+    int notify;  // state changed in the background, not yet reported
     struct job *next;
 };
 
@@ -27,6 +30,29 @@ static job_t *job_list_head = NULL;
 static int next_job_id = 1;
 /** Set when SIGCHLD occurs; drained by jobs_reap_background. */
 static volatile sig_atomic_t jobs_sigchld_flag = 0;
+/** Job currently waited on by job_fg(); its changes are not announced. */
+static job_t *foreground_job = NULL;
+
+static job_t *job_find_by_pgid(pid_t pgid);
+
+// childwatch callback: apply a state change of a job leader immediately.
+static void jobs_child_event(pid_t pid, int status, void *data) {
+    (void)data;
+    job_t *job = job_find_by_pgid(pid);
+    if (!job)
+        return;
+    if (WIFSTOPPED(status)) {
+        job->status = JOB_STOPPED;
+    } else if (WIFCONTINUED(status)) {
+        job->status = JOB_RUNNING;
+        return;
+    } else {
+        job->status = JOB_DONE;
+        job->watched = 0;
+    }
+    if (job != foreground_job)
+        job->notify = 1;
+}
 
 job_t *job_create(pid_t pgid, const char *command) {
     if (!command)
@@ -38,6 +64,8 @@ job_t *job_create(pid_t pgid, const char *command) {
     job->status = JOB_RUNNING;
     job->next = job_list_head;
     job_list_head = job;
+    job->notify = 0;
+    job->watched = childwatch_add(pgid, jobs_child_event, NULL) == 0;
     return job;
 }
 
@@ -102,19 +130,29 @@ void job_fg(job_t *job) {
         }
     }
 
-    // Wait for the job to finish or stop (any child in group)
-    int status = 0;
-    pid_t w = waitpid(-job->pgid, &status, WUNTRACED);
-    if (w == -1) {
-        if (errno != ECHILD)
-            perror("waitpid");
-        return;
-    }
-
-    if (WIFSTOPPED(status)) {
-        job->status = JOB_STOPPED;
+    if (job->watched && childwatch_active()) {
+        // The leader's exit/stop arrives as an event and updates the job.
+        foreground_job = job;
+        while (job->status == JOB_RUNNING) {
+            if (childwatch_dispatch() != 0)
+                break;
+        }
+        foreground_job = NULL;
     } else {
-        job->status = JOB_DONE;
+        // Wait for the job to finish or stop (any child in group)
+        int status = 0;
+        pid_t w = waitpid(-job->pgid, &status, WUNTRACED);
+        if (w == -1) {
+            if (errno != ECHILD)
+                perror("waitpid");
+            return;
+        }
+
+        if (WIFSTOPPED(status)) {
+            job->status = JOB_STOPPED;
+        } else {
+            job->status = JOB_DONE;
+        }
     }
 
     // Restore terminal control back to the shell's process group
@@ -163,6 +201,23 @@ void job_cleanup(void) {
     }
 }
 
+int jobs_report_changes(void) {
+    int reported = 0;
+    for (job_t *job = job_list_head; job; job = job->next) {
+        if (!job->notify)
+            continue;
+        job->notify = 0;
+        if (job->status == JOB_RUNNING)
+            continue;
+        printf("%s[%d] %s\t%s\n", reported ? "" : "\n", job->id,
+               job->status == JOB_DONE ? "Done" : "Stopped", job->command);
+        reported++;
+    }
+    if (reported)
+        fflush(stdout);
+    return reported;
+}
+
 void jobs_notify_sigchld(void) {
     jobs_sigchld_flag = 1;
 }
@@ -0,0 +1,160 @@
+/**
+ * @file launch.c
+ * @brief posix_spawn-based launching of external commands.
+ */
+#include "launch.h"
+#include "childwatch.h"
+#include "env.h"
+#include "redir.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Open every redirection source in the shell and queue a dup2 onto its
+// target. Sources are O_CLOEXEC, so the child needs no explicit close
+// actions; src_fds collects them for the caller to close after spawning.
+// The child runs the dup2s in order, so every source is moved above all
+// targets first: otherwise one could sit on a descriptor that an earlier
+// action overwrites.
+static int build_file_actions(posix_spawn_file_actions_t *fa,
+                              const launch_redir_t *redirs, int n_redirs,
+                              int *src_fds) {
+    int lowest = 10;
+    for (int i = 0; i < n_redirs; ++i) {
+        if (redirs[i].fd >= lowest)
+            lowest = redirs[i].fd + 1;
+    }
+    for (int i = 0; i < n_redirs; ++i) {
+        int src = redir_open_source(redirs[i].type, redirs[i].filename);
+        if (src < 0)
+            return LAUNCH_EREDIR;
+        // This also keeps dup2 from targeting its own source, which would
+        // leave FD_CLOEXEC set
+        int moved = fcntl(src, F_DUPFD_CLOEXEC, lowest);
+        close(src);
+        if (moved < 0) {
+            perror("fcntl");
+            return LAUNCH_EREDIR;
+        }
+        src_fds[i] = moved;
+        int rc = posix_spawn_file_actions_adddup2(fa, moved, redirs[i].fd);
+        if (rc != 0) {
+            errno = rc;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+pid_t launch_spawn(const char *path, char **argv, const launch_redir_t *redirs,
+                   int n_redirs, pid_t pgid) {
+    if (!argv || !argv[0] || n_redirs < 0 || (n_redirs > 0 && !redirs)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    posix_spawn_file_actions_t fa;
+    posix_spawnattr_t attr;
+    int src_fds[n_redirs > 0 ? n_redirs : 1];
+    pid_t pid = -1;
+    int err;
+
+    for (int i = 0; i < n_redirs; ++i)
+        src_fds[i] = -1;
+
+    if ((err = posix_spawn_file_actions_init(&fa)) != 0) {
+        errno = err;
+        return -1;
+    }
+    if ((err = posix_spawnattr_init(&attr)) != 0) {
+        posix_spawn_file_actions_destroy(&fa);
+        errno = err;
+        return -1;
+    }
+
+    // Children start in their own (or the given) process group, with default
+    // job-control signal dispositions and an empty signal mask, regardless of
+    // what the shell ignores or blocks.
+    sigset_t defaults, empty;
+    sigemptyset(&empty);
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGINT);
+    sigaddset(&defaults, SIGQUIT);
+    sigaddset(&defaults, SIGTSTP);
+    sigaddset(&defaults, SIGTTIN);
+    sigaddset(&defaults, SIGTTOU);
+    sigaddset(&defaults, SIGCHLD);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setsigmask(&attr, &empty);
+    posix_spawnattr_setpgroup(&attr, pgid);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF |
+                                        POSIX_SPAWN_SETSIGMASK);
+
+    pid_t ret = build_file_actions(&fa, redirs, n_redirs, src_fds);
+    if (ret == 0) {
+        char **envp = env_envp();
+        err = posix_spawnp(&pid, path ? path : argv[0], &fa, &attr, argv, envp);
+        if (err == ENOENT && path && strcmp(path, argv[0]) != 0)
+            err = posix_spawnp(&pid, argv[0], &fa, &attr, argv, envp);
+        ret = err == 0 ? pid : -1;
+    } else {
+        err = errno;
+    }
+
+    for (int i = 0; i < n_redirs; ++i) {
+        if (src_fds[i] >= 0)
+            close(src_fds[i]);
+    }
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&fa);
+
+    if (ret == -1)
+        errno = err;
+    return ret;
+}
+
+int launch_wait(pid_t pid) {
+    int status = 0;
+    int rc;
+    if (childwatch_active()) {
+        // Reaped from the event loop; a SIGINT only restarts the wait.
+        rc = childwatch_wait(pid, &status);
+    } else {
+        void (*oldint)(int) = signal(SIGINT, SIG_IGN);
+        rc = childwatch_wait(pid, &status);
+        signal(SIGINT, oldint);
+    }
+    if (rc == -1)
+        return 1;
+    if (WIFEXITED(status))
+        return WEXITSTATUS(status);
+    if (WIFSIGNALED(status))
+        return 128 + WTERMSIG(status);
+    return 1;
+}
+
+int launch_external(const char *path, char **argv, const launch_redir_t *redirs,
+                    int n_redirs) {
+    pid_t pid = launch_spawn(path, argv, redirs, n_redirs, 0);
+    if (pid == LAUNCH_EREDIR)
+        return 1;
+    if (pid < 0) {
+        int err = errno;
+        const char *name = argv && argv[0] ? argv[0] : "spawn";
+        if (err == ENOENT) {
+            fprintf(stderr, "%s: command not found\n", name);
+            return 127;
+        }
+        fprintf(stderr, "%s: %s\n", name, strerror(err));
+        if (err == EACCES || err == ENOEXEC)
+            return 126;
+        return 1;
+    }
+    return launch_wait(pid);
+}
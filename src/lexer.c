@@ -13,153 +13,346 @@ struct lexer {
     const char *input;
     size_t pos;
     size_t length;
+    // Words whose bytes change under quote removal are rebuilt here; the
+    // buffer is reused for every such word.
+    char *scratch;
+    size_t scratch_len;
+    size_t scratch_cap;
+    int cooked;        // current word is being rebuilt in scratch
+    size_t word_start; // input offset of the current word
 };
 
 lexer_t *lexer_create(const char *input) {
+    return lexer_create_n(input, strlen(input));
+}
+
+lexer_t *lexer_create_n(const char *input, size_t length) {
     lexer_t *lexer = malloc_safe(sizeof(lexer_t));
     lexer->input = input;
     lexer->pos = 0;
-    lexer->length = strlen(input);
+    lexer->length = length;
+    lexer->scratch = NULL;
+    lexer->scratch_len = 0;
+    lexer->scratch_cap = 0;
+    lexer->cooked = 0;
+    lexer->word_start = 0;
     return lexer;
 }
 
+size_t lexer_line_at(const lexer_t *lexer, size_t offset) {
+    size_t line = 1;
+    for (size_t i = 0; i < offset && i < lexer->length; ++i)
+        line += lexer->input[i] == '\n';
+    return line;
+}
+
+// Skip blanks, backslash-newline continuations and comments; newlines are
+// tokens.
 static void skip_whitespace(lexer_t *lexer) {
-    while (lexer->pos < lexer->length && isspace((unsigned char)lexer->input[lexer->pos]))
-        lexer->pos++;
+    while (lexer->pos < lexer->length) {
+        char c = lexer->input[lexer->pos];
+        if (c == '\\' && lexer->pos + 1 < lexer->length && lexer->input[lexer->pos + 1] == '\n') {
+            lexer->pos += 2;
+        } else if (c == '#') {
+            while (lexer->pos < lexer->length && lexer->input[lexer->pos] != '\n')
+                lexer->pos++;
+        } else if (c != '\n' && isspace((unsigned char)c)) {
+            lexer->pos++;
+        } else {
+            break;
+        }
+    }
 }
 
-static char *read_word(lexer_t *lexer) {
+// Length of the balanced $(...), ${...} or `...` group at pos ("$"
+// included), or 0 if it is not closed. The group is kept verbatim,
+// whitespace included, for the expander to interpret.
+static size_t group_length(const lexer_t *lexer, size_t pos) {
+    if (lexer->input[pos] == '`') {
+        const char *close = memchr(lexer->input + pos + 1, '`', lexer->length - pos - 1);
+        return close ? (size_t)(close - lexer->input) + 1 - pos : 0;
+    }
+    char open = lexer->input[pos + 1];
+    char close = open == '(' ? ')' : '}';
+    int depth = 0;
+    for (size_t i = pos + 1; i < lexer->length; ++i) {
+        char c = lexer->input[i];
+        if (c == open) {
+            depth++;
+        } else if (c == close && --depth == 0) {
+            return i + 1 - pos;
+        }
+    }
+    return 0;
+}
+
+// Append to the rebuilt word; a no-op while the word is still a plain
+// view of the input.
+static void put(lexer_t *lexer, const char *p, size_t n) {
+    if (!lexer->cooked)
+        return;
+    if (lexer->scratch_len + n > lexer->scratch_cap) {
+        size_t cap = lexer->scratch_cap ? lexer->scratch_cap * 2 : 64;
+        while (lexer->scratch_len + n > cap)
+            cap *= 2;
+        lexer->scratch = realloc_safe(lexer->scratch, cap);
+        lexer->scratch_cap = cap;
+    }
+    memcpy(lexer->scratch + lexer->scratch_len, p, n);
+    lexer->scratch_len += n;
+}
+
+// The current word differs from its input bytes from pos on: start
+// rebuilding it with the unchanged prefix.
+static void cook(lexer_t *lexer) {
+    if (lexer->cooked)
+        return;
+    lexer->cooked = 1;
+    lexer->scratch_len = 0;
+    put(lexer, lexer->input + lexer->word_start, lexer->pos - lexer->word_start);
+}
+
+// Append a quoted character; '$' and '`' get a mark so the expander
+// leaves them alone.
+static void put_literal(lexer_t *lexer, char c) {
+    static const char mark = LEXER_LITERAL_MARK;
+    if (c == '$' || c == '`')
+        put(lexer, &mark, 1);
+    put(lexer, &c, 1);
+}
+
+static const char quote_mark = LEXER_QUOTE_MARK;
+
+// Append a quote mark unless the word already ends with one.
+static void put_quote_mark(lexer_t *lexer) {
+    if (lexer->scratch_len == 0 || lexer->scratch[lexer->scratch_len - 1] != LEXER_QUOTE_MARK)
+        put(lexer, &quote_mark, 1);
+}
+
+// Character classes for unquoted text: characters that end a word, and
+// characters that need a closer look inside one.
+enum { CH_STOP = 1, CH_SPECIAL = 2 };
+static const unsigned char char_class[256] = {
+    [' '] = CH_STOP,  ['\t'] = CH_STOP, ['\n'] = CH_STOP, ['\v'] = CH_STOP,
+    ['\f'] = CH_STOP, ['\r'] = CH_STOP, ['|'] = CH_STOP,  ['<'] = CH_STOP,
+    ['>'] = CH_STOP,  ['&'] = CH_STOP,  [';'] = CH_STOP,  ['('] = CH_STOP,
+    [')'] = CH_STOP,  ['\''] = CH_SPECIAL, ['"'] = CH_SPECIAL, ['\\'] = CH_SPECIAL,
+    ['$'] = CH_SPECIAL, ['`'] = CH_SPECIAL,
+};
+
+// Scan a word starting at pos. The result is a view of the input unless a
+// quote, an escape or a mark makes it differ.
+static void read_word(lexer_t *lexer, token_view_t *token) {
     int in_single = 0, in_double = 0;
-    // Accumulate into dynamic buffer to handle quotes/escapes
-    size_t cap = 32;
-    char *buf = malloc_safe(cap);
-    size_t out = 0;
+    lexer->cooked = 0;
+    lexer->word_start = lexer->pos;
     while (lexer->pos < lexer->length) {
         char c = lexer->input[lexer->pos];
         if (!in_single && !in_double) {
-            if (isspace((unsigned char)c) || c == '|' || c == '<' || c == '>' || c == '&' || c == ';')
+            // Plain characters are taken as a run
+            size_t end = lexer->pos;
+            while (end < lexer->length && !char_class[(unsigned char)lexer->input[end]])
+                end++;
+            if (end > lexer->pos) {
+                put(lexer, lexer->input + lexer->pos, end - lexer->pos);
+                lexer->pos = end;
+                continue;
+            }
+            if (char_class[(unsigned char)c] == CH_STOP)
                 break;
-            if (c == '\'' ) { in_single = 1; lexer->pos++; continue; }
-            if (c == '"' ) { in_double = 1; lexer->pos++; continue; }
+            if (c == '\\' && lexer->pos + 1 < lexer->length && lexer->input[lexer->pos + 1] == '\n') {
+                // Line continuation inside a word
+                cook(lexer);
+                lexer->pos += 2;
+                continue;
+            }
+            if (c == '\\' && lexer->pos + 1 < lexer->length) {
+                // An escaped "$(" keeps its group in the word, all of it
+                // literal
+                cook(lexer);
+                lexer->pos++;
+                size_t n = 0;
+                if (lexer->input[lexer->pos] == '$' && lexer->pos + 1 < lexer->length &&
+                    lexer->input[lexer->pos + 1] == '(')
+                    n = group_length(lexer, lexer->pos);
+                if (n == 0)
+                    n = 1;
+                while (n-- > 0)
+                    put_literal(lexer, lexer->input[lexer->pos++]);
+                continue;
+            }
+            if (c == '\'' || c == '"') {
+                // The mark ends a $name before the quotes and keeps an
+                // empty quoted word as a field
+                cook(lexer);
+                put_quote_mark(lexer);
+                in_single = c == '\'';
+                in_double = c == '"';
+                lexer->pos++;
+                continue;
+            }
         } else if (in_single) {
             if (c == '\'') { lexer->pos++; in_single = 0; continue; }
+            put_literal(lexer, c);
+            lexer->pos++;
+            continue;
         } else if (in_double) {
             if (c == '"') { lexer->pos++; in_double = 0; continue; }
-            if (c == '\\' && lexer->pos + 1 < lexer->length) {
-                // support simple escapes inside double quotes
+            if (c == '\\' && lexer->pos + 1 < lexer->length &&
+                strchr("$`\"\\\n", lexer->input[lexer->pos + 1])) {
+                // \ escapes only $ ` " \ and newline inside double quotes;
+                // an escaped character never opens a group
                 lexer->pos++;
-                c = lexer->input[lexer->pos];
+                put_literal(lexer, lexer->input[lexer->pos++]);
+                continue;
+            }
+        }
+        if (!in_single && (c == '`' || (c == '$' && lexer->pos + 1 < lexer->length &&
+                                        (lexer->input[lexer->pos + 1] == '(' ||
+                                         lexer->input[lexer->pos + 1] == '{')))) {
+            size_t n = group_length(lexer, lexer->pos);
+            if (n > 0) {
+                if (in_double)
+                    put_quote_mark(lexer);
+                put(lexer, lexer->input + lexer->pos, n);
+                lexer->pos += n;
+                continue;
             }
         }
-        if (out + 2 > cap) { cap *= 2; buf = realloc_safe(buf, cap); }
-        buf[out++] = c;
+        if (in_double && c == '$')
+            put_quote_mark(lexer);
+        put(lexer, &c, 1);
         lexer->pos++;
     }
-    buf[out] = '\0';
-    return buf;
+    token->type = TOKEN_WORD;
+    token->offset = lexer->word_start;
+    token->length = lexer->pos - lexer->word_start;
+    if (lexer->cooked) {
+        token->text = lexer->scratch;
+        token->text_len = lexer->scratch_len;
+    } else {
+        token->text = lexer->input + lexer->word_start;
+        token->text_len = token->length;
+    }
 }
 
-token_t *lexer_next_token(lexer_t *lexer) {
+// Position of the "))" closing a "((" whose body starts at pos, or 0.
+static size_t arith_end(const lexer_t *lexer, size_t pos) {
+    int depth = 0;
+    for (size_t i = pos; i < lexer->length; ++i) {
+        char c = lexer->input[i];
+        if (c == '(') {
+            depth++;
+        } else if (c == ')') {
+            if (depth > 0)
+                depth--;
+            else
+                return i + 1 < lexer->length && lexer->input[i + 1] == ')' ? i : 0;
+        }
+    }
+    return 0;
+}
+
+// Fill in an operator token of n bytes at pos and step over it.
+static void operator(lexer_t *lexer, token_view_t *token, token_type_t type, size_t n) {
+    token->type = type;
+    token->offset = lexer->pos;
+    token->length = n;
+    token->text = lexer->input + lexer->pos;
+    token->text_len = n;
+    lexer->pos += n;
+}
+
+token_view_t lexer_next(lexer_t *lexer) {
     skip_whitespace(lexer);
 
+    token_view_t token;
     if (lexer->pos >= lexer->length) {
-        token_t *token = malloc_safe(sizeof(token_t));
-        token->type = TOKEN_EOF;
-        token->value = NULL;
+        operator(lexer, &token, TOKEN_EOF, 0);
         return token;
     }
 
-    token_t *token = malloc_safe(sizeof(token_t));
     char ch = lexer->input[lexer->pos];
-
-    // Support numeric FD prefix for redirections (e.g., 2>)
-    if (isdigit((unsigned char)ch)) {
-        size_t save = lexer->pos;
-        while (lexer->pos < lexer->length && isdigit((unsigned char)lexer->input[lexer->pos]))
-            lexer->pos++;
-        if (lexer->pos < lexer->length && (lexer->input[lexer->pos] == '>' || lexer->input[lexer->pos] == '<')) {
-            // roll back and treat as WORD; parser can interpret numeric fd before redir
-            lexer->pos = save;
-        } else {
-            lexer->pos = save;
-        }
-    }
-
+    char next = lexer->pos + 1 < lexer->length ? lexer->input[lexer->pos + 1] : '\0';
     switch (ch) {
     case '|':
-        if (lexer->pos + 1 < lexer->length && lexer->input[lexer->pos + 1] == '|') {
-            token->type = TOKEN_OR_IF;
-            token->value = strdup_safe("||");
-            lexer->pos += 2;
-        } else {
-            token->type = TOKEN_PIPE;
-            token->value = strdup_safe("|");
-            lexer->pos++;
-        }
+        if (next == '|')
+            operator(lexer, &token, TOKEN_OR_IF, 2);
+        else
+            operator(lexer, &token, TOKEN_PIPE, 1);
         break;
     case '<':
-        if (lexer->pos + 1 < lexer->length && lexer->input[lexer->pos + 1] == '<') {
-            token->type = TOKEN_HEREDOC;
-            token->value = strdup_safe("<<");
-            lexer->pos += 2;
-        } else {
-            token->type = TOKEN_REDIRECT_IN;
-            token->value = strdup_safe("<");
-            lexer->pos++;
-        }
+        if (next == '<')
+            operator(lexer, &token, TOKEN_HEREDOC, 2);
+        else
+            operator(lexer, &token, TOKEN_REDIRECT_IN, 1);
         break;
     case '>':
-        if (lexer->pos + 1 < lexer->length && lexer->input[lexer->pos + 1] == '>') {
-            token->type = TOKEN_REDIRECT_APPEND;
-            token->value = strdup_safe(">>");
-            lexer->pos += 2;
-        } else if (lexer->pos + 1 < lexer->length && lexer->input[lexer->pos + 1] == '&') {
-            token->type = TOKEN_REDIRECT_AND_OUT;
-            token->value = strdup_safe("&>");
-            lexer->pos += 2;
-        } else {
-            token->type = TOKEN_REDIRECT_OUT;
-            token->value = strdup_safe(">");
-            lexer->pos++;
-        }
+        if (next == '>')
+            operator(lexer, &token, TOKEN_REDIRECT_APPEND, 2);
+        else if (next == '&')
+            operator(lexer, &token, TOKEN_REDIRECT_AND_OUT, 2);
+        else
+            operator(lexer, &token, TOKEN_REDIRECT_OUT, 1);
         break;
     case '&':
-        if (lexer->pos + 1 < lexer->length && lexer->input[lexer->pos + 1] == '&') {
-            token->type = TOKEN_AND_IF;
-            token->value = strdup_safe("&&");
-            lexer->pos += 2;
-        } else {
-            token->type = TOKEN_BACKGROUND;
-            token->value = strdup_safe("&");
-            lexer->pos++;
-        }
+        if (next == '&')
+            operator(lexer, &token, TOKEN_AND_IF, 2);
+        else
+            operator(lexer, &token, TOKEN_BACKGROUND, 1);
         break;
     case ';':
-        token->type = TOKEN_SEMICOLON;
-        token->value = strdup_safe(";");
-        lexer->pos++;
+        if (next == ';')
+            operator(lexer, &token, TOKEN_DSEMI, 2);
+        else
+            operator(lexer, &token, TOKEN_SEMICOLON, 1);
+        break;
+    case '\n':
+        operator(lexer, &token, TOKEN_NEWLINE, 1);
         break;
     case '(':
-        token->type = TOKEN_LPAREN;
-        token->value = strdup_safe("(");
-        lexer->pos++;
+        if (next == '(') {
+            size_t end = arith_end(lexer, lexer->pos + 2);
+            if (end) {
+                // The value is the expression between (( and ))
+                token.type = TOKEN_ARITH;
+                token.offset = lexer->pos;
+                token.length = end + 2 - lexer->pos;
+                token.text = lexer->input + lexer->pos + 2;
+                token.text_len = end - lexer->pos - 2;
+                lexer->pos = end + 2;
+                break;
+            }
+        }
+        operator(lexer, &token, TOKEN_LPAREN, 1);
         break;
     case ')':
-        token->type = TOKEN_RPAREN;
-        token->value = strdup_safe(")");
-        lexer->pos++;
+        operator(lexer, &token, TOKEN_RPAREN, 1);
         break;
     default:
-        token->type = TOKEN_WORD;
-        token->value = read_word(lexer);
+        // A numeric fd prefix (2>) stays a word; the parser interprets it
+        read_word(lexer, &token);
         break;
     }
+    return token;
+}
 
+token_t *lexer_next_token(lexer_t *lexer) {
+    token_view_t view = lexer_next(lexer);
+    token_t *token = malloc_safe(sizeof(token_t));
+    token->type = view.type;
+    token->value = NULL;
+    if (view.type != TOKEN_EOF) {
+        token->value = malloc_safe(view.text_len + 1);
+        memcpy(token->value, view.text, view.text_len);
+        token->value[view.text_len] = '\0';
+    }
     return token;
 }
 
 void lexer_free(lexer_t *lexer) {
     if (lexer) {
+        free(lexer->scratch);
         free(lexer);
     }
 }
@@ -3,30 +3,83 @@
  * @brief Minimal async logger implementation.
  */
 #include "logger.h"
+#include <errno.h>
+#include <fcntl.h>
 #include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <signal.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 #include <time.h>
+#include <unistd.h>
 
-#define LOG_QUEUE_CAP 1024
 #define LOG_MSG_MAX 1024
+#define LOG_PATH_MAX 256
+
+/*
+ * Multi-producer/single-consumer byte ring of variable-length records.
+ *
+ * Producers reserve space by advancing ring_head with a CAS, copy their
+ * record in and publish it by storing its size into the header (release).
+ * The consumer reads records in order from ring_tail, stops at the first
+ * unpublished one, zeroes what it consumed (so stale bytes never look
+ * like a published header) and then advances ring_tail. A record that
+ * would straddle the end of the buffer is preceded by a padding record
+ * that fills the remainder. When the ring is full the new record is
+ * dropped and counted; producers never block or take a lock.
+ */
+#define RING_SIZE (1u << 18)
+#define RING_MASK (RING_SIZE - 1)
+#define RECORD_ALIGN 16u
+#define RECORD_PAD 1u
+#define RECORD_BINARY 2u // payload: path and format pointers, then encoded arguments
 
 typedef struct {
-    log_level_t level;
-    char path[FILENAME_MAX]; // Path to the source file
-    char msg[LOG_MSG_MAX];
-} log_item_t;
+    _Atomic uint32_t size; // whole record incl. header; 0 until published
+    uint8_t level;
+    uint8_t flags;
+    uint16_t path_len;
+    uint32_t msg_len;
+    uint32_t reserved;
+    // followed by path and message bytes (not NUL-terminated)
+} log_record_t;
+
+_Static_assert(sizeof(log_record_t) == RECORD_ALIGN, "record header must stay 16 bytes");
+
+// Allocated when the consumer first starts and kept for the life of the
+// process, since a producer may still be writing into it during shutdown.
+static unsigned char *ring;
+static _Atomic uint64_t ring_head; // next byte to reserve
+static _Atomic uint64_t ring_tail; // next byte to consume
+static _Atomic unsigned long dropped;
+
+// The consumer sets consumer_idle before sleeping on wake_sem; the first
+// producer to publish afterwards clears it and posts once.
+static sem_t wake_sem;
+static _Atomic int consumer_idle;
 
 static pthread_t log_thread;
-static pthread_mutex_t log_mu = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t log_cv = PTHREAD_COND_INITIALIZER;
-static log_item_t queue[LOG_QUEUE_CAP];
-static size_t q_head = 0, q_size = 0;
-static int running = 0;
+static pthread_mutex_t log_mu = PTHREAD_MUTEX_INITIALIZER; // init/shutdown only
+static _Atomic int running = 0;     // consumer thread alive
+static _Atomic int initialized = 0; // between logger_init() and logger_shutdown()
 static log_level_t current_level = LOG_LEVEL_OFF;
 static int logger_enabled = 1;
+log_level_t logger_threshold = LOG_LEVEL_OFF;
+
+// Keep the threshold read by the LOG_* macros in step with the level and
+// the MYSHELL_DISABLE_LOGGER switch.
+static void update_threshold(void) {
+    logger_threshold = logger_enabled ? current_level : LOG_LEVEL_OFF;
+}
 
 static const char *lvl_name(log_level_t lvl) {
     switch (lvl) {
@@ -45,36 +98,663 @@ static const char *lvl_name(log_level_t lvl) {
     }
 }
 
-static void *log_consumer(void *arg) {
-    (void)arg;
+static log_record_t *record_at(uint64_t pos) {
+    return (log_record_t *)(ring + (pos & RING_MASK));
+}
+
+/*
+ * Deferred ("binary") formatting.
+ *
+ * The producer walks the format string only to learn the argument types,
+ * and copies the raw values (strings by content) into the record; the
+ * consumer walks it again and formats one conversion at a time. Formats
+ * using %n, %m, positional arguments or wide strings are formatted
+ * eagerly instead.
+ */
+typedef enum {
+    ARG_NONE, // %%
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_INTMAX,
+    ARG_SSIZE,
+    ARG_PTRDIFF,
+    ARG_UINT,
+    ARG_ULONG,
+    ARG_ULLONG,
+    ARG_UINTMAX,
+    ARG_SIZE,
+    ARG_DOUBLE,
+    ARG_LDOUBLE,
+    ARG_STR,
+    ARG_PTR,
+    ARG_UNSUPPORTED,
+} log_arg_t;
+
+typedef struct {
+    log_arg_t type;
+    int star_width; // width given as an int argument
+    int star_prec;  // precision given as an int argument
+} log_spec_t;
+
+#define SPEC_MAX 32 // longest conversion spec handled by the consumer
+// Encoded arguments may exceed the formatted message a little, so a long
+// string still fills the whole LOG_MSG_MAX message.
+#define LOG_ARGS_MAX (LOG_MSG_MAX + 64)
+#define STR_NULL UINT32_MAX
+
+// Parse the conversion starting at p (just past '%'); returns the
+// character after it.
+static const char *parse_spec(const char *p, log_spec_t *spec) {
+    spec->star_width = spec->star_prec = 0;
+    if (*p == '%') {
+        spec->type = ARG_NONE;
+        return p + 1;
+    }
+    while (*p && strchr("-+ #0'", *p))
+        p++;
+    if (*p == '*') {
+        spec->star_width = 1;
+        p++;
+    }
+    while (*p >= '0' && *p <= '9')
+        p++;
+    if (*p == '$') {
+        spec->type = ARG_UNSUPPORTED;
+        return p;
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->star_prec = 1;
+            p++;
+        }
+        while (*p >= '0' && *p <= '9')
+            p++;
+    }
+    // Length modifier: 0 none, 1 l, 2 ll, 'j', 'z', 't', 'L'
+    int len = 0;
     for (;;) {
-        pthread_mutex_lock(&log_mu);
-        while (running && q_size == 0)
-            pthread_cond_wait(&log_cv, &log_mu);
+        if (*p == 'h') {
+            p++;
+        } else if (*p == 'l') {
+            len++;
+            p++;
+        } else if (*p == 'q') {
+            len = 2;
+            p++;
+        } else if (*p == 'j' || *p == 'z' || *p == 't' || *p == 'L') {
+            len = *p++;
+        } else {
+            break;
+        }
+    }
+    switch (*p) {
+    case 'd':
+    case 'i':
+        spec->type = len == 1     ? ARG_LONG
+                     : len == 2   ? ARG_LLONG
+                     : len == 'j' ? ARG_INTMAX
+                     : len == 'z' ? ARG_SSIZE
+                     : len == 't' ? ARG_PTRDIFF
+                                  : ARG_INT;
+        break;
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+        spec->type = len == 1     ? ARG_ULONG
+                     : len == 2   ? ARG_ULLONG
+                     : len == 'j' ? ARG_UINTMAX
+                     : len == 'z' ? ARG_SIZE
+                     : len == 't' ? ARG_PTRDIFF
+                                  : ARG_UINT;
+        break;
+    case 'c':
+        spec->type = len ? ARG_UNSUPPORTED : ARG_INT;
+        break;
+    case 's':
+        spec->type = len ? ARG_UNSUPPORTED : ARG_STR;
+        break;
+    case 'p':
+        spec->type = ARG_PTR;
+        break;
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        spec->type = len == 'L' ? ARG_LDOUBLE : ARG_DOUBLE;
+        break;
+    default:
+        spec->type = ARG_UNSUPPORTED;
+        return *p ? p + 1 : p;
+    }
+    return p + 1;
+}
+
+#define ARG_SLOT 8u
+#define SLOT_ALIGN(n) (((n) + ARG_SLOT - 1) & ~(size_t)(ARG_SLOT - 1))
+
+// Append n bytes at *off (slot aligned). Returns 0 if they do not fit.
+static int put_arg(unsigned char *blob, size_t cap, size_t *off, const void *v, size_t n) {
+    if (*off + SLOT_ALIGN(n) > cap)
+        return 0;
+    memcpy(blob + *off, v, n);
+    *off += SLOT_ALIGN(n);
+    return 1;
+}
+
+static int put_u64(unsigned char *blob, size_t cap, size_t *off, uint64_t v) {
+    return put_arg(blob, cap, off, &v, sizeof v);
+}
 
-        if (!running && q_size == 0) {
-            pthread_mutex_unlock(&log_mu);
+/*
+ * Copy the arguments described by fmt from ap into blob. Returns the
+ * number of bytes used, or -1 if the format needs eager formatting.
+ * Strings that do not fit are truncated like an over-long text message.
+ */
+static long encode_args(const char *fmt, va_list ap, unsigned char *blob, size_t cap) {
+    size_t off = 0;
+    for (const char *p = fmt; (p = strchr(p, '%')) != NULL;) {
+        log_spec_t spec;
+        p = parse_spec(p + 1, &spec);
+        if (spec.type == ARG_UNSUPPORTED)
+            return -1;
+        if (spec.star_width && !put_u64(blob, cap, &off, (uint64_t)(int64_t)va_arg(ap, int)))
+            return -1;
+        if (spec.star_prec && !put_u64(blob, cap, &off, (uint64_t)(int64_t)va_arg(ap, int)))
+            return -1;
+        int ok = 1;
+        switch (spec.type) {
+        case ARG_NONE:
+            break;
+        case ARG_INT:
+            ok = put_u64(blob, cap, &off, (uint64_t)(int64_t)va_arg(ap, int));
+            break;
+        case ARG_LONG:
+            ok = put_u64(blob, cap, &off, (uint64_t)(int64_t)va_arg(ap, long));
+            break;
+        case ARG_LLONG:
+            ok = put_u64(blob, cap, &off, (uint64_t)va_arg(ap, long long));
+            break;
+        case ARG_INTMAX:
+            ok = put_u64(blob, cap, &off, (uint64_t)va_arg(ap, intmax_t));
+            break;
+        case ARG_SSIZE:
+            ok = put_u64(blob, cap, &off, (uint64_t)va_arg(ap, ssize_t));
+            break;
+        case ARG_PTRDIFF:
+            ok = put_u64(blob, cap, &off, (uint64_t)va_arg(ap, ptrdiff_t));
+            break;
+        case ARG_UINT:
+            ok = put_u64(blob, cap, &off, va_arg(ap, unsigned int));
+            break;
+        case ARG_ULONG:
+            ok = put_u64(blob, cap, &off, va_arg(ap, unsigned long));
+            break;
+        case ARG_ULLONG:
+            ok = put_u64(blob, cap, &off, va_arg(ap, unsigned long long));
+            break;
+        case ARG_UINTMAX:
+            ok = put_u64(blob, cap, &off, va_arg(ap, uintmax_t));
+            break;
+        case ARG_SIZE:
+            ok = put_u64(blob, cap, &off, va_arg(ap, size_t));
+            break;
+        case ARG_DOUBLE: {
+            double d = va_arg(ap, double);
+            ok = put_arg(blob, cap, &off, &d, sizeof d);
             break;
         }
-        log_item_t item = queue[q_head];
-        q_head = (q_head + 1) % LOG_QUEUE_CAP;
-        q_size--;
-        pthread_mutex_unlock(&log_mu);
+        case ARG_LDOUBLE: {
+            long double d = va_arg(ap, long double);
+            ok = put_arg(blob, cap, &off, &d, sizeof d);
+            break;
+        }
+        case ARG_PTR: {
+            void *ptr = va_arg(ap, void *);
+            ok = put_arg(blob, cap, &off, &ptr, sizeof ptr);
+            break;
+        }
+        case ARG_STR: {
+            const char *str = va_arg(ap, const char *);
+            uint32_t len = STR_NULL;
+            if (str) {
+                size_t room = cap > off + ARG_SLOT ? cap - off - ARG_SLOT : 0;
+                len = (uint32_t)strnlen(str, room);
+            }
+            ok = put_arg(blob, cap, &off, &len, sizeof len);
+            if (ok && str) {
+                memcpy(blob + off, str, len);
+                off += SLOT_ALIGN(len);
+            }
+            break;
+        }
+        case ARG_UNSUPPORTED:
+            return -1;
+        }
+        if (!ok)
+            return -1;
+    }
+    return (long)off;
+}
+
+static uint64_t get_u64(const unsigned char *blob, size_t *off) {
+    uint64_t v;
+    memcpy(&v, blob + *off, sizeof v);
+    *off += ARG_SLOT;
+    return v;
+}
+
+// snprintf one conversion, passing the '*' width/precision if present.
+#define EMIT(value)                                                                                \
+    (spec.star_width && spec.star_prec ? snprintf(dst, room, conv, w, pr, value)                  \
+     : spec.star_width                 ? snprintf(dst, room, conv, w, value)                      \
+     : spec.star_prec                  ? snprintf(dst, room, conv, pr, value)                     \
+                                       : snprintf(dst, room, conv, value))
+
+// Format fmt with the arguments encoded by encode_args(). Returns the
+// message length (truncated to cap - 1).
+static size_t format_args(const char *fmt, const unsigned char *blob, char *out, size_t cap) {
+    size_t len = 0;
+    size_t off = 0;
+    const char *p = fmt;
+    while (*p && len + 1 < cap) {
+        const char *pct = strchr(p, '%');
+        size_t lit = pct ? (size_t)(pct - p) : strlen(p);
+        if (lit > cap - 1 - len)
+            lit = cap - 1 - len;
+        memcpy(out + len, p, lit);
+        len += lit;
+        if (!pct || len + 1 >= cap)
+            break;
+
+        log_spec_t spec;
+        const char *end = parse_spec(pct + 1, &spec);
+        p = end;
+        if (spec.type == ARG_NONE) {
+            out[len++] = '%';
+            continue;
+        }
+        char conv[SPEC_MAX];
+        size_t conv_len = (size_t)(end - pct);
+        if (conv_len >= sizeof conv)
+            break; // cannot happen for formats encode_args() accepted
+        memcpy(conv, pct, conv_len);
+        conv[conv_len] = '\0';
+
+        int w = spec.star_width ? (int)(int64_t)get_u64(blob, &off) : 0;
+        int pr = spec.star_prec ? (int)(int64_t)get_u64(blob, &off) : 0;
+        char *dst = out + len;
+        size_t room = cap - len;
+        int n = 0;
+        switch (spec.type) {
+        case ARG_INT:
+            n = EMIT((int)(int64_t)get_u64(blob, &off));
+            break;
+        case ARG_LONG:
+            n = EMIT((long)(int64_t)get_u64(blob, &off));
+            break;
+        case ARG_LLONG:
+            n = EMIT((long long)get_u64(blob, &off));
+            break;
+        case ARG_INTMAX:
+            n = EMIT((intmax_t)get_u64(blob, &off));
+            break;
+        case ARG_SSIZE:
+            n = EMIT((ssize_t)get_u64(blob, &off));
+            break;
+        case ARG_PTRDIFF:
+            n = EMIT((ptrdiff_t)get_u64(blob, &off));
+            break;
+        case ARG_UINT:
+            n = EMIT((unsigned int)get_u64(blob, &off));
+            break;
+        case ARG_ULONG:
+            n = EMIT((unsigned long)get_u64(blob, &off));
+            break;
+        case ARG_ULLONG:
+            n = EMIT((unsigned long long)get_u64(blob, &off));
+            break;
+        case ARG_UINTMAX:
+            n = EMIT((uintmax_t)get_u64(blob, &off));
+            break;
+        case ARG_SIZE:
+            n = EMIT((size_t)get_u64(blob, &off));
+            break;
+        case ARG_DOUBLE: {
+            double d;
+            memcpy(&d, blob + off, sizeof d);
+            off += SLOT_ALIGN(sizeof d);
+            n = EMIT(d);
+            break;
+        }
+        case ARG_LDOUBLE: {
+            long double d;
+            memcpy(&d, blob + off, sizeof d);
+            off += SLOT_ALIGN(sizeof d);
+            n = EMIT(d);
+            break;
+        }
+        case ARG_PTR: {
+            void *ptr;
+            memcpy(&ptr, blob + off, sizeof ptr);
+            off += SLOT_ALIGN(sizeof ptr);
+            n = EMIT(ptr);
+            break;
+        }
+        case ARG_STR: {
+            uint32_t slen;
+            memcpy(&slen, blob + off, sizeof slen);
+            off += ARG_SLOT;
+            if (slen == STR_NULL) {
+                n = EMIT("(null)");
+                break;
+            }
+            // The copy is not NUL-terminated: bound it with a precision.
+            char sconv[SPEC_MAX + 8];
+            const char *dot = memchr(conv, '.', conv_len);
+            int prec = (int)slen;
+            if (dot && !spec.star_prec && atoi(dot + 1) < prec)
+                prec = atoi(dot + 1);
+            else if (dot && spec.star_prec && pr >= 0 && pr < prec)
+                prec = pr;
+            size_t head = dot ? (size_t)(dot - conv) : conv_len - 1;
+            memcpy(sconv, conv, head);
+            snprintf(sconv + head, sizeof sconv - head, ".*s");
+            const char *str = (const char *)blob + off;
+            off += SLOT_ALIGN(slen);
+            n = spec.star_width ? snprintf(dst, room, sconv, w, prec, str)
+                                : snprintf(dst, room, sconv, prec, str);
+            break;
+        }
+        default:
+            break;
+        }
+        if (n > 0)
+            len += (size_t)n < room ? (size_t)n : room - 1;
+    }
+    out[len] = '\0';
+    return len;
+}
+
+/*
+ * Output sink: stderr, or the file named by MYSHELL_LOG_FILE. A file is
+ * rotated (name -> name.1 -> ... -> name.LOG_ROTATE_KEEP) before a batch
+ * would grow it past max_size (MYSHELL_LOG_MAX_SIZE, 0 = never).
+ */
+#define LOG_ROTATE_KEEP 3
+#define LOG_DEFAULT_MAX_SIZE (8u << 20)
+#define BATCH_SIZE (64u << 10)
+#define LINE_MAX_LEN (64 + LOG_PATH_MAX + LOG_MSG_MAX) // timestamp, level, path, msg
+
+typedef struct {
+    int fd;
+    char *path; // NULL for stderr
+    uint64_t size;
+    uint64_t max_size;
+} log_sink_t;
+
+static log_sink_t sink = {STDERR_FILENO, NULL, 0, 0};
+
+// Consumer-only batch state
+static char batch[BATCH_SIZE];
+static size_t batch_len;
+static time_t stamp_sec = -1;
+static char stamp[sizeof "HH:MM:SS"];
+
+// Flush barrier: ring_flushed is the ring position up to which every
+// record has been written to the sink.
+static _Atomic uint64_t ring_flushed;
+static _Atomic int flush_waiters;
+static pthread_mutex_t flush_mu = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flush_cv = PTHREAD_COND_INITIALIZER;
+
+static uint64_t parse_size(const char *s) {
+    char *end;
+    unsigned long long v = strtoull(s, &end, 10);
+    if (*end == 'k' || *end == 'K')
+        v <<= 10;
+    else if (*end == 'm' || *end == 'M')
+        v <<= 20;
+    else if (*end == 'g' || *end == 'G')
+        v <<= 30;
+    return (uint64_t)v;
+}
 
-        // Timestamp and print to stderr
-        struct timespec ts;
-        clock_gettime(CLOCK_REALTIME, &ts);
+static int sink_open_file(int flags) {
+    int fd = open(sink.path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC | flags, 0644);
+    if (fd == -1) {
+        perror(sink.path);
+        return -1;
+    }
+    struct stat st;
+    sink.size = fstat(fd, &st) == 0 ? (uint64_t)st.st_size : 0;
+    sink.fd = fd;
+    return 0;
+}
+
+// Read the sink settings; the file itself is opened when the consumer
+// starts.
+static void sink_configure(void) {
+    const char *file = getenv("MYSHELL_LOG_FILE");
+    sink.fd = STDERR_FILENO;
+    if (!file || !*file)
+        return;
+    const char *max = getenv("MYSHELL_LOG_MAX_SIZE");
+    sink.max_size = max && *max ? parse_size(max) : LOG_DEFAULT_MAX_SIZE;
+    sink.path = strdup(file);
+}
+
+static void sink_open(void) {
+    if (sink.path && sink_open_file(0) != 0) {
+        free(sink.path);
+        sink.path = NULL;
+        sink.fd = STDERR_FILENO;
+    }
+}
+
+static void sink_close(void) {
+    if (sink.path) {
+        if (sink.fd != STDERR_FILENO)
+            close(sink.fd);
+        free(sink.path);
+        sink.path = NULL;
+    }
+    sink.fd = STDERR_FILENO;
+}
+
+static void sink_rotate(void) {
+    size_t n = strlen(sink.path) + 8;
+    char *from = malloc(n), *to = malloc(n);
+    if (!from || !to) {
+        free(from);
+        free(to);
+        return;
+    }
+    close(sink.fd);
+    for (int i = LOG_ROTATE_KEEP; i > 1; --i) {
+        snprintf(from, n, "%s.%d", sink.path, i - 1);
+        snprintf(to, n, "%s.%d", sink.path, i);
+        rename(from, to);
+    }
+    snprintf(to, n, "%s.1", sink.path);
+    rename(sink.path, to);
+    free(from);
+    free(to);
+    if (sink_open_file(O_TRUNC) != 0)
+        sink.fd = STDERR_FILENO; // keep logging somewhere
+}
+
+static void write_all(struct iovec *iov, int cnt) {
+    while (cnt > 0) {
+        ssize_t n = writev(sink.fd, iov, cnt);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return; // nowhere to report it
+        }
+        while (cnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            cnt--;
+        }
+        if (cnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+}
+
+// Write the batch (plus a note about dropped records) with one writev.
+static void batch_flush(void) {
+    static unsigned long reported;
+    char note[64];
+    struct iovec iov[2];
+    int cnt = 0;
+    if (batch_len) {
+        iov[cnt].iov_base = batch;
+        iov[cnt++].iov_len = batch_len;
+    }
+    unsigned long total = atomic_load_explicit(&dropped, memory_order_relaxed);
+    if (total != reported) {
+        int n = snprintf(note, sizeof note, "[logger] dropped %lu messages (ring full)\n",
+                         total - reported);
+        iov[cnt].iov_base = note;
+        iov[cnt++].iov_len = (size_t)n;
+        reported = total;
+    }
+    if (!cnt)
+        return;
+    size_t bytes = 0;
+    for (int i = 0; i < cnt; ++i)
+        bytes += iov[i].iov_len;
+    if (sink.path && sink.max_size && sink.size > 0 && sink.size + bytes > sink.max_size)
+        sink_rotate();
+    write_all(iov, cnt);
+    sink.size += bytes;
+    batch_len = 0;
+}
+
+static char *put_str(char *p, const char *s, size_t n) {
+    memcpy(p, s, n);
+    return p + n;
+}
+
+// Append one formatted line to the batch; the caller guarantees room
+// for LINE_MAX_LEN bytes.
+static void format_record(const log_record_t *rec) {
+    const char *path = (const char *)(rec + 1);
+    size_t path_len = rec->path_len;
+    const char *fmt = NULL;
+    const unsigned char *blob = NULL;
+    if (rec->flags & RECORD_BINARY) {
+        const char *ptrs[2]; // path, format (both static strings)
+        memcpy(ptrs, rec + 1, sizeof ptrs);
+        path = ptrs[0] ? ptrs[0] : "";
+        path_len = strnlen(path, LOG_PATH_MAX);
+        fmt = ptrs[1];
+        blob = (const unsigned char *)(rec + 1) + sizeof ptrs;
+    }
+
+    // Timestamp: HH:MM:SS is re-rendered only when the second changes.
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    if (ts.tv_sec != stamp_sec) {
         struct tm tm;
         localtime_r(&ts.tv_sec, &tm);
-        char tbuf[32];
-        strftime(tbuf, sizeof tbuf, "%H:%M:%S", &tm);
-        fprintf(stderr,
-                "%s.%06ld [%s] %s: %s\n",
-                tbuf,
-                ts.tv_nsec / 1000,
-                lvl_name(item.level),
-                item.path,
-                item.msg);
+        strftime(stamp, sizeof stamp, "%H:%M:%S", &tm);
+        stamp_sec = ts.tv_sec;
+    }
+    char *p = batch + batch_len;
+    p = put_str(p, stamp, sizeof stamp - 1);
+    *p++ = '.';
+    long usec = ts.tv_nsec / 1000;
+    for (int i = 5; i >= 0; --i, usec /= 10)
+        p[i] = (char)('0' + usec % 10);
+    p += 6;
+    p = put_str(p, " [", 2);
+    const char *lvl = lvl_name((log_level_t)rec->level);
+    p = put_str(p, lvl, strlen(lvl));
+    p = put_str(p, "] ", 2);
+    p = put_str(p, path, path_len);
+    p = put_str(p, ": ", 2);
+    if (fmt)
+        p += format_args(fmt, blob, p, LOG_MSG_MAX);
+    else
+        p = put_str(p, (const char *)(rec + 1) + rec->path_len, rec->msg_len);
+    *p++ = '\n';
+    batch_len = (size_t)(p - batch);
+}
+
+static void publish_flushed(uint64_t pos) {
+    atomic_store(&ring_flushed, pos);
+    if (atomic_load(&flush_waiters)) {
+        pthread_mutex_lock(&flush_mu);
+        pthread_cond_broadcast(&flush_cv);
+        pthread_mutex_unlock(&flush_mu);
+    }
+}
+
+// Consume every published record into the batch, writing it out when it
+// fills up and once at the end. Returns the number of records consumed.
+static int drain(void) {
+    int n = 0;
+    uint64_t tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    for (;;) {
+        log_record_t *rec = record_at(tail);
+        uint32_t size = atomic_load_explicit(&rec->size, memory_order_acquire);
+        if (size == 0)
+            break;
+        if (!(rec->flags & RECORD_PAD)) {
+            if (batch_len + LINE_MAX_LEN > sizeof batch) {
+                batch_flush();
+                publish_flushed(tail);
+            }
+            format_record(rec);
+            n++;
+        }
+        memset(rec, 0, size);
+        tail += size;
+        atomic_store_explicit(&ring_tail, tail, memory_order_release);
+    }
+    batch_flush();
+    publish_flushed(tail);
+    return n;
+}
+
+static int ring_empty(void) {
+    uint64_t tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    return atomic_load_explicit(&record_at(tail)->size, memory_order_acquire) == 0;
+}
+
+static void *log_consumer(void *arg) {
+    (void)arg;
+    for (;;) {
+        drain();
+        if (!atomic_load(&running)) {
+            // Wait out producers that reserved space before shutdown
+            // but have not published yet.
+            while (atomic_load(&ring_tail) != atomic_load(&ring_head)) {
+                if (!drain())
+                    sched_yield();
+            }
+            break;
+        }
+        atomic_store(&consumer_idle, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        // Re-check after announcing idleness so a record published in
+        // between is not left waiting for the next one.
+        if (!ring_empty() || !atomic_load(&running)) {
+            atomic_store(&consumer_idle, 0);
+            continue;
+        }
+        while (sem_wait(&wake_sem) != 0)
+            ;
     }
     return NULL;
 }
@@ -83,70 +763,180 @@ int logger_init(void) {
     const char *q = getenv("MYSHELL_DISABLE_LOGGER");
     if (q && q[0] == '1') {
         logger_enabled = 0;
+        update_threshold();
         return 0;
     }
+    logger_enabled = 1;
+    update_threshold();
     pthread_mutex_lock(&log_mu);
-    if (running) {
-        pthread_mutex_unlock(&log_mu);
-        return 0;
+    if (!atomic_load(&initialized)) {
+        sink_configure();
+        atomic_store(&initialized, 1);
     }
-    running = 1;
     pthread_mutex_unlock(&log_mu);
-    if (pthread_create(&log_thread, NULL, log_consumer, NULL) != 0) {
-        pthread_mutex_lock(&log_mu);
-        running = 0;
-        pthread_mutex_unlock(&log_mu);
-        return -1;
-    }
     return 0;
 }
 
+/*
+ * Start the consumer for the first record after logger_init(), so a shell
+ * that never logs never pays for the thread or the ring. Called by
+ * producers on their slow path. Returns 0 if the consumer is running.
+ */
+static int logger_start(void) {
+    pthread_mutex_lock(&log_mu);
+    int rc = 0;
+    if (atomic_load(&running))
+        goto out;
+    rc = -1;
+    if (!atomic_load(&initialized))
+        goto out;
+    static int sem_ready = 0;
+    if (!sem_ready) {
+        if (sem_init(&wake_sem, 0, 0) != 0)
+            goto out;
+        sem_ready = 1;
+    }
+    if (!ring) {
+        ring = aligned_alloc(RECORD_ALIGN, RING_SIZE);
+        if (!ring)
+            goto out;
+        memset(ring, 0, RING_SIZE);
+    }
+    sink_open();
+    atomic_store(&consumer_idle, 0);
+    // The consumer starts with every signal blocked so process-directed
+    // signals (SIGINT, SIGCHLD read through a signalfd) reach the shell
+    // thread only, whichever thread logs first.
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    atomic_store(&running, 1); // before the consumer checks it
+    if (pthread_create(&log_thread, NULL, log_consumer, NULL) == 0)
+        rc = 0;
+    else
+        atomic_store(&running, 0);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+out:
+    pthread_mutex_unlock(&log_mu);
+    return rc;
+}
+
+int logger_flush(void) {
+    if (!atomic_load(&running))
+        return atomic_load(&initialized) ? 0 : -1; // nothing was logged yet
+    uint64_t target = atomic_load(&ring_head);
+    pthread_mutex_lock(&flush_mu);
+    atomic_fetch_add(&flush_waiters, 1);
+    while (atomic_load(&ring_flushed) < target && atomic_load(&running))
+        pthread_cond_wait(&flush_cv, &flush_mu);
+    atomic_fetch_sub(&flush_waiters, 1);
+    int rc = atomic_load(&ring_flushed) >= target ? 0 : -1;
+    pthread_mutex_unlock(&flush_mu);
+    return rc;
+}
+
 void logger_shutdown(void) {
     if (!logger_enabled)
         return;
     pthread_mutex_lock(&log_mu);
-    if (!running) {
+    if (!atomic_load(&initialized)) {
         pthread_mutex_unlock(&log_mu);
         return;
     }
-    running = 0;
-    pthread_cond_broadcast(&log_cv);
+    atomic_store(&initialized, 0);
+    if (atomic_load(&running)) {
+        // Everything logged before this point reaches the sink; the
+        // consumer then also waits for records still being written by
+        // other threads.
+        logger_flush();
+        atomic_store(&running, 0);
+        sem_post(&wake_sem);
+        pthread_join(log_thread, NULL);
+        pthread_mutex_lock(&flush_mu);
+        pthread_cond_broadcast(&flush_cv);
+        pthread_mutex_unlock(&flush_mu);
+    }
+    sink_close();
     pthread_mutex_unlock(&log_mu);
-    pthread_join(log_thread, NULL);
 }
 
 void logger_set_level(log_level_t level) {
     current_level = level;
+    update_threshold();
 }
 
 log_level_t logger_get_level(void) {
     return current_level;
 }
 
-static void enqueue(log_level_t level, const char *path, const char *buf) {
-    pthread_mutex_lock(&log_mu);
-    if (q_size == LOG_QUEUE_CAP) {
-        // Drop oldest (bounded queue)
-        q_head = (q_head + 1) % LOG_QUEUE_CAP;
-        q_size--;
-    }
-    size_t idx = (q_head + q_size) % LOG_QUEUE_CAP;
-    queue[idx].level = level;
-    if (path) {
-        strncpy(queue[idx].path, path, FILENAME_MAX - 1);
-        queue[idx].path[FILENAME_MAX - 1] = '\0';
-    } else {
-        queue[idx].path[0] = '\0'; // No path
+unsigned long logger_dropped(void) {
+    return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
+
+// Reserve need bytes (plus padding up to the end of the buffer if the
+// record would wrap). Returns the record position, or UINT64_MAX if full.
+static uint64_t ring_reserve(uint32_t need) {
+    uint64_t head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    uint32_t pad;
+    do {
+        uint32_t off = (uint32_t)(head & RING_MASK);
+        pad = off + need > RING_SIZE ? RING_SIZE - off : 0;
+        // Acquire pairs with the consumer's release of ring_tail, so the
+        // zeroing of the reclaimed bytes is visible before we reuse them.
+        uint64_t tail = atomic_load_explicit(&ring_tail, memory_order_acquire);
+        if (head + pad + need - tail > RING_SIZE)
+            return UINT64_MAX;
+    } while (!atomic_compare_exchange_weak_explicit(&ring_head, &head, head + pad + need,
+                                                    memory_order_relaxed,
+                                                    memory_order_relaxed));
+    if (pad) {
+        log_record_t *filler = record_at(head);
+        filler->flags = RECORD_PAD;
+        atomic_store_explicit(&filler->size, pad, memory_order_release);
     }
-    if (buf) {
-        strncpy(queue[idx].msg, buf, LOG_MSG_MAX - 1);
-    } else {
-        queue[idx].msg[0] = '\0'; // No message
+    return head + pad;
+}
+
+// Publish a record whose payload is head followed by body.
+static void enqueue(log_level_t level, uint8_t flags, const void *head, size_t head_len,
+                    const void *body, size_t body_len) {
+    // Acquire pairs with logger_start(): a running consumer implies the
+    // ring is allocated.
+    if (!atomic_load_explicit(&running, memory_order_acquire) && logger_start() != 0)
+        return; // not initialized (before logger_init() or after shutdown)
+    uint32_t need = (uint32_t)(sizeof(log_record_t) + head_len + body_len + RECORD_ALIGN - 1) &
+                    ~(RECORD_ALIGN - 1);
+    uint64_t pos = ring_reserve(need);
+    if (pos == UINT64_MAX) {
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        return;
     }
-    queue[idx].msg[LOG_MSG_MAX - 1] = '\0';
-    q_size++;
-    pthread_cond_signal(&log_cv);
-    pthread_mutex_unlock(&log_mu);
+
+    log_record_t *rec = record_at(pos);
+    rec->level = (uint8_t)level;
+    rec->flags = flags;
+    rec->path_len = (uint16_t)((flags & RECORD_BINARY) ? 0 : head_len);
+    rec->msg_len = (uint32_t)body_len;
+    if (head_len)
+        memcpy(rec + 1, head, head_len);
+    memcpy((char *)(rec + 1) + head_len, body, body_len);
+    atomic_store_explicit(&rec->size, need, memory_order_release);
+
+    // Pairs with the fence in log_consumer(): either the consumer sees
+    // this record when it re-checks, or we see it idle and wake it.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&consumer_idle, memory_order_relaxed) &&
+        atomic_exchange(&consumer_idle, 0))
+        sem_post(&wake_sem);
+}
+
+static void enqueue_text(log_level_t level, const char *path, const char *fmt, va_list ap) {
+    char buf[LOG_MSG_MAX];
+    int n = vsnprintf(buf, sizeof buf, fmt, ap);
+    if (n < 0)
+        return;
+    size_t path_len = path ? strnlen(path, LOG_PATH_MAX) : 0;
+    enqueue(level, 0, path, path_len, buf, (size_t)n < sizeof buf ? (size_t)n : sizeof buf - 1);
 }
 
 void logger_vlog(log_level_t level, const char *path, const char *fmt, va_list ap) {
@@ -154,9 +944,7 @@ void logger_vlog(log_level_t level, const char *path, const char *fmt, va_list a
         return;
     if (level > current_level || level == LOG_LEVEL_OFF)
         return;
-    char buf[LOG_MSG_MAX];
-    vsnprintf(buf, sizeof buf, fmt, ap);
-    enqueue(level, path, buf);
+    enqueue_text(level, path, fmt, ap);
 }
 
 void logger_log(log_level_t level, const char *path, const char *fmt, ...) {
@@ -165,3 +953,23 @@ void logger_log(log_level_t level, const char *path, const char *fmt, ...) {
     logger_vlog(level, path, fmt, ap);
     va_end(ap);
 }
+
+void logger_log_deferred(log_level_t level, const char *path, const char *fmt, ...) {
+    if (!logger_enabled)
+        return;
+    if (level > current_level || level == LOG_LEVEL_OFF)
+        return;
+    va_list ap, text_ap;
+    va_start(ap, fmt);
+    va_copy(text_ap, ap);
+    unsigned char blob[LOG_ARGS_MAX];
+    long n = encode_args(fmt, ap, blob, sizeof blob);
+    if (n >= 0) {
+        const char *ptrs[2] = {path, fmt};
+        enqueue(level, RECORD_BINARY, ptrs, sizeof ptrs, blob, (size_t)n);
+    } else {
+        enqueue_text(level, path, fmt, text_ap);
+    }
+    va_end(text_ap);
+    va_end(ap);
+}
@@ -1,209 +1,651 @@
 /**
  * @file parser.c
- * @brief Simple recursive-descent parser for commands, pipelines, background, and sequences.
+ * @brief Simple recursive-descent parser for commands, pipelines, background,
+ * sequences and the compound commands (if, while, until, for, case).
  */
 #include "parser.h"
+#include "arena.h"
 #include "util.h"
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /** Parser state holding input lexer and current token. */
 struct parser {
-    lexer_t *lexer;         /**< Source token stream. */
-    token_t *current_token; /**< Lookahead token. */
+    lexer_t *lexer;        /**< Source token stream. */
+    token_view_t current;  /**< Lookahead token. */
+    arena_t words;         /**< Scratch for the argv and redirections being collected. */
+    arena_t *tree;         /**< Arena of the tree being built by parser_parse(). */
+    int error;             /**< Set once a syntax error has been reported. */
+    int partial;           /**< Input may continue: end of input is not an error. */
+    int incomplete;        /**< The error was end of input while partial. */
 };
 
 parser_t *parser_create(lexer_t *lexer) {
     parser_t *parser = malloc_safe(sizeof(parser_t));
     parser->lexer = lexer;
-    parser->current_token = lexer_next_token(lexer);
+    parser->current = lexer_next(lexer);
+    arena_init(&parser->words, 0);
+    parser->tree = NULL;
+    parser->error = 0;
+    parser->partial = 0;
+    parser->incomplete = 0;
     return parser;
 }
 
 static void advance_token(parser_t *parser) {
-    token_free(parser->current_token);
-    parser->current_token = lexer_next_token(parser->lexer);
+    parser->current = lexer_next(parser->lexer);
 }
 
-static ast_node_t *parse_command(parser_t *parser) {
-    // Collect WORD tokens as argv elements and track simple redirections
-    int capacity = 8;
-    int argc = 0;
-    char **argv = malloc_safe(capacity * sizeof(char *));
+// Copy the current token's text into the tree; lexer_next() may reuse its
+// buffer.
+static char *token_text(parser_t *parser) {
+    return arena_strndup(parser->tree, parser->current.text, parser->current.text_len);
+}
 
-    // Temporary redirection collection
-    struct { int fd; int type; char *file; } redirs[8];
-    int rcount = 0;
+// Copy of the current word for places that are not expanded, without the
+// marks the lexer put before quoted '$' and '`'.
+static char *token_plain_text(parser_t *parser) {
+    char *text = token_text(parser);
+    char *out = text;
+    for (const char *p = text; *p; ++p) {
+        if (*p != LEXER_LITERAL_MARK && *p != LEXER_QUOTE_MARK)
+            *out++ = *p;
+    }
+    *out = '\0';
+    return text;
+}
+
+// Report a syntax error at the current token (only the first one).
+static void syntax_error(parser_t *parser) {
+    if (parser->error)
+        return;
+    parser->error = 1;
+    if (parser->partial && parser->current.type == TOKEN_EOF) {
+        parser->incomplete = 1; // the caller reads more input instead
+        return;
+    }
+    size_t line = lexer_line_at(parser->lexer, parser->current.offset);
+    switch (parser->current.type) {
+    case TOKEN_EOF:
+        fprintf(stderr, "myshell: line %zu: syntax error: unexpected end of input\n", line);
+        break;
+    case TOKEN_NEWLINE:
+        fprintf(stderr, "myshell: line %zu: syntax error near unexpected newline\n", line);
+        break;
+    default:
+        fprintf(stderr, "myshell: line %zu: syntax error near `%.*s'\n", line,
+                (int)parser->current.length, parser->current.text);
+        break;
+    }
+}
+
+static void skip_newlines(parser_t *parser) {
+    while (parser->current.type == TOKEN_NEWLINE)
+        advance_token(parser);
+}
+
+// Is the current token the reserved word kw? Reserved words are only
+// recognized unquoted (quote removal would make text shorter than the
+// token) and only where a command may start.
+static int at_keyword(const parser_t *parser, const char *kw) {
+    size_t n = strlen(kw);
+    return parser->current.type == TOKEN_WORD && parser->current.length == n &&
+           parser->current.text_len == n && memcmp(parser->current.text, kw, n) == 0;
+}
 
-    // Helper to test if string is all digits
-    auto int is_all_digits(const char *s) {
-        if (!s || !*s) return 0;
-        for (const char *p = s; *p; ++p) if (*p < '0' || *p > '9') return 0;
+// Reserved words that close a list instead of starting a command.
+static const char *const closing_keywords[] = {
+    "then", "elif", "else", "fi", "do", "done", "esac", "}", NULL,
+};
+
+// Can the current token begin a command?
+static int starts_command(const parser_t *parser) {
+    switch (parser->current.type) {
+    case TOKEN_WORD:
+        for (int i = 0; closing_keywords[i]; ++i) {
+            if (at_keyword(parser, closing_keywords[i]))
+                return 0;
+        }
+        return 1;
+    case TOKEN_LPAREN:
+    case TOKEN_ARITH:
+    case TOKEN_REDIRECT_IN:
+    case TOKEN_REDIRECT_OUT:
+    case TOKEN_REDIRECT_APPEND:
+    case TOKEN_HEREDOC:
+    case TOKEN_REDIRECT_AND_OUT:
         return 1;
+    default:
+        return 0;
+    }
+}
+
+static int is_all_digits(const char *s) {
+    if (!s || !*s)
+        return 0;
+    for (const char *p = s; *p; ++p) {
+        if (*p < '0' || *p > '9')
+            return 0;
+    }
+    return 1;
+}
+
+static int is_name(const char *s, size_t len) {
+    if (len == 0 || !(s[0] == '_' || isalpha((unsigned char)s[0])))
+        return 0;
+    for (size_t i = 1; i < len; ++i) {
+        if (!(s[i] == '_' || isalnum((unsigned char)s[i])))
+            return 0;
     }
+    return 1;
+}
+
+static ast_node_t *parse_function(parser_t *parser, char *name);
+
+static ast_node_t *parse_command(parser_t *parser) {
+    // Words and filenames are copied straight into the tree; the argv and
+    // redirection arrays are collected in scratch space and copied into
+    // the node once their size is known.
+    arena_mark_t mark = arena_mark(&parser->words);
+    int capacity = 16;
+    int argc = 0;
+    char **argv = arena_alloc(&parser->words, capacity * sizeof(char *));
+    int rcapacity = 4;
+    int rcount = 0;
+    ast_redir_t *redirs = arena_alloc(&parser->words, rcapacity * sizeof(ast_redir_t));
 
-    while (parser->current_token->type == TOKEN_WORD ||
-           parser->current_token->type == TOKEN_REDIRECT_IN ||
-           parser->current_token->type == TOKEN_REDIRECT_OUT ||
-           parser->current_token->type == TOKEN_REDIRECT_APPEND ||
-           parser->current_token->type == TOKEN_HEREDOC ||
-           parser->current_token->type == TOKEN_REDIRECT_AND_OUT) {
-        if (parser->current_token->type == TOKEN_WORD) {
-            if (argc >= capacity - 1) {
+    while (parser->current.type == TOKEN_WORD ||
+           parser->current.type == TOKEN_REDIRECT_IN ||
+           parser->current.type == TOKEN_REDIRECT_OUT ||
+           parser->current.type == TOKEN_REDIRECT_APPEND ||
+           parser->current.type == TOKEN_HEREDOC ||
+           parser->current.type == TOKEN_REDIRECT_AND_OUT) {
+        if (parser->current.type == TOKEN_WORD) {
+            if (argc >= capacity) {
+                char **bigger = arena_alloc(&parser->words, capacity * 2 * sizeof(char *));
+                memcpy(bigger, argv, argc * sizeof(char *));
+                argv = bigger;
                 capacity *= 2;
-                argv = realloc_safe(argv, capacity * sizeof(char *));
             }
-            argv[argc++] = strdup_safe(parser->current_token->value);
+            argv[argc++] = token_text(parser);
             advance_token(parser);
             continue;
         }
 
         // Determine redirection type and default fd
-    int type = -1; // ast_redir_type_t: input/output/append/heredoc
+        int type = -1; // ast_redir_type_t: input/output/append/heredoc
         int dfd = 1;
         int is_and_out = 0;
-        if (parser->current_token->type == TOKEN_REDIRECT_IN) {
+        if (parser->current.type == TOKEN_REDIRECT_IN) {
             type = REDIR_INPUT; dfd = 0;
-        } else if (parser->current_token->type == TOKEN_REDIRECT_OUT) {
+        } else if (parser->current.type == TOKEN_REDIRECT_OUT) {
             type = REDIR_OUTPUT; dfd = 1;
-        } else if (parser->current_token->type == TOKEN_REDIRECT_APPEND) {
+        } else if (parser->current.type == TOKEN_REDIRECT_APPEND) {
             type = REDIR_APPEND; dfd = 1;
-        } else if (parser->current_token->type == TOKEN_HEREDOC) {
+        } else if (parser->current.type == TOKEN_HEREDOC) {
             type = REDIR_HEREDOC; dfd = 0;
-        } else if (parser->current_token->type == TOKEN_REDIRECT_AND_OUT) {
+        } else if (parser->current.type == TOKEN_REDIRECT_AND_OUT) {
             type = REDIR_OUTPUT; dfd = 1; is_and_out = 1;
         }
         advance_token(parser);
-        if (parser->current_token->type != TOKEN_WORD) {
+        if (parser->current.type != TOKEN_WORD) {
             // Missing filename; abort
-            free_string_array(argv);
-            for (int i = 0; i < rcount; ++i) free(redirs[i].file);
+            syntax_error(parser);
+            arena_release(&parser->words, mark);
             return NULL;
         }
-        char *filename = strdup_safe(parser->current_token->value);
+        char *filename = token_plain_text(parser);
         advance_token(parser);
 
         int fd = dfd;
-        if (!is_and_out && argc > 0 && is_all_digits(argv[argc - 1])) {
-            fd = atoi(argv[argc - 1]);
-            free(argv[argc - 1]);
-            argv[--argc] = NULL;
+        if (!is_and_out && argc > 0 && is_all_digits(argv[argc - 1]))
+            fd = atoi(argv[--argc]);
+
+        if (rcount + 2 > rcapacity) {
+            ast_redir_t *bigger = arena_alloc(&parser->words, rcapacity * 2 * sizeof(ast_redir_t));
+            memcpy(bigger, redirs, rcount * sizeof(ast_redir_t));
+            redirs = bigger;
+            rcapacity *= 2;
         }
+        redirs[rcount++] = (ast_redir_t){fd, type, filename};
+        if (is_and_out)
+            redirs[rcount++] = (ast_redir_t){2, type, filename};
+    }
+
+    if (argc == 1 && rcount == 0 && parser->current.type == TOKEN_LPAREN &&
+        is_name(argv[0], strlen(argv[0]))) {
+        char *name = argv[0];
+        arena_release(&parser->words, mark);
+        return parse_function(parser, name);
+    }
+
+    ast_node_t *node = NULL;
+    if (argc > 0)
+        node = ast_arena_command(parser->tree, argv, argc, redirs, rcount);
+    else
+        syntax_error(parser); // redirections without a command
+    arena_release(&parser->words, mark);
+    return node;
+}
+
+// Forward declarations for recursive descent
+static ast_node_t *parse_list(parser_t *parser);
+
+// Consume the reserved word kw, or report a syntax error.
+static int expect_keyword(parser_t *parser, const char *kw) {
+    if (!at_keyword(parser, kw)) {
+        syntax_error(parser);
+        return 0;
+    }
+    advance_token(parser);
+    return 1;
+}
+
+// A list that must not be empty (conditions and bodies).
+static ast_node_t *parse_body(parser_t *parser) {
+    ast_node_t *body = parse_list(parser);
+    if (!body)
+        syntax_error(parser);
+    return body;
+}
+
+// if_clause := 'if' list 'then' list [ 'elif' list 'then' list ... ]
+//              [ 'else' list ] 'fi'
+// An elif becomes an if node in the else part and consumes the 'fi'.
+static ast_node_t *parse_if(parser_t *parser) {
+    advance_token(parser); // 'if' or 'elif'
+    ast_node_t *cond = parse_body(parser);
+    if (!cond || !expect_keyword(parser, "then"))
+        return NULL;
+    ast_node_t *then_part = parse_body(parser);
+    if (!then_part)
+        return NULL;
+    ast_node_t *else_part = NULL;
+    if (at_keyword(parser, "elif")) {
+        else_part = parse_if(parser);
+        if (!else_part)
+            return NULL;
+        return ast_arena_if(parser->tree, cond, then_part, else_part);
+    }
+    if (at_keyword(parser, "else")) {
+        advance_token(parser);
+        else_part = parse_body(parser);
+        if (!else_part)
+            return NULL;
+    }
+    if (!expect_keyword(parser, "fi"))
+        return NULL;
+    return ast_arena_if(parser->tree, cond, then_part, else_part);
+}
+
+// do_group := 'do' list 'done'
+static ast_node_t *parse_do_group(parser_t *parser) {
+    if (!expect_keyword(parser, "do"))
+        return NULL;
+    ast_node_t *body = parse_body(parser);
+    if (!body || !expect_keyword(parser, "done"))
+        return NULL;
+    return body;
+}
 
-        if (rcount < 8) {
-            redirs[rcount].fd = fd;
-            redirs[rcount].type = type;
-            redirs[rcount].file = filename;
-            rcount++;
-            if (is_and_out && rcount < 8) {
-                redirs[rcount].fd = 2;
-                redirs[rcount].type = type;
-                redirs[rcount].file = strdup_safe(filename);
-                rcount++;
+// while_clause := ('while' | 'until') list do_group
+static ast_node_t *parse_loop(parser_t *parser, ast_node_type_t type) {
+    advance_token(parser);
+    ast_node_t *cond = parse_body(parser);
+    if (!cond)
+        return NULL;
+    ast_node_t *body = parse_do_group(parser);
+    if (!body)
+        return NULL;
+    return ast_arena_node(parser->tree, type, cond, body);
+}
+
+// for_clause := 'for' NAME [ ';' ] newlines do_group
+//             | 'for' NAME newlines 'in' { WORD } (';' | newline) newlines do_group
+static ast_node_t *parse_for(parser_t *parser) {
+    advance_token(parser);
+    if (parser->current.type != TOKEN_WORD ||
+        !is_name(parser->current.text, parser->current.text_len)) {
+        syntax_error(parser);
+        return NULL;
+    }
+    char *name = token_text(parser);
+    advance_token(parser);
+
+    arena_mark_t mark = arena_mark(&parser->words);
+    int capacity = 16;
+    int n = 0;
+    char **words = NULL;
+    if (parser->current.type == TOKEN_SEMICOLON) {
+        advance_token(parser);
+    } else {
+        skip_newlines(parser);
+        if (at_keyword(parser, "in")) {
+            advance_token(parser);
+            words = arena_alloc(&parser->words, capacity * sizeof(char *));
+            while (parser->current.type == TOKEN_WORD) {
+                if (n == capacity) {
+                    char **bigger = arena_alloc(&parser->words, capacity * 2 * sizeof(char *));
+                    memcpy(bigger, words, n * sizeof(char *));
+                    words = bigger;
+                    capacity *= 2;
+                }
+                words[n++] = token_text(parser);
+                advance_token(parser);
             }
-        } else {
-            free(filename);
+            if (parser->current.type != TOKEN_SEMICOLON &&
+                parser->current.type != TOKEN_NEWLINE) {
+                syntax_error(parser);
+                arena_release(&parser->words, mark);
+                return NULL;
+            }
+            advance_token(parser);
         }
     }
+    skip_newlines(parser);
+    ast_node_t *body = parse_do_group(parser);
+    ast_node_t *node = body ? ast_arena_for(parser->tree, name, words, n, body) : NULL;
+    arena_release(&parser->words, mark);
+    return node;
+}
+
+// One case item: [ '(' ] WORD { '|' WORD } ')' [ list ]. The pattern
+// array is copied into the tree once its size is known.
+static int parse_case_item(parser_t *parser, ast_case_item_t *item) {
+    if (parser->current.type == TOKEN_LPAREN)
+        advance_token(parser);
+    arena_mark_t mark = arena_mark(&parser->words);
+    int capacity = 4;
+    int n = 0;
+    char **patterns = arena_alloc(&parser->words, capacity * sizeof(char *));
+    for (;;) {
+        if (parser->current.type != TOKEN_WORD) {
+            syntax_error(parser);
+            arena_release(&parser->words, mark);
+            return -1;
+        }
+        if (n == capacity) {
+            char **bigger = arena_alloc(&parser->words, capacity * 2 * sizeof(char *));
+            memcpy(bigger, patterns, n * sizeof(char *));
+            patterns = bigger;
+            capacity *= 2;
+        }
+        patterns[n++] = token_text(parser);
+        advance_token(parser);
+        if (parser->current.type != TOKEN_PIPE)
+            break;
+        advance_token(parser);
+    }
+    if (parser->current.type != TOKEN_RPAREN) {
+        syntax_error(parser);
+        arena_release(&parser->words, mark);
+        return -1;
+    }
+    advance_token(parser);
+    item->patterns = arena_alloc(parser->tree, n * sizeof(char *));
+    memcpy(item->patterns, patterns, n * sizeof(char *));
+    item->n_patterns = n;
+    arena_release(&parser->words, mark);
+    item->body = parse_list(parser); // may be empty
+    return parser->error ? -1 : 0;
+}
 
-    if (argc == 0) {
-        free(argv);
+// case_clause := 'case' WORD newlines 'in' newlines
+//                { case_item ( ';;' newlines | <before esac> ) } 'esac'
+static ast_node_t *parse_case(parser_t *parser) {
+    advance_token(parser);
+    if (parser->current.type != TOKEN_WORD) {
+        syntax_error(parser);
         return NULL;
     }
+    char *word = token_text(parser);
+    advance_token(parser);
+    skip_newlines(parser);
+    if (!expect_keyword(parser, "in"))
+        return NULL;
+    skip_newlines(parser);
 
-    argv[argc] = NULL;
-    ast_node_t *node = ast_create_command(argv);
-    // Attach collected redirections
-    for (int i = 0; i < rcount; ++i) {
-        ast_command_add_redirection(node, redirs[i].fd, redirs[i].type, redirs[i].file);
-        free(redirs[i].file);
+    arena_mark_t mark = arena_mark(&parser->words);
+    int capacity = 8;
+    int n = 0;
+    ast_case_item_t *items = arena_alloc(&parser->words, capacity * sizeof(ast_case_item_t));
+    ast_node_t *node = NULL;
+    while (!at_keyword(parser, "esac")) {
+        ast_case_item_t item;
+        if (parse_case_item(parser, &item) != 0)
+            break;
+        if (n == capacity) {
+            ast_case_item_t *bigger =
+                arena_alloc(&parser->words, capacity * 2 * sizeof(ast_case_item_t));
+            memcpy(bigger, items, n * sizeof(ast_case_item_t));
+            items = bigger;
+            capacity *= 2;
+        }
+        items[n++] = item;
+        if (parser->current.type == TOKEN_DSEMI) {
+            advance_token(parser);
+            skip_newlines(parser);
+        } else if (!at_keyword(parser, "esac")) {
+            syntax_error(parser);
+            break;
+        }
     }
-    free_string_array(argv);
+    if (!parser->error) {
+        advance_token(parser); // 'esac'
+        node = ast_arena_case(parser->tree, word, items, n);
+    }
+    arena_release(&parser->words, mark);
     return node;
 }
 
-// primary := ( list ) | command
-// Forward declarations for recursive descent
-static ast_node_t *parse_list(parser_t *parser);
+// Can the current token begin a compound command?
+static int starts_compound(const parser_t *parser) {
+    static const char *const openers[] = {"{", "if", "while", "until", "for", "case", NULL};
+    if (parser->current.type == TOKEN_LPAREN)
+        return 1;
+    for (int i = 0; openers[i]; ++i) {
+        if (at_keyword(parser, openers[i]))
+            return 1;
+    }
+    return 0;
+}
+
 static ast_node_t *parse_primary(parser_t *parser);
 
+// function_definition := NAME '(' ')' newlines compound_command
+// The name has been read by parse_command(); the current token is '('.
+static ast_node_t *parse_function(parser_t *parser, char *name) {
+    advance_token(parser);
+    if (parser->current.type != TOKEN_RPAREN) {
+        syntax_error(parser);
+        return NULL;
+    }
+    advance_token(parser);
+    skip_newlines(parser);
+    if (!starts_compound(parser)) {
+        syntax_error(parser);
+        return NULL;
+    }
+    ast_node_t *body = parse_primary(parser);
+    if (!body)
+        return NULL;
+    return ast_arena_function(parser->tree, name, body);
+}
+
+// primary := ( list ) | '{' list '}' | (( expr )) | if_clause
+//          | while_clause | for_clause | case_clause | command
 static ast_node_t *parse_primary(parser_t *parser) {
-    if (parser->current_token->type == TOKEN_LPAREN) {
+    if (at_keyword(parser, "{")) {
+        // A group runs in the current shell: it is just its list
         advance_token(parser);
-        ast_node_t *inside = NULL;
-    // Parse a full list inside parentheses
-    inside = parse_list(parser);
-        if (parser->current_token->type == TOKEN_RPAREN) {
-            advance_token(parser);
-        } else {
-            ast_free(inside);
+        ast_node_t *body = parse_body(parser);
+        if (!body || !expect_keyword(parser, "}"))
+            return NULL;
+        return body;
+    }
+    if (at_keyword(parser, "if"))
+        return parse_if(parser);
+    if (at_keyword(parser, "while"))
+        return parse_loop(parser, AST_WHILE);
+    if (at_keyword(parser, "until"))
+        return parse_loop(parser, AST_UNTIL);
+    if (at_keyword(parser, "for"))
+        return parse_for(parser);
+    if (at_keyword(parser, "case"))
+        return parse_case(parser);
+    if (parser->current.type == TOKEN_LPAREN) {
+        advance_token(parser);
+        // Parse a full list inside parentheses
+        ast_node_t *inside = parse_list(parser);
+        if (!inside || parser->current.type != TOKEN_RPAREN) {
+            syntax_error(parser);
             return NULL;
         }
-        return ast_create_subshell(inside);
+        advance_token(parser);
+        return ast_arena_node(parser->tree, AST_SUBSHELL, inside, NULL);
+    }
+    if (parser->current.type == TOKEN_ARITH) {
+        // (( expr )) runs as `let expr`
+        char *argv[] = {arena_strndup(parser->tree, "let", 3), token_text(parser)};
+        ast_node_t *node = ast_arena_command(parser->tree, argv, 2, NULL, 0);
+        advance_token(parser);
+        return node;
     }
     return parse_command(parser);
 }
 
+// pipeline := primary { '|' newlines primary }
 static ast_node_t *parse_pipeline(parser_t *parser) {
     ast_node_t *left = parse_primary(parser);
     if (!left) return NULL;
-    while (parser->current_token->type == TOKEN_PIPE) {
+    while (parser->current.type == TOKEN_PIPE) {
         advance_token(parser);
+        skip_newlines(parser);
         ast_node_t *right = parse_primary(parser);
-        if (!right) {
-            ast_free(left);
+        if (!right)
             return NULL;
-        }
-        left = ast_create_pipeline(left, right);
+        left = ast_arena_node(parser->tree, AST_PIPELINE, left, right);
     }
     return left;
 }
 
+// and_or := pipeline { ('&&' | '||') newlines pipeline }
 static ast_node_t *parse_and_or(parser_t *parser) {
     ast_node_t *left = parse_pipeline(parser);
     if (!left) return NULL;
-    while (parser->current_token->type == TOKEN_AND_IF || parser->current_token->type == TOKEN_OR_IF) {
-        token_type_t t = parser->current_token->type;
+    while (parser->current.type == TOKEN_AND_IF || parser->current.type == TOKEN_OR_IF) {
+        token_type_t t = parser->current.type;
         advance_token(parser);
+        skip_newlines(parser);
         ast_node_t *right = parse_pipeline(parser);
-        if (!right) { ast_free(left); return NULL; }
-        if (t == TOKEN_AND_IF) left = ast_create_and(left, right);
-        else left = ast_create_or(left, right);
+        if (!right) return NULL;
+        left = ast_arena_node(parser->tree, t == TOKEN_AND_IF ? AST_AND : AST_OR, left, right);
     }
     return left;
 }
 
-// list := and_or [ ; list ] [ & ]
+// list := newlines and_or { ('&' | ';' | newline) newlines and_or } [separator]
+//
+// The items are collected first and chained from the end, so the sequence
+// nests to the right without recursing once per item: a script is one list
+// thousands of items long.
 static ast_node_t *parse_list(parser_t *parser) {
-    ast_node_t *left = parse_and_or(parser);
-    if (!left) return NULL;
+    skip_newlines(parser);
+    if (!starts_command(parser))
+        return NULL;
+    arena_mark_t mark = arena_mark(&parser->words);
+    int capacity = 16;
+    int n = 0;
+    ast_node_t **items = arena_alloc(&parser->words, capacity * sizeof(ast_node_t *));
+    for (;;) {
+        ast_node_t *item = parse_and_or(parser);
+        if (!item) {
+            syntax_error(parser);
+            break;
+        }
+        int separated = 0;
+        if (parser->current.type == TOKEN_BACKGROUND) {
+            advance_token(parser);
+            item = ast_arena_node(parser->tree, AST_BACKGROUND, item, NULL);
+            separated = 1;
+        } else if (parser->current.type == TOKEN_SEMICOLON ||
+                   parser->current.type == TOKEN_NEWLINE) {
+            advance_token(parser);
+            separated = 1;
+        }
+        if (n == capacity) {
+            ast_node_t **bigger = arena_alloc(&parser->words, capacity * 2 * sizeof(ast_node_t *));
+            memcpy(bigger, items, n * sizeof(ast_node_t *));
+            items = bigger;
+            capacity *= 2;
+        }
+        items[n++] = item;
+        skip_newlines(parser);
+        if (!separated || !starts_command(parser))
+            break;
+    }
 
-    // Optional background on this and_or
-    if (parser->current_token->type == TOKEN_BACKGROUND) {
-        advance_token(parser);
-        left = ast_create_background(left);
+    ast_node_t *list = NULL;
+    if (!parser->error) {
+        list = items[n - 1];
+        for (int i = n - 2; i >= 0; --i)
+            list = ast_arena_node(parser->tree, AST_SEQUENCE, items[i], list);
     }
+    arena_release(&parser->words, mark);
+    return list;
+}
 
-    if (parser->current_token->type == TOKEN_SEMICOLON) {
-        advance_token(parser);
-        if (parser->current_token->type != TOKEN_EOF && parser->current_token->type != TOKEN_RPAREN) {
-            ast_node_t *right = parse_list(parser);
-            if (right) left = ast_create_sequence(left, right);
-        }
+// Parse into a fresh tree arena; on success the root owns it. With
+// whole_input, tokens left after the list are a syntax error.
+static ast_node_t *parse_tree(parser_t *parser, int whole_input) {
+    // The whole tree, words included, goes into one arena owned by the
+    // root; a failed parse drops it in one go.
+    parser->tree = malloc_safe(sizeof(arena_t));
+    arena_init(parser->tree, 0);
+    ast_node_t *root = parse_list(parser);
+    if (whole_input && !parser->error && parser->current.type != TOKEN_EOF)
+        syntax_error(parser);
+    if (root && !parser->error) {
+        ast_set_arena(root, parser->tree);
+    } else {
+        root = NULL;
+        arena_free(parser->tree);
+        free(parser->tree);
     }
-    return left;
+    parser->tree = NULL;
+    return root;
 }
 
 ast_node_t *parser_parse(parser_t *parser) {
-    if (parser->current_token->type == TOKEN_EOF) {
+    if (parser->current.type == TOKEN_EOF) {
         return NULL;
     }
-    return parse_list(parser);
+    return parse_tree(parser, 0);
+}
+
+ast_node_t *parser_parse_program(parser_t *parser, int *error) {
+    ast_node_t *root = parse_tree(parser, 1);
+    if (error)
+        *error = parser->error;
+    return root;
+}
+
+ast_node_t *parser_parse_input(parser_t *parser, parser_status_t *status) {
+    parser->partial = 1;
+    ast_node_t *root = parse_tree(parser, 1);
+    parser->partial = 0;
+    if (parser->incomplete)
+        *status = PARSER_INCOMPLETE;
+    else
+        *status = parser->error ? PARSER_ERROR : PARSER_OK;
+    return root;
 }
 
 void parser_free(parser_t *parser) {
     if (parser) {
-        token_free(parser->current_token);
+        arena_free(&parser->words);
         free(parser);
     }
 }
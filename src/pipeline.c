@@ -1,14 +1,17 @@
 /**
  * @file pipeline.c
  * @brief Implementation of N-stage pipeline execution using fork/pipe/dup2.
+ *
+ * Pipes are opened lazily, one stage ahead of the fork loop, so the shell
+ * never holds more than two pipes at once.
  */
 #include "pipeline.h"
 #include "exec.h"
+#include "launch.h"
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/wait.h>
 #include <unistd.h>
 
 static int make_pipe_cloexec(int fds[2]) {
@@ -24,47 +27,48 @@ static int make_pipe_cloexec(int fds[2]) {
     return 0;
 }
 
+// Close every descriptor above stderr in a pipeline child. The stage only
+// needs stdin/stdout, which were installed with dup2() beforehand; anything
+// else the shell holds must not leak into the stage.
+static void close_inherited_fds(int prev_read, const int next[2]) {
+#ifdef CLOSE_RANGE_CLOEXEC
+    if (close_range(STDERR_FILENO + 1, ~0U, 0) == 0)
+        return;
+#endif
+    // Fallback: the only shell-held pipe ends are the ones this stage saw.
+    if (prev_read > STDERR_FILENO)
+        close(prev_read);
+    if (next[0] > STDERR_FILENO)
+        close(next[0]);
+    if (next[1] > STDERR_FILENO)
+        close(next[1]);
+}
+
 int pipeline_execute(ast_node_t **commands, int count) {
     if (count <= 0 || !commands)
         return -1;
     if (count == 1)
         return exec_ast(commands[0]);
 
-    const int n_pipes = count - 1;
-    int (*pipes)[2] = NULL;
-    pid_t *pids = NULL;
-    int created = 0;
-    int spawned = 0;
-
-    pipes = n_pipes > 0 ? malloc(sizeof(int[2]) * (size_t)n_pipes) : NULL;
-    pids = malloc(sizeof(pid_t) * (size_t)count);
-    if ((n_pipes > 0 && !pipes) || !pids) {
+    pid_t *pids = malloc(sizeof(pid_t) * (size_t)count);
+    if (!pids) {
         perror("malloc");
-        free(pipes);
-        free(pids);
         return -1;
     }
 
-    // Create pipes with CLOEXEC using helper
-
-    // Create all pipes
-    for (int i = 0; i < n_pipes; i++) {
-        if (make_pipe_cloexec(pipes[i]) == -1) {
+    // Pipes are created one stage ahead: when stage i is forked the shell
+    // holds only the read end feeding it and the pipe towards stage i+1,
+    // so each child inherits at most three pipe descriptors regardless of
+    // the pipeline length.
+    int prev_read = -1;
+    int spawned = 0;
+    for (int i = 0; i < count; i++) {
+        int next[2] = {-1, -1};
+        if (i < count - 1 && make_pipe_cloexec(next) == -1) {
             perror("pipe");
-            // Close any previously created pipes
-            for (int j = 0; j < i; j++) {
-                close(pipes[j][0]);
-                close(pipes[j][1]);
-            }
-            free(pipes);
-            free(pids);
-            return -1;
+            break;
         }
-        created++;
-    }
 
-    // Execute each command in the pipeline
-    for (int i = 0; i < count; i++) {
         pid_t pid = fork();
         if (pid == 0) {
             // Child process
@@ -75,76 +79,52 @@ int pipeline_execute(ast_node_t **commands, int count) {
             } else {
                 (void)setpgid(0, pids[0]);
             }
-            // Set up input
-            if (i > 0) {
-                if (dup2(pipes[i - 1][0], STDIN_FILENO) == -1) {
-                    perror("dup2");
-                    _exit(127);
-                }
-                // Close after dup2
-                close(pipes[i - 1][0]);
+            if (prev_read != -1 && dup2(prev_read, STDIN_FILENO) == -1) {
+                perror("dup2");
+                _exit(127);
             }
-
-            // Set up output
-            if (i < count - 1) {
-                if (dup2(pipes[i][1], STDOUT_FILENO) == -1) {
-                    perror("dup2");
-                    _exit(127);
-                }
-                // Close after dup2
-                close(pipes[i][1]);
-            }
-
-            // Close all pipe file descriptors
-            for (int j = 0; j < n_pipes; j++) {
-                close(pipes[j][0]);
-                close(pipes[j][1]);
+            if (next[1] != -1 && dup2(next[1], STDOUT_FILENO) == -1) {
+                perror("dup2");
+                _exit(127);
             }
+            close_inherited_fds(prev_read, next);
 
             // Execute the command and exit with its status
             int st = exec_ast(commands[i]);
             _exit(st & 0xFF);
-        } else if (pid < 0) {
+        }
+
+        // Parent: the write end now belongs to stage i, the read end is
+        // handed to stage i+1 on the next iteration.
+        if (prev_read != -1)
+            close(prev_read);
+        if (next[1] != -1)
+            close(next[1]);
+        prev_read = next[0];
+        if (pid < 0) {
             perror("fork");
             // On fork failure, stop spawning more; break to cleanup
             break;
-        } else {
-            pids[i] = pid;
-            // Parent: ensure process group assignment (race-safe)
-            if (i == 0)
-                (void)setpgid(pid, pid);
-            else
-                (void)setpgid(pid, pids[0]);
-            spawned++;
         }
+        pids[i] = pid;
+        // Parent: ensure process group assignment (race-safe)
+        if (i == 0)
+            (void)setpgid(pid, pid);
+        else
+            (void)setpgid(pid, pids[0]);
+        spawned++;
     }
-
-    // Close all pipe file descriptors in parent
-    for (int i = 0; i < created; i++) {
-        close(pipes[i][0]);
-        close(pipes[i][1]);
-    }
+    if (prev_read != -1)
+        close(prev_read);
 
     // Wait for all spawned children
     int last_status = 0;
     for (int i = 0; i < spawned; i++) {
-        int status = 0;
-        if (waitpid(pids[i], &status, 0) == -1) {
-            // If a child is already handled or error, keep going
-            continue;
-        }
-        if (i == count - 1) {
-            if (WIFEXITED(status)) {
-                last_status = WEXITSTATUS(status);
-            } else if (WIFSIGNALED(status)) {
-                last_status = 128 + WTERMSIG(status);
-            } else {
-                last_status = 1; // Fallback
-            }
-        }
+        int status = launch_wait(pids[i]);
+        if (i == count - 1)
+            last_status = status;
     }
 
-    free(pipes);
     free(pids);
     // If we failed to spawn all, surface an error unless at least one ran
     if (spawned < count) {
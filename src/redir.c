@@ -3,11 +3,14 @@
  * @brief File descriptor redirection helpers.
  */
 #include "redir.h"
+#include "env.h"
 #include "util.h"
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 redir_t *redir_create(redir_type_t type, int fd, const char *filename) {
@@ -15,22 +18,61 @@ redir_t *redir_create(redir_type_t type, int fd, const char *filename) {
     redir->type = type;
     redir->fd = fd;
     redir->filename = strdup_safe(filename);
+    redir->saved_fd = -1;
     return redir;
 }
 
-static int open_and_dup(const char *path, int oflags, mode_t mode, int target_fd) {
-    int file_fd = (oflags & O_CREAT) ? open(path, oflags | O_CLOEXEC, mode) : open(path, oflags | O_CLOEXEC);
-    if (file_fd == -1) {
-        perror("open");
+// Save a copy of target_fd above the range used by redirections.
+static int save_fd(int target_fd) {
+    int saved = fcntl(target_fd, F_DUPFD_CLOEXEC, 10);
+    if (saved == -1)
+        return errno == EBADF ? REDIR_SAVED_CLOSED : -1;
+    return saved;
+}
+
+static void restore_fd(int target_fd, int saved_fd) {
+    if (saved_fd == REDIR_SAVED_CLOSED) {
+        close(target_fd);
+    } else if (saved_fd >= 0) {
+        if (dup2(saved_fd, target_fd) == -1)
+            perror("dup2");
+        close(saved_fd);
+    }
+}
+
+// Open the redirection source and install it on target_fd. On success the
+// original target has been saved into *saved_out.
+static int apply_redirection(redir_type_t type, int target_fd, const char *filename,
+                             int *saved_out) {
+    if (target_fd < 0) {
+        errno = EBADF;
+        return -1;
+    }
+    // Keep buffered output on the descriptor it was written for
+    fflush(stdout);
+    fflush(stderr);
+
+    int saved = save_fd(target_fd);
+    if (saved == -1) {
+        perror("fcntl");
+        return -1;
+    }
+    int src = redir_open_source(type, filename);
+    if (src == -1) {
+        // The target is untouched; only the saved copy needs releasing
+        if (saved >= 0)
+            close(saved);
         return -1;
     }
-    if (file_fd != target_fd) {
-        if (dup2(file_fd, target_fd) == -1) {
+    if (src != target_fd) {
+        if (dup2(src, target_fd) == -1) {
             perror("dup2");
-            close(file_fd);
+            close(src);
+            if (saved >= 0)
+                close(saved);
             return -1;
         }
-        close(file_fd);
+        close(src);
     } else {
         // If open returned the same fd as the target, ensure CLOEXEC is cleared
         int flags = fcntl(target_fd, F_GETFD);
@@ -38,6 +80,7 @@ static int open_and_dup(const char *path, int oflags, mode_t mode, int target_fd
             (void)fcntl(target_fd, F_SETFD, flags & ~FD_CLOEXEC);
         }
     }
+    *saved_out = saved;
     return 0;
 }
 
@@ -46,23 +89,156 @@ int redir_setup(redir_t *redir) {
         errno = EINVAL;
         return -1;
     }
-
     switch (redir->type) {
     case REDIR_INPUT:
-        return open_and_dup(redir->filename, O_RDONLY, 0, redir->fd);
     case REDIR_OUTPUT:
-        return open_and_dup(redir->filename, O_WRONLY | O_CREAT | O_TRUNC, 0644, redir->fd);
     case REDIR_APPEND:
-        return open_and_dup(redir->filename, O_WRONLY | O_CREAT | O_APPEND, 0644, redir->fd);
+    case REDIR_HEREDOC:
+        return apply_redirection(redir->type, redir->fd, redir->filename, &redir->saved_fd);
     default:
         errno = EINVAL;
         return -1;
     }
 }
 
-void redir_cleanup(redir_t *redir __attribute__((unused))) {
-    // In a real implementation, this would restore original file descriptors
-    // For now, it's a placeholder
+void redir_cleanup(redir_t *redir) {
+    if (!redir || redir->saved_fd == -1)
+        return;
+    fflush(stdout);
+    fflush(stderr);
+    restore_fd(redir->fd, redir->saved_fd);
+    redir->saved_fd = -1;
+}
+
+void redir_stack_init(redir_stack_t *stack) {
+    stack->slots = stack->inline_slots;
+    stack->depth = 0;
+    stack->capacity = (int)(sizeof(stack->inline_slots) / sizeof(stack->inline_slots[0]));
+}
+
+int redir_stack_push(redir_stack_t *stack, redir_type_t type, int fd,
+                     const char *filename) {
+    if (!stack || !filename) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (stack->depth == stack->capacity) {
+        int cap = stack->capacity * 2;
+        if (stack->slots == stack->inline_slots) {
+            redir_saved_t *heap = malloc_safe(sizeof(redir_saved_t) * (size_t)cap);
+            memcpy(heap, stack->inline_slots, sizeof(stack->inline_slots));
+            stack->slots = heap;
+        } else {
+            stack->slots = realloc_safe(stack->slots, sizeof(redir_saved_t) * (size_t)cap);
+        }
+        stack->capacity = cap;
+    }
+    int saved;
+    if (apply_redirection(type, fd, filename, &saved) != 0)
+        return -1;
+    stack->slots[stack->depth].fd = fd;
+    stack->slots[stack->depth].saved_fd = saved;
+    stack->depth++;
+    return 0;
+}
+
+void redir_stack_unwind(redir_stack_t *stack) {
+    if (!stack)
+        return;
+    fflush(stdout);
+    fflush(stderr);
+    while (stack->depth > 0) {
+        redir_saved_t *e = &stack->slots[--stack->depth];
+        restore_fd(e->fd, e->saved_fd);
+    }
+    if (stack->slots != stack->inline_slots)
+        free(stack->slots);
+    stack->slots = stack->inline_slots;
+    stack->capacity = (int)(sizeof(stack->inline_slots) / sizeof(stack->inline_slots[0]));
+}
+
+// An unlinked temporary file, for when memfd_create() is unavailable. A
+// pipe would not do: the body is written before anything reads it.
+static int heredoc_tmpfile(void) {
+    const char *dir = env_get("TMPDIR");
+    if (!dir || !*dir)
+        dir = "/tmp";
+    int fd = -1;
+#ifdef O_TMPFILE
+    fd = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+#endif
+    if (fd == -1) {
+        char path[4096];
+        if (snprintf(path, sizeof path, "%s/myshell-heredoc-XXXXXX", dir) >= (int)sizeof path) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        fd = mkostemp(path, O_CLOEXEC);
+        if (fd != -1)
+            unlink(path);
+    }
+    return fd;
+}
+
+int redir_heredoc_fd(const char *delim) {
+    if (!delim) {
+        errno = EINVAL;
+        return -1;
+    }
+    int fd = -1;
+#ifdef MFD_CLOEXEC
+    fd = memfd_create("myshell-heredoc", MFD_CLOEXEC);
+#endif
+    if (fd == -1 && (fd = heredoc_tmpfile()) == -1) {
+        perror("here-document");
+        return -1;
+    }
+
+    size_t cap = 0;
+    char *line = NULL;
+    ssize_t nread;
+    while ((nread = getline(&line, &cap, stdin)) != -1) {
+        if (nread > 0 && line[nread - 1] == '\n') {
+            line[nread - 1] = '\0';
+            nread--;
+        }
+        if (strcmp(line, delim) == 0)
+            break;
+        // Write the line back with its newline in one call
+        line[nread] = '\n';
+        sig_safe_write(fd, line, (size_t)nread + 1);
+    }
+    free(line);
+
+    (void)lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+int redir_open_source(redir_type_t type, const char *filename) {
+    if (!filename) {
+        errno = EINVAL;
+        return -1;
+    }
+    int fd;
+    switch (type) {
+    case REDIR_INPUT:
+        fd = open(filename, O_RDONLY | O_CLOEXEC);
+        break;
+    case REDIR_OUTPUT:
+        fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        break;
+    case REDIR_APPEND:
+        fd = open(filename, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        break;
+    case REDIR_HEREDOC:
+        return redir_heredoc_fd(filename);
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+    if (fd == -1)
+        perror(filename);
+    return fd;
 }
 
 void redir_free(redir_t *redir) {
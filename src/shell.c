@@ -3,18 +3,27 @@
  * @brief Interactive shell main loop and lifecycle management.
  */
 #include "shell.h"
+#include "astcache.h"
 #include "builtin.h"
+#include "childwatch.h"
 #include "env.h"
+#include "evloop.h"
 #include "exec.h"
+#include "func.h"
 #include "jobs.h"
 #include "lexer.h"
 #include "logger.h"
 #include "parser.h"
 #include "plugin.h"
 #include "term.h"
+#include "util.h"
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 /** Global flag for main loop run-state; set to 0 to stop. */
@@ -27,11 +36,22 @@ int shell_flag_errexit = 0;
 int shell_flag_xtrace = 0;
 /** Last command status tracked by the shell. */
 static int shell_last_status = 0;
+/** Event loop driving child supervision and prompt input. */
+static evloop_t *shell_loop = NULL;
 
 void shell_init(void) {
     // Initialize terminal
     term_setup_signals();
 
+    // Reap children from the event loop (pidfd + signalfd)
+    if (!shell_loop) {
+        shell_loop = evloop_create();
+        if (shell_loop && childwatch_init(shell_loop) != 0) {
+            evloop_free(shell_loop);
+            shell_loop = NULL;
+        }
+    }
+
     // Initialize logger (optional, default off)
     logger_init();
     logger_set_level(LOG_LEVEL_OFF);
@@ -44,7 +64,11 @@ void shell_init(void) {
 }
 
 void shell_cleanup(void) {
+    childwatch_shutdown();
+    evloop_free(shell_loop);
+    shell_loop = NULL;
     plugin_cleanup_all();
+    func_clear();
     term_restore_signals();
     logger_shutdown();
 }
@@ -64,6 +88,30 @@ static inline void shell_print_prompt(size_t multiline_length) {
     fflush(stdout);
 }
 
+static void shell_on_input_ready(int fd, void *data) {
+    (void)fd;
+    *(int *)data = 1;
+    evloop_stop(shell_loop);
+}
+
+// Block until stdin is readable while dispatching child events, so
+// background jobs are reaped and reported as soon as they change state
+// instead of at the next prompt. Only used on a terminal: in canonical
+// mode each read returns at most one line, so stdio never holds buffered
+// input that the fd-level wait could miss.
+static void shell_wait_for_input(size_t multiline_length) {
+    int ready = 0;
+    if (evloop_add_fd(shell_loop, STDIN_FILENO, EVLOOP_READ, shell_on_input_ready, &ready) != 0)
+        return;
+    while (!ready && shell_running) {
+        if (childwatch_dispatch() != 0)
+            break;
+        if (!ready && jobs_report_changes() > 0)
+            shell_print_prompt(multiline_length);
+    }
+    evloop_remove_fd(shell_loop, STDIN_FILENO);
+}
+
 // Ensure the multiline buffer has capacity for at least needed bytes
 // (including the trailing NUL once appended). Returns 0 on success, non-zero on OOM.
 static int ensure_capacity(char **buffer, size_t *capacity, size_t needed) {
@@ -81,21 +129,21 @@ static int ensure_capacity(char **buffer, size_t *capacity, size_t needed) {
     return 0;
 }
 
-// Append a line into the multiline buffer, inserting a separating space when
-// there is already content and the new line is non-empty.
+// Append a line into the multiline buffer, inserting sep between it and
+// the content already there when both are non-empty.
 static int append_line(char **buffer, size_t *capacity, size_t *length,
-                       const char *line, size_t line_len) {
+                       const char *line, size_t line_len, char sep) {
     size_t extra = line_len;
-    int add_space = (*length > 0 && line_len > 0) ? 1 : 0;
-    size_t needed = *length + (size_t)add_space + extra + 1; // +1 for NUL
+    int add_sep = (*length > 0 && line_len > 0) ? 1 : 0;
+    size_t needed = *length + (size_t)add_sep + extra + 1; // +1 for NUL
     if (ensure_capacity(buffer, capacity, needed) != 0) {
         return -1;
     }
     if (*length == 0) {
         (*buffer)[0] = '\0';
     }
-    if (add_space) {
-        (*buffer)[*length] = ' ';
+    if (add_sep) {
+        (*buffer)[*length] = sep;
         *length += 1;
         (*buffer)[*length] = '\0';
     }
@@ -107,60 +155,176 @@ static int append_line(char **buffer, size_t *capacity, size_t *length,
     return 0;
 }
 
-static int execute_line(const char *line_in) {
+// Parse and run one chunk of input. With incomplete non-NULL more input
+// may follow: if the chunk ends inside a command, *incomplete is set and
+// nothing runs. A syntax error runs nothing and sets the status to 2.
+static int execute_line(const char *line_in, int *incomplete) {
     int rc = 0;
+    if (incomplete)
+        *incomplete = 0;
     if (!line_in || *line_in == '\0')
         return 0;
 
-    if (shell_flag_xtrace)
-        fprintf(stderr, "+ %s\n", line_in);
-
     lexer_t *lexer = lexer_create(line_in);
     parser_t *parser = parser_create(lexer);
-    ast_node_t *ast = parser_parse(parser);
+    parser_status_t status;
+    ast_node_t *ast;
+    if (incomplete) {
+        ast = parser_parse_input(parser, &status);
+    } else {
+        int error;
+        ast = parser_parse_program(parser, &error);
+        status = error ? PARSER_ERROR : PARSER_OK;
+    }
     if (ast) {
-        rc = exec_ast(ast);
+        rc = exec_program(ast);
         ast_free(ast);
     }
     parser_free(parser);
     lexer_free(lexer);
+    if (status == PARSER_INCOMPLETE) {
+        *incomplete = 1;
+        return shell_last_status;
+    }
+    if (status == PARSER_ERROR)
+        rc = 2;
     shell_last_status = rc;
     return rc;
 }
 
+// Read what is left of fd into a malloc'd buffer, for scripts that cannot
+// be mapped (pipes, FIFOs, /dev/stdin). Returns NULL on a read error.
+static char *read_script(int fd, size_t *size) {
+    size_t cap = 4096, len = 0;
+    char *buf = malloc_safe(cap);
+    for (;;) {
+        if (len == cap) {
+            cap *= 2;
+            buf = realloc_safe(buf, cap);
+        }
+        ssize_t n = read(fd, buf + len, cap - len);
+        if (n == 0)
+            break;
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            free(buf);
+            return NULL;
+        }
+        len += (size_t)n;
+    }
+    *size = len;
+    return buf;
+}
+
 int shell_run_file(const char *path) {
-    FILE *f = fopen(path, "r");
-    if (!f) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
         perror(path);
+        if (fd >= 0)
+            close(fd);
         return 127;
     }
     shell_interactive = 0; // disable prompts/job-control tweaks
 
-    char *line = NULL;
-    size_t len = 0;
-    ssize_t read;
-    int last_status = 0;
-    int lineno = 0;
-    while ((read = getline(&line, &len, f)) != -1) {
-        lineno++;
-        if (lineno == 1 && read >= 2 && line[0] == '#' && line[1] == '!') {
-            // skip shebang
-            continue;
+    // Run the compiled tree if `--compile` cached one for these exact
+    // contents; otherwise parse the whole file once. Either way the tree
+    // does not point into the script, so its text is dropped before
+    // anything runs. Regular files are mapped; anything else, or a file
+    // that cannot be mapped, is read into a buffer.
+    size_t size = (size_t)st.st_size;
+    char *text = NULL;
+    int mapped = 0;
+    if (S_ISREG(st.st_mode) && size > 0) {
+        text = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        mapped = text != MAP_FAILED;
+    }
+    if (!mapped && (!S_ISREG(st.st_mode) || size > 0)) {
+        text = read_script(fd, &size);
+        if (!text) {
+            perror(path);
+            close(fd);
+            return 127;
         }
-        if (read > 0 && line[read - 1] == '\n')
-            line[read - 1] = '\0';
-        if (line[0] == '\0')
-            continue;
-    last_status = execute_line(line);
-        if (shell_flag_errexit && last_status != 0) {
-            break;
+    }
+    close(fd);
+
+    ast_node_t *ast = NULL;
+    astcache_image_t cached = {0};
+    int error = 0;
+    if (size > 0) {
+        if (mapped && astcache_load(path, &st, text, size, &cached) == 0) {
+            ast = cached.root;
+        } else {
+            lexer_t *lexer = lexer_create_n(text, size);
+            parser_t *parser = parser_create(lexer);
+            ast = parser_parse_program(parser, &error);
+            parser_free(parser);
+            lexer_free(lexer);
         }
     }
-    free(line);
-    fclose(f);
+    if (mapped)
+        munmap(text, size);
+    else
+        free(text);
+    if (error) {
+        shell_last_status = 2;
+        return 2;
+    }
+
+    int last_status = 0;
+    if (ast)
+        last_status = exec_program(ast);
+    if (cached.map)
+        astcache_release(&cached);
+    else
+        ast_free(ast);
+    shell_last_status = last_status;
     return last_status;
 }
 
+int shell_compile_file(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(path);
+        if (fd >= 0)
+            close(fd);
+        return 1;
+    }
+    // A cache entry is keyed on the file's size and mtime, which only mean
+    // something for a regular file
+    if (!S_ISREG(st.st_mode)) {
+        fprintf(stderr, "myshell: %s: not a regular file\n", path);
+        close(fd);
+        return 1;
+    }
+    size_t size = (size_t)st.st_size;
+    char *text = NULL;
+    if (size > 0 && (text = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        perror(path);
+        close(fd);
+        return 1;
+    }
+    close(fd);
+
+    ast_node_t *ast = NULL;
+    int error = 0;
+    if (size > 0) {
+        lexer_t *lexer = lexer_create_n(text, size);
+        parser_t *parser = parser_create(lexer);
+        ast = parser_parse_program(parser, &error);
+        parser_free(parser);
+        lexer_free(lexer);
+    }
+    int rc = error ? 2 : astcache_write(path, &st, text, size, ast) == 0 ? 0 : 1;
+    ast_free(ast);
+    if (text)
+        munmap(text, size);
+    return rc;
+}
+
 void shell_set_errexit(int on) {
     shell_flag_errexit = on ? 1 : 0;
 }
@@ -182,8 +346,19 @@ int shell_main(int argc, char **argv) {
     shell_running = 1; // ensure a fresh loop for each invocation
     // Ensure stdin stream flags are clear (tests may have hit EOF earlier)
     clearerr(stdin);
-    // Basic CLI: myshell [-e] [-x] [script [args...]]
+    // Basic CLI: myshell [-e] [-x] [script [args...]] | --compile script...
     int argi = 1;
+    if (argi < argc && strcmp(argv[argi], "--compile") == 0) {
+        int rc = argi + 1 < argc ? 0 : 1;
+        if (rc)
+            fprintf(stderr, "myshell: usage: myshell --compile script...\n");
+        for (++argi; argi < argc; ++argi) {
+            int file_rc = shell_compile_file(argv[argi]);
+            if (file_rc > rc)
+                rc = file_rc;
+        }
+        return rc;
+    }
     while (argi < argc && argv[argi][0] == '-' && argv[argi][1] != '\0') {
         if (strcmp(argv[argi], "-e") == 0)
             shell_set_errexit(1);
@@ -194,8 +369,12 @@ int shell_main(int argc, char **argv) {
         argi++;
     }
     if (argi < argc) {
-        // Non-interactive: run file
-        return shell_run_file(argv[argi]);
+        // Non-interactive: run file with the remaining arguments as $1...
+        env_positional_t saved = *env_positional();
+        env_set_positional(argv + argi + 1, argc - argi - 1);
+        int rc = shell_run_file(argv[argi]);
+        env_set_positional(saved.argv, saved.argc);
+        return rc;
     }
 
     char *line = NULL;
@@ -207,20 +386,26 @@ int shell_main(int argc, char **argv) {
     size_t multiline_capacity = 0;
     size_t multiline_length = 0;
 
+    int joined = 0; // the last buffered line ended with a backslash
+
     while (shell_running) {
         // Be defensive each iteration in case callers swap stdin between loops
         clearerr(stdin);
         // Drain any background children if interactive
         if (shell_interactive) {
             jobs_reap_background();
+            jobs_report_changes();
         }
         shell_print_prompt(multiline_length);
+        if (shell_interactive && shell_loop && childwatch_active())
+            shell_wait_for_input(multiline_length);
 
         if ((read = getline(&line, &len, stdin)) == -1) {
             if (feof(stdin)) {
-                // EOF reached. If we have a pending multiline command, execute it once.
+                // EOF reached. A pending command runs now, or its syntax
+                // error (such as a missing `done') is reported.
                 if (multiline_length > 0 && multiline_buffer && multiline_buffer[0] != '\0') {
-                    exit_code = execute_line(multiline_buffer);
+                    exit_code = execute_line(multiline_buffer, NULL);
                 }
                 break; // then exit loop
             } else {
@@ -247,35 +432,45 @@ int shell_main(int argc, char **argv) {
             read--;
         }
 
-        // If we're in continuation mode, use the multiline buffer; otherwise execute single line directly
+        // Lines continued with a backslash join with a space; lines of a
+        // command that is not finished yet keep their newline
+        const char *input = line;
         if (has_continuation || multiline_length > 0) {
-            // Accumulate the line in multiline buffer
             if (append_line(&multiline_buffer, &multiline_capacity, &multiline_length,
-                            line, (size_t)read) != 0) {
+                            line, (size_t)read, joined ? ' ' : '\n') != 0) {
                 perror("realloc");
                 exit_code = 1;
                 break;
             }
+            input = multiline_buffer;
+        }
+        joined = has_continuation;
+        if (has_continuation)
+            continue;
 
-            // If no continuation now, execute the accumulated buffer
-            if (!has_continuation && multiline_length > 0) {
-                exit_code = execute_line(multiline_buffer);
-
-                // Reset multiline buffer
-                multiline_length = 0;
-                if (multiline_buffer) {
-                    multiline_buffer[0] = '\0';
-                }
-
-                if (shell_flag_errexit && exit_code != 0)
-                    break;
-            }
-        } else {
-            // No continuation and nothing buffered: execute this line immediately
-            exit_code = execute_line(line);
-            if (shell_flag_errexit && exit_code != 0)
+        int incomplete;
+        exit_code = execute_line(input, &incomplete);
+        if (incomplete) {
+            // Keep the text (the first line may not be buffered yet) and
+            // read the rest of the command
+            if (multiline_length == 0 &&
+                append_line(&multiline_buffer, &multiline_capacity, &multiline_length,
+                            line, (size_t)read, '\n') != 0) {
+                perror("realloc");
+                exit_code = 1;
                 break;
+            }
+            continue;
+        }
+
+        // Reset multiline buffer
+        multiline_length = 0;
+        if (multiline_buffer) {
+            multiline_buffer[0] = '\0';
         }
+
+        if (shell_flag_errexit && exit_code != 0)
+            break;
     }
 
     // Clean up multiline buffer
@@ -293,3 +488,7 @@ int shell_main(int argc, char **argv) {
 int shell_get_last_status(void) {
     return shell_last_status;
 }
+
+void shell_set_last_status(int status) {
+    shell_last_status = status;
+}
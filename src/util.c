@@ -2,6 +2,7 @@
  * @file util.c
  * @brief Utility helpers for memory, strings, paths, and debugging.
  */
+#include "env.h"
 #include "util.h"
 #include <ctype.h>
 #include <stdarg.h>
@@ -98,7 +99,7 @@ char *resolve_path(const char *path) {
     }
 
     // Search in PATH
-    char *path_env = getenv("PATH");
+    const char *path_env = env_get("PATH");
     if (!path_env)
         return NULL;
 
@@ -0,0 +1,381 @@
+/**
+ * @file vm.c
+ * @brief Bytecode compiler and interpreter (MYSHELL_ENGINE=vm).
+ *
+ * The interpreter keeps one status register, the value exec_ast() would
+ * be returning at that point of the walk. Each construct compiles to code
+ * that leaves its status in the register; "return from this node early"
+ * in the tree walker becomes a jump to the end of the node's code, where
+ * the enclosing construct's code continues with the same status. Loops
+ * keep their own status and iteration state in a slot, one per loop
+ * nesting level of the program.
+ */
+#include "vm.h"
+#include "ast_node.h"
+#include "exec.h"
+#include "exec_vm.h"
+#include "shell.h"
+#include "util.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+/** Opcodes. "status" is the register; a and b are instruction operands. */
+typedef enum {
+    VM_HALT,      // end of program: return status
+    VM_COMMAND,   // status = exec_command(nodes[a])
+    VM_NODE,      // status = exec_ast(nodes[a]): pipeline, subshell, &, function definition
+    VM_SET,       // status = a
+    VM_JUMP,      // goto a
+    VM_JUMP_STOP, // after a list element: goto a if the list must stop (interrupt, -e)
+    VM_JUMP_AND,  // after the left of &&: goto a unless it succeeded
+    VM_JUMP_OR,   // after the left of ||: goto a unless it failed
+    VM_JUMP_IF,   // after a condition: goto a on interrupt, b if it failed
+    VM_LOOP,      // start a while/until loop in slot
+    VM_LOOP_TEST, // after the condition: goto a (next) or b (exit); flag: until
+    VM_LOOP_NEXT, // after a loop body: goto a (next iteration) or b (exit)
+    VM_LOOP_END,  // leave the loop in slot: status = its status
+    VM_FOR,       // start the for loop nodes[a] in slot: expand its words
+    VM_FOR_NEXT,  // set the variable to the next word, or goto a when done
+    VM_FOR_END,   // leave the for loop in slot: status = its status
+    VM_CASE,      // match case nodes[a]: goto table[b + item], or table[b + n_items]
+                  // (one past it, status 1, if the word fails to expand)
+} vm_op_t;
+
+static const char *const op_names[] = {
+    "halt",      "command",   "node",     "set",      "jump",     "jump_stop",
+    "jump_and",  "jump_or",   "jump_if",  "loop",     "loop_test", "loop_next",
+    "loop_end",  "for",       "for_next", "for_end",  "case",
+};
+
+/** One instruction (12 bytes). */
+typedef struct {
+    uint8_t op;
+    uint8_t flag;
+    uint16_t slot;
+    int32_t a;
+    int32_t b;
+} vm_insn_t;
+
+struct vm_program {
+    vm_insn_t *code;
+    int n_code;
+    ast_node_t **nodes; // operands: nodes of the tree the program came from
+    int n_nodes;
+    int32_t *table;     // case jump tables
+    int n_table;
+    int n_slots;
+};
+
+/** Compiler state around the program being built. */
+typedef struct {
+    vm_program_t *program;
+    int code_capacity;
+    int nodes_capacity;
+    int table_capacity;
+    int depth; // loops open at the current point
+} vm_compiler_t;
+
+/** Runtime state of one loop. */
+typedef struct {
+    int status;
+    int index;              // for: next word
+    expand_fields_t fields; // for: words
+    arena_mark_t mark;      // for: where its words start in exec_arena()
+} vm_slot_t;
+
+/** Slots on the C stack before vm_run() allocates them. */
+#define VM_LOCAL_SLOTS 8
+
+// Grow an array of count elements to hold one more.
+static void *grow(void *array, int count, int *capacity, size_t size) {
+    if (count < *capacity)
+        return array;
+    *capacity = *capacity ? *capacity * 2 : 64;
+    return realloc_safe(array, (size_t)*capacity * size);
+}
+
+static int emit(vm_compiler_t *c, vm_op_t op, int slot, int a, int b) {
+    vm_program_t *p = c->program;
+    p->code = grow(p->code, p->n_code, &c->code_capacity, sizeof(vm_insn_t));
+    p->code[p->n_code] = (vm_insn_t){.op = op, .slot = (uint16_t)slot, .a = a, .b = b};
+    return p->n_code++;
+}
+
+static int operand(vm_compiler_t *c, ast_node_t *node) {
+    vm_program_t *p = c->program;
+    p->nodes = grow(p->nodes, p->n_nodes, &c->nodes_capacity, sizeof(ast_node_t *));
+    p->nodes[p->n_nodes] = node;
+    return p->n_nodes++;
+}
+
+// Forward jumps to a label not placed yet are chained through their a
+// operands; point every jump in the chain at target.
+static void patch(vm_compiler_t *c, int chain, int target) {
+    while (chain >= 0) {
+        int next = c->program->code[chain].a;
+        c->program->code[chain].a = target;
+        chain = next;
+    }
+}
+
+static int open_loop(vm_compiler_t *c) {
+    int slot = c->depth++;
+    if (c->depth > c->program->n_slots)
+        c->program->n_slots = c->depth;
+    return slot;
+}
+
+static void compile(vm_compiler_t *c, ast_node_t *node) {
+    vm_program_t *p = c->program;
+    if (!node) {
+        emit(c, VM_SET, 0, -1, 0);
+        return;
+    }
+    switch (node->type) {
+    case AST_COMMAND:
+        emit(c, VM_COMMAND, 0, operand(c, node), 0);
+        break;
+    case AST_SEQUENCE: {
+        // The right spine becomes straight-line code
+        int stops = -1;
+        while (node && node->type == AST_SEQUENCE) {
+            compile(c, node->data.sequence.left);
+            stops = emit(c, VM_JUMP_STOP, 0, stops, 0);
+            node = node->data.sequence.right;
+        }
+        compile(c, node);
+        patch(c, stops, p->n_code);
+        break;
+    }
+    case AST_AND:
+    case AST_OR: {
+        compile(c, node->data.boollist.left);
+        int skip = emit(c, node->type == AST_AND ? VM_JUMP_AND : VM_JUMP_OR, 0, -1, 0);
+        compile(c, node->data.boollist.right);
+        patch(c, skip, p->n_code);
+        break;
+    }
+    case AST_IF: {
+        // One test per if/elif; every exit joins at the end
+        int ends = -1;
+        while (node && node->type == AST_IF) {
+            compile(c, node->data.if_clause.cond);
+            int test = emit(c, VM_JUMP_IF, 0, ends, -1);
+            ends = test;
+            compile(c, node->data.if_clause.then_part);
+            ends = emit(c, VM_JUMP, 0, ends, 0);
+            p->code[test].b = p->n_code;
+            node = node->data.if_clause.else_part;
+        }
+        if (node)
+            compile(c, node);
+        else
+            emit(c, VM_SET, 0, 0, 0);
+        patch(c, ends, p->n_code);
+        break;
+    }
+    case AST_WHILE:
+    case AST_UNTIL: {
+        int slot = open_loop(c);
+        emit(c, VM_LOOP, slot, 0, 0);
+        int top = p->n_code;
+        compile(c, node->data.loop.cond);
+        int test = emit(c, VM_LOOP_TEST, slot, top, -1);
+        p->code[test].flag = node->type == AST_UNTIL;
+        compile(c, node->data.loop.body);
+        int next = emit(c, VM_LOOP_NEXT, slot, top, -1);
+        p->code[test].b = p->code[next].b = p->n_code;
+        emit(c, VM_LOOP_END, slot, 0, 0);
+        c->depth--;
+        break;
+    }
+    case AST_FOR: {
+        int slot = open_loop(c);
+        int loop = operand(c, node);
+        emit(c, VM_FOR, slot, loop, 0);
+        int top = emit(c, VM_FOR_NEXT, slot, -1, loop);
+        compile(c, node->data.for_clause.body);
+        int next = emit(c, VM_LOOP_NEXT, slot, top, -1);
+        p->code[top].a = p->code[next].b = p->n_code;
+        emit(c, VM_FOR_END, slot, 0, 0);
+        c->depth--;
+        break;
+    }
+    case AST_CASE: {
+        int n = node->data.case_clause.n_items;
+        int table = p->n_table;
+        for (int i = 0; i <= n; ++i) {
+            p->table = grow(p->table, p->n_table, &c->table_capacity, sizeof(int32_t));
+            p->n_table++;
+        }
+        emit(c, VM_CASE, 0, operand(c, node), table);
+        int ends = -1;
+        for (int i = 0; i < n; ++i) {
+            ast_node_t *body = node->data.case_clause.items[i].body;
+            p->table[table + i] = p->n_code;
+            if (body)
+                compile(c, body);
+            else
+                emit(c, VM_SET, 0, 0, 0); // empty item: `pattern) ;;`
+            ends = emit(c, VM_JUMP, 0, ends, 0);
+        }
+        p->table[table + n] = p->n_code;
+        emit(c, VM_SET, 0, 0, 0); // no match
+        patch(c, ends, p->n_code);
+        break;
+    }
+    case AST_PIPELINE:
+    case AST_BACKGROUND:
+    case AST_SUBSHELL:
+    case AST_FUNCTION:
+        emit(c, VM_NODE, 0, operand(c, node), 0);
+        break;
+    default:
+        emit(c, VM_SET, 0, -1, 0);
+        break;
+    }
+}
+
+vm_program_t *vm_compile(ast_node_t *ast) {
+    vm_compiler_t c = {0};
+    c.program = malloc_safe(sizeof(vm_program_t));
+    *c.program = (vm_program_t){0};
+    compile(&c, ast);
+    emit(&c, VM_HALT, 0, 0, 0);
+    return c.program;
+}
+
+int vm_run(const vm_program_t *program) {
+    if (!program)
+        return -1;
+    vm_slot_t local[VM_LOCAL_SLOTS];
+    vm_slot_t *slots = local;
+    if (program->n_slots > VM_LOCAL_SLOTS)
+        slots = malloc_safe((size_t)program->n_slots * sizeof(vm_slot_t));
+    const vm_insn_t *code = program->code;
+    ast_node_t *const *nodes = program->nodes;
+    int status = 0;
+    int pc = 0;
+    for (;;) {
+        const vm_insn_t *insn = &code[pc++];
+        vm_slot_t *slot = &slots[insn->slot];
+        switch ((vm_op_t)insn->op) {
+        case VM_HALT:
+            if (slots != local)
+                free(slots);
+            return status;
+        case VM_COMMAND:
+            status = exec_command((ast_command_t *)nodes[insn->a]);
+            break;
+        case VM_NODE:
+            status = exec_ast(nodes[insn->a]);
+            break;
+        case VM_SET:
+            status = insn->a;
+            break;
+        case VM_JUMP:
+            pc = insn->a;
+            break;
+        case VM_JUMP_STOP:
+            shell_set_last_status(status);
+            if (exec_interrupted() || (shell_flag_errexit && status != 0))
+                pc = insn->a;
+            break;
+        case VM_JUMP_AND:
+            shell_set_last_status(status);
+            if (status != 0 || exec_interrupted())
+                pc = insn->a;
+            break;
+        case VM_JUMP_OR:
+            shell_set_last_status(status);
+            if (status == 0 || exec_interrupted())
+                pc = insn->a;
+            break;
+        case VM_JUMP_IF:
+            shell_set_last_status(status);
+            if (exec_interrupted())
+                pc = insn->a;
+            else if (status != 0)
+                pc = insn->b;
+            break;
+        case VM_LOOP:
+            slot->status = 0;
+            exec_loop_enter();
+            break;
+        case VM_LOOP_TEST:
+            shell_set_last_status(status);
+            if (exec_interrupted())
+                pc = exec_loop_stop() ? insn->b : insn->a;
+            else if ((status == 0) == insn->flag)
+                pc = insn->b;
+            break;
+        case VM_LOOP_NEXT:
+            slot->status = status;
+            shell_set_last_status(status);
+            if (exec_loop_stop() || (shell_flag_errexit && status != 0))
+                pc = insn->b;
+            else
+                pc = insn->a;
+            break;
+        case VM_LOOP_END:
+            exec_loop_leave();
+            status = slot->status;
+            break;
+        case VM_FOR:
+            slot->index = 0;
+            slot->mark = arena_mark(exec_arena());
+            // A failed expansion leaves no words: the loop ends at once
+            slot->status = exec_for_words(nodes[insn->a], &slot->fields);
+            exec_loop_enter();
+            break;
+        case VM_FOR_NEXT:
+            if (slot->index >= slot->fields.n) {
+                pc = insn->a;
+            } else if (exec_for_assign(nodes[insn->b], slot->fields.words[slot->index++]) != 0) {
+                slot->status = 1;
+                pc = insn->a;
+            }
+            break;
+        case VM_FOR_END:
+            exec_loop_leave();
+            arena_release(exec_arena(), slot->mark);
+            status = slot->status;
+            break;
+        case VM_CASE: {
+            ast_node_t *node = nodes[insn->a];
+            int item;
+            int rc = exec_case_match(node, &item);
+            pc = program->table[insn->b + (item >= 0 ? item : node->data.case_clause.n_items)];
+            if (rc != 0) {
+                // Step over the no-match VM_SET to the end of the case
+                status = rc;
+                pc++;
+            }
+            break;
+        }
+        }
+    }
+}
+
+void vm_free(vm_program_t *program) {
+    if (!program)
+        return;
+    free(program->code);
+    free(program->nodes);
+    free(program->table);
+    free(program);
+}
+
+int vm_length(const vm_program_t *program) {
+    return program ? program->n_code : 0;
+}
+
+void vm_dump(const vm_program_t *program, FILE *out) {
+    if (!program)
+        return;
+    for (int pc = 0; pc < program->n_code; ++pc) {
+        const vm_insn_t *insn = &program->code[pc];
+        fprintf(out, "%5d  %-10s slot=%u a=%d b=%d%s\n", pc, op_names[insn->op], insn->slot,
+                insn->a, insn->b, insn->flag ? " until" : "");
+    }
+}
@@ -0,0 +1,62 @@
+#include "arena.h"
+#include "unity.h"
+#include <stdint.h>
+#include <string.h>
+
+void test_arena_alloc_aligned_and_distinct(void) {
+    arena_t arena;
+    arena_init(&arena, 256);
+    char *prev = NULL;
+    for (int i = 1; i < 200; ++i) {
+        char *p = arena_alloc(&arena, (size_t)i % 40);
+        TEST_ASSERT_EQUAL(0, (uintptr_t)p % _Alignof(max_align_t));
+        TEST_ASSERT_TRUE(p != prev);
+        memset(p, 'x', (size_t)i % 40);
+        prev = p;
+    }
+    // Larger than a chunk: served from a dedicated block
+    char *big = arena_alloc(&arena, 10000);
+    memset(big, 'y', 10000);
+    TEST_ASSERT_EQUAL_STRING("abc", arena_strndup(&arena, "abcdef", 3));
+    arena_free(&arena);
+}
+
+void test_arena_mark_release_reuses_memory(void) {
+    arena_t arena;
+    arena_init(&arena, 0);
+    char *keep = arena_strndup(&arena, "keep", 4);
+
+    arena_mark_t mark = arena_mark(&arena);
+    char *first = arena_alloc(&arena, 64);
+    arena_alloc(&arena, 5000); // dedicated block, freed on release
+    for (int i = 0; i < 100; ++i)
+        arena_alloc(&arena, 500); // spills into further chunks
+    arena_release(&arena, mark);
+
+    // The next allocation lands where the released ones started
+    TEST_ASSERT_EQUAL_PTR(first, arena_alloc(&arena, 64));
+    TEST_ASSERT_EQUAL_STRING("keep", keep);
+
+    arena_reset(&arena);
+    TEST_ASSERT_EQUAL_PTR(keep, arena_alloc(&arena, 8));
+    arena_free(&arena);
+}
+
+void test_arena_adopt_moves_allocations(void) {
+    arena_t a, b;
+    arena_init(&a, 256);
+    arena_init(&b, 256);
+    char *in_a = arena_strndup(&a, "first", 5);
+    char *in_b = arena_strndup(&b, "second", 6);
+    char *big = arena_alloc(&b, 4096);
+    memset(big, 'z', 4096);
+
+    arena_adopt(&a, &b);
+    TEST_ASSERT_NULL(b.first);
+    TEST_ASSERT_NULL(b.large);
+    TEST_ASSERT_EQUAL_STRING("first", in_a);
+    TEST_ASSERT_EQUAL_STRING("second", in_b);
+    TEST_ASSERT_EQUAL_STRING("more", arena_strndup(&a, "more", 4));
+    arena_free(&b);
+    arena_free(&a); // frees b's former chunks too (checked by ASan)
+}
@@ -0,0 +1,79 @@
+#include "arith.h"
+#include "env.h"
+#include "unity.h"
+#include <limits.h>
+
+// Test functions only - setUp/tearDown and main are in test_runner.c
+
+static long eval_ok(const char *expr) {
+    long v = -12345;
+    TEST_ASSERT_EQUAL_MESSAGE(0, arith_eval(expr, &v), expr);
+    return v;
+}
+
+void test_arith_precedence_and_operators(void) {
+    TEST_ASSERT_EQUAL(0, eval_ok(""));
+    TEST_ASSERT_EQUAL(7, eval_ok("1 + 2 * 3"));
+    TEST_ASSERT_EQUAL(9, eval_ok("(1 + 2) * 3"));
+    TEST_ASSERT_EQUAL(-3, eval_ok("-7 / 2"));
+    TEST_ASSERT_EQUAL(-1, eval_ok("-7 % 2"));
+    TEST_ASSERT_EQUAL(512, eval_ok("2 ** 3 ** 2"));
+    TEST_ASSERT_EQUAL(4, eval_ok("-2 ** 2"));
+    TEST_ASSERT_EQUAL(24, eval_ok("0x10 + 010"));
+    TEST_ASSERT_EQUAL(20, eval_ok("5 << 2 >> 0"));
+    TEST_ASSERT_EQUAL(1, eval_ok("1 < 2 == 2 > 1"));
+    TEST_ASSERT_EQUAL(6, eval_ok("6 & 7 | 0 ^ 0"));
+    TEST_ASSERT_EQUAL(1, eval_ok("!0 && ~0 == -1"));
+    TEST_ASSERT_EQUAL(7, eval_ok("5--2"));
+    TEST_ASSERT_EQUAL(30, eval_ok("0 ? 20 : 1 ? 30 : 40"));
+    TEST_ASSERT_EQUAL(3, eval_ok("1, 2, 3"));
+    TEST_ASSERT_EQUAL(LONG_MIN, eval_ok("9223372036854775807 + 1"));
+    TEST_ASSERT_EQUAL(LONG_MIN, eval_ok("(-9223372036854775807 - 1) / -1"));
+}
+
+void test_arith_variables_and_assignment(void) {
+    env_assign("TEST_AR_I", "5");
+    TEST_ASSERT_EQUAL(5, eval_ok("TEST_AR_I++"));
+    TEST_ASSERT_EQUAL_STRING("6", env_get("TEST_AR_I"));
+    TEST_ASSERT_EQUAL(7, eval_ok("++TEST_AR_I"));
+    TEST_ASSERT_EQUAL(70, eval_ok("TEST_AR_I *= 10"));
+    TEST_ASSERT_EQUAL(2, eval_ok("TEST_AR_I %= 4"));
+    TEST_ASSERT_EQUAL(8, eval_ok("TEST_AR_I <<= 2"));
+    TEST_ASSERT_EQUAL(3, eval_ok("TEST_AR_J = TEST_AR_K = 3"));
+    TEST_ASSERT_EQUAL_STRING("3", env_get("TEST_AR_J"));
+    TEST_ASSERT_FALSE(env_is_exported("TEST_AR_J"));
+
+    // Unset counts as 0; values are evaluated as expressions
+    env_unset("TEST_AR_U");
+    TEST_ASSERT_EQUAL(1, eval_ok("TEST_AR_U + 1"));
+    env_assign("TEST_AR_E", "TEST_AR_I + 1");
+    TEST_ASSERT_EQUAL(18, eval_ok("TEST_AR_E * 2"));
+
+    // Branches that are not taken have no side effects
+    TEST_ASSERT_EQUAL(0, eval_ok("0 && (TEST_AR_I = 100)"));
+    TEST_ASSERT_EQUAL(1, eval_ok("1 || (TEST_AR_I = 100)"));
+    TEST_ASSERT_EQUAL(8, eval_ok("1 ? TEST_AR_I : (TEST_AR_I = 100)"));
+    TEST_ASSERT_EQUAL(0, eval_ok("0 && 1 / 0"));
+    TEST_ASSERT_EQUAL_STRING("8", env_get("TEST_AR_I"));
+
+    const char *names[] = {"TEST_AR_I", "TEST_AR_J", "TEST_AR_K", "TEST_AR_E"};
+    for (int i = 0; i < 4; ++i)
+        env_unset(names[i]);
+}
+
+void test_arith_errors(void) {
+    long v = 42;
+    TEST_ASSERT_EQUAL(-1, arith_eval("1 / 0", &v));
+    TEST_ASSERT_EQUAL(-1, arith_eval("1 +", &v));
+    TEST_ASSERT_EQUAL(-1, arith_eval("(1 + 2", &v));
+    TEST_ASSERT_EQUAL(-1, arith_eval("2 3", &v));
+    TEST_ASSERT_EQUAL(-1, arith_eval("08", &v));
+    TEST_ASSERT_EQUAL(-1, arith_eval("2 ** -1", &v));
+    TEST_ASSERT_EQUAL(-1, arith_eval("1 = 2", &v));
+    TEST_ASSERT_EQUAL(42, v);
+
+    // A variable that refers to itself hits the recursion limit
+    env_assign("TEST_AR_SELF", "TEST_AR_SELF + 1");
+    TEST_ASSERT_EQUAL(-1, arith_eval("TEST_AR_SELF", &v));
+    env_unset("TEST_AR_SELF");
+}
@@ -0,0 +1,173 @@
+#include "astcache.h"
+#include "env.h"
+#include "exec.h"
+#include "func.h"
+#include "parser.h"
+#include "shell.h"
+#include "unity.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char script_text[] =
+    "#!/bin/sh\n"
+    "ac_add() { local s=$(( $1 + $2 )); AC_SUM=$(( AC_SUM + s )); }\n"
+    "AC_SUM=0\n"
+    "for w in 1 2 3; do ac_add $w 10; done\n"
+    "case $AC_SUM in 3?) AC_CASE=thirties ;; *) AC_CASE=other ;; esac\n"
+    "if test -n \"$1\"; then AC_ARG=$1; else AC_ARG=none; fi\n"
+    "echo redirected > /dev/null 2>&1\n";
+
+static char dir[64];
+static char script[96];
+
+static void make_script(const char *text) {
+    strcpy(dir, "/tmp/test_astcache_XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+    snprintf(script, sizeof script, "%s/script.sh", dir);
+    FILE *f = fopen(script, "w");
+    TEST_ASSERT_NOT_NULL(f);
+    fputs(text, f);
+    fclose(f);
+    env_set("MYSHELL_CACHE_DIR", dir);
+}
+
+static void remove_script(void) {
+    char cache[256];
+    if (astcache_path(script, cache, sizeof cache) == 0)
+        unlink(cache);
+    unlink(script);
+    rmdir(dir);
+    env_unset("MYSHELL_CACHE_DIR");
+}
+
+// astcache_load() for the script's current contents.
+static int load(astcache_image_t *image) {
+    int fd = open(script, O_RDONLY);
+    TEST_ASSERT_TRUE(fd >= 0);
+    struct stat st;
+    fstat(fd, &st);
+    char *text = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    TEST_ASSERT_TRUE(text != MAP_FAILED);
+    int rc = astcache_load(script, &st, text, (size_t)st.st_size, image);
+    munmap(text, (size_t)st.st_size);
+    return rc;
+}
+
+void test_astcache_compiled_script_runs_from_cache(void) {
+    make_script(script_text);
+    astcache_image_t image;
+    TEST_ASSERT_EQUAL(-1, load(&image)); // nothing compiled yet
+    TEST_ASSERT_EQUAL(0, shell_compile_file(script));
+    TEST_ASSERT_EQUAL(0, load(&image));
+    TEST_ASSERT_NOT_NULL(image.root);
+
+    // The relocated tree runs like the parsed one
+    env_unset("AC_SUM");
+    TEST_ASSERT_EQUAL(0, exec_ast(image.root));
+    TEST_ASSERT_EQUAL_STRING("36", env_get("AC_SUM"));
+    TEST_ASSERT_EQUAL_STRING("thirties", env_get("AC_CASE"));
+    TEST_ASSERT_EQUAL_STRING("none", env_get("AC_ARG"));
+    astcache_release(&image);
+    TEST_ASSERT_NULL(image.map);
+    astcache_release(&image);
+
+    // The function defined from the mapping outlives it
+    lexer_t *lexer = lexer_create("ac_add 5 5");
+    parser_t *parser = parser_create(lexer);
+    ast_node_t *ast = parser_parse_program(parser, NULL);
+    TEST_ASSERT_EQUAL(0, exec_ast(ast));
+    ast_free(ast);
+    parser_free(parser);
+    lexer_free(lexer);
+    TEST_ASSERT_EQUAL_STRING("46", env_get("AC_SUM"));
+
+    // shell_run_file() takes the cached tree, with arguments
+    env_positional_t saved = *env_positional();
+    char *args[] = {"given", NULL};
+    env_set_positional(args, 1);
+    TEST_ASSERT_EQUAL(0, shell_run_file(script));
+    env_set_positional(saved.argv, saved.argc);
+    TEST_ASSERT_EQUAL_STRING("36", env_get("AC_SUM"));
+    TEST_ASSERT_EQUAL_STRING("given", env_get("AC_ARG"));
+    func_unset("ac_add");
+    remove_script();
+}
+
+void test_astcache_stale_or_corrupt_cache_misses(void) {
+    make_script("AC_V=old\n");
+    astcache_image_t image;
+    TEST_ASSERT_EQUAL(0, shell_compile_file(script));
+    TEST_ASSERT_EQUAL(0, load(&image));
+    astcache_release(&image);
+
+    // Same size, new contents: the cache is stale and the script is parsed
+    FILE *f = fopen(script, "w");
+    fputs("AC_V=new\n", f);
+    fclose(f);
+    TEST_ASSERT_EQUAL(-1, load(&image));
+    TEST_ASSERT_EQUAL(0, shell_run_file(script));
+    TEST_ASSERT_EQUAL_STRING("new", env_get("AC_V"));
+
+    // A flipped byte in the image, then a truncated file
+    TEST_ASSERT_EQUAL(0, shell_compile_file(script));
+    char cache[256];
+    TEST_ASSERT_EQUAL(0, astcache_path(script, cache, sizeof cache));
+    struct stat st;
+    TEST_ASSERT_EQUAL(0, stat(cache, &st));
+    int fd = open(cache, O_RDWR);
+    char byte;
+    TEST_ASSERT_EQUAL(1, pread(fd, &byte, 1, st.st_size - 20));
+    byte ^= 0x40;
+    TEST_ASSERT_EQUAL(1, pwrite(fd, &byte, 1, st.st_size - 20));
+    TEST_ASSERT_EQUAL(-1, load(&image));
+    TEST_ASSERT_EQUAL(0, ftruncate(fd, 32));
+    close(fd);
+    TEST_ASSERT_EQUAL(-1, load(&image));
+    env_unset("AC_V");
+    TEST_ASSERT_EQUAL(0, shell_run_file(script));
+    TEST_ASSERT_EQUAL_STRING("new", env_get("AC_V"));
+
+    // Syntax errors are reported and nothing is cached
+    f = fopen(script, "w");
+    fputs("if then\n", f);
+    fclose(f);
+    unlink(cache);
+    TEST_ASSERT_EQUAL(2, shell_compile_file(script));
+    TEST_ASSERT_EQUAL(-1, access(cache, F_OK));
+    remove_script();
+}
+
+void test_astcache_dir_follows_shell_variables(void) {
+    char *home = env_get("HOME") ? strdup(env_get("HOME")) : NULL;
+    char *xdg = env_get("XDG_CACHE_HOME") ? strdup(env_get("XDG_CACHE_HOME")) : NULL;
+    char path[256];
+
+    // Unexported assignments made in the shell pick the directory
+    env_unset("XDG_CACHE_HOME");
+    env_assign("HOME", "/tmp/test_astcache_home");
+    TEST_ASSERT_EQUAL(0, astcache_path("/", path, sizeof path));
+    TEST_ASSERT_EQUAL(0, strncmp(path, "/tmp/test_astcache_home/.cache/myshell/", 39));
+    env_assign("XDG_CACHE_HOME", "/tmp/test_astcache_xdg");
+    TEST_ASSERT_EQUAL(0, astcache_path("/", path, sizeof path));
+    TEST_ASSERT_EQUAL(0, strncmp(path, "/tmp/test_astcache_xdg/myshell/", 31));
+
+    env_set("MYSHELL_CACHE_DIR", "/tmp/test_astcache_own");
+    TEST_ASSERT_EQUAL(0, astcache_path("/", path, sizeof path));
+    TEST_ASSERT_EQUAL(0, strncmp(path, "/tmp/test_astcache_own/", 23));
+    env_unset("MYSHELL_CACHE_DIR");
+
+    env_unset("XDG_CACHE_HOME");
+    if (xdg)
+        env_set("XDG_CACHE_HOME", xdg);
+    env_unset("HOME");
+    if (home)
+        env_set("HOME", home);
+    free(xdg);
+    free(home);
+}
@@ -1,7 +1,9 @@
 #include "builtin.h"
 #include "unity.h"
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 void test_builtin_find_existing(void) {
     // Try to find a builtin that should exist (cd)
@@ -123,3 +125,77 @@ void test_builtin_find_all_core_builtins(void) {
     TEST_ASSERT_NOT_NULL(builtin_find("bg"));
     TEST_ASSERT_NOT_NULL(builtin_find("type"));
 }
+
+// Run a builtin with stdout captured into buf (NUL-terminated).
+static int run_captured(builtin_func_t func, int argc, char **argv, char *buf, size_t cap) {
+    char path[] = "/tmp/myshell_builtin_XXXXXX";
+    int fd = mkstemp(path);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    dup2(fd, STDOUT_FILENO);
+    int rc = func(argc, argv);
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    ssize_t n = pread(fd, buf, cap - 1, 0);
+    buf[n > 0 ? n : 0] = '\0';
+    close(fd);
+    unlink(path);
+    return rc;
+}
+
+void test_builtin_echo_options(void) {
+    char buf[128];
+    char *plain[] = {"echo", "a", "b", NULL};
+    TEST_ASSERT_EQUAL(0, run_captured(builtin_echo, 3, plain, buf, sizeof buf));
+    TEST_ASSERT_EQUAL_STRING("a b\n", buf);
+    char *n[] = {"echo", "-n", "x", NULL};
+    run_captured(builtin_echo, 3, n, buf, sizeof buf);
+    TEST_ASSERT_EQUAL_STRING("x", buf);
+    char *e[] = {"echo", "-e", "a\\tb\\c", "ignored", NULL};
+    run_captured(builtin_echo, 4, e, buf, sizeof buf);
+    TEST_ASSERT_EQUAL_STRING("a\tb", buf);
+    char *not_opt[] = {"echo", "-x", NULL};
+    run_captured(builtin_echo, 2, not_opt, buf, sizeof buf);
+    TEST_ASSERT_EQUAL_STRING("-x\n", buf);
+}
+
+void test_builtin_printf_formats(void) {
+    char buf[128];
+    char *reuse[] = {"printf", "%s=%d,", "a", "1", "b", "2", NULL};
+    TEST_ASSERT_EQUAL(0, run_captured(builtin_printf, 6, reuse, buf, sizeof buf));
+    TEST_ASSERT_EQUAL_STRING("a=1,b=2,", buf);
+    char *widths[] = {"printf", "[%5.1f|%-3s|%x|%%]\\n", "2.25", "ab", "255", NULL};
+    run_captured(builtin_printf, 5, widths, buf, sizeof buf);
+    TEST_ASSERT_EQUAL_STRING("[  2.2|ab |ff|%]\n", buf);
+    char *chars[] = {"printf", "%c|%c|%2c|%c.", "", "xy", "", NULL};
+    run_captured(builtin_printf, 5, chars, buf, sizeof buf);
+    TEST_ASSERT_EQUAL_STRING("|x|  |.", buf);
+    char *bad[] = {"printf", "%d", "abc", NULL};
+    TEST_ASSERT_EQUAL(1, run_captured(builtin_printf, 3, bad, buf, sizeof buf));
+}
+
+void test_builtin_test_expressions(void) {
+    char *eq[] = {"test", "2", "-eq", "2", NULL};
+    TEST_ASSERT_EQUAL(0, builtin_test(4, eq));
+    char *str[] = {"[", "a", "!=", "a", "]", NULL};
+    TEST_ASSERT_EQUAL(1, builtin_test(5, str));
+    char *dir[] = {"[", "!", "-d", "/", "]", NULL};
+    TEST_ASSERT_EQUAL(1, builtin_test(5, dir));
+    char *andor[] = {"test", "-z", "", "-a", "(", "1", "-lt", "0", "-o", "-e", "/", ")", NULL};
+    TEST_ASSERT_EQUAL(0, builtin_test(12, andor));
+    char *empty[] = {"test", NULL};
+    TEST_ASSERT_EQUAL(1, builtin_test(1, empty));
+    char *unclosed[] = {"[", "x", NULL};
+    TEST_ASSERT_EQUAL(2, builtin_test(2, unclosed));
+    char *badint[] = {"test", "x", "-gt", "1", NULL};
+    TEST_ASSERT_EQUAL(2, builtin_test(4, badint));
+}
+
+void test_builtin_true_false_colon(void) {
+    char *args[] = {"x", NULL};
+    TEST_ASSERT_EQUAL(0, builtin_execute("true", 1, args));
+    TEST_ASSERT_EQUAL(1, builtin_execute("false", 1, args));
+    TEST_ASSERT_EQUAL(0, builtin_execute(":", 1, args));
+}
@@ -0,0 +1,82 @@
+#include "childwatch.h"
+#include "evloop.h"
+#include "unity.h"
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static pid_t fork_exit(int code) {
+    pid_t pid = fork();
+    if (pid == 0)
+        _exit(code);
+    return pid;
+}
+
+void test_childwatch_wait_without_init_uses_waitpid(void) {
+    TEST_ASSERT_FALSE(childwatch_active());
+    pid_t pid = fork_exit(3);
+    TEST_ASSERT_TRUE(pid > 0);
+    int status = 0;
+    TEST_ASSERT_EQUAL(0, childwatch_wait(pid, &status));
+    TEST_ASSERT_TRUE(WIFEXITED(status));
+    TEST_ASSERT_EQUAL(3, WEXITSTATUS(status));
+    TEST_ASSERT_EQUAL(-1, childwatch_add(pid, NULL, NULL));
+}
+
+void test_childwatch_wait_reaps_from_loop(void) {
+    evloop_t *loop = evloop_create();
+    TEST_ASSERT_EQUAL(0, childwatch_init(loop));
+    TEST_ASSERT_TRUE(childwatch_active());
+    TEST_ASSERT_EQUAL(0, childwatch_init(loop)); // idempotent
+
+    pid_t pid = fork_exit(5);
+    int status = 0;
+    TEST_ASSERT_EQUAL(0, childwatch_wait(pid, &status));
+    TEST_ASSERT_TRUE(WIFEXITED(status));
+    TEST_ASSERT_EQUAL(5, WEXITSTATUS(status));
+    // Already reaped: no zombie left behind
+    TEST_ASSERT_EQUAL(-1, waitpid(pid, NULL, WNOHANG));
+
+    childwatch_shutdown();
+    TEST_ASSERT_FALSE(childwatch_active());
+    evloop_free(loop);
+}
+
+typedef struct {
+    int events;
+    int last_status;
+} watch_record_t;
+
+static void record_event(pid_t pid, int status, void *data) {
+    (void)pid;
+    watch_record_t *rec = data;
+    rec->events++;
+    rec->last_status = status;
+}
+
+void test_childwatch_reports_stop_and_exit(void) {
+    evloop_t *loop = evloop_create();
+    TEST_ASSERT_EQUAL(0, childwatch_init(loop));
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        raise(SIGSTOP);
+        _exit(7);
+    }
+    watch_record_t rec = {0, 0};
+    TEST_ASSERT_EQUAL(0, childwatch_add(pid, record_event, &rec));
+
+    while (rec.events == 0)
+        TEST_ASSERT_EQUAL(0, childwatch_dispatch());
+    TEST_ASSERT_TRUE(WIFSTOPPED(rec.last_status));
+    TEST_ASSERT_EQUAL(SIGSTOP, WSTOPSIG(rec.last_status));
+
+    kill(pid, SIGCONT);
+    while (!WIFEXITED(rec.last_status))
+        TEST_ASSERT_EQUAL(0, childwatch_dispatch());
+    TEST_ASSERT_EQUAL(7, WEXITSTATUS(rec.last_status));
+
+    childwatch_shutdown();
+    evloop_free(loop);
+}
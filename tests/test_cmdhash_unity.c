@@ -0,0 +1,64 @@
+#include "builtin.h"
+#include "cmdhash.h"
+#include "env.h"
+#include "unity.h"
+#include <stdlib.h>
+#include <string.h>
+
+void test_cmdhash_lookup_fills_table(void) {
+    cmdhash_clear();
+    TEST_ASSERT_NULL(cmdhash_peek("sh"));
+    const char *path = cmdhash_lookup("sh");
+    TEST_ASSERT_NOT_NULL(path);
+    TEST_ASSERT_EQUAL('/', path[0]);
+    TEST_ASSERT_EQUAL_STRING(path, cmdhash_peek("sh"));
+    cmdhash_clear();
+}
+
+void test_cmdhash_lookup_rejects_paths_and_missing(void) {
+    TEST_ASSERT_NULL(cmdhash_lookup("/bin/sh"));
+    TEST_ASSERT_NULL(cmdhash_lookup("nonexistent_command_xyz123"));
+    TEST_ASSERT_NULL(cmdhash_lookup(NULL));
+    TEST_ASSERT_NULL(cmdhash_lookup(""));
+}
+
+void test_cmdhash_path_assignment_invalidates(void) {
+    char *saved = strdup(getenv("PATH"));
+    cmdhash_clear();
+    TEST_ASSERT_NOT_NULL(cmdhash_lookup("sh"));
+    env_set("PATH", "/nonexistent_dir_xyz");
+    TEST_ASSERT_NULL(cmdhash_peek("sh"));
+    TEST_ASSERT_NULL(cmdhash_lookup("sh"));
+    env_set("PATH", saved);
+    TEST_ASSERT_NOT_NULL(cmdhash_lookup("sh"));
+    free(saved);
+    cmdhash_clear();
+}
+
+void test_cmdhash_add_and_remove(void) {
+    cmdhash_clear();
+    TEST_ASSERT_EQUAL(0, cmdhash_add("myalias", "/bin/echo"));
+    TEST_ASSERT_EQUAL_STRING("/bin/echo", cmdhash_lookup("myalias"));
+    TEST_ASSERT_EQUAL(0, cmdhash_remove("myalias"));
+    TEST_ASSERT_EQUAL(-1, cmdhash_remove("myalias"));
+    TEST_ASSERT_EQUAL(-1, cmdhash_add("a/b", "/bin/echo"));
+}
+
+void test_builtin_hash_options(void) {
+    cmdhash_clear();
+    char *list[] = {"hash", NULL};
+    char *add[] = {"hash", "sh", NULL};
+    char *show[] = {"hash", "-t", "sh", NULL};
+    char *pin[] = {"hash", "-p", "/bin/echo", "e2", NULL};
+    char *reset[] = {"hash", "-r", NULL};
+    char *missing[] = {"hash", "-t", "nonexistent_command_xyz123", NULL};
+    TEST_ASSERT_EQUAL(0, builtin_execute("hash", 1, list));
+    TEST_ASSERT_EQUAL(0, builtin_execute("hash", 2, add));
+    TEST_ASSERT_EQUAL(0, builtin_execute("hash", 3, show));
+    TEST_ASSERT_EQUAL(0, builtin_execute("hash", 4, pin));
+    TEST_ASSERT_EQUAL_STRING("/bin/echo", cmdhash_peek("e2"));
+    TEST_ASSERT_EQUAL(1, builtin_execute("hash", 3, missing));
+    TEST_ASSERT_EQUAL(0, builtin_execute("hash", 2, reset));
+    TEST_ASSERT_NULL(cmdhash_peek("sh"));
+    TEST_ASSERT_NULL(cmdhash_peek("e2"));
+}
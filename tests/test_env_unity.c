@@ -1,5 +1,6 @@
 #include "env.h"
 #include "unity.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -58,4 +59,177 @@ void test_expand_variables_no_expansion(void) {
     free(result);
 }
 
+static int envp_has(const char *entry) {
+    for (char **e = env_envp(); *e; ++e) {
+        if (strcmp(*e, entry) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+void test_env_assign_is_not_exported(void) {
+    TEST_ASSERT_EQUAL(0, env_assign("TEST_LOCAL", "1"));
+    TEST_ASSERT_EQUAL_STRING("1", env_get("TEST_LOCAL"));
+    TEST_ASSERT_FALSE(env_is_exported("TEST_LOCAL"));
+    TEST_ASSERT_FALSE(envp_has("TEST_LOCAL=1"));
+
+    TEST_ASSERT_EQUAL(0, env_export("TEST_LOCAL"));
+    TEST_ASSERT_TRUE(envp_has("TEST_LOCAL=1"));
+    // Assignments keep the export flag and show up in the next envp
+    TEST_ASSERT_EQUAL(0, env_assign("TEST_LOCAL", "2"));
+    TEST_ASSERT_TRUE(envp_has("TEST_LOCAL=2"));
+    TEST_ASSERT_FALSE(envp_has("TEST_LOCAL=1"));
+
+    TEST_ASSERT_EQUAL(0, env_unset("TEST_LOCAL"));
+    TEST_ASSERT_FALSE(env_is_exported("TEST_LOCAL"));
+    TEST_ASSERT_FALSE(envp_has("TEST_LOCAL=2"));
+}
+
+void test_env_export_before_assign(void) {
+    TEST_ASSERT_EQUAL(0, env_export("TEST_LATER"));
+    TEST_ASSERT_NULL(env_get("TEST_LATER"));
+    TEST_ASSERT_FALSE(envp_has("TEST_LATER="));
+    TEST_ASSERT_EQUAL(0, env_assign("TEST_LATER", "x"));
+    TEST_ASSERT_TRUE(envp_has("TEST_LATER=x"));
+    env_unset("TEST_LATER");
+}
+
+void test_env_invalid_names(void) {
+    TEST_ASSERT_EQUAL(-1, env_set("1ABC", "x"));
+    TEST_ASSERT_EQUAL(-1, env_assign("A-B", "x"));
+    TEST_ASSERT_EQUAL(-1, env_export(""));
+    TEST_ASSERT_TRUE(env_is_assignment("A_1=x"));
+    TEST_ASSERT_TRUE(env_is_assignment("A="));
+    TEST_ASSERT_FALSE(env_is_assignment("=x"));
+    TEST_ASSERT_FALSE(env_is_assignment("1A=x"));
+    TEST_ASSERT_FALSE(env_is_assignment("echo"));
+}
+
+void test_env_many_variables_and_self_assignment(void) {
+    // Enough names to force several table resizes, half of them unset again
+    char name[32], value[32];
+    for (int i = 0; i < 1000; ++i) {
+        snprintf(name, sizeof name, "TEST_MANY_%d", i);
+        snprintf(value, sizeof value, "v%d", i);
+        TEST_ASSERT_EQUAL(0, env_assign(name, value));
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        snprintf(name, sizeof name, "TEST_MANY_%d", i);
+        TEST_ASSERT_EQUAL(0, env_unset(name));
+    }
+    for (int i = 0; i < 1000; ++i) {
+        snprintf(name, sizeof name, "TEST_MANY_%d", i);
+        snprintf(value, sizeof value, "v%d", i);
+        if (i % 2)
+            TEST_ASSERT_EQUAL_STRING(value, env_get(name));
+        else
+            TEST_ASSERT_NULL(env_get(name));
+    }
+    // The new value may alias the old one
+    TEST_ASSERT_EQUAL(0, env_assign("TEST_MANY_1", env_get("TEST_MANY_1") + 1));
+    TEST_ASSERT_EQUAL_STRING("1", env_get("TEST_MANY_1"));
+    for (int i = 1; i < 1000; i += 2) {
+        snprintf(name, sizeof name, "TEST_MANY_%d", i);
+        env_unset(name);
+    }
+}
+
+void test_expand_word_plain_is_not_copied(void) {
+    arena_t arena;
+    arena_init(&arena, 0);
+    const char *word = "plain-word";
+    TEST_ASSERT_EQUAL_PTR(word, expand_word(&arena, word));
+    arena_free(&arena);
+}
+
+static void assert_expands(arena_t *arena, const char *expected, const char *word) {
+    TEST_ASSERT_EQUAL_STRING_MESSAGE(expected, expand_word(arena, word), word);
+}
+
+void test_expand_word_braced_forms(void) {
+    arena_t arena;
+    arena_init(&arena, 0);
+    env_assign("TEST_F", "/usr/lib/file.tar.gz");
+    env_assign("TEST_EMPTY", "");
+    env_unset("TEST_UNSET");
+
+    assert_expands(&arena, "/usr/lib/file.tar.gz!", "${TEST_F}!");
+    assert_expands(&arena, "20 0 0", "${#TEST_F} ${#TEST_EMPTY} ${#TEST_UNSET}");
+    assert_expands(&arena, "/usr/lib/file.tar /usr/lib/file", "${TEST_F%.*} ${TEST_F%%.*}");
+    assert_expands(&arena, "usr/lib/file.tar.gz file.tar.gz", "${TEST_F#*/} ${TEST_F##*/}");
+    assert_expands(&arena, "/usr/lib/file.tar.gz", "${TEST_F%.zip}");
+    assert_expands(&arena, "d [] e", "${TEST_UNSET:-d} [${TEST_EMPTY-x}] ${TEST_EMPTY:-e}");
+    assert_expands(&arena, "[] [alt]", "[${TEST_UNSET:+alt}] [${TEST_F:+alt}]");
+    assert_expands(&arena, "file.tar.gz", "${TEST_UNSET:-${TEST_F##*/}}");
+    assert_expands(&arena, "$ a$ ${open", "$ a$ ${open");
+    assert_expands(&arena, "x21y", "x$(( ${#TEST_F} + 1 ))y");
+
+    // := assigns an unexported shell variable
+    assert_expands(&arena, "v-20", "${TEST_UNSET:=v-${#TEST_F}}");
+    TEST_ASSERT_EQUAL_STRING("v-20", env_get("TEST_UNSET"));
+    assert_expands(&arena, "v-20", "${TEST_UNSET:=other}");
+    TEST_ASSERT_FALSE(env_is_exported("TEST_UNSET"));
+
+    env_unset("TEST_F");
+    env_unset("TEST_EMPTY");
+    env_unset("TEST_UNSET");
+    arena_free(&arena);
+}
+
+void test_expand_command_substitution_fields(void) {
+    arena_t arena;
+    arena_init(&arena, 0);
+    env_unset("IFS");
+
+    // Builtins are captured in-process, external commands through a pipe
+    assert_expands(&arena, "[a  b]", "[$(echo 'a  b')]");
+    assert_expands(&arena, "x-y", "`echo x`-$(/bin/echo y)");
+    TEST_ASSERT_EQUAL_STRING("1\n2", expand_word(&arena, "$(printf '1\\n2\\n\\n')"));
+
+    // Only an unquoted whole-word substitution is split into fields
+    expand_fields_t fields = {0};
+    expand_fields(&arena, "$(printf ' one\\ttwo  three\\n')", &fields);
+    expand_fields(&arena, "\001$(echo 'not split')", &fields);
+    expand_fields(&arena, "$(true)", &fields);
+    TEST_ASSERT_EQUAL(4, fields.n);
+    TEST_ASSERT_EQUAL_STRING("one", fields.words[0]);
+    TEST_ASSERT_EQUAL_STRING("two", fields.words[1]);
+    TEST_ASSERT_EQUAL_STRING("three", fields.words[2]);
+    TEST_ASSERT_EQUAL_STRING("not split", fields.words[3]);
+    TEST_ASSERT_NULL(fields.words[4]);
+
+    expand_take_status();
+    expand_word(&arena, "$(false)");
+    TEST_ASSERT_EQUAL(1, expand_take_status());
+    TEST_ASSERT_EQUAL(-1, expand_take_status());
+    arena_free(&arena);
+}
+
 // End of environment tests
+
+void test_expand_positional_parameters(void) {
+    arena_t arena;
+    arena_init(&arena, 0);
+    char *params[] = {"a", "b c", "d", "e", "f", "g", "h", "i", "j", "ten"};
+    env_positional_t saved = *env_positional();
+    env_set_positional(params, 10);
+
+    assert_expands(&arena, "a|b c|10", "$1|$2|$#");
+    assert_expands(&arena, "a0 ten", "$10 ${10}");
+    assert_expands(&arena, "[a b c d e f g h i j ten]", "[$@]");
+    assert_expands(&arena, "-", "${11}-${12:-}");
+    assert_expands(&arena, "3", "${#2}");
+
+    // $@ alone is one field per parameter
+    expand_fields_t fields = {0};
+    expand_fields(&arena, "$@", &fields);
+    TEST_ASSERT_EQUAL(10, fields.n);
+    TEST_ASSERT_EQUAL_STRING("b c", fields.words[1]);
+
+    TEST_ASSERT_EQUAL(0, env_shift_positional(9));
+    assert_expands(&arena, "ten 1", "$1 $#");
+    TEST_ASSERT_EQUAL(-1, env_shift_positional(2));
+
+    env_set_positional(saved.argv, saved.argc);
+    arena_free(&arena);
+}
@@ -1,6 +1,8 @@
 #include "evloop.h"
 #include "unity.h"
 #include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -166,3 +168,275 @@ void test_evloop_two_fds_callbacks_and_stop(void) {
     close(p2[1]);
     evloop_free(loop);
 }
+
+typedef struct {
+    evloop_t *loop;
+    int other_fd;
+    int calls;
+} remove_ctx_t;
+
+// Remove the other registration from inside a dispatch round.
+static void cb_remove_other(int fd, void *data) {
+    char c;
+    remove_ctx_t *ctx = (remove_ctx_t *)data;
+    (void)!read(fd, &c, 1);
+    ctx->calls++;
+    evloop_remove_fd(ctx->loop, ctx->other_fd);
+    evloop_stop(ctx->loop);
+}
+
+void test_evloop_backends_remove_during_dispatch(void) {
+    const char *names[] = {"epoll", "poll", "select"};
+    for (int i = 0; i < 3; ++i) {
+        evloop_t *loop = evloop_create_backend(names[i]);
+        TEST_ASSERT_NOT_NULL(loop);
+        TEST_ASSERT_EQUAL_STRING(names[i], evloop_backend_name(loop));
+
+        int p1[2], p2[2];
+        TEST_ASSERT_EQUAL_INT(0, pipe(p1));
+        TEST_ASSERT_EQUAL_INT(0, pipe(p2));
+        remove_ctx_t c1 = {loop, p2[0], 0};
+        remove_ctx_t c2 = {loop, p1[0], 0};
+        TEST_ASSERT_EQUAL_INT(0, evloop_add_fd(loop, p1[0], EVLOOP_READ, cb_remove_other, &c1));
+        TEST_ASSERT_EQUAL_INT(0, evloop_add_fd(loop, p2[0], EVLOOP_READ, cb_remove_other, &c2));
+        TEST_ASSERT_TRUE(write(p1[1], "x", 1) == 1);
+        TEST_ASSERT_TRUE(write(p2[1], "x", 1) == 1);
+
+        // Exactly one callback runs; the other registration is gone.
+        TEST_ASSERT_EQUAL_INT(0, evloop_run(loop, -1));
+        TEST_ASSERT_EQUAL_INT(1, c1.calls + c2.calls);
+        TEST_ASSERT_EQUAL_INT(0, evloop_run(loop, 10));
+        TEST_ASSERT_EQUAL_INT(1, c1.calls + c2.calls);
+
+        evloop_free(loop);
+        close(p1[0]);
+        close(p1[1]);
+        close(p2[0]);
+        close(p2[1]);
+    }
+}
+
+void test_evloop_backend_selection(void) {
+    TEST_ASSERT_NULL(evloop_create_backend("kqueue"));
+
+    setenv("MYSHELL_EVLOOP", "select", 1);
+    evloop_t *loop = evloop_create();
+    TEST_ASSERT_NOT_NULL(loop);
+    TEST_ASSERT_EQUAL_STRING("select", evloop_backend_name(loop));
+    // select(2) cannot watch descriptors at or above FD_SETSIZE
+    int high = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 1100);
+    if (high >= 0) {
+        TEST_ASSERT_EQUAL_INT(-1, evloop_add_fd(loop, high, EVLOOP_READ, cb_count_only, NULL));
+        close(high);
+    }
+    evloop_free(loop);
+    unsetenv("MYSHELL_EVLOOP");
+
+    loop = evloop_create();
+    TEST_ASSERT_NOT_NULL(loop);
+    TEST_ASSERT_EQUAL_STRING("epoll", evloop_backend_name(loop));
+    evloop_free(loop);
+}
+
+void test_evloop_add_duplicate_and_mod_unregistered(void) {
+    int fds[2];
+    TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+    evloop_t *loop = evloop_create();
+    TEST_ASSERT_NOT_NULL(loop);
+    TEST_ASSERT_EQUAL_INT(-1, evloop_mod_fd(loop, fds[0], EVLOOP_READ));
+    TEST_ASSERT_EQUAL_INT(0, evloop_add_fd(loop, fds[0], EVLOOP_READ, cb_count_only, NULL));
+    TEST_ASSERT_EQUAL_INT(-1, evloop_add_fd(loop, fds[0], EVLOOP_READ, cb_count_only, NULL));
+    TEST_ASSERT_EQUAL_INT(0, evloop_remove_fd(loop, fds[0]));
+    TEST_ASSERT_EQUAL_INT(-1, evloop_mod_fd(loop, fds[0], EVLOOP_READ));
+    // A freed slot can be registered again
+    TEST_ASSERT_EQUAL_INT(0, evloop_add_fd(loop, fds[0], EVLOOP_READ, cb_count_only, NULL));
+    evloop_free(loop);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void test_evloop_backends_mod_fd(void) {
+    const char *names[] = {"epoll", "poll", "select"};
+    for (int i = 0; i < 3; ++i) {
+        evloop_t *loop = evloop_create_backend(names[i]);
+        TEST_ASSERT_NOT_NULL(loop);
+        int fds[2];
+        TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+
+        // The write end is never readable: nothing fires until it is
+        // switched to write interest.
+        cb_count = 0;
+        TEST_ASSERT_EQUAL_INT(0, evloop_add_fd(loop, fds[1], EVLOOP_READ, cb_stop_on_event, loop));
+        TEST_ASSERT_EQUAL_INT(0, evloop_run(loop, 10));
+        TEST_ASSERT_EQUAL_INT(0, cb_count);
+        TEST_ASSERT_EQUAL_INT(0, evloop_mod_fd(loop, fds[1], EVLOOP_WRITE));
+        TEST_ASSERT_EQUAL_INT(0, evloop_run(loop, -1));
+        TEST_ASSERT_EQUAL_INT(1, cb_count);
+
+        evloop_free(loop);
+        close(fds[0]);
+        close(fds[1]);
+    }
+}
+
+void test_evloop_backends_oneshot(void) {
+    const char *names[] = {"epoll", "poll", "select"};
+    for (int i = 0; i < 3; ++i) {
+        evloop_t *loop = evloop_create_backend(names[i]);
+        TEST_ASSERT_NOT_NULL(loop);
+        int fds[2];
+        TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+        TEST_ASSERT_TRUE(write(fds[1], "x", 1) == 1);
+
+        // The data is never read, so a level-triggered registration would
+        // fire on every wait; a oneshot one fires once until re-armed.
+        cb_data_count = 0;
+        TEST_ASSERT_EQUAL_INT(0, evloop_add_fd(loop, fds[0], EVLOOP_READ | EVLOOP_ONESHOT,
+                                               cb_count_only, NULL));
+        TEST_ASSERT_EQUAL_INT(0, evloop_run(loop, 10));
+        TEST_ASSERT_EQUAL_INT(1, cb_data_count);
+        TEST_ASSERT_EQUAL_INT(0, evloop_run(loop, 10));
+        TEST_ASSERT_EQUAL_INT(1, cb_data_count);
+        TEST_ASSERT_EQUAL_INT(0, evloop_mod_fd(loop, fds[0], EVLOOP_READ | EVLOOP_ONESHOT));
+        TEST_ASSERT_EQUAL_INT(0, evloop_run(loop, 10));
+        TEST_ASSERT_EQUAL_INT(2, cb_data_count);
+
+        evloop_free(loop);
+        close(fds[0]);
+        close(fds[1]);
+    }
+}
+
+void test_evloop_epoll_edge_triggered(void) {
+    evloop_t *loop = evloop_create_backend("epoll");
+    TEST_ASSERT_NOT_NULL(loop);
+    int fds[2];
+    TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+    TEST_ASSERT_TRUE(write(fds[1], "x", 1) == 1);
+
+    cb_data_count = 0;
+    TEST_ASSERT_EQUAL_INT(0, evloop_add_fd(loop, fds[0], EVLOOP_READ | EVLOOP_EDGE,
+                                           cb_count_only, NULL));
+    TEST_ASSERT_EQUAL_INT(0, evloop_run(loop, 10));
+    TEST_ASSERT_EQUAL_INT(1, cb_data_count);
+    // Unread data does not re-trigger; new data does.
+    TEST_ASSERT_EQUAL_INT(0, evloop_run(loop, 10));
+    TEST_ASSERT_EQUAL_INT(1, cb_data_count);
+    TEST_ASSERT_TRUE(write(fds[1], "y", 1) == 1);
+    TEST_ASSERT_EQUAL_INT(0, evloop_run(loop, 10));
+    TEST_ASSERT_EQUAL_INT(2, cb_data_count);
+
+    evloop_free(loop);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+typedef struct {
+    evloop_t *loop;
+    int *log;
+    int *n_log;
+    int tag;
+    int timer_id;
+    int remaining; // periodic: cancel itself after this many more calls
+} timer_ctx_t;
+
+static void cb_timer_log(void *data) {
+    timer_ctx_t *ctx = (timer_ctx_t *)data;
+    ctx->log[(*ctx->n_log)++] = ctx->tag;
+    if (ctx->remaining > 0 && --ctx->remaining == 0)
+        TEST_ASSERT_EQUAL_INT(0, evloop_cancel_timer(ctx->loop, ctx->timer_id));
+}
+
+void test_evloop_backends_timers(void) {
+    const char *names[] = {"epoll", "poll", "select"};
+    for (int i = 0; i < 3; ++i) {
+        evloop_t *loop = evloop_create_backend(names[i]);
+        TEST_ASSERT_NOT_NULL(loop);
+        int log[16];
+        int n_log = 0;
+        timer_ctx_t late = {loop, log, &n_log, 3, 0, 0};
+        timer_ctx_t early = {loop, log, &n_log, 1, 0, 0};
+        timer_ctx_t cancelled = {loop, log, &n_log, 9, 0, 0};
+        timer_ctx_t periodic = {loop, log, &n_log, 2, 0, 3};
+
+        TEST_ASSERT_TRUE(evloop_add_timer(loop, 30, 0, cb_timer_log, &late) > 0);
+        TEST_ASSERT_TRUE(evloop_add_timer(loop, 1, 0, cb_timer_log, &early) > 0);
+        int id = evloop_add_timer(loop, 5, 0, cb_timer_log, &cancelled);
+        TEST_ASSERT_TRUE(id > 0);
+        periodic.timer_id = evloop_add_timer(loop, 2, 5, cb_timer_log, &periodic);
+        TEST_ASSERT_TRUE(periodic.timer_id > 0);
+        TEST_ASSERT_EQUAL_INT(0, evloop_cancel_timer(loop, id));
+        TEST_ASSERT_EQUAL_INT(-1, evloop_cancel_timer(loop, id));
+
+        // Runs until every timer has fired or been cancelled.
+        TEST_ASSERT_EQUAL_INT(0, evloop_run(loop, -1));
+        TEST_ASSERT_EQUAL_INT(5, n_log);
+        TEST_ASSERT_EQUAL_INT(1, log[0]);
+        TEST_ASSERT_EQUAL_INT(2, log[1]);
+        TEST_ASSERT_EQUAL_INT(2, log[2]);
+        TEST_ASSERT_EQUAL_INT(2, log[3]);
+        TEST_ASSERT_EQUAL_INT(3, log[4]);
+        evloop_free(loop);
+    }
+}
+
+void test_evloop_timer_outlasts_run_timeout(void) {
+    evloop_t *loop = evloop_create();
+    TEST_ASSERT_NOT_NULL(loop);
+    int log[4];
+    int n_log = 0;
+    timer_ctx_t ctx = {loop, log, &n_log, 1, 0, 0};
+    int id = evloop_add_timer(loop, 10000, 0, cb_timer_log, &ctx);
+    TEST_ASSERT_TRUE(id > 0);
+    TEST_ASSERT_EQUAL_INT(0, evloop_run(loop, 10));
+    TEST_ASSERT_EQUAL_INT(0, n_log);
+    TEST_ASSERT_EQUAL_INT(-1, evloop_add_timer(loop, -1, 0, cb_timer_log, &ctx));
+    TEST_ASSERT_EQUAL_INT(-1, evloop_add_timer(loop, 1, 0, NULL, NULL));
+    // Pending timers are released with the loop.
+    evloop_free(loop);
+}
+
+static int defer_log[8];
+static int defer_n;
+static evloop_t *defer_loop;
+
+static void cb_defer_second(void *data) {
+    defer_log[defer_n++] = (int)(intptr_t)data;
+}
+
+static void cb_defer_first(void *data) {
+    defer_log[defer_n++] = (int)(intptr_t)data;
+    // Queued from a deferred callback: runs on the following iteration,
+    // after the fd callback below.
+    evloop_defer(defer_loop, cb_defer_second, (void *)(intptr_t)3);
+}
+
+static void cb_defer_fd(int fd, void *data) {
+    char c;
+    (void)data;
+    (void)!read(fd, &c, 1);
+    defer_log[defer_n++] = 2;
+    evloop_remove_fd(defer_loop, fd);
+}
+
+void test_evloop_defer_runs_next_iteration(void) {
+    int fds[2];
+    TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+    defer_loop = evloop_create();
+    TEST_ASSERT_NOT_NULL(defer_loop);
+    defer_n = 0;
+    TEST_ASSERT_EQUAL_INT(-1, evloop_defer(defer_loop, NULL, NULL));
+    TEST_ASSERT_EQUAL_INT(0, evloop_defer(defer_loop, cb_defer_first, (void *)(intptr_t)1));
+    TEST_ASSERT_EQUAL_INT(0, evloop_add_fd(defer_loop, fds[0], EVLOOP_READ, cb_defer_fd, NULL));
+    TEST_ASSERT_TRUE(write(fds[1], "x", 1) == 1);
+
+    TEST_ASSERT_EQUAL_INT(0, evloop_run(defer_loop, -1));
+    TEST_ASSERT_EQUAL_INT(3, defer_n);
+    TEST_ASSERT_EQUAL_INT(1, defer_log[0]);
+    TEST_ASSERT_EQUAL_INT(2, defer_log[1]);
+    TEST_ASSERT_EQUAL_INT(3, defer_log[2]);
+
+    evloop_free(defer_loop);
+    close(fds[0]);
+    close(fds[1]);
+}
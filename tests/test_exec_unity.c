@@ -1,7 +1,11 @@
 #include "ast.h"
+#include "env.h"
 #include "exec.h"
+#include "parser.h"
+#include "shell.h"
 #include "unity.h"
 #include <stdlib.h>
+#include <unistd.h>
 
 void test_exec_ast_null(void) {
     // Test executing NULL AST
@@ -147,3 +151,213 @@ void test_exec_builtin_simulation(void) {
         TEST_ASSERT_TRUE(1);
     }
 }
+
+void test_exec_builtin_with_redirection_runs_in_shell(void) {
+    // cd with a redirection must change the shell's own directory
+    char *saved = getcwd(NULL, 0);
+    char *cmd_argv[] = {"cd", "/", NULL};
+    ast_node_t *cmd_node = ast_create_command(cmd_argv);
+    ast_command_add_redirection(cmd_node, 1, REDIR_OUTPUT, "/dev/null");
+
+    TEST_ASSERT_EQUAL(0, exec_ast(cmd_node));
+    char *cwd = getcwd(NULL, 0);
+    TEST_ASSERT_EQUAL_STRING("/", cwd);
+
+    free(cwd);
+    ast_free(cmd_node);
+    TEST_ASSERT_EQUAL(0, chdir(saved));
+    free(saved);
+}
+
+void test_exec_assignment_sets_shell_variable(void) {
+    env_set("TEST_EXEC_BASE", "base");
+    char *cmd_argv[] = {"TEST_EXEC_A=$TEST_EXEC_BASE-1", "TEST_EXEC_B=", NULL};
+    ast_node_t *cmd_node = ast_create_command(cmd_argv);
+
+    TEST_ASSERT_EQUAL(0, exec_ast(cmd_node));
+    TEST_ASSERT_EQUAL_STRING("base-1", env_get("TEST_EXEC_A"));
+    TEST_ASSERT_EQUAL_STRING("", env_get("TEST_EXEC_B"));
+    TEST_ASSERT_FALSE(env_is_exported("TEST_EXEC_A"));
+
+    ast_free(cmd_node);
+    env_unset("TEST_EXEC_A");
+    env_unset("TEST_EXEC_B");
+    env_unset("TEST_EXEC_BASE");
+}
+
+void test_exec_capture_in_process_and_forked(void) {
+    arena_t arena;
+    arena_init(&arena, 0);
+    char *out;
+    size_t len;
+
+    TEST_ASSERT_EQUAL(0, exec_capture("echo a && printf b", &arena, &out, &len));
+    TEST_ASSERT_EQUAL(3, len);
+    TEST_ASSERT_EQUAL_MEMORY("a\nb", out, 3);
+
+    // Large output from an external command grows the buffer
+    TEST_ASSERT_EQUAL(0, exec_capture("seq 1 100000", &arena, &out, &len));
+    TEST_ASSERT_EQUAL(588895, len);
+    TEST_ASSERT_EQUAL_MEMORY("99999\n100000\n", out + len - 13, 13);
+
+    TEST_ASSERT_EQUAL(1, exec_capture("false", &arena, &out, &len));
+    TEST_ASSERT_EQUAL(0, len);
+    arena_free(&arena);
+}
+
+void test_exec_capture_in_pipeline_after_parent_capture(void) {
+    arena_t arena;
+    arena_init(&arena, 0);
+    char *out;
+    size_t len;
+
+    // The parent keeps a spare memfd; pipeline children must not reuse it
+    TEST_ASSERT_EQUAL(0, exec_capture("echo first", &arena, &out, &len));
+    TEST_ASSERT_EQUAL_STRING("first\n", out);
+    TEST_ASSERT_EQUAL(0, exec_capture("echo $(echo inpipe) | cat", &arena, &out, &len));
+    TEST_ASSERT_EQUAL_STRING("inpipe\n", out);
+    TEST_ASSERT_EQUAL(0, exec_capture("echo $(echo again)", &arena, &out, &len));
+    TEST_ASSERT_EQUAL_STRING("again\n", out);
+    arena_free(&arena);
+}
+
+void test_exec_control_flow(void) {
+    arena_t arena;
+    arena_init(&arena, 0);
+    char *out;
+    size_t len;
+
+    TEST_ASSERT_EQUAL(0, exec_capture("for x in a b c; do printf $x; done", &arena, &out, &len));
+    TEST_ASSERT_EQUAL_STRING("abc", out);
+
+    const char *script =
+        "i=0; s=\n"
+        "while true; do\n"
+        "  i=$((i + 1))\n"
+        "  if [ $i -gt 6 ]; then break\n"
+        "  elif [ $i -eq 2 ]; then continue\n"
+        "  fi\n"
+        "  case $i in 1|3) s=${s}o ;; *) s=${s}x ;; esac\n"
+        "done\n"
+        "until [ $i -eq 0 ]; do let i--; done\n"
+        "for a in 1 2; do for b in 1 2 3; do [ $b = 2 ] && continue 2; s=$s$a$b; done; done";
+    TEST_ASSERT_EQUAL(0, exec_capture(script, &arena, &out, &len));
+    // The loop ran in a subshell; run it here too to check the variables
+    lexer_t *lexer = lexer_create(script);
+    parser_t *parser = parser_create(lexer);
+    ast_node_t *ast = parser_parse_program(parser, NULL);
+    TEST_ASSERT_NOT_NULL(ast);
+    TEST_ASSERT_EQUAL(0, exec_ast(ast));
+    TEST_ASSERT_EQUAL_STRING("ooxxx1121", env_get("s"));
+    TEST_ASSERT_EQUAL_STRING("0", env_get("i"));
+    ast_free(ast);
+    parser_free(parser);
+    lexer_free(lexer);
+    arena_free(&arena);
+}
+
+void test_exec_quoted_substitution_is_literal(void) {
+    arena_t arena;
+    arena_init(&arena, 0);
+    char *out;
+    size_t len;
+
+    TEST_ASSERT_EQUAL(0, exec_capture("echo '$(echo no)' '`echo x`' \\$(echo esc)",
+                                      &arena, &out, &len));
+    TEST_ASSERT_EQUAL_STRING("$(echo no) `echo x` $(echo esc)\n", out);
+    TEST_ASSERT_EQUAL(0, exec_capture("echo \"\\$(echo q) $(echo y)\"", &arena, &out, &len));
+    TEST_ASSERT_EQUAL_STRING("$(echo q) y\n", out);
+    arena_free(&arena);
+}
+
+void test_exec_unquoted_expansions_are_split(void) {
+    arena_t arena;
+    arena_init(&arena, 0);
+    char *out;
+    size_t len;
+
+    TEST_ASSERT_EQUAL(0, exec_capture("L='a b  c'; for w in $L; do printf \"[$w]\"; done",
+                                      &arena, &out, &len));
+    TEST_ASSERT_EQUAL_STRING("[a][b][c]", out);
+    TEST_ASSERT_EQUAL(0, exec_capture("L='a b'; E=; printf '<%s>' $L \"$L\" $E \"$E\" x$L\"y z\" "
+                                      "${U:-u v} $(echo 1 2)",
+                                      &arena, &out, &len));
+    TEST_ASSERT_EQUAL_STRING("<a><b><a b><><xa><by z><u><v><1><2>", out);
+    arena_free(&arena);
+}
+
+// Parse and run text in the shell process.
+static int run_text(const char *text) {
+    lexer_t *lexer = lexer_create(text);
+    parser_t *parser = parser_create(lexer);
+    ast_node_t *ast = parser_parse_program(parser, NULL);
+    TEST_ASSERT_NOT_NULL(ast);
+    int rc = exec_ast(ast);
+    ast_free(ast);
+    parser_free(parser);
+    lexer_free(lexer);
+    return rc;
+}
+
+void test_exec_arith_error_skips_command(void) {
+    int saved_interactive = shell_interactive;
+    shell_interactive = 1;
+    TEST_ASSERT_EQUAL(1, run_text("TEST_AE=a; TEST_AE=$((1/0))"));
+    TEST_ASSERT_EQUAL_STRING("a", env_get("TEST_AE"));
+    TEST_ASSERT_EQUAL(0, run_text("echo $((1/0)) > /dev/null; TEST_AE=$?"));
+    TEST_ASSERT_EQUAL_STRING("1", env_get("TEST_AE"));
+    TEST_ASSERT_EQUAL(1, shell_running);
+
+    // A script stops at the failed expansion
+    shell_interactive = 0;
+    TEST_ASSERT_EQUAL(1, run_text("TEST_AE=b; echo $((2 +)) > /dev/null; TEST_AE=no"));
+    TEST_ASSERT_EQUAL_STRING("b", env_get("TEST_AE"));
+    TEST_ASSERT_EQUAL(0, shell_running);
+
+    shell_running = 1;
+    shell_interactive = saved_interactive;
+    env_unset("TEST_AE");
+}
+
+void test_exec_expansion_error_skips_for_and_case(void) {
+    int saved_interactive = shell_interactive;
+    shell_interactive = 1;
+    TEST_ASSERT_EQUAL(1, run_text("TEST_AE=a; for v in $((1/0)) z; do TEST_AE=$TEST_AE-$v; done"));
+    TEST_ASSERT_EQUAL_STRING("a", env_get("TEST_AE"));
+    TEST_ASSERT_EQUAL(1, run_text("case $((1/0)) in *) TEST_AE=matched;; esac"));
+    TEST_ASSERT_EQUAL(1, run_text("case x in $((1/0))) ;; *) TEST_AE=star;; esac"));
+    TEST_ASSERT_EQUAL_STRING("a", env_get("TEST_AE"));
+    TEST_ASSERT_EQUAL(1, shell_running);
+
+    // A script stops there
+    shell_interactive = 0;
+    TEST_ASSERT_EQUAL(1, run_text("for v in $((1/0)); do :; done; TEST_AE=no"));
+    TEST_ASSERT_EQUAL_STRING("a", env_get("TEST_AE"));
+    TEST_ASSERT_EQUAL(0, shell_running);
+
+    shell_running = 1;
+    shell_interactive = saved_interactive;
+    env_unset("TEST_AE");
+}
+
+void test_exec_bad_substitution_skips_command(void) {
+    int saved_interactive = shell_interactive;
+    shell_interactive = 1;
+    TEST_ASSERT_EQUAL(0, run_text("echo ${x:?unset} > /dev/null; TEST_BS=$?"));
+    TEST_ASSERT_EQUAL_STRING("1", env_get("TEST_BS"));
+    TEST_ASSERT_EQUAL(1, run_text("TEST_BS=${1=a}"));
+    TEST_ASSERT_EQUAL_STRING("1", env_get("TEST_BS"));
+    shell_interactive = saved_interactive;
+    env_unset("TEST_BS");
+}
+
+void test_exec_quoted_arith_is_literal(void) {
+    arena_t arena;
+    arena_init(&arena, 0);
+    char *out;
+    size_t len;
+
+    TEST_ASSERT_EQUAL(0, exec_capture("echo '$((1+2))' \\$((1+2)) $((1+2))", &arena, &out, &len));
+    TEST_ASSERT_EQUAL_STRING("$((1+2)) $((1+2)) 3\n", out);
+    arena_free(&arena);
+}
@@ -0,0 +1,84 @@
+#include "env.h"
+#include "exec.h"
+#include "func.h"
+#include "parser.h"
+#include "unity.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Parse and run text; the tree is freed before returning.
+static int run_text(const char *text) {
+    lexer_t *lexer = lexer_create(text);
+    parser_t *parser = parser_create(lexer);
+    ast_node_t *ast = parser_parse_program(parser, NULL);
+    int rc = ast ? exec_ast(ast) : -1;
+    ast_free(ast);
+    parser_free(parser);
+    lexer_free(lexer);
+    return rc;
+}
+
+void test_func_body_outlives_definition_tree(void) {
+    TEST_ASSERT_EQUAL(0, run_text("fn_set() { FN_OUT=\"$1-$2-$#\"; }"));
+    func_t *fn = func_find("fn_set");
+    TEST_ASSERT_NOT_NULL(fn);
+    TEST_ASSERT_NOT_NULL(func_body(fn));
+
+    // The tree holding the definition is gone; the stored copy runs
+    TEST_ASSERT_EQUAL(0, run_text("fn_set a b c"));
+    TEST_ASSERT_EQUAL_STRING("a-b-3", env_get("FN_OUT"));
+    TEST_ASSERT_EQUAL(0, env_positional()->argc);
+
+    TEST_ASSERT_EQUAL(0, func_unset("fn_set"));
+    TEST_ASSERT_NULL(func_find("fn_set"));
+    TEST_ASSERT_EQUAL(-1, func_unset("fn_set"));
+}
+
+void test_func_redefined_while_running(void) {
+    TEST_ASSERT_EQUAL(0, run_text("fn_self() { fn_self() { FN_OUT=second; }; FN_OUT=first; }"));
+    TEST_ASSERT_EQUAL(0, run_text("fn_self"));
+    TEST_ASSERT_EQUAL_STRING("first", env_get("FN_OUT"));
+    TEST_ASSERT_EQUAL(0, run_text("fn_self"));
+    TEST_ASSERT_EQUAL_STRING("second", env_get("FN_OUT"));
+    func_unset("fn_self");
+}
+
+void test_func_local_frames_restore(void) {
+    env_assign("FN_L1", "outer");
+    env_unset("FN_L2");
+    TEST_ASSERT_EQUAL(-1, func_local("FN_L1", "x")); // outside a call
+
+    func_frame_push();
+    TEST_ASSERT_EQUAL(0, func_local("FN_L1", "inner"));
+    TEST_ASSERT_EQUAL(0, func_local("FN_L2", "new"));
+    TEST_ASSERT_EQUAL(-1, func_local("1bad", "x"));
+    func_frame_push();
+    TEST_ASSERT_EQUAL(0, func_local("FN_L1", "innermost"));
+    TEST_ASSERT_EQUAL(0, func_local("FN_L1", "again"));
+    TEST_ASSERT_EQUAL_STRING("again", env_get("FN_L1"));
+    func_frame_pop();
+    TEST_ASSERT_EQUAL_STRING("inner", env_get("FN_L1"));
+    func_frame_pop();
+    TEST_ASSERT_EQUAL_STRING("outer", env_get("FN_L1"));
+    TEST_ASSERT_NULL(env_get("FN_L2"));
+    TEST_ASSERT_EQUAL(0, func_depth());
+}
+
+void test_func_return_and_recursion(void) {
+    const char *script =
+        "fn_fib() {\n"
+        "  if [ $1 -lt 2 ]; then FN_R=$1; return; fi\n"
+        "  local a\n"
+        "  fn_fib $(( $1 - 1 )); a=$FN_R\n"
+        "  fn_fib $(( $1 - 2 )); FN_R=$(( a + FN_R ))\n"
+        "}\n"
+        "fn_first() { for x in \"$@\"; do [ $x = stop ] && return 3; FN_SEEN=$x; done; }\n";
+    TEST_ASSERT_EQUAL(0, run_text(script));
+    TEST_ASSERT_EQUAL(0, run_text("fn_fib 15"));
+    TEST_ASSERT_EQUAL_STRING("610", env_get("FN_R"));
+    TEST_ASSERT_EQUAL(3, run_text("fn_first a b stop c"));
+    TEST_ASSERT_EQUAL_STRING("b", env_get("FN_SEEN"));
+    TEST_ASSERT_EQUAL(0, func_depth());
+    func_clear();
+    TEST_ASSERT_NULL(func_find("fn_fib"));
+}
@@ -0,0 +1,91 @@
+#include "ast.h"
+#include "launch.h"
+#include "unity.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+void test_launch_spawn_null_argv(void) {
+    errno = 0;
+    pid_t pid = launch_spawn(NULL, NULL, NULL, 0, 0);
+    TEST_ASSERT_EQUAL(-1, pid);
+    TEST_ASSERT_EQUAL(EINVAL, errno);
+}
+
+void test_launch_external_status(void) {
+    char *ok[] = {"true", NULL};
+    char *fail[] = {"false", NULL};
+    TEST_ASSERT_EQUAL(0, launch_external(NULL, ok, NULL, 0));
+    TEST_ASSERT_EQUAL(1, launch_external(NULL, fail, NULL, 0));
+}
+
+void test_launch_external_not_found(void) {
+    char *argv[] = {"nonexistent_command_xyz123", NULL};
+    TEST_ASSERT_EQUAL(127, launch_external(NULL, argv, NULL, 0));
+}
+
+void test_launch_external_output_redirection(void) {
+    char path[] = "/tmp/myshell_launch_XXXXXX";
+    int tmp = mkstemp(path);
+    TEST_ASSERT_NOT_EQUAL(-1, tmp);
+    close(tmp);
+
+    char *argv[] = {"echo", "spawned", NULL};
+    launch_redir_t r = {.fd = 1, .type = REDIR_OUTPUT, .filename = path};
+    TEST_ASSERT_EQUAL(0, launch_external(NULL, argv, &r, 1));
+
+    char buf[32] = {0};
+    int fd = open(path, O_RDONLY);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    TEST_ASSERT_TRUE(read(fd, buf, sizeof buf - 1) > 0);
+    close(fd);
+    unlink(path);
+    TEST_ASSERT_EQUAL_STRING("spawned\n", buf);
+}
+
+void test_launch_external_redirections_do_not_collide(void) {
+    char first[] = "/tmp/myshell_launch_XXXXXX";
+    char second[] = "/tmp/myshell_launch_XXXXXX";
+    int tmp = mkstemp(first);
+    TEST_ASSERT_NOT_EQUAL(-1, tmp);
+    close(tmp);
+    tmp = mkstemp(second);
+    TEST_ASSERT_NOT_EQUAL(-1, tmp);
+    close(tmp);
+
+    // N>second >first with N the lowest free descriptor: the source for
+    // fd 1 must not open on N, which the first action replaces before the
+    // second one runs
+    int lowest = open("/dev/null", O_RDONLY);
+    TEST_ASSERT_NOT_EQUAL(-1, lowest);
+    close(lowest);
+    char *argv[] = {"echo", "X", NULL};
+    launch_redir_t r[] = {
+        {.fd = lowest, .type = REDIR_OUTPUT, .filename = second},
+        {.fd = 1, .type = REDIR_OUTPUT, .filename = first},
+    };
+    TEST_ASSERT_EQUAL(0, launch_external(NULL, argv, r, 2));
+
+    char buf[32] = {0};
+    int fd = open(first, O_RDONLY);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    TEST_ASSERT_TRUE(read(fd, buf, sizeof buf - 1) > 0);
+    close(fd);
+    struct stat st;
+    TEST_ASSERT_EQUAL(0, stat(second, &st));
+    unlink(first);
+    unlink(second);
+    TEST_ASSERT_EQUAL_STRING("X\n", buf);
+    TEST_ASSERT_EQUAL(0, st.st_size);
+}
+
+void test_launch_external_missing_input_file(void) {
+    char *argv[] = {"cat", NULL};
+    launch_redir_t r = {.fd = 0, .type = REDIR_INPUT, .filename = "/nonexistent/file"};
+    // Redirection failure is reported by the shell; the command never runs
+    TEST_ASSERT_EQUAL(1, launch_external(NULL, argv, &r, 1));
+}
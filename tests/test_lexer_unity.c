@@ -150,3 +150,118 @@ void test_lexer_special_characters(void) {
 }
 
 // End of lexer tests
+
+void test_lexer_expansion_groups_and_arith(void) {
+    lexer_t *lexer = lexer_create("echo $(( 1 + 2 ))x ${A:-a b} (( i += 1 )) (a)");
+    const char *expected[] = {"echo", "$(( 1 + 2 ))x", "${A:-a b}"};
+    for (int i = 0; i < 3; ++i) {
+        token_t *token = lexer_next_token(lexer);
+        TEST_ASSERT_EQUAL(TOKEN_WORD, token->type);
+        TEST_ASSERT_EQUAL_STRING(expected[i], token->value);
+        token_free(token);
+    }
+
+    token_t *token = lexer_next_token(lexer);
+    TEST_ASSERT_EQUAL(TOKEN_ARITH, token->type);
+    TEST_ASSERT_EQUAL_STRING(" i += 1 ", token->value);
+    token_free(token);
+
+    // A single '(' still opens a subshell
+    token = lexer_next_token(lexer);
+    TEST_ASSERT_EQUAL(TOKEN_LPAREN, token->type);
+    token_free(token);
+
+    lexer_free(lexer);
+}
+
+void test_lexer_marks_quoted_arith(void) {
+    lexer_t *lexer = lexer_create("'$((1+2))' \\$((1+2)) \"\\$((1+2))\"");
+    const char *expected[] = {"\001\002$((1+2))", "\002$((1+2))", "\001\002$((1+2))"};
+    for (int i = 0; i < 3; ++i) {
+        token_t *token = lexer_next_token(lexer);
+        TEST_ASSERT_EQUAL(TOKEN_WORD, token->type);
+        TEST_ASSERT_EQUAL_STRING(expected[i], token->value);
+        token_free(token);
+    }
+    lexer_free(lexer);
+}
+
+void test_lexer_command_substitution_groups(void) {
+    lexer_t *lexer = lexer_create("`echo a b`x \"q $(echo c d) `e`\" \"\\$(n) \\\\ \\a\"");
+    const char *expected[] = {"`echo a b`x", "\001q \001$(echo c d) \001`e`",
+                              "\001\002$(n) \\ \\a"};
+    for (int i = 0; i < 3; ++i) {
+        token_t *token = lexer_next_token(lexer);
+        TEST_ASSERT_EQUAL(TOKEN_WORD, token->type);
+        TEST_ASSERT_EQUAL_STRING(expected[i], token->value);
+        token_free(token);
+    }
+    lexer_free(lexer);
+}
+
+void test_lexer_marks_quoted_substitutions(void) {
+    lexer_t *lexer = lexer_create("'$(echo no)' '`echo x`' \\$(echo $(id)) a\\ b");
+    const char *expected[] = {"\001\002$(echo no)", "\001\002`echo x\002`",
+                              "\002$(echo \002$(id))", "a b"};
+    for (int i = 0; i < 4; ++i) {
+        token_t *token = lexer_next_token(lexer);
+        TEST_ASSERT_EQUAL(TOKEN_WORD, token->type);
+        TEST_ASSERT_EQUAL_STRING(expected[i], token->value);
+        token_free(token);
+    }
+    lexer_free(lexer);
+}
+
+void test_lexer_next_returns_views(void) {
+    const char *input = "ls -l \"a b\"c >> out (( x ))";
+    lexer_t *lexer = lexer_create(input);
+
+    // Unquoted words point into the input
+    token_view_t token = lexer_next(lexer);
+    TEST_ASSERT_EQUAL(TOKEN_WORD, token.type);
+    TEST_ASSERT_EQUAL_PTR(input, token.text);
+    TEST_ASSERT_EQUAL(2, token.text_len);
+    token = lexer_next(lexer);
+    TEST_ASSERT_EQUAL_PTR(input + 3, token.text);
+    TEST_ASSERT_EQUAL(2, token.length);
+
+    // Quote removal rebuilds the word outside the input
+    token = lexer_next(lexer);
+    TEST_ASSERT_EQUAL(TOKEN_WORD, token.type);
+    TEST_ASSERT_EQUAL(6, token.offset);
+    TEST_ASSERT_EQUAL(6, token.length);
+    TEST_ASSERT_EQUAL(5, token.text_len);
+    TEST_ASSERT_EQUAL_MEMORY("\001a bc", token.text, 5);
+    TEST_ASSERT_TRUE(token.text < input || token.text > input + strlen(input));
+
+    token = lexer_next(lexer);
+    TEST_ASSERT_EQUAL(TOKEN_REDIRECT_APPEND, token.type);
+    TEST_ASSERT_EQUAL_MEMORY(">>", token.text, 2);
+    token = lexer_next(lexer);
+    TEST_ASSERT_EQUAL_PTR(input + 16, token.text);
+
+    token = lexer_next(lexer);
+    TEST_ASSERT_EQUAL(TOKEN_ARITH, token.type);
+    TEST_ASSERT_EQUAL_MEMORY(" x ", token.text, token.text_len);
+    TEST_ASSERT_EQUAL(3, token.text_len);
+
+    TEST_ASSERT_EQUAL(TOKEN_EOF, lexer_next(lexer).type);
+    TEST_ASSERT_EQUAL(TOKEN_EOF, lexer_next(lexer).type);
+    lexer_free(lexer);
+}
+
+void test_lexer_newlines_comments_and_continuations(void) {
+    lexer_t *lexer = lexer_create("a # note\n\nb\\\nc d\\\ne\n");
+    token_type_t types[] = {TOKEN_WORD, TOKEN_NEWLINE, TOKEN_NEWLINE, TOKEN_WORD, TOKEN_WORD,
+                            TOKEN_NEWLINE, TOKEN_EOF};
+    const char *words[] = {"a", NULL, NULL, "bc", "de", NULL, NULL};
+    for (int i = 0; i < 7; ++i) {
+        token_t *token = lexer_next_token(lexer);
+        TEST_ASSERT_EQUAL(types[i], token->type);
+        if (words[i])
+            TEST_ASSERT_EQUAL_STRING(words[i], token->value);
+        token_free(token);
+    }
+    TEST_ASSERT_EQUAL(3, lexer_line_at(lexer, 10));
+    lexer_free(lexer);
+}
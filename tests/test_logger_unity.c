@@ -1,7 +1,17 @@
 #include "logger.h"
 #include "unity.h"
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
 
 void test_logger_init_shutdown_idempotent(void) {
     unsetenv("MYSHELL_DISABLE_LOGGER");
@@ -71,3 +81,335 @@ void test_logger_level_gating(void) {
     LOG_ERROR("e");
     logger_shutdown();
 }
+
+// Redirect stderr to a temporary file while the logger runs.
+static int capture_begin(char *path, int *saved) {
+    int fd = mkstemp(path);
+    TEST_ASSERT_TRUE(fd >= 0);
+    fflush(stderr);
+    *saved = dup(STDERR_FILENO);
+    dup2(fd, STDERR_FILENO);
+    close(fd);
+    return 0;
+}
+
+static void capture_end(int saved) {
+    fflush(stderr);
+    dup2(saved, STDERR_FILENO);
+    close(saved);
+}
+
+#define PRODUCERS 4
+#define PER_PRODUCER 2000
+
+static void *producer_thread(void *arg) {
+    int id = (int)(intptr_t)arg;
+    for (int i = 0; i < PER_PRODUCER; ++i)
+        LOG_INFO("producer %d seq %d", id, i);
+    return NULL;
+}
+
+void test_logger_concurrent_producers_ordered(void) {
+    unsetenv("MYSHELL_DISABLE_LOGGER");
+    char path[] = "/tmp/myshell_logger_XXXXXX";
+    int saved;
+    capture_begin(path, &saved);
+    unsigned long dropped_before = logger_dropped();
+    TEST_ASSERT_EQUAL_INT(0, logger_init());
+    logger_set_level(LOG_LEVEL_INFO);
+
+    pthread_t tids[PRODUCERS];
+    for (int t = 0; t < PRODUCERS; ++t)
+        TEST_ASSERT_EQUAL_INT(0, pthread_create(&tids[t], NULL, producer_thread, (void *)(intptr_t)t));
+    for (int t = 0; t < PRODUCERS; ++t)
+        pthread_join(tids[t], NULL);
+    logger_shutdown(); // drains before returning
+    logger_set_level(LOG_LEVEL_OFF);
+    capture_end(saved);
+
+    // Every record arrives intact and in per-producer order; anything
+    // missing must have been counted as dropped.
+    FILE *f = fopen(path, "r");
+    TEST_ASSERT_NOT_NULL(f);
+    int next[PRODUCERS] = {0};
+    int received = 0;
+    char line[256];
+    while (fgets(line, sizeof line, f)) {
+        const char *m = strstr(line, "] ");
+        if (!m || !strstr(m, "test_logger_unity.c: producer "))
+            continue;
+        int id, seq;
+        TEST_ASSERT_EQUAL_INT(2, sscanf(strstr(m, "producer "), "producer %d seq %d", &id, &seq));
+        TEST_ASSERT_TRUE(id >= 0 && id < PRODUCERS);
+        TEST_ASSERT_TRUE(seq >= next[id]);
+        next[id] = seq + 1;
+        received++;
+    }
+    fclose(f);
+    unlink(path);
+    unsigned long lost = logger_dropped() - dropped_before;
+    TEST_ASSERT_EQUAL_UINT(PRODUCERS * PER_PRODUCER, (unsigned long)received + lost);
+    TEST_ASSERT_TRUE(received > 0);
+}
+
+void test_logger_long_message_truncated(void) {
+    unsetenv("MYSHELL_DISABLE_LOGGER");
+    char path[] = "/tmp/myshell_logger_XXXXXX";
+    int saved;
+    capture_begin(path, &saved);
+    TEST_ASSERT_EQUAL_INT(0, logger_init());
+    logger_set_level(LOG_LEVEL_WARN);
+    char big[4000];
+    memset(big, 'a', sizeof big - 1);
+    big[sizeof big - 1] = '\0';
+    LOG_WARN("%s", big);
+    LOG_WARN("after");
+    logger_shutdown();
+    logger_set_level(LOG_LEVEL_OFF);
+    capture_end(saved);
+
+    FILE *f = fopen(path, "r");
+    TEST_ASSERT_NOT_NULL(f);
+    char line[8192];
+    TEST_ASSERT_NOT_NULL(fgets(line, sizeof line, f));
+    const char *msg = strstr(line, ": a");
+    TEST_ASSERT_NOT_NULL(msg);
+    TEST_ASSERT_EQUAL_size_t(1023, strspn(msg + 2, "a"));
+    TEST_ASSERT_NOT_NULL(fgets(line, sizeof line, f));
+    TEST_ASSERT_NOT_NULL(strstr(line, "[WARN]"));
+    TEST_ASSERT_NOT_NULL(strstr(line, ": after\n"));
+    fclose(f);
+    unlink(path);
+}
+
+// Next captured line's message part (after "path: "), newline stripped.
+static const char *next_message(FILE *f, char *line, size_t size) {
+    if (!fgets(line, (int)size, f))
+        return NULL;
+    line[strcspn(line, "\n")] = '\0';
+    const char *m = strstr(line, "test_logger_unity.c: ");
+    return m ? m + strlen("test_logger_unity.c: ") : NULL;
+}
+
+void test_logger_deferred_formatting_matches_printf(void) {
+    unsetenv("MYSHELL_DISABLE_LOGGER");
+    char path[] = "/tmp/myshell_logger_XXXXXX";
+    int saved;
+    capture_begin(path, &saved);
+    TEST_ASSERT_EQUAL_INT(0, logger_init());
+    logger_set_level(LOG_LEVEL_DEBUG);
+
+    char name[16] = "mutable";
+    const char *null_str = getenv("MYSHELL_UNSET_FOR_TEST");
+    int x = 7;
+    LOG_DEBUG("%d %i %5d|%-5d|%05d %+d", -3, 42, 12, 12, 12, 9);
+    LOG_DEBUG("%ld %lld %lu %zu %zd %jd %td", -1L, -2LL, 3UL, (size_t)4, (ssize_t)-5,
+              (intmax_t)6, (ptrdiff_t)-7);
+    LOG_DEBUG("%x %X %#o %hhu %hd %c", 255u, 255u, 8u, 300, -1, 'z');
+    LOG_DEBUG("%.2f %e %g %10.3Lf", 3.14159, 1e10, 0.5, (long double)2.5);
+    LOG_DEBUG("[%s] [%8s] [%-8s] [%.3s] [%.s] [%*s] [%.*s]", name, "ab", "ab", "abcdef", "xyz", 6,
+              "cd", 2, "efgh");
+    LOG_DEBUG("%s %p %% done", null_str, (void *)&x);
+    LOG_DEBUG("no args");
+    errno = ENOENT;
+    LOG_DEBUG("eager %m"); // not deferrable: formatted on this thread
+    // The string argument was copied; changing it now must not matter.
+    strcpy(name, "changed");
+    logger_shutdown();
+    logger_set_level(LOG_LEVEL_OFF);
+    capture_end(saved);
+
+    char expect[512];
+    char line[1024];
+    FILE *f = fopen(path, "r");
+    TEST_ASSERT_NOT_NULL(f);
+    snprintf(expect, sizeof expect, "%d %i %5d|%-5d|%05d %+d", -3, 42, 12, 12, 12, 9);
+    TEST_ASSERT_EQUAL_STRING(expect, next_message(f, line, sizeof line));
+    snprintf(expect, sizeof expect, "%ld %lld %lu %zu %zd %jd %td", -1L, -2LL, 3UL, (size_t)4,
+             (ssize_t)-5, (intmax_t)6, (ptrdiff_t)-7);
+    TEST_ASSERT_EQUAL_STRING(expect, next_message(f, line, sizeof line));
+    snprintf(expect, sizeof expect, "%x %X %#o %hhu %hd %c", 255u, 255u, 8u, 300, -1, 'z');
+    TEST_ASSERT_EQUAL_STRING(expect, next_message(f, line, sizeof line));
+    snprintf(expect, sizeof expect, "%.2f %e %g %10.3Lf", 3.14159, 1e10, 0.5, (long double)2.5);
+    TEST_ASSERT_EQUAL_STRING(expect, next_message(f, line, sizeof line));
+    TEST_ASSERT_EQUAL_STRING("[mutable] [      ab] [ab      ] [abc] [] [    cd] [ef]",
+                             next_message(f, line, sizeof line));
+    snprintf(expect, sizeof expect, "(null) %p %% done", (void *)&x);
+    TEST_ASSERT_EQUAL_STRING(expect, next_message(f, line, sizeof line));
+    TEST_ASSERT_EQUAL_STRING("no args", next_message(f, line, sizeof line));
+    snprintf(expect, sizeof expect, "eager %s", strerror(ENOENT));
+    TEST_ASSERT_EQUAL_STRING(expect, next_message(f, line, sizeof line));
+    fclose(f);
+    unlink(path);
+}
+
+static int side_effects;
+static int bump(void) {
+    return ++side_effects;
+}
+
+void test_logger_disabled_levels_skip_arguments(void) {
+    unsetenv("MYSHELL_DISABLE_LOGGER");
+    TEST_ASSERT_EQUAL_INT(0, logger_init());
+    side_effects = 0;
+    logger_set_level(LOG_LEVEL_WARN);
+    TEST_ASSERT_EQUAL(LOG_LEVEL_WARN, logger_threshold);
+    LOG_INFO("%d", bump());
+    LOG_DEBUG("%d", bump());
+    LOG_TRACE("%d", bump());
+    TEST_ASSERT_EQUAL_INT(0, side_effects);
+    LOG_WARN("%d", bump());
+    TEST_ASSERT_EQUAL_INT(1, side_effects);
+    logger_set_level(LOG_LEVEL_OFF);
+    LOG_ERROR("%d", bump());
+    TEST_ASSERT_EQUAL_INT(1, side_effects);
+    logger_shutdown();
+
+    // A disabled logger reports OFF regardless of the requested level.
+    setenv("MYSHELL_DISABLE_LOGGER", "1", 1);
+    TEST_ASSERT_EQUAL_INT(0, logger_init());
+    logger_set_level(LOG_LEVEL_TRACE);
+    TEST_ASSERT_EQUAL(LOG_LEVEL_OFF, logger_threshold);
+    LOG_ERROR("%d", bump());
+    TEST_ASSERT_EQUAL_INT(1, side_effects);
+    unsetenv("MYSHELL_DISABLE_LOGGER");
+    logger_init();
+    logger_set_level(LOG_LEVEL_OFF);
+    logger_shutdown();
+}
+
+// The threshold is read where a macro is expanded, so the rest of this
+// file is built as if with -DMYSHELL_LOG_MIN_LEVEL=LOG_LEVEL_INFO.
+#undef MYSHELL_LOG_MIN_LEVEL
+#define MYSHELL_LOG_MIN_LEVEL LOG_LEVEL_INFO
+
+void test_logger_compile_time_min_level(void) {
+    unsetenv("MYSHELL_DISABLE_LOGGER");
+    TEST_ASSERT_EQUAL_INT(0, logger_init());
+    logger_set_level(LOG_LEVEL_TRACE);
+    side_effects = 0;
+    LOG_TRACE("%d", bump());
+    LOG_DEBUG("%d", bump());
+    TEST_ASSERT_EQUAL_INT(0, side_effects);
+    LOG_INFO("%d", bump());
+    TEST_ASSERT_EQUAL_INT(1, side_effects);
+    logger_set_level(LOG_LEVEL_OFF);
+    logger_shutdown();
+}
+
+static long file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+static int file_contains(const char *path, const char *needle) {
+    char buf[8192];
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return 0;
+    size_t n = fread(buf, 1, sizeof buf - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+    return strstr(buf, needle) != NULL;
+}
+
+void test_logger_file_sink_and_flush(void) {
+    unsetenv("MYSHELL_DISABLE_LOGGER");
+    char dir[] = "/tmp/myshell_logdir_XXXXXX";
+    TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+    char path[64];
+    snprintf(path, sizeof path, "%s/shell.log", dir);
+    setenv("MYSHELL_LOG_FILE", path, 1);
+    unsetenv("MYSHELL_LOG_MAX_SIZE");
+    TEST_ASSERT_EQUAL_INT(0, logger_init());
+    logger_set_level(LOG_LEVEL_INFO);
+
+    LOG_INFO("first %d", 1);
+    // The barrier returns only once the line is in the file.
+    TEST_ASSERT_EQUAL_INT(0, logger_flush());
+    TEST_ASSERT_TRUE(file_contains(path, "[INFO] tests/test_logger_unity.c: first 1\n"));
+    logger_log(LOG_LEVEL_WARN, "x.c", "second");
+    logger_shutdown();
+    TEST_ASSERT_TRUE(file_contains(path, "[WARN] x.c: second\n"));
+    TEST_ASSERT_EQUAL_INT(-1, logger_flush());
+
+    logger_set_level(LOG_LEVEL_OFF);
+    unsetenv("MYSHELL_LOG_FILE");
+    unlink(path);
+    rmdir(dir);
+}
+
+void test_logger_file_rotation_by_size(void) {
+    unsetenv("MYSHELL_DISABLE_LOGGER");
+    char dir[] = "/tmp/myshell_logdir_XXXXXX";
+    TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+    char path[64], rotated[80];
+    snprintf(path, sizeof path, "%s/shell.log", dir);
+    setenv("MYSHELL_LOG_FILE", path, 1);
+    setenv("MYSHELL_LOG_MAX_SIZE", "2k", 1);
+    TEST_ASSERT_EQUAL_INT(0, logger_init());
+    logger_set_level(LOG_LEVEL_INFO);
+
+    // ~80 bytes per line, one write per line: about 4 files' worth.
+    for (int i = 0; i < 100; ++i) {
+        LOG_INFO("rotation line %03d padding padding padding", i);
+        TEST_ASSERT_EQUAL_INT(0, logger_flush());
+    }
+    logger_shutdown();
+    logger_set_level(LOG_LEVEL_OFF);
+    unsetenv("MYSHELL_LOG_FILE");
+    unsetenv("MYSHELL_LOG_MAX_SIZE");
+
+    TEST_ASSERT_TRUE(file_contains(path, "rotation line 099"));
+    TEST_ASSERT_TRUE(file_size(path) <= 2048);
+    for (int i = 1; i <= 4; ++i) {
+        snprintf(rotated, sizeof rotated, "%s.%d", path, i);
+        if (i <= 3) {
+            TEST_ASSERT_TRUE(file_size(rotated) > 0);
+            TEST_ASSERT_TRUE(file_size(rotated) <= 2048);
+        } else {
+            TEST_ASSERT_EQUAL_INT(-1, file_size(rotated)); // only 3 are kept
+        }
+        unlink(rotated);
+    }
+    unlink(path);
+    TEST_ASSERT_EQUAL_INT(0, rmdir(dir));
+}
+
+static int thread_count(void) {
+    int n = 0;
+    DIR *d = opendir("/proc/self/task");
+    if (!d)
+        return -1;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL)
+        n += e->d_name[0] != '.';
+    closedir(d);
+    return n;
+}
+
+void test_logger_thread_starts_on_first_record(void) {
+    unsetenv("MYSHELL_DISABLE_LOGGER");
+    int base = thread_count();
+    TEST_ASSERT_TRUE(base > 0);
+    TEST_ASSERT_EQUAL_INT(0, logger_init());
+    logger_set_level(LOG_LEVEL_WARN);
+    LOG_INFO("below the level: no record, no thread");
+    TEST_ASSERT_EQUAL_INT(base, thread_count());
+    TEST_ASSERT_EQUAL_INT(0, logger_flush()); // nothing pending
+    LOG_WARN("first record");
+    TEST_ASSERT_EQUAL_INT(base + 1, thread_count());
+    logger_shutdown();
+    TEST_ASSERT_EQUAL_INT(base, thread_count());
+
+    // A shell that never logs never starts the thread.
+    TEST_ASSERT_EQUAL_INT(0, logger_init());
+    logger_set_level(LOG_LEVEL_OFF);
+    TEST_ASSERT_EQUAL_INT(base, thread_count());
+    logger_shutdown();
+    // Records after shutdown are discarded rather than restarting it.
+    logger_set_level(LOG_LEVEL_WARN);
+    LOG_WARN("after shutdown");
+    TEST_ASSERT_EQUAL_INT(base, thread_count());
+    logger_set_level(LOG_LEVEL_OFF);
+}
@@ -2,8 +2,10 @@
 #include "lexer.h"
 #include "parser.h"
 #include "unity.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 // Test functions only - setUp/tearDown and main are in test_runner.c
 
@@ -55,4 +57,85 @@ void test_parser_pipeline(void) {
     lexer_free(lexer);
 }
 
+void test_parser_more_than_eight_redirections(void) {
+    // Ten redirections of stdout: all files are created, the last one wins
+    char line[512] = "echo ten";
+    char path[64];
+    for (int i = 0; i < 10; ++i) {
+        snprintf(path, sizeof path, " > /tmp/myshell_parser_redir_%d", i);
+        strcat(line, path);
+    }
+    lexer_t *lexer = lexer_create(line);
+    parser_t *parser = parser_create(lexer);
+    ast_node_t *ast = parser_parse(parser);
+    TEST_ASSERT_NOT_NULL(ast);
+    TEST_ASSERT_EQUAL(0, exec_ast(ast));
+    ast_free(ast);
+    parser_free(parser);
+    lexer_free(lexer);
+
+    for (int i = 0; i < 10; ++i) {
+        snprintf(path, sizeof path, "/tmp/myshell_parser_redir_%d", i);
+        FILE *f = fopen(path, "r");
+        TEST_ASSERT_NOT_NULL(f);
+        char buf[16] = "";
+        TEST_ASSERT_EQUAL(i == 9 ? 4 : 0, (int)fread(buf, 1, sizeof buf, f));
+        fclose(f);
+        unlink(path);
+    }
+}
+
 // End of parser tests
+
+// Parse text as a script; returns the parser's error flag.
+static int parse_program_error(const char *text) {
+    lexer_t *lexer = lexer_create(text);
+    parser_t *parser = parser_create(lexer);
+    int error = -1;
+    ast_node_t *ast = parser_parse_program(parser, &error);
+    ast_free(ast);
+    parser_free(parser);
+    lexer_free(lexer);
+    return error;
+}
+
+void test_parser_compound_commands(void) {
+    TEST_ASSERT_EQUAL(0, parse_program_error("if a; then b; elif c\nthen d; else e; fi"));
+    TEST_ASSERT_EQUAL(0, parse_program_error("while a; do b; done; until a\ndo\nb\ndone"));
+    TEST_ASSERT_EQUAL(0, parse_program_error("for x in a 'b c'; do echo $x; done; for y\ndo :; done"));
+    TEST_ASSERT_EQUAL(0, parse_program_error("case $v in\n(a|b) x;;\n*) ;;\nc) y\nesac"));
+    TEST_ASSERT_EQUAL(0, parse_program_error("echo if then fi; 'if' x"));
+
+    TEST_ASSERT_EQUAL(1, parse_program_error("if a; then b"));
+    TEST_ASSERT_EQUAL(1, parse_program_error("while a; do done"));
+    TEST_ASSERT_EQUAL(1, parse_program_error("for 1 in a; do b; done"));
+    TEST_ASSERT_EQUAL(1, parse_program_error("case a in b) c;; d"));
+    TEST_ASSERT_EQUAL(1, parse_program_error("echo a; fi"));
+}
+
+static parser_status_t parse_input_status(const char *text) {
+    lexer_t *lexer = lexer_create(text);
+    parser_t *parser = parser_create(lexer);
+    parser_status_t status;
+    ast_node_t *ast = parser_parse_input(parser, &status);
+    ast_free(ast);
+    parser_free(parser);
+    lexer_free(lexer);
+    return status;
+}
+
+void test_parser_input_incomplete(void) {
+    TEST_ASSERT_EQUAL(PARSER_OK, parse_input_status("echo a; echo b\n"));
+    TEST_ASSERT_EQUAL(PARSER_OK, parse_input_status(""));
+    TEST_ASSERT_EQUAL(PARSER_OK, parse_input_status("for i in 1 2\ndo\n echo $i\ndone"));
+
+    TEST_ASSERT_EQUAL(PARSER_INCOMPLETE, parse_input_status("for i in 1 2"));
+    TEST_ASSERT_EQUAL(PARSER_INCOMPLETE, parse_input_status("if a; then\n b"));
+    TEST_ASSERT_EQUAL(PARSER_INCOMPLETE, parse_input_status("case x in\n a) b;;"));
+    TEST_ASSERT_EQUAL(PARSER_INCOMPLETE, parse_input_status("f() {\n echo"));
+    TEST_ASSERT_EQUAL(PARSER_INCOMPLETE, parse_input_status("(echo a"));
+    TEST_ASSERT_EQUAL(PARSER_INCOMPLETE, parse_input_status("echo a |"));
+
+    TEST_ASSERT_EQUAL(PARSER_ERROR, parse_input_status("echo a )"));
+    TEST_ASSERT_EQUAL(PARSER_ERROR, parse_input_status("while a; do done"));
+}
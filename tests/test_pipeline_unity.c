@@ -1,7 +1,10 @@
 #include "ast.h"
+#include "exec.h"
 #include "pipeline.h"
 #include "unity.h"
+#include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 void test_pipeline_execute_null_commands(void) {
     // Test with NULL commands array
@@ -172,3 +175,34 @@ void test_pipeline_execute_three_commands(void) {
         TEST_ASSERT_TRUE(1);
     }
 }
+
+void test_pipeline_execute_many_stages(void) {
+    // 40 stages: well past the old 16-stage flattening limit. The first
+    // stage lists its own descriptors; each stage should see only 0, 1, 2
+    // (plus the directory handle ls opens itself).
+    char path[] = "/tmp/myshell_pipeline_XXXXXX";
+    int fd = mkstemp(path);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    close(fd);
+
+    char *ls_argv[] = {"ls", "/proc/self/fd", NULL};
+    char *cat_argv[] = {"cat", NULL};
+    char *wc_argv[] = {"wc", "-l", NULL};
+    ast_node_t *tree = ast_create_command(ls_argv);
+    for (int i = 1; i < 39; ++i)
+        tree = ast_create_pipeline(tree, ast_create_command(cat_argv));
+    ast_node_t *last = ast_create_command(wc_argv);
+    ast_command_add_redirection(last, STDOUT_FILENO, REDIR_OUTPUT, path);
+    tree = ast_create_pipeline(tree, last);
+
+    TEST_ASSERT_EQUAL(0, exec_ast(tree));
+    ast_free(tree);
+
+    char buf[32] = {0};
+    FILE *f = fopen(path, "r");
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_NOT_NULL(fgets(buf, sizeof buf, f));
+    fclose(f);
+    unlink(path);
+    TEST_ASSERT_EQUAL(4, atoi(buf));
+}
@@ -3,6 +3,7 @@
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 void test_redir_create_input(void) {
@@ -184,3 +185,48 @@ void test_redir_all_types(void) {
     if (append)
         redir_free(append);
 }
+
+void test_redir_setup_cleanup_restores_fd(void) {
+    // Redirect fd 1 to a file and verify cleanup restores the original target
+    char path[] = "/tmp/myshell_redir_XXXXXX";
+    int tmp = mkstemp(path);
+    TEST_ASSERT_NOT_EQUAL(-1, tmp);
+    close(tmp);
+
+    struct stat before, during, after;
+    TEST_ASSERT_EQUAL(0, fstat(STDOUT_FILENO, &before));
+    redir_t *redir = redir_create(REDIR_OUTPUT, STDOUT_FILENO, path);
+    TEST_ASSERT_EQUAL(0, redir_setup(redir));
+    TEST_ASSERT_EQUAL(0, fstat(STDOUT_FILENO, &during));
+    TEST_ASSERT_FALSE(before.st_ino == during.st_ino && before.st_dev == during.st_dev);
+    redir_cleanup(redir);
+    TEST_ASSERT_EQUAL(0, fstat(STDOUT_FILENO, &after));
+    TEST_ASSERT_TRUE(before.st_ino == after.st_ino && before.st_dev == after.st_dev);
+    redir_free(redir);
+    unlink(path);
+}
+
+void test_redir_stack_push_unwind(void) {
+    char path[] = "/tmp/myshell_redir_XXXXXX";
+    int tmp = mkstemp(path);
+    TEST_ASSERT_NOT_EQUAL(-1, tmp);
+    close(tmp);
+
+    redir_stack_t stack;
+    redir_stack_init(&stack);
+    TEST_ASSERT_EQUAL(0, redir_stack_push(&stack, REDIR_OUTPUT, 12, path));
+    TEST_ASSERT_EQUAL(1, stack.depth);
+    TEST_ASSERT_TRUE(write(12, "data", 4) == 4);
+    // A failing push leaves the stack unchanged
+    TEST_ASSERT_EQUAL(-1, redir_stack_push(&stack, REDIR_INPUT, 13, "/nonexistent/file"));
+    TEST_ASSERT_EQUAL(1, stack.depth);
+    redir_stack_unwind(&stack);
+    TEST_ASSERT_EQUAL(0, stack.depth);
+    // fd 12 was closed before the push, so unwinding closes it again
+    TEST_ASSERT_EQUAL(-1, fcntl(12, F_GETFD));
+
+    struct stat st;
+    TEST_ASSERT_EQUAL(0, stat(path, &st));
+    TEST_ASSERT_EQUAL(4, st.st_size);
+    unlink(path);
+}
@@ -14,12 +14,21 @@ void test_lexer_multiple_words(void);
 void test_lexer_pipe_token(void);
 void test_lexer_redirection_tokens(void);
 void test_lexer_special_characters(void);
+void test_lexer_expansion_groups_and_arith(void);
+void test_lexer_marks_quoted_arith(void);
+void test_lexer_command_substitution_groups(void);
+void test_lexer_marks_quoted_substitutions(void);
+void test_lexer_next_returns_views(void);
+void test_lexer_newlines_comments_and_continuations(void);
 
 // Parser tests
 void test_parser_create_and_free(void);
 void test_parser_simple_command(void);
 void test_parser_empty_input(void);
 void test_parser_pipeline(void);
+void test_parser_more_than_eight_redirections(void);
+void test_parser_compound_commands(void);
+void test_parser_input_incomplete(void);
 
 // AST tests
 void test_ast_free_null(void);
@@ -37,6 +46,24 @@ void test_env_set_and_get(void);
 void test_env_unset(void);
 void test_expand_variables_simple(void);
 void test_expand_variables_no_expansion(void);
+void test_env_assign_is_not_exported(void);
+void test_env_export_before_assign(void);
+void test_env_invalid_names(void);
+void test_env_many_variables_and_self_assignment(void);
+void test_expand_word_plain_is_not_copied(void);
+void test_expand_word_braced_forms(void);
+void test_expand_command_substitution_fields(void);
+void test_expand_positional_parameters(void);
+
+// Arithmetic tests
+void test_arith_precedence_and_operators(void);
+void test_arith_variables_and_assignment(void);
+void test_arith_errors(void);
+
+// Arena tests
+void test_arena_alloc_aligned_and_distinct(void);
+void test_arena_mark_release_reuses_memory(void);
+void test_arena_adopt_moves_allocations(void);
 
 // Utility tests
 void test_strdup_safe(void);
@@ -69,6 +96,33 @@ void test_exec_nonexistent_command(void);
 void test_exec_pipeline_creation(void);
 void test_exec_empty_command(void);
 void test_exec_builtin_simulation(void);
+void test_exec_builtin_with_redirection_runs_in_shell(void);
+void test_exec_assignment_sets_shell_variable(void);
+void test_exec_capture_in_process_and_forked(void);
+void test_exec_capture_in_pipeline_after_parent_capture(void);
+void test_exec_control_flow(void);
+void test_exec_quoted_substitution_is_literal(void);
+void test_exec_unquoted_expansions_are_split(void);
+void test_exec_arith_error_skips_command(void);
+void test_exec_bad_substitution_skips_command(void);
+void test_exec_quoted_arith_is_literal(void);
+void test_exec_expansion_error_skips_for_and_case(void);
+void test_func_body_outlives_definition_tree(void);
+void test_func_redefined_while_running(void);
+void test_func_local_frames_restore(void);
+void test_func_return_and_recursion(void);
+
+// Compiled script cache tests
+void test_astcache_compiled_script_runs_from_cache(void);
+void test_astcache_stale_or_corrupt_cache_misses(void);
+void test_astcache_dir_follows_shell_variables(void);
+
+// Bytecode VM tests
+void test_vm_matches_tree_lists_and_conditionals(void);
+void test_vm_matches_tree_loops_and_functions(void);
+void test_vm_matches_tree_errexit_and_exit(void);
+void test_vm_matches_tree_expansion_errors(void);
+void test_vm_long_list_runs_flat(void);
 
 // Builtin tests
 void test_builtin_find_existing(void);
@@ -84,6 +138,10 @@ void test_builtin_export(void);
 void test_builtin_unset(void);
 void test_builtin_type(void);
 void test_builtin_find_all_core_builtins(void);
+void test_builtin_echo_options(void);
+void test_builtin_printf_formats(void);
+void test_builtin_test_expressions(void);
+void test_builtin_true_false_colon(void);
 
 // Plugin tests
 void test_plugin_load_null_path(void);
@@ -115,6 +173,8 @@ void test_redir_setup_nonexistent_input(void);
 void test_redir_invalid_fd(void);
 void test_redir_large_fd(void);
 void test_redir_all_types(void);
+void test_redir_setup_cleanup_restores_fd(void);
+void test_redir_stack_push_unwind(void);
 
 // Terminal tests
 void test_term_get_size(void);
@@ -141,6 +201,15 @@ void test_evloop_add_write_event_and_trigger(void);
 void test_evloop_remove_fd_not_found(void);
 void test_evloop_run_null_loop_returns_error(void);
 void test_evloop_two_fds_callbacks_and_stop(void);
+void test_evloop_backends_remove_during_dispatch(void);
+void test_evloop_backend_selection(void);
+void test_evloop_add_duplicate_and_mod_unregistered(void);
+void test_evloop_backends_mod_fd(void);
+void test_evloop_backends_oneshot(void);
+void test_evloop_epoll_edge_triggered(void);
+void test_evloop_backends_timers(void);
+void test_evloop_timer_outlasts_run_timeout(void);
+void test_evloop_defer_runs_next_iteration(void);
 
 // Logger tests
 void test_logger_init_shutdown_idempotent(void);
@@ -149,6 +218,14 @@ void test_logger_log_calls_do_not_crash(void);
 void test_logger_disabled_env(void);
 void test_logger_vlog_variadic_path(void);
 void test_logger_level_gating(void);
+void test_logger_concurrent_producers_ordered(void);
+void test_logger_long_message_truncated(void);
+void test_logger_deferred_formatting_matches_printf(void);
+void test_logger_disabled_levels_skip_arguments(void);
+void test_logger_compile_time_min_level(void);
+void test_logger_file_sink_and_flush(void);
+void test_logger_file_rotation_by_size(void);
+void test_logger_thread_starts_on_first_record(void);
 
 // Shell tests
 void test_shell_init(void);
@@ -172,8 +249,12 @@ void test_shell_run_file_shebang_skipped(void);
 void test_shell_run_file_errexit_stops_on_error(void);
 void test_shell_run_file_errexit_off_allows_continue(void);
 void test_shell_run_file_xtrace_does_not_change_status(void);
+void test_shell_run_file_from_pipe(void);
 void test_shell_source_semantics_env_persists(void);
 void test_shell_set_builtin_toggles_flags(void);
+void test_shell_run_file_parses_multiline_commands(void);
+void test_shell_run_file_syntax_error_runs_nothing(void);
+void test_shell_main_reads_multiline_commands(void);
 
 // Pipeline tests
 void test_pipeline_execute_null_commands(void);
@@ -186,6 +267,27 @@ void test_pipeline_execute_mixed_commands(void);
 void test_pipeline_execute_large_count(void);
 void test_pipeline_execute_echo_cat(void);
 void test_pipeline_execute_three_commands(void);
+void test_pipeline_execute_many_stages(void);
+
+// Launch (spawn engine) tests
+void test_launch_spawn_null_argv(void);
+void test_launch_external_status(void);
+void test_launch_external_not_found(void);
+void test_launch_external_output_redirection(void);
+void test_launch_external_redirections_do_not_collide(void);
+void test_launch_external_missing_input_file(void);
+
+// Command hash tests
+void test_cmdhash_lookup_fills_table(void);
+void test_cmdhash_lookup_rejects_paths_and_missing(void);
+void test_cmdhash_path_assignment_invalidates(void);
+void test_cmdhash_add_and_remove(void);
+void test_builtin_hash_options(void);
+
+// Child supervision tests
+void test_childwatch_wait_without_init_uses_waitpid(void);
+void test_childwatch_wait_reaps_from_loop(void);
+void test_childwatch_reports_stop_and_exit(void);
 
 // Global variables to store original file descriptors
 static int original_stdout = -1;
@@ -244,6 +346,12 @@ int main(void) {
     RUN_TEST(test_lexer_pipe_token);
     RUN_TEST(test_lexer_redirection_tokens);
     RUN_TEST(test_lexer_special_characters);
+    RUN_TEST(test_lexer_expansion_groups_and_arith);
+    RUN_TEST(test_lexer_marks_quoted_arith);
+    RUN_TEST(test_lexer_command_substitution_groups);
+    RUN_TEST(test_lexer_marks_quoted_substitutions);
+    RUN_TEST(test_lexer_next_returns_views);
+    RUN_TEST(test_lexer_newlines_comments_and_continuations);
 
     // Parser tests
     printf("=== Running Parser Tests ===\n");
@@ -251,6 +359,9 @@ int main(void) {
     RUN_TEST(test_parser_simple_command);
     RUN_TEST(test_parser_empty_input);
     RUN_TEST(test_parser_pipeline);
+    RUN_TEST(test_parser_more_than_eight_redirections);
+    RUN_TEST(test_parser_compound_commands);
+    RUN_TEST(test_parser_input_incomplete);
 
     // AST tests
     printf("=== Running AST Tests ===\n");
@@ -270,6 +381,26 @@ int main(void) {
     RUN_TEST(test_env_unset);
     RUN_TEST(test_expand_variables_simple);
     RUN_TEST(test_expand_variables_no_expansion);
+    RUN_TEST(test_env_assign_is_not_exported);
+    RUN_TEST(test_env_export_before_assign);
+    RUN_TEST(test_env_invalid_names);
+    RUN_TEST(test_env_many_variables_and_self_assignment);
+    RUN_TEST(test_expand_word_plain_is_not_copied);
+    RUN_TEST(test_expand_word_braced_forms);
+    RUN_TEST(test_expand_command_substitution_fields);
+    RUN_TEST(test_expand_positional_parameters);
+
+    // Arithmetic tests
+    printf("=== Running Arithmetic Tests ===\n");
+    RUN_TEST(test_arith_precedence_and_operators);
+    RUN_TEST(test_arith_variables_and_assignment);
+    RUN_TEST(test_arith_errors);
+
+    // Arena tests
+    printf("=== Running Arena Tests ===\n");
+    RUN_TEST(test_arena_alloc_aligned_and_distinct);
+    RUN_TEST(test_arena_mark_release_reuses_memory);
+    RUN_TEST(test_arena_adopt_moves_allocations);
 
     // Utility tests
     printf("=== Running Utility Tests ===\n");
@@ -305,6 +436,38 @@ int main(void) {
     RUN_TEST(test_exec_pipeline_creation);
     RUN_TEST(test_exec_empty_command);
     RUN_TEST(test_exec_builtin_simulation);
+    RUN_TEST(test_exec_builtin_with_redirection_runs_in_shell);
+    RUN_TEST(test_exec_assignment_sets_shell_variable);
+    RUN_TEST(test_exec_capture_in_process_and_forked);
+    RUN_TEST(test_exec_capture_in_pipeline_after_parent_capture);
+    RUN_TEST(test_exec_control_flow);
+    RUN_TEST(test_exec_quoted_substitution_is_literal);
+    RUN_TEST(test_exec_unquoted_expansions_are_split);
+    RUN_TEST(test_exec_arith_error_skips_command);
+    RUN_TEST(test_exec_bad_substitution_skips_command);
+    RUN_TEST(test_exec_quoted_arith_is_literal);
+    RUN_TEST(test_exec_expansion_error_skips_for_and_case);
+
+    // Function tests
+    printf("=== Running Function Tests ===\n");
+    RUN_TEST(test_func_body_outlives_definition_tree);
+    RUN_TEST(test_func_redefined_while_running);
+    RUN_TEST(test_func_local_frames_restore);
+    RUN_TEST(test_func_return_and_recursion);
+
+    // Compiled script cache tests
+    printf("=== Running Compiled Script Cache Tests ===\n");
+    RUN_TEST(test_astcache_compiled_script_runs_from_cache);
+    RUN_TEST(test_astcache_stale_or_corrupt_cache_misses);
+    RUN_TEST(test_astcache_dir_follows_shell_variables);
+
+    // Bytecode VM tests
+    printf("=== Running Bytecode VM Tests ===\n");
+    RUN_TEST(test_vm_matches_tree_lists_and_conditionals);
+    RUN_TEST(test_vm_matches_tree_loops_and_functions);
+    RUN_TEST(test_vm_matches_tree_errexit_and_exit);
+    RUN_TEST(test_vm_matches_tree_expansion_errors);
+    RUN_TEST(test_vm_long_list_runs_flat);
 
     // Builtin tests
     printf("=== Running Builtin Tests ===\n");
@@ -321,6 +484,10 @@ int main(void) {
     RUN_TEST(test_builtin_unset);
     RUN_TEST(test_builtin_type);
     RUN_TEST(test_builtin_find_all_core_builtins);
+    RUN_TEST(test_builtin_echo_options);
+    RUN_TEST(test_builtin_printf_formats);
+    RUN_TEST(test_builtin_test_expressions);
+    RUN_TEST(test_builtin_true_false_colon);
 
     // Plugin tests
     printf("=== Running Plugin Tests ===\n");
@@ -354,6 +521,8 @@ int main(void) {
     RUN_TEST(test_redir_invalid_fd);
     RUN_TEST(test_redir_large_fd);
     RUN_TEST(test_redir_all_types);
+    RUN_TEST(test_redir_setup_cleanup_restores_fd);
+    RUN_TEST(test_redir_stack_push_unwind);
 
     // Terminal tests
     printf("=== Running Terminal Tests ===\n");
@@ -382,6 +551,15 @@ int main(void) {
     RUN_TEST(test_evloop_remove_fd_not_found);
     RUN_TEST(test_evloop_run_null_loop_returns_error);
     RUN_TEST(test_evloop_two_fds_callbacks_and_stop);
+    RUN_TEST(test_evloop_backends_remove_during_dispatch);
+    RUN_TEST(test_evloop_backend_selection);
+    RUN_TEST(test_evloop_add_duplicate_and_mod_unregistered);
+    RUN_TEST(test_evloop_backends_mod_fd);
+    RUN_TEST(test_evloop_backends_oneshot);
+    RUN_TEST(test_evloop_epoll_edge_triggered);
+    RUN_TEST(test_evloop_backends_timers);
+    RUN_TEST(test_evloop_timer_outlasts_run_timeout);
+    RUN_TEST(test_evloop_defer_runs_next_iteration);
 
     // Logger tests
     printf("=== Running Logger Tests ===\n");
@@ -391,6 +569,14 @@ int main(void) {
     RUN_TEST(test_logger_disabled_env);
     RUN_TEST(test_logger_vlog_variadic_path);
     RUN_TEST(test_logger_level_gating);
+    RUN_TEST(test_logger_concurrent_producers_ordered);
+    RUN_TEST(test_logger_long_message_truncated);
+    RUN_TEST(test_logger_deferred_formatting_matches_printf);
+    RUN_TEST(test_logger_disabled_levels_skip_arguments);
+    RUN_TEST(test_logger_compile_time_min_level);
+    RUN_TEST(test_logger_file_sink_and_flush);
+    RUN_TEST(test_logger_file_rotation_by_size);
+    RUN_TEST(test_logger_thread_starts_on_first_record);
 
     // Shell tests
     printf("=== Running Shell Tests ===\n");
@@ -414,8 +600,12 @@ int main(void) {
     RUN_TEST(test_shell_run_file_errexit_stops_on_error);
     RUN_TEST(test_shell_run_file_errexit_off_allows_continue);
     RUN_TEST(test_shell_run_file_xtrace_does_not_change_status);
+    RUN_TEST(test_shell_run_file_from_pipe);
     RUN_TEST(test_shell_source_semantics_env_persists);
     RUN_TEST(test_shell_set_builtin_toggles_flags);
+    RUN_TEST(test_shell_run_file_parses_multiline_commands);
+    RUN_TEST(test_shell_run_file_syntax_error_runs_nothing);
+    RUN_TEST(test_shell_main_reads_multiline_commands);
 
     // Pipeline tests
     printf("=== Running Pipeline Tests ===\n");
@@ -429,6 +619,30 @@ int main(void) {
     RUN_TEST(test_pipeline_execute_large_count);
     RUN_TEST(test_pipeline_execute_echo_cat);
     RUN_TEST(test_pipeline_execute_three_commands);
+    RUN_TEST(test_pipeline_execute_many_stages);
+
+    // Launch tests
+    printf("=== Running Launch Tests ===\n");
+    RUN_TEST(test_launch_spawn_null_argv);
+    RUN_TEST(test_launch_external_status);
+    RUN_TEST(test_launch_external_not_found);
+    RUN_TEST(test_launch_external_output_redirection);
+    RUN_TEST(test_launch_external_redirections_do_not_collide);
+    RUN_TEST(test_launch_external_missing_input_file);
+
+    // Command hash tests
+    printf("=== Running Command Hash Tests ===\n");
+    RUN_TEST(test_cmdhash_lookup_fills_table);
+    RUN_TEST(test_cmdhash_lookup_rejects_paths_and_missing);
+    RUN_TEST(test_cmdhash_path_assignment_invalidates);
+    RUN_TEST(test_cmdhash_add_and_remove);
+    RUN_TEST(test_builtin_hash_options);
+
+    // Child supervision tests
+    printf("=== Running Child Watch Tests ===\n");
+    RUN_TEST(test_childwatch_wait_without_init_uses_waitpid);
+    RUN_TEST(test_childwatch_wait_reaps_from_loop);
+    RUN_TEST(test_childwatch_reports_stop_and_exit);
 
     return UNITY_END();
 }
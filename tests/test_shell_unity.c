@@ -242,6 +242,30 @@ void test_shell_run_file_xtrace_does_not_change_status(void) {
     free(path);
 }
 
+void test_shell_run_file_from_pipe(void) {
+    // A pipe reports size 0 and cannot be mapped; the script is read instead
+    int p[2];
+    TEST_ASSERT_EQUAL(0, pipe(p));
+    const char script[] = "TEST_PIPED=$((6 * 7))\nexit 5\n";
+    TEST_ASSERT_EQUAL((ssize_t)strlen(script), write(p[1], script, strlen(script)));
+    close(p[1]);
+    char path[32];
+    snprintf(path, sizeof path, "/dev/fd/%d", p[0]);
+    shell_running = 1;
+    TEST_ASSERT_EQUAL(5, shell_run_file(path));
+    TEST_ASSERT_EQUAL_STRING("42", env_get("TEST_PIPED"));
+    close(p[0]);
+    env_unset("TEST_PIPED");
+    shell_running = 1;
+
+    // --compile refuses what it could not key a cache entry on
+    TEST_ASSERT_EQUAL(0, pipe(p));
+    close(p[1]);
+    snprintf(path, sizeof path, "/dev/fd/%d", p[0]);
+    TEST_ASSERT_EQUAL(1, shell_compile_file(path));
+    close(p[0]);
+}
+
 void test_shell_source_semantics_env_persists(void) {
     // Script exports a variable; it should persist in the current process
     char *path = write_temp_script("export FOO=bar\n");
@@ -319,3 +343,58 @@ void test_shell_set_builtin_toggles_flags(void) {
     (void)env_unset("T1");
     (void)env_unset("T2");
 }
+
+void test_shell_run_file_parses_multiline_commands(void) {
+    (void)env_unset("ML_A");
+    (void)env_unset("ML_B");
+    char *path = write_temp_script(
+        "# comment\n"
+        "\n"
+        "(export ML_A=sub\n"
+        " true) && \\\n"
+        "  export ML_A=ok   # trailing comment\n"
+        "false\n"
+        "export ML_B=$?; exit 5\n"
+        "export ML_B=not-reached\n");
+    char *argvv[] = {"myshell", path, NULL};
+    TEST_ASSERT_EQUAL(5, shell_main(2, argvv));
+    TEST_ASSERT_EQUAL_STRING("ok", env_get("ML_A"));
+    TEST_ASSERT_EQUAL_STRING("1", env_get("ML_B"));
+    unlink(path);
+    free(path);
+    (void)env_unset("ML_A");
+    (void)env_unset("ML_B");
+}
+
+void test_shell_run_file_syntax_error_runs_nothing(void) {
+    (void)env_unset("SE_A");
+    char *path = write_temp_script("export SE_A=ran\necho ok |\n");
+    char *argvv[] = {"myshell", path, NULL};
+    TEST_ASSERT_EQUAL(2, shell_main(2, argvv));
+    TEST_ASSERT_NULL(env_get("SE_A"));
+    unlink(path);
+    free(path);
+}
+
+void test_shell_main_reads_multiline_commands(void) {
+    (void)env_unset("MLI_A");
+    (void)env_unset("MLI_B");
+    int rc = run_shell_with_input("for i in 1 2\n"
+                                  "do\n"
+                                  "  MLI_A=$MLI_A$i\n"
+                                  "done\n"
+                                  "f() {\n"
+                                  "  MLI_B=$1\n"
+                                  "}\n"
+                                  "f called\n");
+    TEST_ASSERT_EQUAL(0, rc);
+    TEST_ASSERT_EQUAL_STRING("12", env_get("MLI_A"));
+    TEST_ASSERT_EQUAL_STRING("called", env_get("MLI_B"));
+
+    // A real syntax error is status 2; a command cut off by EOF is reported
+    TEST_ASSERT_EQUAL(2, run_shell_with_input("echo a )\n"));
+    TEST_ASSERT_EQUAL(2, run_shell_with_input("MLI_A=no\nwhile true; do\n  MLI_A=loop\n"));
+    TEST_ASSERT_EQUAL_STRING("no", env_get("MLI_A"));
+    (void)env_unset("MLI_A");
+    (void)env_unset("MLI_B");
+}
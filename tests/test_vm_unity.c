@@ -0,0 +1,166 @@
+#include "env.h"
+#include "exec.h"
+#include "func.h"
+#include "parser.h"
+#include "shell.h"
+#include "unity.h"
+#include "vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+extern int shell_running;
+
+#define OUT_SIZE 4096
+
+/** What a program left behind: status, stdout, $R and $?. */
+typedef struct {
+    int status;
+    char out[OUT_SIZE];
+    char r[OUT_SIZE];
+    int last;
+} outcome_t;
+
+// Run text with one engine, starting from the same state each time.
+static void run_engine(exec_engine_t engine, const char *text, int errexit, outcome_t *o) {
+    func_clear();
+    env_unset("R");
+    shell_set_last_status(0);
+    shell_set_errexit(errexit);
+    exec_set_engine(engine);
+
+    lexer_t *lexer = lexer_create(text);
+    parser_t *parser = parser_create(lexer);
+    ast_node_t *ast = parser_parse_program(parser, NULL);
+    TEST_ASSERT_NOT_NULL_MESSAGE(ast, text);
+
+    fflush(stdout);
+    FILE *tmp = tmpfile();
+    int saved = dup(STDOUT_FILENO);
+    dup2(fileno(tmp), STDOUT_FILENO);
+    o->status = exec_program(ast);
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    rewind(tmp);
+    size_t n = fread(o->out, 1, OUT_SIZE - 1, tmp);
+    o->out[n] = '\0';
+    fclose(tmp);
+
+    const char *r = env_get("R");
+    snprintf(o->r, sizeof o->r, "%s", r ? r : "<unset>");
+    o->last = shell_get_last_status();
+    ast_free(ast);
+    parser_free(parser);
+    lexer_free(lexer);
+
+    shell_running = 1;
+    shell_set_errexit(0);
+    exec_set_engine(EXEC_ENGINE_TREE);
+    func_clear();
+}
+
+// The VM must leave exactly what the tree walker leaves.
+static void check_same(const char *text, int errexit) {
+    static outcome_t tree, vm;
+    run_engine(EXEC_ENGINE_TREE, text, errexit, &tree);
+    run_engine(EXEC_ENGINE_VM, text, errexit, &vm);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(tree.status, vm.status, text);
+    TEST_ASSERT_EQUAL_STRING_MESSAGE(tree.out, vm.out, text);
+    TEST_ASSERT_EQUAL_STRING_MESSAGE(tree.r, vm.r, text);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(tree.last, vm.last, text);
+}
+
+void test_vm_matches_tree_lists_and_conditionals(void) {
+    check_same("R=a; R=$R-b; false; R=$R-c; echo $R", 0);
+    check_same("true && R=1 || R=2; false && R=$R-3 || R=$R-4; false || false && R=$R-5; echo $R $?",
+               0);
+    check_same("for v in 1 2 3 4; do if [ $v = 1 ]; then R=$R-one; elif [ $v = 2 ]; then "
+               "R=$R-two; elif false; then :; else R=$R-other; fi; done; if false; then :; fi; "
+               "echo $R $?",
+               0);
+    check_same("if false; then R=no; elif true; then R=yes; false; fi", 0);
+    check_same("for w in apple banana cherry 'x y' ''; do case $w in a*|b*) R=$R-ab ;; c*) ;; "
+               "'x y') R=$R-xy ;; *) R=$R-none ;; esac; done; case zzz in a) R=no ;; esac; "
+               "echo $R $?",
+               0);
+    check_same("echo one | tr o 0; (R=inner; echo sub $R); echo $R-outer; { echo grouped; }", 0);
+    check_same("missing_command_for_vm_test 2>/dev/null; R=$?", 0);
+}
+
+void test_vm_matches_tree_loops_and_functions(void) {
+    check_same("i=0; while [ $i -lt 10 ]; do i=$((i+1)); case $i in 3) continue ;; 7) break ;; "
+               "esac; R=$R$i; done; until [ $i -eq 0 ]; do i=$((i-1)); done; echo $R $i",
+               0);
+    check_same("for a in 1 2 3; do for b in x y z; do [ $b = y ] && continue 2; "
+               "[ $a = 3 ] && break 2; R=$R$a$b; done; R=$R-never; done; echo $R",
+               0);
+    check_same("while false; do :; done; R=$?; i=0; while [ $i -lt 2 ]; do i=$((i+1)); false; "
+               "done; R=$R$?",
+               0);
+    check_same("f() { for x in 1 2 3; do [ $x = $1 ] && return $x; done; return 9; }; f 2; "
+               "R=$?; f 5; R=$R$?; "
+               "fact() { if [ $1 -le 1 ]; then echo 1; else local n=$1; "
+               "local m=$(fact $((n-1))); echo $((n*m)); fi; }; R=$R-$(fact 5); echo $R",
+               0);
+    check_same("g() { for a; do R=$R$a; done; shift; R=$R-$#; }; g p q r; g", 0);
+    check_same("h() { while true; do R=$R-h; return 3; done; R=$R-no; }; "
+               "for i in 1 2; do h; R=$R$?; done",
+               0);
+    check_same("for x in 1 2; do R=$R$x; continue && R=$R-no; done; "
+               "for x in 1 2; do break || R=$R-no; done; "
+               "k() { return 0 && R=$R-no; }; k; R=$R-k$?",
+               0);
+    check_same("break; R=after; continue 2; R=$R-again", 0);
+}
+
+void test_vm_matches_tree_errexit_and_exit(void) {
+    check_same("R=a; false; R=$R-b", 1);
+    check_same("for x in 1 2; do R=$R$x; false; R=$R-no; done; R=$R-after", 1);
+    check_same("false || R=rescued; false && R=$R-no; R=$R-end", 1);
+    check_same("i=0; while [ $i -lt 3 ]; do i=$((i+1)); R=$R$i; done; R=$R-done", 1);
+    check_same("R=a; for x in 1 2 3; do R=$R$x; [ $x = 2 ] && exit 4; done; R=$R-no", 0);
+    check_same("f() { R=$R-f; exit 6; }; while true; do f; R=$R-no; done", 0);
+}
+
+void test_vm_matches_tree_expansion_errors(void) {
+    int saved_interactive = shell_interactive;
+    shell_interactive = 1;
+    check_same("R=a; for v in $((1/0)) z; do R=$R-$v; done; R=$R-$?", 0);
+    check_same("R=a; case $((1/0)) in *) R=$R-matched ;; esac; R=$R-$?", 0);
+    check_same("R=a; case x in $((1/0))) ;; *) R=$R-star ;; esac; R=$R-$?", 0);
+    shell_interactive = saved_interactive;
+
+    static outcome_t o;
+    run_engine(EXEC_ENGINE_VM, "R=a; for v in $((1/0)); do R=no; done; R=$R-$?", 0, &o);
+    TEST_ASSERT_EQUAL_STRING("a", o.r); // not interactive: the script stops
+}
+
+void test_vm_long_list_runs_flat(void) {
+    // A generated script: one list as long as the script
+    enum { N = 20000 };
+    size_t size = (size_t)N * 24 + 64;
+    char *text = malloc(size);
+    size_t len = 0;
+    for (int i = 0; i < N; ++i)
+        len += (size_t)snprintf(text + len, size - len, "R=$((R + %d))\n", i % 7);
+    len += (size_t)snprintf(text + len, size - len, "echo $R\n");
+    check_same(text, 0);
+
+    lexer_t *lexer = lexer_create(text);
+    parser_t *parser = parser_create(lexer);
+    ast_node_t *ast = parser_parse_program(parser, NULL);
+    vm_program_t *program = vm_compile(ast);
+    // A command and a list test per element, then halt
+    TEST_ASSERT_EQUAL_INT(2 * (N + 1), vm_length(program));
+    vm_free(program);
+    ast_free(ast);
+    parser_free(parser);
+    lexer_free(lexer);
+    free(text);
+
+    vm_program_t *empty = vm_compile(NULL);
+    TEST_ASSERT_EQUAL_INT(-1, vm_run(empty));
+    vm_free(empty);
+}